@@ -0,0 +1,135 @@
+// CPU check of the FieldKernels::ApplyField kernels against the nested loop VectorField::apply_field
+// started from: every instruction set the CPU supports, 1, 3 and 4 channel images and heights
+// that aren't a multiple of the vector width.
+//   apply_field_check
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "FieldKernels.h"
+#include "FieldStorage.h"
+#include "ThreadPool.h"
+
+#include "Check.h"
+
+namespace
+{
+	using Kernel = void (*)(FieldStorage const&, unsigned char const*, unsigned char*, size_t, size_t, size_t, size_t, size_t);
+
+	// The original loop, pixel (i, j) at n * (j + i * x), the first three channels move
+	void ApplyFieldBaseline(FieldStorage const& field, unsigned char const* imageData, unsigned char* newImageData, size_t x, size_t y, size_t n)
+	{
+		for (size_t i = 0; i < x; ++i)
+		{
+			for (size_t j = 0; j < y; ++j)
+			{
+				std::pair<int, int> vec = field.Get(i, j);
+
+				size_t n_i = i + vec.first;
+				size_t n_j = j + vec.second;
+
+				if (n_i < x && n_j < y)
+				{
+					size_t n_ind = n * (n_j + n_i * x);
+					size_t ind = n * (j + i * x);
+
+					for (size_t c = 0; c < n && c < 3; ++c)
+					{
+						newImageData[n_ind + c] = imageData[ind + c];
+					}
+				}
+			}
+		}
+	}
+
+	// Random displacements, constant blocks that take the contiguous store path and a still border
+	FieldStorage MakeField(size_t x, size_t y, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		FieldStorage field(x, y);
+
+		for (size_t i = 0; i < x; ++i)
+		{
+			for (size_t j = 0; j < y; ++j)
+			{
+				if (i < 3)
+				{
+					field.Set(i, j, 0, 0);
+				}
+				else if ((i / 8 + j / 8) % 2 == 0)
+				{
+					field.Set(i, j, (int)(i / 8 % 5) - 2, (int)(j / 8 % 7) - 3);
+				}
+				else
+				{
+					field.Set(i, j, (int)(rng() % 9) - 4, (int)(rng() % 9) - 4);
+				}
+			}
+		}
+
+		return field;
+	}
+
+	void CheckKernels(size_t x, size_t y, size_t n, unsigned seed)
+	{
+		FieldStorage field = MakeField(x, y, seed);
+
+		std::mt19937 rng(seed + 1);
+		std::vector<unsigned char> image(x * y * n);
+		for (auto& channel : image)
+		{
+			channel = (unsigned char)rng();
+		}
+
+		std::vector<unsigned char> reference = image;
+		ApplyFieldBaseline(field, image.data(), reference.data(), x, y, n);
+
+		Kernel const kernels[] = { &FieldKernels::ApplyFieldScalar, &FieldKernels::ApplyFieldSSE41, &FieldKernels::ApplyFieldAVX2 };
+
+		for (int isa = 0; isa <= (int)FieldKernels::DetectISA(); ++isa)
+		{
+			std::vector<unsigned char> result = image;
+			kernels[isa](field, image.data(), result.data(), x, y, n, 0, x);
+			CHECK(result == reference);
+
+			// Column ranges as the workers split them
+			result = image;
+			kernels[isa](field, image.data(), result.data(), x, y, n, 0, x / 3);
+			kernels[isa](field, image.data(), result.data(), x, y, n, x / 3, x);
+			CHECK(result == reference);
+		}
+
+		if (x == y)
+		{
+			std::vector<unsigned char> parallel = image;
+			FieldKernels::ApplyFieldParallel(field, image.data(), parallel.data(), x, y, n);
+			CHECK(parallel == reference);
+		}
+
+		std::vector<unsigned char> dispatched = image;
+		FieldKernels::ApplyField(field, image.data(), dispatched.data(), x, y, n);
+		CHECK(dispatched == reference);
+	}
+}
+
+int main()
+{
+	// Pixel (i, j) is at j + i * x, the image stays in bounds while x <= y
+	size_t const sizes[][2] = { { 8, 8 }, { 29, 29 }, { 40, 45 }, { 33, 61 }, { 64, 67 }, { 96, 96 }, { 128, 131 } };
+	size_t const channels[] = { 1, 3, 4 };
+
+	// Run the parallel path on workers even on a single core box
+	ThreadPool::Get().SetThreadCount(4);
+
+	unsigned seed = 1;
+	for (auto const& size : sizes)
+	{
+		for (size_t n : channels)
+		{
+			CheckKernels(size[0], size[1], n, seed++);
+		}
+	}
+
+	return Check::Result("apply_field_check");
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+
+// Assertions of the CPU checks, a failed one is reported and the check returns 1 from main.
+// Unlike assert they stay active in Release, the checks build with the benchmarks.
+namespace Check
+{
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline void Expect(bool condition, char const* expression, char const* file, int line)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+			++Failures();
+		}
+	}
+
+	inline int Result(char const* name)
+	{
+		if (Failures() != 0)
+		{
+			std::fprintf(stderr, "%s: %d check(s) failed\n", name, Failures());
+			return 1;
+		}
+
+		std::printf("%s: passed\n", name);
+		return 0;
+	}
+}
+
+#define CHECK(condition) Check::Expect((condition), #condition, __FILE__, __LINE__)
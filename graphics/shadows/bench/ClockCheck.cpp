@@ -0,0 +1,167 @@
+// CPU check of AnimationClock: no drift over long jittered runs, exact replays, rate, scale, pause and seek.
+//   clock_check
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "AnimationClock.h"
+
+#include "Check.h"
+
+namespace
+{
+	using ticks_t = AnimationClock::ticks_t;
+
+	// About a day of frames around 60 fps
+	size_t constexpr jitteredFrames = 5000000;
+
+	void CheckDrift()
+	{
+		// 7 steps per second doesn't divide a second, every step is rounded to 142857 ticks
+		AnimationClock clock(7.0);
+		ticks_t const stepTicks = 142857;
+		CHECK(clock.GetRate() == (double)AnimationClock::ticksPerSecond / stepTicks);
+
+		std::mt19937 rng(1);
+		ticks_t now = 1000;
+		ticks_t total = 0;
+		size_t steps = clock.Update(now);
+		CHECK(steps == 0);
+
+		for (size_t i = 0; i < jitteredFrames; ++i)
+		{
+			ticks_t frame = 16000 + rng() % 1500;
+			now += frame;
+			total += frame;
+			steps += clock.Update(now);
+		}
+
+		// Integer ticks: the clock lands exactly where the total wall time says
+		CHECK(steps == (size_t)(total / stepTicks));
+		CHECK(clock.CurrentStep() == steps);
+		CHECK(clock.Alpha() == (float)(total % stepTicks) / stepTicks);
+	}
+
+	void CheckReplay()
+	{
+		AnimationClock recorded(30.0);
+		recorded.StartRecording();
+
+		std::mt19937 rng(2);
+		ticks_t now = 0;
+		std::vector<size_t> steps;
+		for (size_t i = 0; i < 100000; ++i)
+		{
+			now += 1000 + rng() % 40000;
+			steps.push_back(recorded.Update(now));
+		}
+		recorded.StopRecording();
+
+		CHECK(recorded.Recording().size() == steps.size());
+
+		// The wall clock is ignored while replaying, every frame crosses the same steps
+		AnimationClock replayed(30.0);
+		replayed.Replay(recorded.Recording());
+		CHECK(replayed.IsReplaying());
+
+		bool same = true;
+		for (size_t i = 0; i < steps.size(); ++i)
+		{
+			same = same && replayed.Update(AnimationClock::Now()) == steps[i];
+		}
+
+		CHECK(same);
+		CHECK(replayed.CurrentStep() == recorded.CurrentStep());
+		CHECK(replayed.Alpha() == recorded.Alpha());
+
+		// Past the end of the recording nothing moves
+		CHECK(replayed.Update(now + 1000000) == 0);
+
+		// The wall clock restarts from the Update after the replay
+		replayed.StopReplay();
+		CHECK(!replayed.IsReplaying());
+		CHECK(replayed.Update(5000000) == 0);
+		CHECK(replayed.Update(5000000 + 100000) == 3);
+	}
+
+	void CheckAdvance()
+	{
+		AnimationClock clock(10.0);
+		CHECK(clock.Advance(99999) == 0);
+		CHECK(clock.Advance(1) == 1);
+		CHECK(clock.Advance(1000000) == 10);
+		CHECK(clock.Advance(0) == 0);
+		CHECK(clock.Advance(-5) == 0);
+		CHECK(clock.CurrentStep() == 11);
+		CHECK(clock.Alpha() == 0.0f);
+	}
+
+	void CheckSetRate()
+	{
+		AnimationClock clock(4.0);
+		clock.Advance(125000);
+		CHECK(clock.Alpha() == 0.5f);
+
+		// The fraction of the current step survives a rate change
+		clock.SetRate(2.0);
+		CHECK(clock.GetRate() == 2.0);
+		CHECK(clock.Alpha() == 0.5f);
+		CHECK(clock.Advance(249999) == 0);
+		CHECK(clock.Advance(1) == 1);
+		CHECK(clock.CurrentStep() == 1);
+	}
+
+	void CheckScaleAndPause()
+	{
+		// Fractions of a tick carry over, 0.3 of a million milliseconds is 300 steps
+		AnimationClock scaled(1.0);
+		scaled.SetScale(0.3);
+		size_t steps = 0;
+		for (size_t i = 0; i < 1000000; ++i)
+		{
+			steps += scaled.Advance(1000);
+		}
+		CHECK(steps == 300);
+
+		scaled.SetScale(0.0);
+		CHECK(scaled.Advance(10000000) == 0);
+
+		AnimationClock clock(1.0);
+		clock.Update(0);
+		clock.Pause();
+		CHECK(clock.IsPaused());
+		CHECK(clock.Update(5000000) == 0);
+
+		// Paused time is not caught up on
+		clock.Resume();
+		CHECK(clock.Update(6000000) == 1);
+	}
+
+	void CheckSeek()
+	{
+		AnimationClock clock(3.0);
+		clock.Advance(1500000);
+		CHECK(clock.CurrentStep() == 4);
+		CHECK(clock.Alpha() > 0.0f);
+
+		clock.Seek(100);
+		CHECK(clock.CurrentStep() == 100);
+		CHECK(clock.Alpha() == 0.0f);
+		CHECK(clock.Advance(333333) == 1);
+		CHECK(clock.CurrentStep() == 101);
+	}
+}
+
+int main()
+{
+	CheckDrift();
+	CheckReplay();
+	CheckAdvance();
+	CheckSetRate();
+	CheckScaleAndPause();
+	CheckSeek();
+
+	return Check::Result("clock_check");
+}
@@ -0,0 +1,102 @@
+// CPU check of the DrawPacketList sort order and the StateFilter change masks.
+//   draw_packet_check
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "DrawPacketList.h"
+
+#include "Check.h"
+
+namespace
+{
+	void CheckKeyOrder()
+	{
+		// A more expensive state wins over any value of the cheaper ones
+		CHECK(DrawPacketList::MakeKey(1, 0, 0, 0, 0) > DrawPacketList::MakeKey(0, 0xFFFF, 0xFFFF, 0xF, 0xFFFFF));
+		CHECK(DrawPacketList::MakeKey(0, 1, 0, 0, 0) > DrawPacketList::MakeKey(0, 0, 0xFFFF, 0xF, 0xFFFFF));
+		CHECK(DrawPacketList::MakeKey(0, 0, 1, 0, 0) > DrawPacketList::MakeKey(0, 0, 0, 0xF, 0xFFFFF));
+		CHECK(DrawPacketList::MakeKey(0, 0, 0, 1, 0) > DrawPacketList::MakeKey(0, 0, 0, 0, 0xFFFFF));
+		CHECK(DrawPacketList::MakeKey(0, 0, 0, 0, 1) > DrawPacketList::MakeKey(0, 0, 0, 0, 0));
+		CHECK(DrawPacketList::MakeKey(0xFF, 0xFFFF, 0xFFFF, 0xF, 0xFFFFF) == ~0ull);
+	}
+
+	void CheckSort()
+	{
+		std::mt19937 rng(7);
+		DrawPacketList list;
+		size_t const count = 2000;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			list.Add(rng() % 4, rng() % 12, rng() % 50, rng() % 3);
+		}
+
+		size_t const unsortedChanges = list.CountStateChanges();
+		list.Sort();
+
+		CHECK(list.Size() == count);
+
+		std::vector<bool> seen(count, false);
+
+		for (size_t i = 0; i < list.Size(); ++i)
+		{
+			DrawPacketList::Packet const& packet = list[i];
+
+			CHECK(packet.key == DrawPacketList::MakeKey(packet.shaderFlags, packet.material, packet.matrix, packet.topology, packet.primitive));
+			CHECK(packet.primitive < count && !seen[packet.primitive]);
+			if (packet.primitive < count)
+				seen[packet.primitive] = true;
+
+			if (i > 0)
+			{
+				DrawPacketList::Packet const& prev = list[i - 1];
+
+				CHECK(std::tie(prev.shaderFlags, prev.material, prev.matrix, prev.topology, prev.primitive) <
+					std::tie(packet.shaderFlags, packet.material, packet.matrix, packet.topology, packet.primitive));
+			}
+		}
+
+		// Sorting only ever removes switches of the grouped states
+		CHECK(list.CountStateChanges() <= unsortedChanges);
+	}
+
+	void CheckStateFilter()
+	{
+		DrawPacketList list;
+		list.Add(1, 2, 3, 0);
+		list.Add(1, 2, 3, 0);
+		list.Add(1, 5, 3, 0);
+		list.Add(1, 5, 4, 0);
+		list.Add(2, 5, 4, 1);
+		list.Add(0, 0, 0, 0);
+
+		DrawPacketList::StateFilter filter;
+		CHECK(filter.Apply(list[0]) == DrawPacketList::ALL_CHANGES);
+		CHECK(filter.Apply(list[1]) == 0);
+		CHECK(filter.Apply(list[2]) == DrawPacketList::MATERIAL_CHANGE);
+		CHECK(filter.Apply(list[3]) == DrawPacketList::MATRIX_CHANGE);
+		CHECK(filter.Apply(list[4]) == (DrawPacketList::SHADER_CHANGE | DrawPacketList::TOPOLOGY_CHANGE));
+		CHECK(filter.Apply(list[5]) == DrawPacketList::ALL_CHANGES);
+
+		// A pass starts with everything unbound even if the packet matches the last one
+		filter.Reset();
+		CHECK(filter.Apply(list[5]) == DrawPacketList::ALL_CHANGES);
+		CHECK(filter.Apply(list[5]) == 0);
+
+		// 4 for the first packet, then 0 + 1 + 1 + 2 + 4 bits
+		CHECK(list.CountStateChanges() == 12);
+	}
+}
+
+int main()
+{
+	CheckKeyOrder();
+	CheckSort();
+	CheckStateFilter();
+
+	return Check::Result("draw_packet_check");
+}
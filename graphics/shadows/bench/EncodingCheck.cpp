@@ -0,0 +1,222 @@
+// CPU check of FieldEncoding: Encode / Decode round trips in every format, the range limits of InRange,
+// and the encoded texels a *.vfb stores next to its planes.
+//   encoding_check
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FieldEncoding.h"
+#include "FieldStorage.h"
+#include "VectorField.h"
+
+#include "Check.h"
+
+namespace
+{
+	FieldEncoding::Format const formats[] = { FieldEncoding::Format::FLOAT32, FieldEncoding::Format::SNORM16, FieldEncoding::Format::SNORM8 };
+
+	// Largest displacement the format keeps, FLOAT32 is checked far beyond any texture size
+	int32_t Limit(FieldEncoding::Format format)
+	{
+		int32_t range = FieldEncoding::Range(format);
+
+		return range == 0 ? 1 << 20 : range;
+	}
+
+	void CheckRoundTrip(FieldEncoding::Format format, size_t width, size_t height, unsigned seed)
+	{
+		int32_t limit = Limit(format);
+
+		// Random displacements with both extremes in the corners
+		std::mt19937 rng(seed);
+		FieldStorage field(width, height);
+		for (size_t i = 0; i < width; ++i)
+		{
+			for (size_t j = 0; j < height; ++j)
+			{
+				field.Set(i, j, (int)(rng() % (2 * limit + 1)) - limit, (int)(rng() % (2 * limit + 1)) - limit);
+			}
+		}
+		field.Set(0, 0, limit, -limit);
+		field.Set(width - 1, height - 1, -limit, limit);
+
+		CHECK(FieldEncoding::InRange(field, format));
+
+		std::vector<unsigned char> texels(FieldEncoding::TexelSize(format) * width * height);
+		FieldEncoding::Encode(field, format, texels.data());
+
+		// EncodeColumns over split ranges writes the same bytes
+		std::vector<unsigned char> split(texels.size());
+		FieldEncoding::EncodeColumns(field, format, split.data(), 0, width / 2);
+		FieldEncoding::EncodeColumns(field, format, split.data(), width / 2, width);
+		CHECK(split == texels);
+
+		std::vector<float> uv(2 * width * height);
+		FieldEncoding::Decode(format, texels.data(), width, height, uv.data(), 2);
+
+		// Texel (i, j) at i + j * width decodes to the uv displacement raw_data() computes
+		bool exact = true;
+		bool close = true;
+		for (size_t i = 0; i < width; ++i)
+		{
+			for (size_t j = 0; j < height; ++j)
+			{
+				float const* decoded = &uv[2 * (i + j * width)];
+
+				exact = exact && std::lround(decoded[0] * width) == field.DX(i, j) && std::lround(decoded[1] * height) == field.DY(i, j);
+				close = close && std::fabs(decoded[0] - (float)field.DX(i, j) / width) <= 1e-6f * (1.0f + std::fabs(decoded[0])) &&
+					std::fabs(decoded[1] - (float)field.DY(i, j) / height) <= 1e-6f * (1.0f + std::fabs(decoded[1]));
+			}
+		}
+		CHECK(exact);
+		CHECK(close);
+	}
+
+	void CheckRange(FieldEncoding::Format format)
+	{
+		int32_t range = FieldEncoding::Range(format);
+		FieldStorage field(16, 9);
+
+		if (range == 0)
+		{
+			field.Set(3, 4, INT32_MAX, INT32_MIN + 1);
+			CHECK(FieldEncoding::InRange(field, format));
+			return;
+		}
+
+		// +-range fit, one more either way doesn't in either component
+		field.Set(3, 4, range, -range);
+		CHECK(FieldEncoding::InRange(field, format));
+
+		int32_t const outside[][2] = { { range + 1, 0 }, { -range - 1, 0 }, { 0, range + 1 }, { 0, -range - 1 } };
+		for (auto const& d : outside)
+		{
+			field.Set(15, 8, d[0], d[1]);
+			CHECK(!FieldEncoding::InRange(field, format));
+		}
+
+		field.Set(15, 8, 0, 0);
+		CHECK(FieldEncoding::InRange(field, format));
+	}
+
+	std::vector<unsigned char> Encoded(FieldStorage const& field, FieldEncoding::Format format)
+	{
+		std::vector<unsigned char> texels(FieldEncoding::TexelSize(format) * field.Width() * field.Height());
+		FieldEncoding::Encode(field, format, texels.data());
+
+		return texels;
+	}
+
+	bool SameTexels(unsigned char const* mapped, std::vector<unsigned char> const& texels)
+	{
+		return mapped != nullptr && std::memcmp(mapped, texels.data(), texels.size()) == 0;
+	}
+
+	void CheckFieldFile()
+	{
+		// AddDots2 reaches (659, 530)
+		size_t constexpr size = 768;
+		std::filesystem::path tmp = std::filesystem::temp_directory_path();
+		std::string fldPath = (tmp / "encoding_check.fld").string();
+
+		{
+			std::ofstream os(fldPath);
+			os << size << " " << size << "\n0 0 64 768 3 -2\n64 0 768 128 -90 100";
+		}
+
+		// With a transform, and displacements past the SNORM8 range
+		std::unique_ptr<VectorField> field(VectorField::loadFromFile(fldPath));
+		CHECK(field != nullptr);
+		if (field == nullptr)
+		{
+			return;
+		}
+		field->AddDots2();
+		CHECK(!FieldEncoding::IsZero(field->TransformStorage()));
+
+		for (FieldEncoding::Format format : formats)
+		{
+			std::string vfbPath = (tmp / (std::string("encoding_check_") + FieldEncoding::FormatName(format) + ".vfb")).string();
+			CHECK(field->saveToBinary(vfbPath, true, format));
+
+			std::unique_ptr<VectorField> mapped(VectorField::loadFromFile(vfbPath));
+			CHECK(mapped != nullptr);
+			if (mapped == nullptr)
+			{
+				continue;
+			}
+
+			bool inRange = FieldEncoding::InRange(field->Storage(), format) && FieldEncoding::InRange(field->TransformStorage(), format);
+
+			if (inRange)
+			{
+				CHECK(SameTexels(mapped->mapped_texels(format), Encoded(field->Storage(), format)));
+				CHECK(SameTexels(mapped->mapped_transform_texels(format), Encoded(field->TransformStorage(), format)));
+			}
+			else
+			{
+				// A field out of range is stored without texels, the planes still load
+				CHECK(mapped->mapped_texels(format) == nullptr);
+				CHECK(mapped->mapped_transform_texels(format) == nullptr);
+			}
+
+			CHECK(mapped->Storage().DX(10, 10) == 3 && mapped->Storage().DY(100, 10) == 100);
+
+			// Texels of another format are never handed out
+			for (FieldEncoding::Format other : formats)
+			{
+				if (other != format)
+				{
+					CHECK(mapped->mapped_texels(other) == nullptr);
+				}
+			}
+
+			// Nor once the planes change
+			mapped->invert();
+			CHECK(mapped->mapped_texels(format) == nullptr);
+
+			mapped.reset();
+			std::remove(vfbPath.c_str());
+		}
+
+		// A zero transform has no texels of its own
+		std::unique_ptr<VectorField> plain(VectorField::loadFromFile(fldPath));
+		std::string vfbPath = (tmp / "encoding_check_plain.vfb").string();
+		CHECK(plain != nullptr && plain->saveToBinary(vfbPath, true, FieldEncoding::Format::SNORM16));
+
+		std::unique_ptr<VectorField> mapped(VectorField::loadFromFile(vfbPath));
+		CHECK(mapped != nullptr);
+		if (mapped != nullptr)
+		{
+			CHECK(SameTexels(mapped->mapped_texels(FieldEncoding::Format::SNORM16), Encoded(plain->Storage(), FieldEncoding::Format::SNORM16)));
+			CHECK(mapped->mapped_transform_texels(FieldEncoding::Format::SNORM16) == nullptr);
+		}
+
+		mapped.reset();
+		std::remove(vfbPath.c_str());
+		std::remove(fldPath.c_str());
+	}
+}
+
+int main()
+{
+	unsigned seed = 1;
+	for (FieldEncoding::Format format : formats)
+	{
+		CheckRoundTrip(format, 37, 23, seed++);
+		CheckRoundTrip(format, 64, 64, seed++);
+		CheckRange(format);
+	}
+
+	CheckFieldFile();
+
+	return Check::Result("encoding_check");
+}
@@ -0,0 +1,892 @@
+// Benchmarks of the animated texture CPU pipeline.
+//   field_bench [--sizes 256,1024,...] [--reps N] [--threads N] [--filter substr]
+//               [--models dir] [--assets dir] [--json file] [--csv file]
+// Every case is timed `reps` times after one warm-up run, results are reported
+// as min/mean/percentiles in milliseconds.
+// Builds with CMake from this directory:
+//   cmake -S . -B build && cmake --build build --config Release
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define TINYGLTF_IMPLEMENTATION
+#include "tiny_gltf.h"
+
+#include "DrawPacketList.h"
+#include "FieldAtlas.h"
+#include "FieldEncoding.h"
+#include "FieldKernels.h"
+#include "FieldSchedule.h"
+#include "FieldStream.h"
+#include "FieldSwapper.h"
+#include "ImageImport.h"
+#include "JobGraph.h"
+#include "ShaderCache.h"
+#include "SparseField.h"
+#include "ThreadPool.h"
+#include "VectorField.h"
+
+#ifndef SHADOWS_MODELS_DIR
+#define SHADOWS_MODELS_DIR "../../models"
+#endif
+
+#ifndef SHADOWS_ASSETS_DIR
+#define SHADOWS_ASSETS_DIR "../shadows/Assets"
+#endif
+
+namespace
+{
+	// AddDots* write texels up to (659, 530)
+	size_t constexpr addDotsMinSize = 660;
+
+	// Keeps benchmarked results observable
+	volatile size_t switchesSink = 0;
+
+	// Results that differ from their reference, any makes the bench fail
+	size_t mismatches = 0;
+
+	struct Options
+	{
+		std::vector<size_t> sizes = { 256, 512, 1024, 2048, 4096 };
+		size_t reps = 10;
+		size_t threads = 0;
+		std::string filter;
+		std::string modelsDir = SHADOWS_MODELS_DIR;
+		std::string assetsDir = SHADOWS_ASSETS_DIR;
+		std::string jsonPath;
+		std::string csvPath;
+	};
+
+	struct Result
+	{
+		std::string name;
+		std::string param;
+		std::vector<double> samples;
+
+		double min, mean, p50, p90, p99, max;
+	};
+
+	double Percentile(std::vector<double> const& sorted, double p)
+	{
+		// Nearest rank
+		size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+
+		return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+	}
+
+	void ComputeStats(Result& result)
+	{
+		std::vector<double> sorted = result.samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+		for (double sample : sorted)
+		{
+			sum += sample;
+		}
+
+		result.min = sorted.front();
+		result.max = sorted.back();
+		result.mean = sum / sorted.size();
+		result.p50 = Percentile(sorted, 50.0);
+		result.p90 = Percentile(sorted, 90.0);
+		result.p99 = Percentile(sorted, 99.0);
+	}
+
+	class Bench
+	{
+	public:
+		Bench(Options const& options) : m_options{ options } {}
+
+		bool Enabled(std::string const& name) const
+		{
+			return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+		}
+
+		void Measure(std::string const& name, std::string const& param, std::function<void()> const& run)
+		{
+			if (!Enabled(name))
+			{
+				return;
+			}
+
+			Result result;
+			result.name = name;
+			result.param = param;
+
+			for (size_t rep = 0; rep <= m_options.reps; ++rep)
+			{
+				auto start = std::chrono::steady_clock::now();
+				run();
+				auto end = std::chrono::steady_clock::now();
+
+				// The first run only warms caches and the thread pool
+				if (rep > 0)
+				{
+					result.samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+				}
+			}
+
+			ComputeStats(result);
+
+			std::printf("%-16s %-12s min %10.3f  mean %10.3f  p50 %10.3f  p90 %10.3f  p99 %10.3f ms\n",
+				result.name.c_str(), result.param.c_str(), result.min, result.mean, result.p50, result.p90, result.p99);
+			std::fflush(stdout);
+
+			m_aResults.push_back(result);
+		}
+
+		bool WriteJSON(std::string const& path) const
+		{
+			std::ofstream os(path);
+			if (!os.is_open())
+			{
+				return false;
+			}
+
+			os << "{\n  \"reps\": " << m_options.reps << ",\n  \"threads\": " << ThreadPool::Get().ThreadCount() << ",\n  \"results\": [\n";
+
+			for (size_t i = 0; i < m_aResults.size(); ++i)
+			{
+				Result const& result = m_aResults[i];
+
+				os << "    {\"name\": \"" << result.name << "\", \"param\": \"" << result.param << "\", "
+					<< "\"min_ms\": " << result.min << ", \"mean_ms\": " << result.mean << ", "
+					<< "\"p50_ms\": " << result.p50 << ", \"p90_ms\": " << result.p90 << ", "
+					<< "\"p99_ms\": " << result.p99 << ", \"max_ms\": " << result.max << ", \"samples_ms\": [";
+
+				for (size_t k = 0; k < result.samples.size(); ++k)
+				{
+					os << (k ? ", " : "") << result.samples[k];
+				}
+
+				os << "]}" << (i + 1 < m_aResults.size() ? "," : "") << "\n";
+			}
+
+			os << "  ]\n}\n";
+
+			return os.good();
+		}
+
+		bool WriteCSV(std::string const& path) const
+		{
+			std::ofstream os(path);
+			if (!os.is_open())
+			{
+				return false;
+			}
+
+			os << "name,param,reps,min_ms,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+
+			for (Result const& result : m_aResults)
+			{
+				os << result.name << "," << result.param << "," << result.samples.size() << ","
+					<< result.min << "," << result.mean << "," << result.p50 << ","
+					<< result.p90 << "," << result.p99 << "," << result.max << "\n";
+			}
+
+			return os.good();
+		}
+
+	private:
+		Options m_options;
+		std::vector<Result> m_aResults;
+	};
+
+	std::string SizeParam(size_t size)
+	{
+		return std::to_string(size) + "x" + std::to_string(size);
+	}
+
+	// *.fld text with a grid of constant displacement blocks
+	void WriteFieldText(std::string const& path, size_t size)
+	{
+		size_t constexpr block = 32;
+
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<int> shift(-16, 16);
+
+		std::ofstream os(path);
+		os << size << " " << size;
+
+		for (size_t x = 0; x < size; x += block)
+		{
+			for (size_t y = 0; y < size; y += block)
+			{
+				os << "\n" << x << " " << y << " " << std::min(size, x + block) << " " << std::min(size, y + block)
+					<< " " << shift(rng) << " " << shift(rng);
+			}
+		}
+	}
+
+	// Dense and tiled apply of one field, `suffix` names the field
+	void BenchSparse(Bench& bench, std::string const& suffix, VectorField const& field, size_t size)
+	{
+		std::string param = SizeParam(size);
+
+		if (!bench.Enabled("sparse") && !bench.Enabled("apply_dense"))
+		{
+			return;
+		}
+
+		std::mt19937 rng(3);
+		std::vector<unsigned char> image(4 * size * size);
+		for (auto& channel : image)
+		{
+			channel = (unsigned char)rng();
+		}
+
+		// sparse_check compares the results with the dense kernel
+		SparseField sparse(field.Storage());
+
+		std::vector<unsigned char> dense = image;
+		std::vector<unsigned char> tiled = image;
+
+		std::fprintf(stderr, "sparse %s %s: %zu/%zu tiles active, %zu dense, %zu KB\n", suffix.c_str(), param.c_str(),
+			sparse.ActiveTilesNum(), sparse.TilesX() * sparse.TilesY(), sparse.DenseTilesNum(), sparse.MemorySize() / 1024);
+
+		// What the GPU keeps of it, against the pages of a dense upload
+		FieldAtlas atlas(FieldEncoding::Format::SNORM16, size, size);
+		if (FieldAtlas::InRange(sparse, FieldEncoding::Format::SNORM16))
+		{
+			std::vector<uint32_t> tiles;
+			std::vector<FieldAtlas::Copy> copies;
+			atlas.AddTiles(sparse, tiles, copies);
+
+			std::fprintf(stderr, "sparse %s %s: %zu atlas tiles in %zu of %zu pages\n", suffix.c_str(), param.c_str(),
+				atlas.TilesNum(), atlas.PagesNum(), (atlas.TilesY() + FieldAtlas::pageRows - 1) / FieldAtlas::pageRows);
+		}
+
+		bench.Measure("sparse_build_" + suffix, param, [&]()
+			{
+				SparseField built(field.Storage());
+			});
+
+		bench.Measure("apply_dense_" + suffix, param, [&]()
+			{
+				std::copy(image.begin(), image.end(), dense.begin());
+				FieldKernels::ApplyField(field.Storage(), image.data(), dense.data(), size, size, 4);
+			});
+
+		bench.Measure("sparse_apply_" + suffix, param, [&]()
+			{
+				std::copy(image.begin(), image.end(), tiled.begin());
+				sparse.Apply(image.data(), tiled.data(), size, size, 4);
+			});
+	}
+
+	// A sequence longer than the window played at two steps per field, uploads copy into the window slices
+	void BenchStream(Bench& bench, std::string const& file, size_t size)
+	{
+		size_t constexpr fieldsNum = 16;
+		size_t constexpr window = 3;
+
+		if (!bench.Enabled("field_stream"))
+		{
+			return;
+		}
+
+		FieldEncoding::Format format = FieldEncoding::Format::SNORM16;
+		std::vector<std::vector<unsigned char>> slices(window);
+		FieldSwapper::StreamStats stats = {};
+
+		bench.Measure("field_stream", SizeParam(size), [&]()
+			{
+				FieldSwapper swapper;
+				swapper.SetUpStreaming(std::make_unique<FieldStream>(std::vector<std::string>(fieldsNum, file), size, size, format, window),
+					{ 0, 1, 2 });
+				swapper.SetUpStepPerFiled(std::vector<size_t>(fieldsNum, 2));
+
+				auto upload = [&](size_t slice, FieldStream::Prepared const& prepared)
+				{
+					slices[slice] = prepared.field;
+				};
+
+				for (size_t frame = 0; frame < 2 * fieldsNum; ++frame)
+				{
+					swapper.Stream(upload);
+					swapper.IncStep(1);
+				}
+
+				stats = swapper.GetStreamStats();
+			});
+
+		std::printf("field_stream     %-12s uploads %zu, stalls %zu, %.3f ms stalled, %.3f ms max\n", SizeParam(size).c_str(),
+			stats.uploads, stats.stalls, 1000.0 * stats.stallSeconds, 1000.0 * stats.maxStallSeconds);
+	}
+
+	void BenchFields(Bench& bench, size_t size)
+	{
+		std::string param = SizeParam(size);
+		std::filesystem::path tmp = std::filesystem::temp_directory_path();
+		std::string fldPath = (tmp / ("field_bench_" + std::to_string(size) + ".fld")).string();
+		std::string vfbPath = (tmp / ("field_bench_" + std::to_string(size) + ".vfb")).string();
+
+		WriteFieldText(fldPath, size);
+
+		VectorField* field = VectorField::loadFromFile(fldPath);
+		if (field == nullptr)
+		{
+			std::fprintf(stderr, "failed to load %s\n", fldPath.c_str());
+			return;
+		}
+
+		bench.Measure("load_fld", param, [&]()
+			{
+				delete VectorField::loadFromFile(fldPath);
+			});
+
+		bool hasVfb = (bench.Enabled("load_vfb") || bench.Enabled("field_stream")) && field->saveToBinary(vfbPath);
+
+		if (hasVfb)
+		{
+			bench.Measure("load_vfb", param, [&]()
+				{
+					delete VectorField::loadFromFile(vfbPath);
+				});
+
+			BenchStream(bench, vfbPath, size);
+		}
+
+		std::vector<float> texels;
+		bench.Measure("raw_data", param, [&]()
+			{
+				field->raw_data(texels);
+			});
+
+		if (bench.Enabled("raw_data_"))
+		{
+			FieldKernels::ISA detected = FieldKernels::DetectISA();
+			std::vector<float> reference(4 * size * size);
+			FieldKernels::FieldTexelsScalar(field->Storage(), field->TransformStorage(), reference.data(), 4 * size * sizeof(float), 0, size);
+
+			for (int isa = 0; isa <= (int)detected; ++isa)
+			{
+				FieldKernels::ForceISA((FieldKernels::ISA)isa);
+
+				bench.Measure(std::string("raw_data_") + FieldKernels::ISAName((FieldKernels::ISA)isa), param, [&]()
+					{
+						field->raw_data(texels);
+					});
+
+				if (texels != reference)
+				{
+					std::fprintf(stderr, "raw_data_%s differs from scalar\n", FieldKernels::ISAName((FieldKernels::ISA)isa));
+					++mismatches;
+				}
+			}
+			FieldKernels::ForceISA(detected);
+		}
+
+		for (int format = 0; format <= (int)FieldEncoding::Format::SNORM8; ++format)
+		{
+			FieldEncoding::Format fieldFormat = (FieldEncoding::Format)format;
+			std::vector<unsigned char> texels(FieldEncoding::TexelSize(fieldFormat) * size * size);
+
+			if (FieldEncoding::InRange(field->Storage(), fieldFormat))
+			{
+				bench.Measure(std::string("field_encode_") + FieldEncoding::FormatName(fieldFormat), param, [&]()
+					{
+						FieldEncoding::Encode(field->Storage(), fieldFormat, texels.data());
+					});
+			}
+		}
+
+		if (bench.Enabled("apply_field"))
+		{
+			std::mt19937 rng(2);
+			std::vector<unsigned char> image(4 * size * size);
+			for (auto& channel : image)
+			{
+				channel = (unsigned char)rng();
+			}
+
+			bench.Measure("apply_field", param, [&]()
+				{
+					delete[] field->apply_field(image.data(), size, size, 4);
+				});
+
+			// Serial kernels alone, without the allocation and copy of apply_field
+			if (bench.Enabled("apply_field_"))
+			{
+				FieldKernels::ISA detected = FieldKernels::DetectISA();
+				std::vector<unsigned char> reference = image;
+				FieldKernels::ApplyFieldScalar(field->Storage(), image.data(), reference.data(), size, size, 4, 0, size);
+
+				std::vector<unsigned char> result(image.size());
+
+				for (int isa = 0; isa <= (int)detected; ++isa)
+				{
+					auto kernel = isa == (int)FieldKernels::ISA::AVX2 ? &FieldKernels::ApplyFieldAVX2 :
+						(isa == (int)FieldKernels::ISA::SSE41 ? &FieldKernels::ApplyFieldSSE41 : &FieldKernels::ApplyFieldScalar);
+
+					result = image;
+
+					// Every run writes the same texels, the copy is only needed once
+					bench.Measure(std::string("apply_field_") + FieldKernels::ISAName((FieldKernels::ISA)isa), param, [&]()
+						{
+							kernel(field->Storage(), image.data(), result.data(), size, size, 4, 0, size);
+						});
+
+					if (result != reference)
+					{
+						std::fprintf(stderr, "apply_field_%s differs from scalar\n", FieldKernels::ISAName((FieldKernels::ISA)isa));
+						++mismatches;
+					}
+				}
+			}
+		}
+
+		BenchSparse(bench, "blocks", *field, size);
+
+		if (size >= addDotsMinSize)
+		{
+			VectorField dots(size, size);
+			dots.AddDots4();
+
+			BenchSparse(bench, "dots", dots, size);
+		}
+
+		bench.Measure("invert", param, [&]()
+			{
+				field->invert();
+			});
+
+		if (size >= addDotsMinSize)
+		{
+			bench.Measure("AddDots1", param, [&]() { field->AddDots1(); });
+			bench.Measure("AddDots2", param, [&]() { field->AddDots2(); });
+			bench.Measure("AddDots3", param, [&]() { field->AddDots3(); });
+			bench.Measure("AddDots4", param, [&]() { field->AddDots4(); });
+		}
+
+		delete field;
+
+		std::error_code error;
+		std::filesystem::remove(fldPath, error);
+		std::filesystem::remove(vfbPath, error);
+	}
+
+	void BenchIncStep(Bench& bench)
+	{
+		// Eleven fields as loadAllFromDir provides, 1000 steps each as set up in Renderer
+		size_t constexpr fieldsNum = 11;
+
+		for (size_t inc : { (size_t)1, (size_t)1000, (size_t)1000000 })
+		{
+			FieldSchedule schedule;
+			schedule.SetFieldsNum(fieldsNum);
+			schedule.SetUpStepPerFiled(std::vector<size_t>(fieldsNum, 1000));
+
+			bench.Measure("inc_step", "inc=" + std::to_string(inc), [&]()
+				{
+					// 100 frames worth of increments
+					for (size_t frame = 0; frame < 100; ++frame)
+					{
+						switchesSink = switchesSink + schedule.IncStep(inc);
+					}
+				});
+		}
+
+		for (FieldSchedule::Playback playback : { FieldSchedule::Playback::LOOP, FieldSchedule::Playback::PING_PONG })
+		{
+			FieldSchedule schedule;
+			schedule.SetFieldsNum(fieldsNum);
+			schedule.SetPlayback(playback);
+			schedule.SetUpStepPerFiled(std::vector<size_t>(fieldsNum, 1000));
+
+			std::mt19937_64 rng(3);
+
+			bench.Measure("seek", playback == FieldSchedule::Playback::LOOP ? "loop" : "ping_pong", [&]()
+				{
+					for (size_t frame = 0; frame < 100; ++frame)
+					{
+						schedule.Seek((size_t)(rng() >> 16));
+						switchesSink = switchesSink + schedule.CurrentSegment();
+					}
+				});
+		}
+	}
+
+	// Mirrors Model::ProcessNode: opaque primitives of a node use the matrix of its parent
+	void CollectPackets(tinygltf::Model const& model, int node, uint32_t parentMatrix, uint32_t& matricesNum, DrawPacketList& packets)
+	{
+		tinygltf::Node const& gltfNode = model.nodes[node];
+
+		if (gltfNode.mesh >= 0)
+		{
+			for (tinygltf::Primitive const& gltfPrimitive : model.meshes[gltfNode.mesh].primitives)
+			{
+				if (gltfPrimitive.material < 0 || model.materials[gltfPrimitive.material].alphaMode == "BLEND")
+				{
+					continue;
+				}
+
+				tinygltf::Material const& gltfMaterial = model.materials[gltfPrimitive.material];
+
+				// Same bits as ModelShaders::MODEL_PIXEL_SHADER_DEFINES
+				uint32_t shaderFlags = 0;
+				shaderFlags |= gltfMaterial.pbrMetallicRoughness.baseColorTexture.index >= 0 ? 0x1 : 0;
+				shaderFlags |= gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0 ? 0x2 : 0;
+				shaderFlags |= gltfMaterial.normalTexture.index >= 0 ? 0x4 : 0;
+				shaderFlags |= gltfMaterial.occlusionTexture.index >= 0 ? 0x8 : 0;
+
+				packets.Add(shaderFlags, (uint32_t)gltfPrimitive.material, parentMatrix, (uint32_t)gltfPrimitive.mode);
+			}
+		}
+
+		if (!gltfNode.children.empty())
+		{
+			uint32_t matrix = matricesNum++;
+
+			for (int child : gltfNode.children)
+			{
+				CollectPackets(model, child, matrix, matricesNum, packets);
+			}
+		}
+	}
+
+	void BenchDrawPackets(Bench& bench, std::string const& name, tinygltf::Model const& model)
+	{
+		if (model.scenes.empty())
+		{
+			return;
+		}
+
+		auto build = [&model](DrawPacketList& packets)
+			{
+				packets.Clear();
+
+				uint32_t matricesNum = 1;
+				for (int node : model.scenes[std::max(model.defaultScene, 0)].nodes)
+				{
+					CollectPackets(model, node, 0, matricesNum, packets);
+				}
+			};
+
+		DrawPacketList packets;
+		build(packets);
+		size_t unsortedChanges = packets.CountStateChanges();
+
+		bench.Measure("draw_packets", name, [&]()
+			{
+				build(packets);
+				packets.Sort();
+			});
+
+		std::printf("%-16s %-12s %zu packets, state changes %zu unsorted -> %zu sorted\n",
+			"draw_packets", name.c_str(), packets.Size(), unsortedChanges, packets.CountStateChanges());
+	}
+
+	void BenchGLTF(Bench& bench, Options const& options)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(options.modelsDir, error))
+		{
+			std::fprintf(stderr, "models directory %s not found, skipping gltf_parse and draw_packets\n", options.modelsDir.c_str());
+			return;
+		}
+
+		std::vector<std::filesystem::path> scenes;
+		for (auto const& entry : std::filesystem::directory_iterator(options.modelsDir, error))
+		{
+			std::filesystem::path scene = entry.path() / "scene.gltf";
+
+			if (std::filesystem::exists(scene, error))
+			{
+				scenes.push_back(scene);
+			}
+		}
+		std::sort(scenes.begin(), scenes.end());
+
+		for (auto const& scene : scenes)
+		{
+			std::string name = scene.parent_path().filename().string();
+
+			auto parse = [&scene](tinygltf::Model& model, std::string* err)
+				{
+					tinygltf::TinyGLTF loader;
+					std::string warn;
+
+					return loader.LoadASCIIFromFile(&model, err, &warn, scene.string());
+				};
+
+			// Scenes with missing buffers or images are not representative
+			tinygltf::Model model;
+			std::string err;
+			if (!(bench.Enabled("gltf_parse") || bench.Enabled("draw_packets")) || !parse(model, &err))
+			{
+				while (!err.empty() && std::isspace((unsigned char)err.back()))
+				{
+					err.pop_back();
+				}
+
+				if (!err.empty())
+				{
+					std::fprintf(stderr, "skipping %s: %s\n", name.c_str(), err.c_str());
+				}
+				continue;
+			}
+
+			bench.Measure("gltf_parse", name, [&]()
+				{
+					tinygltf::Model parsed;
+					parse(parsed, nullptr);
+				});
+
+			if (bench.Enabled("draw_packets"))
+			{
+				BenchDrawPackets(bench, name, model);
+			}
+		}
+	}
+
+	// Layer and material textures as AnimatedTexture::AddLayerByName imports them
+	void BenchImageImport(Bench& bench, Options const& options)
+	{
+		std::error_code error;
+		std::filesystem::path dir = std::filesystem::path(options.assetsDir) / "NewMat";
+		if (!std::filesystem::is_directory(dir, error))
+		{
+			std::fprintf(stderr, "assets directory %s not found, skipping image_*\n", dir.string().c_str());
+			return;
+		}
+
+		std::vector<std::filesystem::path> files;
+		for (auto const& entry : std::filesystem::directory_iterator(dir, error))
+		{
+			std::string extension = entry.path().extension().string();
+
+			if (extension == ".jpg" || extension == ".png")
+			{
+				files.push_back(entry.path());
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		for (auto const& file : files)
+		{
+			std::string name = file.filename().string();
+
+			ImageImport::Image image;
+			if (!ImageImport::Load(file.string(), image))
+			{
+				std::fprintf(stderr, "failed to decode %s\n", name.c_str());
+				continue;
+			}
+
+			bench.Measure("image_decode", name, [&]()
+				{
+					ImageImport::Image decoded;
+					ImageImport::Load(file.string(), decoded);
+				});
+
+			FieldKernels::ISA detected = FieldKernels::DetectISA();
+			for (int isa = 0; isa <= (int)detected; ++isa)
+			{
+				FieldKernels::ForceISA((FieldKernels::ISA)isa);
+
+				bench.Measure(std::string("image_swizzle_") + FieldKernels::ISAName((FieldKernels::ISA)isa), name, [&]()
+					{
+						ImageImport::SwizzleRB(image.Data(), image.width * image.height);
+					});
+			}
+			FieldKernels::ForceISA(detected);
+
+			size_t count = image.width * image.height;
+			std::vector<unsigned char> linear(image.Data(), image.Data() + image.Size());
+			ImageImport::SRGBToLinearScalar(linear.data(), count);
+
+			bench.Measure("image_srgb_scalar", name, [&]()
+				{
+					ImageImport::SRGBToLinearScalar(image.Data(), count);
+				});
+
+			if (detected == FieldKernels::ISA::AVX2)
+			{
+				bench.Measure("image_srgb_avx2", name, [&]()
+					{
+						ImageImport::SRGBToLinearAVX2(image.Data(), count);
+					});
+
+				ImageImport::Image reloaded;
+				if (ImageImport::Load(file.string(), reloaded))
+				{
+					ImageImport::SRGBToLinearAVX2(reloaded.Data(), count);
+					if (!std::equal(linear.begin(), linear.end(), reloaded.Data()))
+					{
+						std::fprintf(stderr, "image_srgb_avx2 differs from scalar on %s\n", name.c_str());
+						++mismatches;
+					}
+				}
+			}
+		}
+
+		// The whole set one after another and as independent loading jobs
+		std::string set = std::to_string(files.size()) + " files";
+
+		bench.Measure("image_decode_all", set, [&]()
+			{
+				std::vector<ImageImport::Image> images(files.size());
+				for (size_t i = 0; i < files.size(); ++i)
+				{
+					ImageImport::Load(files[i].string(), images[i]);
+				}
+			});
+
+		bench.Measure("image_decode_jobs", set, [&]()
+			{
+				std::vector<ImageImport::Image> images(files.size());
+
+				JobGraph jobs;
+				for (size_t i = 0; i < files.size(); ++i)
+				{
+					jobs.Add(files[i].filename().string(), [&, i]() { return ImageImport::Load(files[i].string(), images[i]); });
+				}
+				jobs.Run();
+			});
+	}
+
+	// Work done per shader on a cache hit besides reading the bytecode
+	void BenchShaderCache(Bench& bench, Options const& options)
+	{
+		std::string source = (std::filesystem::path(options.assetsDir).parent_path() / "PBRPixelShader.hlsl").string();
+
+		std::vector<std::vector<unsigned char>> sources;
+		if (!ShaderCache::ReadSources(source, sources))
+		{
+			std::fprintf(stderr, "shader source %s not found, skipping shader_*\n", source.c_str());
+			return;
+		}
+
+		std::string files = std::to_string(sources.size()) + " files";
+
+		bench.Measure("shader_read_sources", files, [&]()
+			{
+				std::vector<std::vector<unsigned char>> read;
+				ShaderCache::ReadSources(source, read);
+			});
+
+		std::vector<ShaderCache::Define> defines = { { "HAS_TANGENT", "1" }, { "HAS_COLOR_TEXTURE", "1" } };
+		bench.Measure("shader_key", files, [&]()
+			{
+				switchesSink = switchesSink + (size_t)ShaderCache::Key(sources, defines, "ps_main", "ps_5_0", 0);
+			});
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--sizes" && hasValue)
+			{
+				options.sizes.clear();
+
+				std::stringstream list(argv[++i]);
+				std::string item;
+				while (std::getline(list, item, ','))
+				{
+					options.sizes.push_back((size_t)std::atoll(item.c_str()));
+				}
+			}
+			else if (arg == "--reps" && hasValue)
+			{
+				options.reps = std::max<size_t>(1, (size_t)std::atoll(argv[++i]));
+			}
+			else if (arg == "--threads" && hasValue)
+			{
+				options.threads = (size_t)std::atoll(argv[++i]);
+			}
+			else if (arg == "--filter" && hasValue)
+			{
+				options.filter = argv[++i];
+			}
+			else if (arg == "--models" && hasValue)
+			{
+				options.modelsDir = argv[++i];
+			}
+			else if (arg == "--assets" && hasValue)
+			{
+				options.assetsDir = argv[++i];
+			}
+			else if (arg == "--json" && hasValue)
+			{
+				options.jsonPath = argv[++i];
+			}
+			else if (arg == "--csv" && hasValue)
+			{
+				options.csvPath = argv[++i];
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: %s [--sizes 256,512,...,8192] [--reps N] [--threads N] [--filter substr] "
+			"[--models dir] [--assets dir] [--json file] [--csv file]\n", argv[0]);
+		return 1;
+	}
+
+	ThreadPool::Get().SetThreadCount(options.threads);
+
+	Bench bench(options);
+
+	for (size_t size : options.sizes)
+	{
+		BenchFields(bench, size);
+	}
+
+	BenchIncStep(bench);
+	BenchGLTF(bench, options);
+	BenchImageImport(bench, options);
+	BenchShaderCache(bench, options);
+
+	if (!options.jsonPath.empty() && !bench.WriteJSON(options.jsonPath))
+	{
+		std::fprintf(stderr, "failed to write %s\n", options.jsonPath.c_str());
+		return 1;
+	}
+
+	if (!options.csvPath.empty() && !bench.WriteCSV(options.csvPath))
+	{
+		std::fprintf(stderr, "failed to write %s\n", options.csvPath.c_str());
+		return 1;
+	}
+
+	if (mismatches != 0)
+	{
+		std::fprintf(stderr, "%zu result(s) differ from their reference\n", mismatches);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+// CPU check of the tone mapping luminance adaptation.
+//   luminance_check
+
+#include <cmath>
+
+#include "LuminanceAdaptation.h"
+
+#include "Check.h"
+
+namespace
+{
+	bool Near(float a, float b, float tolerance = 1e-5f)
+	{
+		return std::fabs(a - b) <= tolerance * std::fmax(1.0f, std::fabs(b));
+	}
+
+	void CheckFixedPoints()
+	{
+		// No time or nothing to adapt to leaves the value alone
+		CHECK(LuminanceAdaptation::Adapt(0.3f, 2.0f, 0.0) == 0.3f);
+		CHECK(LuminanceAdaptation::Adapt(0.7f, 0.7f, 0.016) == 0.7f);
+
+		// Long enough frames land on the measured luminance
+		CHECK(Near(LuminanceAdaptation::Adapt(0.1f, 5.0f, 1000.0), 5.0f));
+		CHECK(Near(LuminanceAdaptation::Adapt(5.0f, 0.1f, 1000.0), 0.1f));
+	}
+
+	void CheckRate()
+	{
+		// tau = sigma * 0.4 + (1 - sigma) * 0.1 with sigma = 0.04 / (0.04 + luminance)
+		float const luminance = 0.36f;
+		double const tau = 0.1 * 0.4 + 0.9 * 0.1;
+		double const delta = 0.5;
+		float expected = static_cast<float>(1.0 + (luminance - 1.0) * (1.0 - std::exp(-delta * tau)));
+		CHECK(Near(LuminanceAdaptation::Adapt(1.0f, luminance, delta), expected));
+
+		// Moves towards the target without overshooting, from both sides
+		float up = LuminanceAdaptation::Adapt(0.2f, 1.0f, 0.1);
+		float down = LuminanceAdaptation::Adapt(1.0f, 0.2f, 0.1);
+		CHECK(up > 0.2f && up < 1.0f);
+		CHECK(down < 1.0f && down > 0.2f);
+
+		// Dark scenes are adapted to faster than bright ones
+		float toDark = (1.0f - LuminanceAdaptation::Adapt(1.0f, 0.01f, 0.1)) / (1.0f - 0.01f);
+		float toBright = (LuminanceAdaptation::Adapt(0.01f, 1.0f, 0.1) - 0.01f) / (1.0f - 0.01f);
+		CHECK(toDark > toBright);
+	}
+
+	void CheckFrameRateIndependence()
+	{
+		// 60 frames of 1/60 s adapt as far as one second long frame
+		float const target = 3.0f;
+		float stepped = 0.05f;
+		for (int i = 0; i < 60; ++i)
+		{
+			stepped = LuminanceAdaptation::Adapt(stepped, target, 1.0 / 60.0);
+		}
+
+		CHECK(Near(stepped, LuminanceAdaptation::Adapt(0.05f, target, 1.0), 1e-4f));
+	}
+}
+
+int main()
+{
+	CheckFixedPoints();
+	CheckRate();
+	CheckFrameRateIndependence();
+
+	return Check::Result("luminance_check");
+}
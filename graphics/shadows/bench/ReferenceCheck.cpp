@@ -0,0 +1,214 @@
+// CPU check of the multi-step layer pass: long catch-ups and walks across field changes
+// have to match advecting one step per pass.
+//   reference_check
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "FieldSwapper.h"
+#include "LayerBatch.h"
+#include "ReferenceRenderer.h"
+
+#include "Check.h"
+
+namespace
+{
+	size_t constexpr size = 64;
+
+	// Whole texel displacements of up to `range` texels, point sampled walks then stay on texel centers
+	std::vector<float> MakeField(unsigned seed, int range)
+	{
+		std::mt19937 rng(seed);
+		std::vector<float> texels(4 * size * size, 0.0f);
+
+		for (size_t i = 0; i < size * size; ++i)
+		{
+			texels[4 * i + 0] = (float)((int)(rng() % (2 * range + 1)) - range) / size;
+			texels[4 * i + 1] = (float)((int)(rng() % (2 * range + 1)) - range) / size;
+		}
+
+		return texels;
+	}
+
+	ReferenceRenderer::Image MakeLayer(unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		ReferenceRenderer::Image image(size, size);
+
+		for (auto& channel : image.pixels)
+		{
+			channel = (unsigned char)rng();
+		}
+
+		return image;
+	}
+
+	ReferenceRenderer::FieldTexture Texture(std::vector<float> const& texels)
+	{
+		return { size, size, texels.data() };
+	}
+
+	bool SameLayers(ReferenceRenderer const& a, ReferenceRenderer const& b)
+	{
+		bool same = a.GetLayersNum() == b.GetLayersNum();
+
+		for (size_t i = 0; same && i < a.GetLayersNum(); ++i)
+		{
+			same = a.GetLayer(i).Source().pixels == b.GetLayer(i).Source().pixels;
+		}
+
+		return same;
+	}
+
+	// Slice of the field a swapper plays at `step`: slices[k] for stepsPerField[k] steps, looping
+	size_t SliceAt(std::vector<size_t> const& slices, std::vector<size_t> const& stepsPerField, size_t step)
+	{
+		size_t period = 0;
+		for (size_t steps : stepsPerField)
+		{
+			period += steps;
+		}
+
+		step %= period;
+		size_t ind = 0;
+		while (step >= stepsPerField[ind])
+		{
+			step -= stepsPerField[ind++];
+		}
+
+		return slices[ind];
+	}
+
+	void CheckWalk()
+	{
+		std::vector<float> field = MakeField(1, 2);
+
+		ReferenceRenderer walked(size, size, ReferenceRenderer::Filter::POINT);
+		walked.AddLayer(MakeLayer(2));
+		walked.SetField(0, Texture(field));
+
+		ReferenceRenderer stepped(size, size, ReferenceRenderer::Filter::POINT);
+		stepped.AddLayer(MakeLayer(2));
+		stepped.SetField(0, Texture(field));
+
+		// The longest walk of one pass follows the field like as many single step passes
+		walked.Render(LayerBatch::maxWalkSteps);
+		walked.Swap();
+
+		for (int i = 0; i < LayerBatch::maxWalkSteps; ++i)
+		{
+			stepped.Render(1);
+			stepped.Swap();
+		}
+
+		CHECK(SameLayers(walked, stepped));
+	}
+
+	void CheckLongCatchUp()
+	{
+		std::vector<float> field = MakeField(3, 1);
+		size_t const steps = 3 * LayerBatch::maxWalkSteps + 11;
+
+		ReferenceRenderer advanced(size, size, ReferenceRenderer::Filter::POINT);
+		advanced.AddLayer(MakeLayer(4));
+		advanced.SetField(0, Texture(field));
+		advanced.Advance(steps);
+
+		ReferenceRenderer tiles(size, size, ReferenceRenderer::Filter::POINT);
+		tiles.AddLayer(MakeLayer(4));
+		tiles.SetField(0, Texture(field));
+		tiles.Advance(steps, true);
+
+		ReferenceRenderer stepped(size, size, ReferenceRenderer::Filter::POINT);
+		stepped.AddLayer(MakeLayer(4));
+		stepped.SetField(0, Texture(field));
+
+		for (size_t i = 0; i < steps; ++i)
+		{
+			stepped.Render(1);
+			stepped.Swap();
+		}
+
+		CHECK(SameLayers(advanced, stepped));
+		CHECK(SameLayers(tiles, stepped));
+	}
+
+	void CheckFieldBoundaries()
+	{
+		std::vector<std::vector<float>> fields = { MakeField(5, 2), MakeField(6, 1), MakeField(7, 3) };
+
+		// The layers switch fields at different steps, every pass has to stop at the nearest switch
+		std::vector<std::vector<size_t>> slices = { { 0, 1 }, { 2, 0, 1 } };
+		std::vector<std::vector<size_t>> stepsPerField = { { 10, 10 }, { 7, 3, 40 } };
+		size_t const steps = 95;
+
+		ReferenceRenderer advanced(size, size, ReferenceRenderer::Filter::POINT);
+		ReferenceRenderer split(size, size, ReferenceRenderer::Filter::POINT);
+		ReferenceRenderer stepped(size, size, ReferenceRenderer::Filter::POINT);
+
+		FieldSwapper advancedSwappers[2];
+		FieldSwapper splitSwappers[2];
+
+		for (auto* renderer : { &advanced, &split })
+		{
+			for (auto const& field : fields)
+			{
+				renderer->AddFieldSlice(Texture(field));
+			}
+		}
+
+		for (size_t layer = 0; layer < 2; ++layer)
+		{
+			for (auto* renderer : { &advanced, &split, &stepped })
+			{
+				renderer->AddLayer(MakeLayer(8 + (unsigned)layer));
+			}
+
+			for (auto* swapper : { &advancedSwappers[layer], &splitSwappers[layer] })
+			{
+				for (size_t slice : slices[layer])
+				{
+					swapper->AddField(slice);
+				}
+				swapper->SetUpStepPerFiled(stepsPerField[layer]);
+			}
+
+			advanced.SetFieldSwapper(layer, &advancedSwappers[layer]);
+			split.SetFieldSwapper(layer, &splitSwappers[layer]);
+		}
+
+		advanced.Advance(steps);
+
+		// Catching up in uneven parts lands on the same layers
+		split.Advance(13);
+		split.Advance(1);
+		split.Advance(steps - 14);
+
+		for (size_t step = 0; step < steps; ++step)
+		{
+			for (size_t layer = 0; layer < 2; ++layer)
+			{
+				stepped.SetField(layer, Texture(fields[SliceAt(slices[layer], stepsPerField[layer], step)]));
+			}
+
+			stepped.Render(1);
+			stepped.Swap();
+		}
+
+		CHECK(SameLayers(advanced, stepped));
+		CHECK(SameLayers(split, stepped));
+
+		CHECK(advancedSwappers[0].CurrentStep() == steps);
+		CHECK(advancedSwappers[1].CurrentStep() == steps);
+	}
+}
+
+int main()
+{
+	CheckWalk();
+	CheckLongCatchUp();
+	CheckFieldBoundaries();
+
+	return Check::Result("reference_check");
+}
@@ -0,0 +1,329 @@
+// CPU check of the tiled field path: SparseField against the dense FieldKernels::ApplyField and the planes
+// it was built from, VectorField::Compact() against an uncompacted copy, and the FieldAtlas texels read
+// back through the tile indirection the way FieldAtlas.hlsli does.
+//   sparse_check
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "FieldAtlas.h"
+#include "FieldEncoding.h"
+#include "FieldKernels.h"
+#include "FieldStorage.h"
+#include "SparseField.h"
+#include "VectorField.h"
+
+#include "Check.h"
+
+namespace
+{
+	FieldEncoding::Format const formats[] = { FieldEncoding::Format::FLOAT32, FieldEncoding::Format::SNORM16, FieldEncoding::Format::SNORM8 };
+
+	// Zero with a few constant tiles, random blocks across tile edges and a still tile inside a moving one
+	FieldStorage MakeField(size_t x, size_t y, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		FieldStorage field(x, y);
+
+		for (size_t i = 0; i < x; ++i)
+		{
+			for (size_t j = 0; j < y; ++j)
+			{
+				size_t tx = i / SparseField::tileSize;
+				size_t ty = j / SparseField::tileSize;
+
+				if ((tx + 2 * ty) % 5 == 1)
+				{
+					field.Set(i, j, (int)(tx % 3) - 1, 2);
+				}
+				else if (i % 47 < 20 && j % 53 < 9)
+				{
+					field.Set(i, j, (int)(rng() % 17) - 8, (int)(rng() % 17) - 8);
+				}
+			}
+		}
+
+		return field;
+	}
+
+	bool SameField(FieldStorage const& a, FieldStorage const& b)
+	{
+		if (a.Width() != b.Width() || a.Height() != b.Height())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.Width(); ++i)
+		{
+			for (size_t j = 0; j < a.Height(); ++j)
+			{
+				if (a.Get(i, j) != b.Get(i, j))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	std::vector<unsigned char> MakeImage(size_t x, size_t y, size_t n, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<unsigned char> image(x * y * n);
+		for (auto& channel : image)
+		{
+			channel = (unsigned char)rng();
+		}
+
+		return image;
+	}
+
+	void CheckSparse(FieldStorage const& field, size_t n, unsigned seed)
+	{
+		size_t x = field.Width();
+		size_t y = field.Height();
+
+		SparseField sparse(field);
+		CHECK(sparse.Width() == x && sparse.Height() == y);
+		CHECK(SameField(sparse.ToStorage(), field));
+
+		bool same = true;
+		for (size_t i = 0; i < x; ++i)
+		{
+			for (size_t j = 0; j < y; ++j)
+			{
+				same = same && sparse.Get(i, j) == field.Get(i, j);
+			}
+		}
+		CHECK(same);
+
+		// Pixel (i, j) is at j + i * x, the image stays in bounds while x <= y
+		std::vector<unsigned char> image = MakeImage(x, y, n, seed);
+		std::vector<unsigned char> dense = image;
+		std::vector<unsigned char> tiled = image;
+		FieldKernels::ApplyField(field, image.data(), dense.data(), x, y, n);
+		sparse.Apply(image.data(), tiled.data(), x, y, n);
+		CHECK(tiled == dense);
+	}
+
+	// Pages as AnimatedTexture keeps them: cleared when allocated, written by the copies
+	class AtlasPages
+	{
+	public:
+		AtlasPages(FieldAtlas const& atlas, FieldEncoding::Format format)
+			: m_atlas{ atlas }, m_iTexelSize{ FieldEncoding::TexelSize(format) }
+		{
+		}
+
+		void Upload(std::vector<FieldAtlas::Copy> const& copies)
+		{
+			m_aPages.resize(m_atlas.PagesNum(), std::vector<unsigned char>(m_iTexelSize * m_atlas.PageWidth() * m_atlas.PageHeight()));
+
+			for (FieldAtlas::Copy const& copy : copies)
+			{
+				size_t page, x, y;
+				m_atlas.Origin(copy.tile, page, x, y);
+
+				bool inPage = page < m_aPages.size() && x + copy.width <= m_atlas.PageWidth() && y + copy.height <= m_atlas.PageHeight();
+				CHECK(inPage);
+				if (!inPage)
+				{
+					continue;
+				}
+
+				for (size_t row = 0; row < copy.height; ++row)
+				{
+					std::memcpy(Texel(page, x, y + row), copy.texels + copy.rowPitch * row, m_iTexelSize * copy.width);
+				}
+			}
+		}
+
+		// Every texel of the field through its indirection, FieldAtlasLoad of FieldAtlas.hlsli
+		bool Matches(std::vector<uint32_t> const& tiles, std::vector<unsigned char> const& texels, size_t width, size_t height)
+		{
+			size_t tileSize = FieldAtlas::tileSize;
+
+			for (size_t j = 0; j < height; ++j)
+			{
+				for (size_t i = 0; i < width; ++i)
+				{
+					uint32_t tile = tiles[i / tileSize + j / tileSize * m_atlas.TilesX()];
+
+					size_t page, x, y;
+					m_atlas.Origin(tile, page, x, y);
+
+					if (page >= m_aPages.size() ||
+						std::memcmp(Texel(page, x + i % tileSize, y + j % tileSize), &texels[m_iTexelSize * (i + j * width)], m_iTexelSize) != 0)
+					{
+						return false;
+					}
+				}
+			}
+
+			return true;
+		}
+
+	private:
+		unsigned char* Texel(size_t page, size_t x, size_t y)
+		{
+			return &m_aPages[page][m_iTexelSize * (x + y * m_atlas.PageWidth())];
+		}
+
+	private:
+		FieldAtlas const& m_atlas;
+		size_t m_iTexelSize;
+
+		std::vector<std::vector<unsigned char>> m_aPages;
+	};
+
+	std::vector<unsigned char> Encoded(FieldStorage const& field, FieldEncoding::Format format)
+	{
+		std::vector<unsigned char> texels(FieldEncoding::TexelSize(format) * field.Width() * field.Height());
+		FieldEncoding::Encode(field, format, texels.data());
+
+		return texels;
+	}
+
+	void CheckAtlas(FieldStorage const& field, FieldStorage const& streamed, FieldEncoding::Format format)
+	{
+		size_t width = field.Width();
+		size_t height = field.Height();
+
+		SparseField sparse(field);
+
+		// The tiles are in range exactly when the planes are
+		bool inRange = FieldEncoding::InRange(field, format);
+		CHECK(FieldAtlas::InRange(sparse, format) == inRange);
+		if (!inRange)
+		{
+			return;
+		}
+
+		FieldAtlas atlas(format, width, height);
+		AtlasPages pages(atlas, format);
+		CHECK(atlas.TilesNum() == 1 && atlas.PagesNum() == 1);
+
+		std::vector<unsigned char> texels = Encoded(field, format);
+		std::vector<uint32_t> fromSparse;
+		std::vector<uint32_t> fromTexels;
+		std::vector<FieldAtlas::Copy> copies;
+
+		// Constant tiles of one value share a tile, so the dense ones and a few values take all of it
+		atlas.AddTiles(sparse, fromSparse, copies);
+		pages.Upload(copies);
+		CHECK(fromSparse.size() == atlas.TilesX() * atlas.TilesY());
+		CHECK(atlas.TilesNum() < 1 + sparse.DenseTilesNum() + 8);
+		CHECK(pages.Matches(fromSparse, texels, width, height));
+
+		// Encoded texels of the same field only add its dense tiles, the constant ones are there already
+		size_t tilesNum = atlas.TilesNum();
+		atlas.AddTiles(texels.data(), fromTexels, copies);
+		pages.Upload(copies);
+		CHECK(atlas.TilesNum() == tilesNum + sparse.DenseTilesNum());
+		CHECK(pages.Matches(fromTexels, texels, width, height));
+
+		// A streamed slot gets whole pages, every new field a copy per page over the same tiles
+		uint32_t first = atlas.Reserve();
+		CHECK(first % atlas.PageTiles() == 0);
+
+		std::vector<uint32_t> reserved;
+		atlas.ReservedTiles(first, reserved);
+		atlas.ReservedCopies(first, texels.data(), copies);
+		pages.Upload(copies);
+		CHECK(copies.size() == (height + atlas.PageHeight() - 1) / atlas.PageHeight());
+		CHECK(pages.Matches(reserved, texels, width, height));
+
+		std::vector<unsigned char> next = Encoded(streamed, format);
+		atlas.ReservedCopies(first, next.data(), copies);
+		pages.Upload(copies);
+		CHECK(pages.Matches(reserved, next, width, height));
+
+		// The earlier fields kept their tiles
+		CHECK(pages.Matches(fromSparse, texels, width, height));
+		CHECK(pages.Matches(fromTexels, texels, width, height));
+	}
+
+	void CheckCompact()
+	{
+		// AddDots4 reaches (658, 529), the edge tiles are cut
+		size_t constexpr size = 700;
+
+		VectorField dense(size, size);
+		VectorField compact(size, size);
+		dense.AddDots4();
+		compact.AddDots4();
+
+		CHECK(compact.Compact());
+		CHECK(compact.Sparse() != nullptr && compact.SparseTransform() != nullptr);
+		CHECK(compact.Width() == size && compact.Height() == size);
+
+		std::vector<unsigned char> image = MakeImage(size, size, 4, 7);
+		std::unique_ptr<unsigned char[]> expected(dense.apply_field(image.data(), size, size, 4));
+		std::unique_ptr<unsigned char[]> result(compact.apply_field(image.data(), size, size, 4));
+		CHECK(std::memcmp(result.get(), expected.get(), image.size()) == 0);
+
+		// The planes come back from the tiles and stay until the next Compact()
+		CHECK(SameField(compact.Storage(), dense.Storage()));
+		CHECK(SameField(compact.TransformStorage(), dense.TransformStorage()));
+		CHECK(compact.Sparse() != nullptr);
+
+		CHECK(compact.Compact());
+		CHECK(SameField(compact.Storage(), dense.Storage()));
+
+		// What the GPU gets of the tiles
+		for (FieldEncoding::Format format : formats)
+		{
+			CheckAtlas(compact.Storage(), compact.TransformStorage(), format);
+		}
+
+		// A modification works on the planes and drops the tiles
+		CHECK(compact.Compact());
+		dense.invert();
+		compact.invert();
+		CHECK(compact.Sparse() == nullptr);
+		CHECK(SameField(compact.Storage(), dense.Storage()));
+		CHECK(SameField(compact.TransformStorage(), dense.TransformStorage()));
+
+		expected.reset(dense.apply_field(image.data(), size, size, 4));
+		result.reset(compact.apply_field(image.data(), size, size, 4));
+		CHECK(std::memcmp(result.get(), expected.get(), image.size()) == 0);
+
+		// A field moving everywhere stays dense
+		VectorField busy(96, 96);
+		busy.setCircleField();
+		CHECK(!busy.Compact());
+		CHECK(busy.Sparse() == nullptr);
+	}
+}
+
+int main()
+{
+	// Sizes that aren't a multiple of the tile size cut the last row and column of tiles
+	size_t const sizes[][2] = { { 32, 32 }, { 45, 61 }, { 96, 96 }, { 100, 130 }, { 257, 300 } };
+	size_t const channels[] = { 1, 3, 4 };
+
+	unsigned seed = 1;
+	for (auto const& size : sizes)
+	{
+		FieldStorage field = MakeField(size[0], size[1], seed++);
+		FieldStorage streamed = MakeField(size[0], size[1], seed++);
+
+		for (size_t n : channels)
+		{
+			CheckSparse(field, n, seed++);
+		}
+
+		for (FieldEncoding::Format format : formats)
+		{
+			CheckAtlas(field, streamed, format);
+		}
+	}
+
+	CheckCompact();
+
+	return Check::Result("sparse_check");
+}
@@ -0,0 +1,266 @@
+// CPU check of FieldStream and the streaming FieldSwapper: more files than window slices, seeks back and
+// forth mid-stream, order changes while the loader is busy, a file that fails to load. Every field taken
+// or uploaded must be the file its position plays, fields prepared for an earlier order or seek never are.
+//   stream_check
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FieldEncoding.h"
+#include "FieldStream.h"
+#include "FieldSwapper.h"
+
+#include "Check.h"
+
+namespace
+{
+	size_t constexpr size = 16;
+	size_t constexpr window = 3;
+	size_t constexpr filesNum = 7;
+	// This one is never written, it streams as an invalid zero field
+	size_t constexpr missingFile = 4;
+
+	FieldEncoding::Format constexpr format = FieldEncoding::Format::SNORM8;
+
+	// File k displaces every texel by (k + 1, -(k + 1))
+	std::vector<std::string> WriteFiles()
+	{
+		std::filesystem::path tmp = std::filesystem::temp_directory_path();
+
+		std::vector<std::string> files;
+		for (size_t k = 0; k < filesNum; ++k)
+		{
+			files.push_back((tmp / ("stream_check_" + std::to_string(k) + ".fld")).string());
+
+			if (k == missingFile)
+			{
+				std::remove(files.back().c_str());
+				continue;
+			}
+
+			std::ofstream os(files.back());
+			os << size << " " << size << "\n0 0 " << size << " " << size << " " << k + 1 << " " << -(int)(k + 1);
+		}
+
+		return files;
+	}
+
+	// File a prepared field was made from, filesNum for a zero field
+	size_t FileOf(FieldStream::Prepared const& prepared)
+	{
+		if (prepared.field.size() != size * size * FieldEncoding::TexelSize(format))
+		{
+			return SIZE_MAX;
+		}
+
+		long dx = std::lround(FieldEncoding::Sample(format, prepared.field.data(), 0, 0) * FieldEncoding::Range(format));
+		long dy = std::lround(FieldEncoding::Sample(format, prepared.field.data(), 0, 1) * FieldEncoding::Range(format));
+
+		for (size_t ind = 1; ind < size * size; ++ind)
+		{
+			if (FieldEncoding::Sample(format, prepared.field.data(), ind, 0) != FieldEncoding::Sample(format, prepared.field.data(), 0, 0) ||
+				FieldEncoding::Sample(format, prepared.field.data(), ind, 1) != FieldEncoding::Sample(format, prepared.field.data(), 0, 1))
+			{
+				return SIZE_MAX;
+			}
+		}
+
+		if (dx == 0 && dy == 0)
+		{
+			return filesNum;
+		}
+
+		return dx == -dy && dx >= 1 && dx <= (long)filesNum ? (size_t)(dx - 1) : SIZE_MAX;
+	}
+
+	// What a position of `order` has to hold
+	bool Holds(FieldStream::Prepared const& prepared, std::vector<size_t> const& order, size_t position)
+	{
+		size_t file = order[position % order.size()];
+
+		if (file == missingFile)
+		{
+			return prepared.position == position && !prepared.valid && FileOf(prepared) == filesNum;
+		}
+
+		return prepared.position == position && prepared.valid && prepared.transform.empty() && FileOf(prepared) == file;
+	}
+
+	std::vector<size_t> LoopOrder()
+	{
+		std::vector<size_t> order;
+		for (size_t k = 0; k < filesNum; ++k)
+		{
+			order.push_back(k);
+		}
+
+		return order;
+	}
+
+	std::vector<size_t> PingPongOrder()
+	{
+		std::vector<size_t> order = LoopOrder();
+		for (size_t k = filesNum - 2; k > 0; --k)
+		{
+			order.push_back(k);
+		}
+
+		return order;
+	}
+
+	void CheckStream(std::vector<std::string> const& files)
+	{
+		FieldStream stream(files, size, size, format, window);
+		CHECK(stream.FieldsNum() == filesNum);
+
+		std::vector<size_t> order = LoopOrder();
+		FieldStream::Prepared prepared;
+
+		// Two passes over more files than fit the window
+		for (size_t position = 0; position < 2 * filesNum; ++position)
+		{
+			stream.Advance(position);
+			stream.Take(position, prepared);
+			CHECK(Holds(prepared, order, position));
+		}
+
+		// Back to the middle of the first pass, then well ahead
+		size_t const seeks[] = { 2, 3, 30, 9, 10, 11, 0 };
+		for (size_t position : seeks)
+		{
+			stream.Advance(position);
+			stream.Take(position, prepared);
+			CHECK(Holds(prepared, order, position));
+		}
+
+		// The rest of the window follows the seek, nothing older is handed out
+		stream.Take(1, prepared);
+		CHECK(Holds(prepared, order, 1));
+		stream.Take(2, prepared);
+		CHECK(Holds(prepared, order, 2));
+		CHECK(!stream.TryTake(1, prepared));
+
+		// Order changes land while the loader is preparing the window of the old order.
+		// A stale field is the other order's file at the same position, which Holds rejects
+		std::vector<size_t> const orders[] = { LoopOrder(), PingPongOrder() };
+		size_t position = 5;
+		for (size_t i = 0; i < 200; ++i)
+		{
+			order = orders[i % 2];
+
+			stream.Advance(position);
+			stream.SetOrder(order);
+
+			for (size_t k = 0; k < (i % 4); ++k)
+			{
+				stream.Take(position + k, prepared);
+				CHECK(Holds(prepared, order, position + k));
+			}
+
+			// Every few rounds seek back past what the loader already prepared
+			position = i % 5 == 4 ? position - 3 : position + 1;
+		}
+	}
+
+	void CheckSwapper(std::vector<std::string> const& files)
+	{
+		FieldSwapper swapper;
+		swapper.SetUpStreaming(std::unique_ptr<FieldStream>(new FieldStream(files, size, size, format, window)), { 10, 11, 12 });
+		swapper.SetUpStepPerFiled(std::vector<size_t>(filesNum, 2));
+
+		// What each slice holds: the position uploaded into it and that upload
+		std::vector<FieldStream::Prepared> slices(13);
+		std::vector<bool> uploaded(13, false);
+
+		auto upload = [&](size_t slice, FieldStream::Prepared const& prepared)
+		{
+			CHECK(slice >= 10 && slice < 13);
+			CHECK(slice == 10 + prepared.position % window);
+
+			slices[slice] = prepared;
+			uploaded[slice] = true;
+		};
+
+		std::vector<size_t> order = LoopOrder();
+
+		auto checkSlices = [&]()
+		{
+			size_t segment = swapper.CurrentStep() / 2;
+			size_t current = swapper.CurrentFieldSlice();
+
+			CHECK(current == 10 + segment % window);
+			CHECK(uploaded[current] && Holds(slices[current], order, segment));
+
+			// Slices uploaded ahead hold the positions that follow
+			for (size_t k = 1; k < window; ++k)
+			{
+				FieldStream::Prepared const& ahead = slices[10 + (segment + k) % window];
+				if (ahead.position == segment + k)
+				{
+					CHECK(Holds(ahead, order, segment + k));
+				}
+			}
+		};
+
+		swapper.Stream(upload);
+		checkSlices();
+
+		for (size_t step = 1; step < 6 * filesNum; ++step)
+		{
+			swapper.IncStep();
+			swapper.Stream(upload);
+			checkSlices();
+		}
+
+		// Seeks back and forth mid-stream, the slices refill from the new position
+		size_t const seeks[] = { 5, 6, 40, 41, 42, 43, 1, 2, 3, 100, 77 };
+		for (size_t step : seeks)
+		{
+			swapper.Seek(step);
+			swapper.Stream(upload);
+			checkSlices();
+		}
+
+		// Playback change mid-stream: the window prepared for LOOP is stale
+		swapper.SetPlayback(FieldSchedule::Playback::PING_PONG);
+		order = PingPongOrder();
+		swapper.Stream(upload);
+
+		for (size_t step = 0; step < 4 * order.size(); ++step)
+		{
+			swapper.IncStep();
+			swapper.Stream(upload);
+
+			// Slices uploaded before the change still name LOOP fields, only the current one is checked until they refill
+			size_t segment = swapper.CurrentStep() / 2;
+			size_t current = swapper.CurrentFieldSlice();
+			CHECK(current == 10 + segment % window);
+			CHECK(Holds(slices[current], order, segment));
+		}
+
+		FieldSwapper::StreamStats stats = swapper.GetStreamStats();
+		CHECK(stats.uploads > 0);
+		CHECK(stats.failed > 0 && stats.failed < stats.uploads);
+	}
+}
+
+int main()
+{
+	std::vector<std::string> files = WriteFiles();
+
+	CheckStream(files);
+	CheckSwapper(files);
+
+	for (std::string const& file : files)
+	{
+		std::remove(file.c_str());
+	}
+
+	return Check::Result("stream_check");
+}
@@ -0,0 +1,182 @@
+// CPU check of FieldSwapper stepping against the schedule spelled out step by step: seeks anywhere
+// including far past the end, LOOP and PING_PONG wraparound, zero step fields and big increments.
+//   swapper_check
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "FieldSchedule.h"
+#include "FieldSwapper.h"
+
+#include "Check.h"
+
+namespace
+{
+	size_t constexpr firstSlice = 100;
+
+	// Field and steps left in its segment of every step of one period
+	struct Timeline
+	{
+		std::vector<size_t> fields;
+		std::vector<size_t> stepsLeft;
+
+		size_t Field(size_t step) const { return fields[step % fields.size()]; }
+		size_t StepsLeft(size_t step) const { return stepsLeft[step % stepsLeft.size()]; }
+	};
+
+	Timeline MakeTimeline(std::vector<size_t> const& stepsPerField, FieldSchedule::Playback playback)
+	{
+		size_t fieldsNum = stepsPerField.size();
+
+		std::vector<size_t> order;
+		for (size_t i = 0; i < fieldsNum; ++i)
+		{
+			order.push_back(i);
+		}
+		if (playback == FieldSchedule::Playback::PING_PONG && fieldsNum > 2)
+		{
+			for (size_t i = fieldsNum - 2; i > 0; --i)
+			{
+				order.push_back(i);
+			}
+		}
+
+		Timeline timeline;
+		for (size_t field : order)
+		{
+			for (size_t k = 0; k < stepsPerField[field]; ++k)
+			{
+				timeline.fields.push_back(field);
+				timeline.stepsLeft.push_back(stepsPerField[field] - k);
+			}
+		}
+
+		return timeline;
+	}
+
+	void SetUp(FieldSwapper& swapper, std::vector<size_t> const& stepsPerField, FieldSchedule::Playback playback)
+	{
+		for (size_t i = 0; i < stepsPerField.size(); ++i)
+		{
+			swapper.AddField(firstSlice + i);
+		}
+		swapper.SetUpStepPerFiled(stepsPerField);
+		swapper.SetPlayback(playback);
+	}
+
+	bool Matches(FieldSwapper const& swapper, Timeline const& timeline, size_t step)
+	{
+		size_t field = timeline.Field(step);
+
+		return swapper.CurrentStep() == step && swapper.CurrentFieldIndex() == (int)field &&
+			swapper.CurrentFieldSlice() == firstSlice + field && swapper.StepsLeftInField() == timeline.StepsLeft(step);
+	}
+
+	void CheckSchedule(std::vector<size_t> const& stepsPerField, FieldSchedule::Playback playback)
+	{
+		Timeline timeline = MakeTimeline(stepsPerField, playback);
+		size_t period = timeline.fields.size();
+
+		// Step by step over a few periods, every boundary and wraparound on the way
+		FieldSwapper stepped;
+		SetUp(stepped, stepsPerField, playback);
+		CHECK(Matches(stepped, timeline, 0));
+
+		for (size_t step = 1; step <= 3 * period + 1; ++step)
+		{
+			size_t left = stepped.StepsLeftInField();
+			int field = stepped.CurrentFieldIndex();
+
+			stepped.IncStep();
+			CHECK(Matches(stepped, timeline, step));
+
+			// The field only changes once the steps left in it run out, zero step fields never show
+			if (left == 1)
+			{
+				CHECK(stepped.StepsLeftInField() == stepsPerField[stepped.CurrentFieldIndex()]);
+			}
+			else
+			{
+				CHECK(stepped.CurrentFieldIndex() == field);
+				CHECK(stepped.StepsLeftInField() == left - 1);
+			}
+			CHECK(stepsPerField[stepped.CurrentFieldIndex()] != 0);
+		}
+
+		// Seeks back and forth, right before, on and after boundaries and far past the end
+		std::vector<size_t> seeks = { 0, period - 1, period, period + 1, 7 * period - 1, 5, 1000003 * period + 2, 3, (size_t)1 << 40 };
+		for (size_t step = 0; step < period; ++step)
+		{
+			if (timeline.StepsLeft(step) == 1)
+			{
+				seeks.push_back(step);
+				seeks.push_back(step + 1);
+				seeks.push_back(step + 11 * period);
+			}
+		}
+
+		FieldSwapper seeking;
+		SetUp(seeking, stepsPerField, playback);
+		for (size_t step : seeks)
+		{
+			seeking.Seek(step);
+			CHECK(Matches(seeking, timeline, step));
+		}
+
+		// A big increment lands where the seek to the same step does
+		std::mt19937_64 rng(period);
+		FieldSwapper incremented;
+		SetUp(incremented, stepsPerField, playback);
+		for (size_t i = 0; i < 64; ++i)
+		{
+			size_t inc = i % 2 == 0 ? (size_t)(rng() % (50 * period)) : (size_t)(rng() % ((size_t)1 << 32));
+			size_t target = incremented.CurrentStep() + inc;
+
+			incremented.IncStep(inc);
+			seeking.Seek(target);
+
+			CHECK(Matches(incremented, timeline, target));
+			CHECK(incremented.CurrentFieldSlice() == seeking.CurrentFieldSlice());
+			CHECK(incremented.StepsLeftInField() == seeking.StepsLeftInField());
+		}
+	}
+
+	void CheckNothingToPlay()
+	{
+		// Without steps the first field stays for good
+		FieldSwapper swapper;
+		SetUp(swapper, { 0, 0, 0 }, FieldSchedule::Playback::LOOP);
+
+		swapper.IncStep(12345);
+		CHECK(swapper.CurrentFieldIndex() == 0);
+		CHECK(swapper.CurrentFieldSlice() == firstSlice);
+		CHECK(swapper.StepsLeftInField() == SIZE_MAX);
+
+		swapper.Seek(99);
+		CHECK(swapper.CurrentFieldIndex() == 0);
+		CHECK(swapper.StepsLeftInField() == SIZE_MAX);
+	}
+}
+
+int main()
+{
+	std::vector<std::vector<size_t>> const schedules = {
+		{ 4 },
+		{ 1, 1 },
+		{ 3, 5, 2 },
+		{ 3, 0, 5, 1 },
+		{ 0, 2, 0, 0, 7 },
+		{ 6, 1, 1, 4, 0 },
+	};
+
+	for (auto const& stepsPerField : schedules)
+	{
+		CheckSchedule(stepsPerField, FieldSchedule::Playback::LOOP);
+		CheckSchedule(stepsPerField, FieldSchedule::Playback::PING_PONG);
+	}
+
+	CheckNothingToPlay();
+
+	return Check::Result("swapper_check");
+}
@@ -0,0 +1 @@
+#include "PostProcessShaders.fx"
@@ -0,0 +1,58 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local size_t allocationsNum = 0;
+}
+
+void* operator new(size_t size)
+{
+	++allocationsNum;
+
+	if (size == 0)
+	{
+		size = 1;
+	}
+
+	while (true)
+	{
+		void* ptr = std::malloc(size);
+		if (ptr != nullptr)
+		{
+			return ptr;
+		}
+
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		handler();
+	}
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+size_t AllocationCounter::Count()
+{
+	return allocationsNum;
+}
+
+AllocationCounter::Scope::Scope() : m_iStart{ allocationsNum } {}
+
+size_t AllocationCounter::Scope::Allocations() const
+{
+	return allocationsNum - m_iStart;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts global operator new calls made by the calling thread.
+// AllocationCounter.cpp replaces the global operator new/delete, so the counter
+// covers STL containers, std::function and everything else built on them.
+class AllocationCounter
+{
+public:
+	static size_t Count();
+
+	// Allocations made by the calling thread since the scope was opened
+	class Scope
+	{
+	public:
+		Scope();
+
+		size_t Allocations() const;
+
+	private:
+		size_t m_iStart;
+	};
+};
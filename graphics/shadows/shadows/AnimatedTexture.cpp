@@ -1,11 +1,12 @@
 #include <cassert>
+#include <memory>
 #include <DirectXMath.h>
 #include <d3dcompiler.h>
-#include <tchar.h>
 
 #include "AnimatedTexture.h"
-#include "../../WICTextureLoader.h"
-#include "../../stb_image.h"
+#include "AnimationSystem.h"
+#include "ImageImport.h"
+#include "Utils.h"
 #include "../../stb_image_write.h"
 
 #define SAFE_RELEASE(p) \
@@ -16,11 +17,21 @@ if (p != NULL) { \
 
 using namespace DirectX;
 
-struct TextureVertex
+namespace
 {
-	XMVECTORF32 pos;
-	XMFLOAT2 uv;
-};
+	DXGI_FORMAT FieldTextureFormat(FieldEncoding::Format format)
+	{
+		switch (format)
+		{
+		case FieldEncoding::Format::SNORM16:
+			return DXGI_FORMAT_R16G16_SNORM;
+		case FieldEncoding::Format::SNORM8:
+			return DXGI_FORMAT_R8G8_SNORM;
+		default:
+			return DXGI_FORMAT_R32G32_FLOAT;
+		}
+	}
+}
 
 AnimatedTexture::TextureResources::~TextureResources()
 {
@@ -28,27 +39,43 @@ AnimatedTexture::TextureResources::~TextureResources()
 	SAFE_RELEASE(m_pTextureSRV);
 }
 
-AnimatedTexture::AnimatedTexture(ID3D11Device* device, ID3D11DeviceContext* context, UINT width, UINT height)
-	: Texture(device, context, width, height),
-	m_pDevice{ device }, m_pContext{ context },
-	m_pVertexBuffer{ nullptr }, m_pIndexBuffer{ nullptr }, m_pInputLayout{ nullptr },
-	m_pVertexShader{ nullptr }, m_pPixelShader{ nullptr }, m_pDepthStencilView{ nullptr },
-	m_pConstantBuffer{ nullptr }, m_pInterpolateBuffer{ nullptr },
-	m_pFieldSamplerState{ nullptr }, m_pTextureSamplerState{ nullptr }, m_iInc{ 0 }
-{
+AnimatedTexture::ArrayTexture::ArrayTexture()
+	: m_pTexture{ nullptr }, m_pTextureSRV{ nullptr }, m_pTextureUAV{ nullptr }, m_iSlices{ 0 } {}
 
+AnimatedTexture::ArrayTexture::~ArrayTexture()
+{
+	Release();
 }
 
-AnimatedTexture::~AnimatedTexture()
+void AnimatedTexture::ArrayTexture::Release()
 {
-	for (auto& pingPing : m_aLayerTextures)
+	for (auto& sliceRTV : m_aSliceRTVs)
 	{
-		if (pingPing)
-		{
-			delete pingPing;
-		}
+		SAFE_RELEASE(sliceRTV);
 	}
+	m_aSliceRTVs.clear();
 
+	SAFE_RELEASE(m_pTextureUAV);
+	SAFE_RELEASE(m_pTextureSRV);
+	SAFE_RELEASE(m_pTexture);
+
+	m_iSlices = 0;
+}
+
+AnimatedTexture::AnimatedTexture(AnimationSystem const& system, ID3D11Device* device, ID3D11DeviceContext* context,
+	UINT width, UINT height, FieldEncoding::Format fieldFormat)
+	: Texture(device, context, width, height),
+	m_system(system), m_pDevice{ device }, m_pContext{ context },
+	m_iSourceLayers{ 0 }, m_eFieldFormat{ fieldFormat }, m_atlas{ fieldFormat, width, height },
+	m_pInterpolateBuffer{ nullptr }, m_iScale{ 0 }, m_iInc{ 0 },
+	m_iPendingSteps{ 0 }, m_bSampled{ false }, m_bSampledLastFrame{ true },
+	m_clock{ 1.0 / expectedFrameTime }
+{
+
+}
+
+AnimatedTexture::~AnimatedTexture()
+{
 	for (auto& field : m_aFieldSwappers)
 	{
 		if (field)
@@ -57,292 +84,431 @@ AnimatedTexture::~AnimatedTexture()
 		}
 	}
 
-	SAFE_RELEASE(m_pVertexBuffer);
-	SAFE_RELEASE(m_pIndexBuffer);
-	SAFE_RELEASE(m_pInputLayout);
+	SAFE_RELEASE(m_pInterpolateBuffer);
+}
 
-	SAFE_RELEASE(m_pVertexShader);
-	SAFE_RELEASE(m_pPixelShader);
+HRESULT AnimatedTexture::CreateResources()
+{
+	D3D11_BUFFER_DESC desc = { 0 };
+	desc.ByteWidth = sizeof(AnimatedTexture::InterpolateBuffer);
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
 
-	SAFE_RELEASE(m_pDepthStencilView);
+	HRESULT result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pInterpolateBuffer);
+	assert(SUCCEEDED(result));
 
-	SAFE_RELEASE(m_pConstantBuffer);
-	SAFE_RELEASE(m_pInterpolateBuffer);
+	return result;
+}
 
-	SAFE_RELEASE(m_pFieldSamplerState);
-	SAFE_RELEASE(m_pTextureSamplerState);
+void AnimatedTexture::UpdateConstantBuffer(CBuffer const* buffer)
+{
+	// The layer constants are assembled per dispatch, only the scale comes from the caller
+	m_iScale = buffer->secs.i[0];
 }
 
-HRESULT AnimatedTexture::CreateAnimationTextureResources(std::string const& vertexShader, std::string const& pixelShader)
+void AnimatedTexture::UpdateInterpolateBuffer(InterpolateBuffer const* buffer)
 {
-	static const TextureVertex vertices[4] = {
-		{ {-1, -1, 0, 1}, {0, 1} },
-		{ {-1, 1, 0, 1}, {0, 0} },
-		{ { 1, 1, 0, 1}, {1, 0} },
-		{ {1, -1, 0, 1}, {1, 1} }
-	};
-	static const UINT16 indices[6] = {
-		0, 1, 2, 0, 2, 3
-	};
+	InterpolateBuffer data = *buffer;
+	LayerBatch::FieldSlices(m_aFieldSwappers, data.fieldSlices);
+
+	float scale[2];
+	FieldDecode(scale);
+	data.fieldDecode = { scale[0], scale[1], 0.0f, 0.0f };
+
+	m_pContext->UpdateSubresource(m_pInterpolateBuffer, 0, nullptr, &data, 0, 0);
+}
+
+ID3D11Buffer* const* AnimatedTexture::GetInterpolateBufferAdress() const
+{
+	return &m_pInterpolateBuffer;
+}
+
+ID3D11ShaderResourceView* AnimatedTexture::GetBackgroundTextureSRV() const
+{
+	return m_pBackgroundTexture->m_pTextureSRV;
+}
+
+ID3D11Texture2D* AnimatedTexture::GetBackgroundTexture() const
+{
+	return m_pBackgroundTexture->m_pTexture;
+}
 
-	D3D11_BUFFER_DESC vertexBufferDesc{ 0 };
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(vertices);
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
+ID3D11SamplerState* const* AnimatedTexture::GetSamplerAdress() const
+{
+	return m_system.GetSamplerAdress();
+}
 
-	D3D11_SUBRESOURCE_DATA vertexData{ 0 };
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
+size_t AnimatedTexture::GetLayersNum() const
+{
+	return m_aLayerArrays[m_iSourceLayers].m_iSlices;
+}
 
-	HRESULT result = m_pDevice->CreateBuffer(&vertexBufferDesc, &vertexData, &m_pVertexBuffer);
+ID3D11ShaderResourceView* AnimatedTexture::GetLayersSourceSRV() const
+{
+	return m_aLayerArrays[m_iSourceLayers].m_pTextureSRV;
+}
 
+ID3D11ShaderResourceView* AnimatedTexture::GetLayersTargetSRV() const
+{
+	return m_aLayerArrays[1 - m_iSourceLayers].m_pTextureSRV;
+}
+
+std::vector<ID3D11ShaderResourceView*> AnimatedTexture::GetLayersTargetTexturesSRV() const
+{
+	return { GetLayersSourceSRV() };
+}
+
+ID3D11ShaderResourceView* AnimatedTexture::GetFieldsSRV() const
+{
+	return m_fieldAtlas.m_pTextureSRV;
+}
+
+ID3D11ShaderResourceView* AnimatedTexture::GetFieldTilesSRV() const
+{
+	return m_fieldTiles.m_pTextureSRV;
+}
+
+FieldEncoding::Format AnimatedTexture::GetFieldFormat() const
+{
+	return m_eFieldFormat;
+}
+
+void AnimatedTexture::FieldDecode(float* scale) const
+{
+	FieldEncoding::DecodeScale(m_eFieldFormat, m_iWidth, m_iHeight, scale);
+}
+
+HRESULT AnimatedTexture::ResizeArray(ArrayTexture& array, DXGI_FORMAT format, UINT bindFlags, UINT width, UINT height, UINT slices) const
+{
+	assert(slices > array.m_iSlices);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Format = format;
+	desc.ArraySize = slices;
+	desc.MipLevels = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.Height = height;
+	desc.Width = width;
+	desc.BindFlags = bindFlags;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+
+	ArrayTexture resized;
+
+	HRESULT result = m_pDevice->CreateTexture2D(&desc, nullptr, &resized.m_pTexture);
+
+	// Explicit array views, the default view of a single slice texture is a Texture2D one
 	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC indexBufferDesc{ 0 };
-		indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-		indexBufferDesc.ByteWidth = sizeof(indices);
-		indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		indexBufferDesc.CPUAccessFlags = 0;
-		indexBufferDesc.MiscFlags = 0;
-		indexBufferDesc.StructureByteStride = 0;
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = 1;
+		srvDesc.Texture2DArray.ArraySize = slices;
 
-		D3D11_SUBRESOURCE_DATA indexData{ 0 };
-		indexData.pSysMem = indices;
-		indexData.SysMemPitch = 0;
-		indexData.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&indexBufferDesc, &indexData, &m_pIndexBuffer);
+		result = m_pDevice->CreateShaderResourceView(resized.m_pTexture, &srvDesc, &resized.m_pTextureSRV);
 	}
 
-	if (SUCCEEDED(result))
+	if (SUCCEEDED(result) && (bindFlags & D3D11_BIND_UNORDERED_ACCESS))
 	{
-		ID3DBlob* pBlob = nullptr;
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format = format;
+		uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2DARRAY;
+		uavDesc.Texture2DArray.ArraySize = slices;
 
-		m_pVertexShader = CreateVertexShader(std::string(vertexShader.begin(), vertexShader.end()).c_str(), &pBlob);
-		m_pPixelShader = CreatePixelShader(std::string(pixelShader.begin(), pixelShader.end()).c_str());
+		result = m_pDevice->CreateUnorderedAccessView(resized.m_pTexture, &uavDesc, &resized.m_pTextureUAV);
+	}
 
-		assert(m_pVertexShader != nullptr && m_pPixelShader != nullptr);
+	// The pixel path draws one slice at a time
+	if (bindFlags & D3D11_BIND_RENDER_TARGET)
+	{
+		resized.m_aSliceRTVs.resize(slices, nullptr);
 
-		if (m_pVertexShader == nullptr || m_pPixelShader == nullptr)
+		for (UINT i = 0; i < slices && SUCCEEDED(result); ++i)
 		{
-			return E_FAIL;
+			D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+			rtvDesc.Format = format;
+			rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+			rtvDesc.Texture2DArray.FirstArraySlice = i;
+			rtvDesc.Texture2DArray.ArraySize = 1;
+
+			result = m_pDevice->CreateRenderTargetView(resized.m_pTexture, &rtvDesc, &resized.m_aSliceRTVs[i]);
 		}
+	}
 
-		if (SUCCEEDED(result))
-		{
-			D3D11_INPUT_ELEMENT_DESC inputDesc[2] = {
-				D3D11_INPUT_ELEMENT_DESC{"POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0 , D3D11_INPUT_PER_VERTEX_DATA, 0},
-				D3D11_INPUT_ELEMENT_DESC{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, sizeof(XMVECTORF32), D3D11_INPUT_PER_VERTEX_DATA, 0}
-			};
+	assert(SUCCEEDED(result));
 
-			result = m_pDevice->CreateInputLayout(inputDesc, 2, pBlob->GetBufferPointer(), pBlob->GetBufferSize(), &m_pInputLayout);
-		}
+	if (FAILED(result))
+	{
+		return result;
+	}
 
-		SAFE_RELEASE(pBlob);
+	for (UINT i = 0; i < array.m_iSlices; ++i)
+	{
+		UINT subresource = D3D11CalcSubresource(0, i, 1);
+
+		m_pContext->CopySubresourceRegion(resized.m_pTexture, subresource, 0, 0, 0, array.m_pTexture, subresource, nullptr);
 	}
 
-	if (SUCCEEDED(result))
+	array.Release();
+
+	array.m_pTexture = resized.m_pTexture;
+	array.m_pTextureSRV = resized.m_pTextureSRV;
+	array.m_pTextureUAV = resized.m_pTextureUAV;
+	array.m_aSliceRTVs.swap(resized.m_aSliceRTVs);
+	array.m_iSlices = slices;
+
+	resized.m_pTexture = nullptr;
+	resized.m_pTextureSRV = nullptr;
+	resized.m_pTextureUAV = nullptr;
+
+	return result;
+}
+
+HRESULT AnimatedTexture::CreateVectorFieldTexture(VectorField const* field, FieldSwapper* swapper)
+{
+	// Decoding scales by the texture size, raw_data() divides by the field size
+	if (field->Width() != m_iWidth || field->Height() != m_iHeight)
 	{
-		ID3D11Texture2D* pTexture = nullptr;
+		assert(false);
+		return E_INVALIDARG;
+	}
 
-		D3D11_TEXTURE2D_DESC depthDesc = {};
-		depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-		depthDesc.ArraySize = 1;
-		depthDesc.MipLevels = 1;
-		depthDesc.Usage = D3D11_USAGE_DEFAULT;
-		depthDesc.Height = m_iHeight;
-		depthDesc.Width = m_iWidth;
-		depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-		depthDesc.CPUAccessFlags = 0;
-		depthDesc.MiscFlags = 0;
-		depthDesc.SampleDesc.Count = 1;
-		depthDesc.SampleDesc.Quality = 0;
+	std::vector<uint32_t> fieldTiles;
+	std::vector<uint32_t> transformTiles;
+	std::vector<FieldAtlas::Copy> copies;
 
-		HRESULT result = m_pDevice->CreateTexture2D(&depthDesc, nullptr, &pTexture);
+	HRESULT result = S_OK;
 
+	// Copies of one plane are uploaded before the next one reuses the staging
+	auto addTiles = [&](auto const& source, std::vector<uint32_t>& tiles)
+	{
 		if (SUCCEEDED(result))
 		{
-			result = m_pDevice->CreateDepthStencilView(pTexture, nullptr, &m_pDepthStencilView);
+			m_atlas.AddTiles(source, tiles, copies);
+			result = UploadAtlasTiles(copies);
 		}
+	};
 
-		SAFE_RELEASE(pTexture);
-	}
+	// Texels of a *.vfb in the field format are tiled straight from the mapping and the tiles of a compact
+	// field as they are, neither brings the planes back
+	unsigned char const* mapped = field->mapped_texels(m_eFieldFormat);
+	SparseField const* sparse = field->Sparse();
 
-	if (SUCCEEDED(result))
+	if (mapped != nullptr)
 	{
-		D3D11_BUFFER_DESC desc = { 0 };
-		desc.ByteWidth = sizeof(AnimatedTexture::CBuffer);
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
+		unsigned char const* mappedTransform = field->mapped_transform_texels(m_eFieldFormat);
 
-		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pConstantBuffer);
+		addTiles(mapped, fieldTiles);
+		if (mappedTransform != nullptr)
+		{
+			addTiles(mappedTransform, transformTiles);
+		}
+	}
+	else if (sparse != nullptr)
+	{
+		SparseField const* sparseTransform = field->SparseTransform();
 
-		assert(SUCCEEDED(result));
+		if (!FieldAtlas::InRange(*sparse, m_eFieldFormat) || !FieldAtlas::InRange(*sparseTransform, m_eFieldFormat))
+		{
+			assert(false);
+			return E_INVALIDARG;
+		}
 
-		if (FAILED(result))
+		// A zero transform is all zero tiles and takes no atlas space
+		addTiles(*sparse, fieldTiles);
+		addTiles(*sparseTransform, transformTiles);
+	}
+	else
+	{
+		FieldStorage const& storage = field->Storage();
+		FieldStorage const& transform = field->TransformStorage();
+
+		if (!FieldEncoding::InRange(storage, m_eFieldFormat) || !FieldEncoding::InRange(transform, m_eFieldFormat))
 		{
-			return result;
+			assert(false);
+			return E_INVALIDARG;
 		}
 
-		desc.ByteWidth = sizeof(AnimatedTexture::InterpolateBuffer);
+		m_aFieldTexels.resize(FieldEncoding::TexelSize(m_eFieldFormat) * m_iWidth * m_iHeight);
 
-		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pInterpolateBuffer);
-		assert(SUCCEEDED(result));
-	}
-	
-	if (SUCCEEDED(result)) {
-		D3D11_SAMPLER_DESC sd = {};
-		ZeroMemory(&sd, sizeof(sd));
+		FieldEncoding::Encode(storage, m_eFieldFormat, m_aFieldTexels.data());
+		addTiles(m_aFieldTexels.data(), fieldTiles);
 
-		sd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-		sd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-		sd.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-		sd.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-		sd.MinLOD = 0;
-		sd.MaxAnisotropy = 16;
-		sd.MaxLOD = D3D11_FLOAT32_MAX;
+		if (!FieldEncoding::IsZero(transform))
+		{
+			FieldEncoding::Encode(transform, m_eFieldFormat, m_aFieldTexels.data());
+			addTiles(m_aFieldTexels.data(), transformTiles);
+		}
+	}
 
-		result = m_pDevice->CreateSamplerState(&sd, &m_pFieldSamplerState);
-		assert(SUCCEEDED(result));
+	UINT slice = m_fieldTiles.m_iSlices;
 
-		sd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	if (SUCCEEDED(result))
+	{
+		result = ResizeArray(m_fieldTiles, DXGI_FORMAT_R32G32_UINT, D3D11_BIND_SHADER_RESOURCE,
+			(UINT)m_atlas.TilesX(), (UINT)m_atlas.TilesY(), slice + 1);
+	}
 
-		result = m_pDevice->CreateSamplerState(&sd, &m_pTextureSamplerState);
-		assert(SUCCEEDED(result));
+	if (SUCCEEDED(result))
+	{
+		UploadSliceTiles(slice, fieldTiles, transformTiles);
 
-		samplers.push_back(m_pFieldSamplerState);
-		samplers.push_back(m_pTextureSamplerState);
+		swapper->AddField(slice);
 	}
 
 	return result;
 }
 
-void AnimatedTexture::UpdateConstantBuffer(CBuffer const* buffer)
-{
-	m_pContext->UpdateSubresource(m_pConstantBuffer, 0, nullptr, buffer, 0, 0);
-}
-
-void AnimatedTexture::UpdateInterpolateBuffer(InterpolateBuffer const* buffer)
+HRESULT AnimatedTexture::CreateStreamedFields(std::vector<std::string> const& files, size_t window, FieldSwapper* swapper)
 {
-	m_pContext->UpdateSubresource(m_pInterpolateBuffer, 0, nullptr, buffer, 0, 0);
-}
+	if (files.empty() || window == 0)
+	{
+		assert(false);
+		return E_INVALIDARG;
+	}
 
-ID3D11Buffer* const* AnimatedTexture::GetInterpolateBufferAdress() const
-{
-	return &m_pInterpolateBuffer;
-}
+	UINT first = m_fieldTiles.m_iSlices;
 
-ID3D11ShaderResourceView* AnimatedTexture::GetBackgroundTextureSRV() const
-{
-	return m_pBackgroundTexture->m_pTextureSRV;
-}
+	HRESULT result = ResizeArray(m_fieldTiles, DXGI_FORMAT_R32G32_UINT, D3D11_BIND_SHADER_RESOURCE,
+		(UINT)m_atlas.TilesX(), (UINT)m_atlas.TilesY(), first + (UINT)window);
 
-ID3D11Texture2D* AnimatedTexture::GetBackgroundTexture() const
-{
-	return m_pBackgroundTexture->m_pTexture;
-}
+	std::vector<size_t> slices;
 
-ID3D11SamplerState* const* AnimatedTexture::GetSamplerAdress() const
-{
-	return samplers.data();
-}
+	if (SUCCEEDED(result))
+	{
+		m_aStreamedSlices.resize(m_fieldTiles.m_iSlices, { FieldAtlas::zeroTile, FieldAtlas::zeroTile });
 
-size_t AnimatedTexture::GetLayersNum() const
-{
-	return m_aLayerTextures.size();
-}
+		for (UINT i = first; i < m_fieldTiles.m_iSlices; ++i)
+		{
+			m_aStreamedSlices[i].field = m_atlas.Reserve();
+			slices.push_back(i);
+		}
 
-std::vector<ID3D11ShaderResourceView*> AnimatedTexture::GetLayersSourceTexturesSRV() const
-{
-	std::vector<ID3D11ShaderResourceView*> layers(m_aLayerTextures.size());
+		// Zero fields until the first ones are streamed in
+		result = UploadAtlasTiles({});
+	}
 
-	for (size_t i = 0; i < layers.size(); ++i)
+	if (SUCCEEDED(result))
 	{
-		layers[i] = m_aLayerTextures[i]->SourceSRV();
-	}
+		std::vector<uint32_t> fieldTiles;
 
-	return layers;
-}
+		for (size_t i : slices)
+		{
+			m_atlas.ReservedTiles(m_aStreamedSlices[i].field, fieldTiles);
+			UploadSliceTiles((UINT)i, fieldTiles, {});
+		}
 
-std::vector<ID3D11ShaderResourceView*> AnimatedTexture::GetLayersTargetTexturesSRV() const
-{
-	std::vector<ID3D11ShaderResourceView*> layers(m_aLayerTextures.size());
+		swapper->SetUpStreaming(std::make_unique<FieldStream>(files, m_iWidth, m_iHeight, m_eFieldFormat, window), slices);
 
-	for (size_t i = 0; i < layers.size(); ++i)
-	{
-		layers[i] = m_aLayerTextures[i]->TargetSRV();
+		// Waits for the first field like CreateVectorFieldTexture would
+		StreamFields(swapper);
 	}
 
-	return layers;
+	return result;
+}
+
+void AnimatedTexture::StreamFields(FieldSwapper* swapper)
+{
+	swapper->Stream([this](size_t slice, FieldStream::Prepared const& prepared)
+		{
+			StreamedSlice& streamed = m_aStreamedSlices[slice];
+			bool hasTransform = !prepared.transform.empty();
+
+			// Kept for the transforms streamed into the slice later on
+			if (hasTransform && streamed.transform == FieldAtlas::zeroTile)
+			{
+				streamed.transform = m_atlas.Reserve();
+			}
+
+			std::vector<FieldAtlas::Copy> copies;
+			m_atlas.ReservedCopies(streamed.field, prepared.field.data(), copies);
+
+			HRESULT result = UploadAtlasTiles(copies);
+
+			if (SUCCEEDED(result) && hasTransform)
+			{
+				m_atlas.ReservedCopies(streamed.transform, prepared.transform.data(), copies);
+				result = UploadAtlasTiles(copies);
+			}
+
+			// A field without a transform reads the zero tile, the reserved transform tiles wait for the next one
+			if (SUCCEEDED(result))
+			{
+				std::vector<uint32_t> fieldTiles;
+				std::vector<uint32_t> transformTiles;
+
+				m_atlas.ReservedTiles(streamed.field, fieldTiles);
+				if (hasTransform)
+				{
+					m_atlas.ReservedTiles(streamed.transform, transformTiles);
+				}
+
+				UploadSliceTiles((UINT)slice, fieldTiles, transformTiles);
+			}
+		});
 }
 
-std::vector<ID3D11RenderTargetView*> AnimatedTexture::GetLayersTexturesRTV() const
+HRESULT AnimatedTexture::UploadAtlasTiles(std::vector<FieldAtlas::Copy> const& copies)
 {
-	std::vector<ID3D11RenderTargetView*> layers(m_aLayerTextures.size());
+	size_t texelSize = FieldEncoding::TexelSize(m_eFieldFormat);
+	UINT first = m_fieldAtlas.m_iSlices;
+	UINT pages = (UINT)m_atlas.PagesNum();
 
-	for (size_t i = 0; i < layers.size(); ++i)
+	if (pages > first)
 	{
-		layers[i] = m_aLayerTextures[i]->RenderTargetView();
-	}
+		HRESULT result = ResizeArray(m_fieldAtlas, FieldTextureFormat(m_eFieldFormat), D3D11_BIND_SHADER_RESOURCE,
+			(UINT)m_atlas.PageWidth(), (UINT)m_atlas.PageHeight(), pages);
 
-	return layers;
-}
+		if (FAILED(result))
+		{
+			return result;
+		}
 
-std::vector<ID3D11Texture2D*> AnimatedTexture::GetLayersTextures() const
-{
-	std::vector<ID3D11Texture2D*> layers(m_aLayerTextures.size());
+		// FieldAtlas::zeroTile, and what the copies of edge tiles leave out
+		std::vector<unsigned char> zeros(texelSize * m_atlas.PageWidth() * m_atlas.PageHeight(), 0);
+
+		for (UINT page = first; page < pages; ++page)
+		{
+			m_pContext->UpdateSubresource(m_fieldAtlas.m_pTexture, D3D11CalcSubresource(0, page, 1), nullptr,
+				zeros.data(), (UINT)(texelSize * m_atlas.PageWidth()), 0);
+		}
+	}
 
-	for (size_t i = 0; i < layers.size(); ++i)
+	for (FieldAtlas::Copy const& copy : copies)
 	{
-		layers[i] = m_aLayerTextures[i]->TargetTexture();
+		size_t page, x, y;
+		m_atlas.Origin(copy.tile, page, x, y);
+
+		D3D11_BOX box = { (UINT)x, (UINT)y, 0, (UINT)(x + copy.width), (UINT)(y + copy.height), 1 };
+
+		m_pContext->UpdateSubresource(m_fieldAtlas.m_pTexture, D3D11CalcSubresource(0, (UINT)page, 1), &box,
+			copy.texels, (UINT)copy.rowPitch, 0);
 	}
 
-	return layers;
+	return S_OK;
 }
 
-HRESULT AnimatedTexture::CreateVectorFieldTexture(VectorField const* field, FieldSwapper* swapper) const
+void AnimatedTexture::UploadSliceTiles(UINT slice, std::vector<uint32_t> const& fieldTiles, std::vector<uint32_t> const& transformTiles)
 {
-	D3D11_TEXTURE2D_DESC desc = {};
-	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	desc.ArraySize = 1;
-	desc.MipLevels = 1;
-	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.Height = m_iHeight;
-	desc.Width = m_iWidth;
-	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	desc.CPUAccessFlags = 0;
-	desc.MiscFlags = 0;
-	desc.SampleDesc.Count = 1;
-	desc.SampleDesc.Quality = 0;
-
-	D3D11_SUBRESOURCE_DATA initData = {};
-	initData.pSysMem = field->raw_data();
-	initData.SysMemPitch = 4u * m_iHeight * sizeof(float);
-	initData.SysMemSlicePitch = 0;
-
-	ID3D11Texture2D* animatedTextureVectorField = nullptr;
-	ID3D11ShaderResourceView* animatedTextureVectorFieldSRV = nullptr;
+	assert(fieldTiles.size() == m_atlas.TilesX() * m_atlas.TilesY());
+	assert(transformTiles.empty() || transformTiles.size() == fieldTiles.size());
 
-	HRESULT result = m_pDevice->CreateTexture2D(&desc, &initData, &animatedTextureVectorField);
-	assert(SUCCEEDED(result));
+	m_aSliceTiles.resize(2 * fieldTiles.size());
 
-	if (SUCCEEDED(result))
+	for (size_t ind = 0; ind < fieldTiles.size(); ++ind)
 	{
-		result = m_pDevice->CreateShaderResourceView(animatedTextureVectorField, NULL, &animatedTextureVectorFieldSRV);
+		m_aSliceTiles[2 * ind + 0] = fieldTiles[ind];
+		m_aSliceTiles[2 * ind + 1] = transformTiles.empty() ? FieldAtlas::zeroTile : transformTiles[ind];
 	}
 
-	assert(SUCCEEDED(result));
-
-	swapper->AddField(animatedTextureVectorField, animatedTextureVectorFieldSRV);
-
-	return result;
+	m_pContext->UpdateSubresource(m_fieldTiles.m_pTexture, D3D11CalcSubresource(0, slice, 1), nullptr,
+		m_aSliceTiles.data(), (UINT)(2 * sizeof(uint32_t) * m_atlas.TilesX()), 0);
 }
 
 std::vector<FieldSwapper*> AnimatedTexture::GetFields() const
@@ -350,6 +516,13 @@ std::vector<FieldSwapper*> AnimatedTexture::GetFields() const
 	return m_aFieldSwappers;
 }
 
+FieldSwapper* AnimatedTexture::GetField(size_t ind) const
+{
+	assert(ind < m_aFieldSwappers.size());
+
+	return m_aFieldSwappers[ind];
+}
+
 void AnimatedTexture::AddBackground(ID3D11Texture2D* texture, ID3D11ShaderResourceView* textureSRV)
 {
 	assert(texture != nullptr && textureSRV != nullptr);
@@ -366,286 +539,286 @@ void AnimatedTexture::AddBackground(ID3D11Texture2D* texture, ID3D11ShaderResour
 	m_pBackgroundTexture->m_pTextureSRV = textureSRV;
 }
 
-void AnimatedTexture::AddLayer(ID3D11Texture2D* texture, ID3D11ShaderResourceView* textureSRV, ID3D11RenderTargetView* textureRTV)
+void AnimatedTexture::SetUpFields(std::vector<FieldSwapper*> const& fields)
 {
-	assert(texture != nullptr && textureSRV != nullptr && textureRTV != nullptr);
+	assert(fields.size() <= LayerBatch::maxLayers);
 
-	PingPong* pingPong = new PingPong();
-	assert(pingPong != nullptr);
-
-	pingPong->SetupResources(PingPong::ResourceType::SOURCE, texture, textureRTV, textureSRV);
-
-	{
-		D3D11_TEXTURE2D_DESC depthDesc = {};
-		depthDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		depthDesc.ArraySize = 1;
-		depthDesc.MipLevels = 1;
-		depthDesc.Usage = D3D11_USAGE_DEFAULT;
-		depthDesc.Height = m_iHeight;
-		depthDesc.Width = m_iWidth;
-		depthDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-		depthDesc.CPUAccessFlags = 0;
-		depthDesc.MiscFlags = 0;
-		depthDesc.SampleDesc.Count = 1;
-		depthDesc.SampleDesc.Quality = 0;
+	m_aFieldSwappers = fields;
+}
 
-		ID3D11Texture2D* pTextureRenderTarget(nullptr);
-		ID3D11RenderTargetView* pTextureRenderTargetRTV(nullptr);
-		ID3D11ShaderResourceView* pTextureRenderTargetSRV(nullptr);
+void AnimatedTexture::Swap()
+{
+	m_iSourceLayers = 1 - m_iSourceLayers;
+}
 
-		HRESULT result = m_pDevice->CreateTexture2D(&depthDesc, NULL, &pTextureRenderTarget);
+void AnimatedTexture::SaveIncrement(size_t inc)
+{
+	m_iInc = inc;
+}
 
-		if (SUCCEEDED(result))
-		{
-			result = m_pDevice->CreateRenderTargetView(pTextureRenderTarget, NULL, &pTextureRenderTargetRTV);
-		}
-		if (SUCCEEDED(result))
-		{
-			result = m_pDevice->CreateShaderResourceView(pTextureRenderTarget, NULL, &pTextureRenderTargetSRV);
-		}
+void AnimatedTexture::IncrementSaved()
+{
+	IncrementStep(m_iInc);
+	m_iInc = 0;
+}
 
-		assert(SUCCEEDED(result));
+void AnimatedTexture::AddPendingSteps(size_t steps)
+{
+	m_iPendingSteps += steps;
+}
 
-		pingPong->SetupResources(PingPong::ResourceType::TARGET, pTextureRenderTarget, pTextureRenderTargetRTV, pTextureRenderTargetSRV);
-	}
+size_t AnimatedTexture::TakePassSteps()
+{
+	size_t steps = LayerBatch::PassSteps(m_iPendingSteps, m_aFieldSwappers);
+	m_iPendingSteps -= steps;
 
-	m_aLayerTextures.push_back(pingPong);
+	return steps;
 }
 
-void AnimatedTexture::SetUpFields(std::vector<FieldSwapper*> const& fields)
+void AnimatedTexture::MarkSampled()
 {
-	m_aFieldSwappers = fields;
+	m_bSampled = true;
 }
 
-void AnimatedTexture::Swap()
+bool AnimatedTexture::WasSampledLastFrame() const
 {
-	for (auto& pingPong : m_aLayerTextures)
-	{
-		pingPong->Swap();
-	}
+	return m_bSampledLastFrame;
 }
 
-void AnimatedTexture::SaveIncrement(size_t inc)
+bool AnimatedTexture::IsLayerPassNeeded() const
 {
-	m_iInc = inc;
+	return m_iPendingSteps > 0 && m_bSampledLastFrame && GetLayersNum() > 0;
 }
 
-void AnimatedTexture::IncrementSaved()
+void AnimatedTexture::EndFrame()
 {
-	IncrementStep(m_iInc);
+	// Zero unless a pass ran, skipped frames don't move the fields either
+	IncrementSaved();
+
+	m_bSampledLastFrame = m_bSampled;
+	m_bSampled = false;
 }
 
 HRESULT AnimatedTexture::AddBackgroundByName(std::string const& filename)
 {
-	ID3D11Texture2D* texture = nullptr;
-	ID3D11ShaderResourceView* textureSRV = nullptr;
-
-	HRESULT result = CreateWICTextureFromFile(
-		m_pDevice,
-		m_pContext,
-		std::wstring(filename.begin(), filename.end()).c_str(),
-		(ID3D11Resource**)&texture,
-		&textureSRV
-	);
-
-	if (SUCCEEDED(result))
+	ImageImport::Image image;
+	if (!ImageImport::Load(filename, image))
 	{
-		AddBackground(texture, textureSRV);
+		return E_FAIL;
 	}
 
-	return result;
+	return AddBackground(image);
 }
 
-HRESULT AnimatedTexture::AddLayerByName(std::string const& filename)
+HRESULT AnimatedTexture::AddBackground(ImageImport::Image const& image)
 {
+	assert(image.format == ImageImport::Format::RGBA8);
+
 	ID3D11Texture2D* texture = nullptr;
 	ID3D11ShaderResourceView* textureSRV = nullptr;
-	ID3D11RenderTargetView* textureRTV = nullptr;
-
-	int x, y, n;
-	unsigned char* pixels = stbi_load(filename.c_str(), &x, &y, &n, 0);
-	assert(pixels != nullptr);
 
-	HRESULT result = CreateWICTextureFromFile(
-		m_pDevice,
-		m_pContext,
-		std::wstring(filename.begin(), filename.end()).c_str(),
-		(ID3D11Resource**)&texture,
-		&textureSRV
-	);
+	// Full mip chain as the WIC loader created it, the background is sampled minified
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.ArraySize = 1;
+	textureDesc.MipLevels = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.Height = (UINT)image.height;
+	textureDesc.Width = (UINT)image.width;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	textureDesc.SampleDesc.Count = 1;
 
-	delete pixels;
+	HRESULT result = m_pDevice->CreateTexture2D(&textureDesc, nullptr, &texture);
 
 	if (SUCCEEDED(result))
 	{
-		result = m_pDevice->CreateRenderTargetView(texture, nullptr, &textureRTV);
+		result = m_pDevice->CreateShaderResourceView(texture, nullptr, &textureSRV);
 	}
 
 	if (SUCCEEDED(result))
 	{
-		AddLayer(texture, textureSRV, textureRTV);
+		m_pContext->UpdateSubresource(texture, 0, nullptr, image.Data(), (UINT)image.RowPitch(), 0);
+		m_pContext->GenerateMips(textureSRV);
+
+		AddBackground(texture, textureSRV);
+	}
+	else
+	{
+		SAFE_RELEASE(texture);
 	}
 
 	return result;
 }
 
-void AnimatedTexture::Render(ID3D11RasterizerState* pRasterizerState,
-	ID3D11SamplerState* pSamplerState,
-	ID3D11Buffer* pConstantBuffer)
+HRESULT AnimatedTexture::AddLayerByName(std::string const& filename)
 {
-	for (size_t i = 0; i < m_aLayerTextures.size(); ++i)
+	ImageImport::Image image;
+	if (!ImageImport::Load(filename, image))
 	{
-		m_pContext->ClearState();
+		return E_FAIL;
+	}
 
-		ID3D11RenderTargetView* views[] = { m_aLayerTextures[i]->RenderTargetView() };
-		m_pContext->OMSetRenderTargets(1, views, m_pDepthStencilView);
+	return AddLayer(image);
+}
 
-		static const FLOAT blackColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-		m_pContext->ClearRenderTargetView(m_aLayerTextures[i]->RenderTargetView(), blackColor);
-		m_pContext->ClearDepthStencilView(m_pDepthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
+HRESULT AnimatedTexture::AddLayer(ImageImport::Image const& image)
+{
+	assert(image.format == ImageImport::Format::RGBA8);
 
-		D3D11_VIEWPORT viewport{ 0, 0, (float)m_iWidth, (float)m_iHeight, 0.0f, 1.0f };
-		m_pContext->RSSetViewports(1, &viewport);
-		D3D11_RECT rect{ 0, 0, (LONG)m_iWidth, (LONG)m_iHeight };
-		m_pContext->RSSetScissorRects(1, &rect);
+	// Slices of an array share one size, the pass renders at the texture size anyway
+	if (image.width != m_iWidth || image.height != m_iHeight || GetLayersNum() >= LayerBatch::maxLayers)
+	{
+		return E_INVALIDARG;
+	}
+
+	UINT slice = (UINT)GetLayersNum();
+	UINT bindFlags = LayersBindFlags();
 
-		RenderTexture(i, pRasterizerState, pSamplerState, m_pConstantBuffer, m_aFieldSwappers[i]);
+	HRESULT result = S_OK;
+
+	for (auto& layers : m_aLayerArrays)
+	{
+		if (SUCCEEDED(result))
+		{
+			result = ResizeArray(layers, DXGI_FORMAT_R8G8B8A8_UNORM, bindFlags, m_iWidth, m_iHeight, slice + 1);
+		}
 	}
-}
 
-void AnimatedTexture::IncrementStep(size_t incSize)
-{
-	for (auto& swapper : m_aFieldSwappers)
+	if (SUCCEEDED(result))
 	{
-		swapper->IncStep(incSize);
+		m_pContext->UpdateSubresource(m_aLayerArrays[m_iSourceLayers].m_pTexture, D3D11CalcSubresource(0, slice, 1), nullptr,
+			image.Data(), (UINT)image.RowPitch(), 0);
 	}
+
+	return result;
 }
 
-void AnimatedTexture::RenderTexture(size_t textureNum,
-	ID3D11RasterizerState* pRasterizerState,
-	ID3D11SamplerState* pSamplerState,
-	ID3D11Buffer* pConstantBuffer,
-	FieldSwapper* pFieldSwapper)
+void AnimatedTexture::Render(ID3D11SamplerState* pSamplerState)
 {
-	PingPong* curTexture = m_aLayerTextures[textureNum];
-
-	ID3D11Buffer* vertexBuffer[] = { m_pVertexBuffer };
-	UINT stride = sizeof(TextureVertex);
-	UINT offset = 0;
+	if (GetLayersNum() == 0)
+	{
+		return;
+	}
 
-	m_pContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &stride, &offset);
-	m_pContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-	m_pContext->IASetInputLayout(m_pInputLayout);
+	assert(m_aFieldSwappers.size() == GetLayersNum());
 
-	m_pContext->VSSetShader(m_pVertexShader, nullptr, 0);
-	m_pContext->PSSetShader(m_pPixelShader, nullptr, 0);
+	// Streamed fields have to be resident before the pass reads their slices
+	for (auto& swapper : m_aFieldSwappers)
+	{
+		StreamFields(swapper);
+	}
 
-	m_pContext->RSSetState(pRasterizerState);
-	m_pContext->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	// Bindings left by earlier model passes may still hold the target, it can't be read while written
+	m_pContext->ClearState();
 
-	ID3D11ShaderResourceView* textures[] = {
-		m_aLayerTextures[textureNum]->SourceSRV(),
-		m_aFieldSwappers[textureNum]->CurrentVectorFieldSRV(),
-		nullptr
-	};
-	m_pContext->PSSetShaderResources(0, 3, textures);
+	float fieldDecode[2];
+	FieldDecode(fieldDecode);
 
-	ID3D11SamplerState* samplers[] = { pSamplerState, m_pFieldSamplerState };
-	m_pContext->PSSetSamplers(0, 2, samplers);
+	LayerBatch::Constants constants = LayerBatch::Build(m_iScale, m_iWidth, m_iHeight, fieldDecode, m_aFieldSwappers);
+	ID3D11Buffer* constantBuffer = m_system.GetConstantBuffer();
+	m_pContext->UpdateSubresource(constantBuffer, 0, nullptr, &constants, 0, 0);
 
-	ID3D11Buffer* buffers[] = { pConstantBuffer };
-	m_pContext->PSSetConstantBuffers(0, 1, buffers);
+	// Fields are loaded through their tiles, only the layers are sampled
+	ID3D11SamplerState* samplers[] = { pSamplerState };
+	ID3D11ShaderResourceView* textures[] = { GetLayersSourceSRV(), GetFieldsSRV(), GetFieldTilesSRV() };
 
-	m_pContext->DrawIndexed(6, 0, 0);
-}
+	if (m_system.GetPath() == AnimationSystem::Path::COMPUTE)
+	{
+		m_pContext->CSSetShaderResources(0, 3, textures);
+		m_pContext->CSSetSamplers(0, 1, samplers);
+		m_pContext->CSSetConstantBuffers(0, 1, &constantBuffer);
 
-ID3D11VertexShader* AnimatedTexture::CreateVertexShader(LPCTSTR shaderSource, ID3DBlob** ppBlob)
-{
-	ID3D11VertexShader* pVertexShader = nullptr;
+		RenderCompute(constants);
+	}
+	else
+	{
+		m_pContext->PSSetShaderResources(0, 3, textures);
+		m_pContext->PSSetSamplers(0, 1, samplers);
+		m_pContext->PSSetConstantBuffers(0, 1, &constantBuffer);
 
-	FILE* pFile = nullptr;
+		RenderPixel(constants);
+	}
 
-	_tfopen_s(&pFile, shaderSource, _T("rb"));
-	if (pFile != nullptr)
-	{
-		fseek(pFile, 0, SEEK_END);
-		int size = ftell(pFile);
-		fseek(pFile, 0, SEEK_SET);
+	// The model pass samples what was just written, so a skipped pass keeps showing it
+	Swap();
+}
 
-		char* pSourceCode = (char*)malloc((size_t)size + 1);
-		if (pSourceCode == nullptr)
-		{
-			return nullptr;
-		}
+void AnimatedTexture::RenderCompute(LayerBatch::Constants const& constants)
+{
+	m_pContext->CSSetShader(m_system.GetComputeShader(), nullptr, 0);
 
-		fread(pSourceCode, size, 1, pFile);
-		pSourceCode[size] = 0;
+	ID3D11UnorderedAccessView* targets[] = { m_aLayerArrays[1 - m_iSourceLayers].m_pTextureUAV };
+	m_pContext->CSSetUnorderedAccessViews(0, 1, targets, nullptr);
 
-		fclose(pFile);
+	LayerBatch::Groups groups = LayerBatch::GroupsNum(constants);
+	m_pContext->Dispatch(groups.x, groups.y, groups.z);
 
-		ID3DBlob* pError = nullptr;
-		HRESULT result = D3DCompile(pSourceCode, size, "", nullptr, nullptr, "VS", "vs_5_0", D3DCOMPILE_SKIP_OPTIMIZATION, 0, ppBlob, &pError);
-		assert(SUCCEEDED(result));
-		if (!SUCCEEDED(result))
-		{
-			const char* pMsg = (const char*)pError->GetBufferPointer();
-			OutputDebugStringA(pMsg);
-		}
-		else
-		{
-			result = m_pDevice->CreateVertexShader((*ppBlob)->GetBufferPointer(), (*ppBlob)->GetBufferSize(), nullptr, &pVertexShader);
-		}
+	// The target is read as an SRV by the model pass, it can't stay bound for writing
+	ID3D11UnorderedAccessView* nullTargets[] = { nullptr };
+	m_pContext->CSSetUnorderedAccessViews(0, 1, nullTargets, nullptr);
 
-		SAFE_RELEASE(pError);
-	}
+	ID3D11ShaderResourceView* nullTextures[] = { nullptr, nullptr, nullptr };
+	m_pContext->CSSetShaderResources(0, 3, nullTextures);
 
-	assert(pVertexShader);
-	return pVertexShader;
+	m_pContext->CSSetShader(nullptr, nullptr, 0);
 }
 
-ID3D11PixelShader* AnimatedTexture::CreatePixelShader(LPCTSTR shaderSource)
+void AnimatedTexture::RenderPixel(LayerBatch::Constants const& constants)
 {
-	ID3D11PixelShader* pPixelShader = nullptr;
+	// Every texel is written, so neither the target nor a depth buffer needs a clear
+	m_pContext->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	m_pContext->VSSetShader(m_system.GetVertexShader(), nullptr, 0);
+	m_pContext->PSSetShader(m_system.GetPixelShader(), nullptr, 0);
 
-	FILE* pFile = nullptr;
+	D3D11_VIEWPORT viewport{ 0, 0, (float)constants.width, (float)constants.height, 0.0f, 1.0f };
+	m_pContext->RSSetViewports(1, &viewport);
 
-	_tfopen_s(&pFile, shaderSource, _T("rb"));
-	if (pFile != nullptr)
+	ArrayTexture const& target = m_aLayerArrays[1 - m_iSourceLayers];
+
+	for (UINT i = 0; i < constants.layersNum; ++i)
 	{
-		fseek(pFile, 0, SEEK_END);
-		int size = ftell(pFile);
-		fseek(pFile, 0, SEEK_SET);
+		m_pContext->OMSetRenderTargets(1, &target.m_aSliceRTVs[i], nullptr);
 
-		char* pSourceCode = (char*)malloc((size_t)size + 1);
-		if (pSourceCode == nullptr)
-		{
-			return nullptr;
-		}
+		// SV_VertexID / 3 is the layer
+		m_pContext->Draw(3, 3 * i);
+	}
+
+	m_pContext->OMSetRenderTargets(0, nullptr, nullptr);
 
-		fread(pSourceCode, size, 1, pFile);
-		pSourceCode[size] = 0;
+	ID3D11ShaderResourceView* nullTextures[] = { nullptr, nullptr, nullptr };
+	m_pContext->PSSetShaderResources(0, 3, nullTextures);
+}
 
-		fclose(pFile);
+void AnimatedTexture::IncrementStep(size_t incSize)
+{
+	for (auto& swapper : m_aFieldSwappers)
+	{
+		swapper->IncStep(incSize);
+	}
+}
 
-		ID3DBlob* pBlob = nullptr;
-		ID3DBlob* pError = nullptr;
-		HRESULT result = D3DCompile(pSourceCode, size, "", nullptr, nullptr, "PS", "ps_5_0", D3DCOMPILE_SKIP_OPTIMIZATION, 0, &pBlob, &pError);
-		assert(SUCCEEDED(result));
-		if (!SUCCEEDED(result))
-		{
-			const char* pMsg = (const char*)pError->GetBufferPointer();
-			OutputDebugStringA(pMsg);
-		}
-		else
-		{
-			result = m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, &pPixelShader);
-			assert(SUCCEEDED(result));
-		}
+AnimationClock& AnimatedTexture::GetClock()
+{
+	return m_clock;
+}
+
+void AnimatedTexture::Seek(size_t step)
+{
+	m_clock.Seek(step);
 
-		SAFE_RELEASE(pError);
-		SAFE_RELEASE(pBlob);
+	for (auto& swapper : m_aFieldSwappers)
+	{
+		swapper->Seek(step);
 	}
 
-	assert(pPixelShader);
-	return pPixelShader;
+	// The increment saved for this frame and the pending steps are already part of `step`
+	m_iInc = 0;
+	m_iPendingSteps = 0;
+}
+
+UINT AnimatedTexture::LayersBindFlags() const
+{
+	return D3D11_BIND_SHADER_RESOURCE | (m_system.GetPath() == AnimationSystem::Path::COMPUTE ? D3D11_BIND_UNORDERED_ACCESS : D3D11_BIND_RENDER_TARGET);
 }
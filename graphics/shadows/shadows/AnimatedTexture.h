@@ -7,40 +7,83 @@
 #include <string>
 
 #include "Texture.h"
+#include "AnimationClock.h"
 #include "FieldSwapper.h"
-#include "PingPong.h"
+#include "FieldEncoding.h"
+#include "FieldAtlas.h"
+#include "LayerBatch.h"
 #include "VectorField.h"
+#include "ImageImport.h"
 
+class AnimationSystem;
 
+
+// Layers and fields of one animated material. The layer pass pipeline comes from the
+// AnimationSystem that created the texture, which has to outlive it.
 class AnimatedTexture : public Texture
 {
 private:
-	ID3D11Device* m_pDevice;
-	ID3D11DeviceContext* m_pContext;
+	// Texture2DArray with views over all of its slices
+	struct ArrayTexture
+	{
+		ArrayTexture();
+		~ArrayTexture();
 
-	std::vector<PingPong*> m_aLayerTextures;
-	std::vector<FieldSwapper*> m_aFieldSwappers;
+		void Release();
 
-	// Render stuff
-	ID3D11Buffer* m_pVertexBuffer;
-	ID3D11Buffer* m_pIndexBuffer;
-	ID3D11InputLayout* m_pInputLayout;
+		ID3D11Texture2D* m_pTexture;
+		ID3D11ShaderResourceView* m_pTextureSRV;
+		ID3D11UnorderedAccessView* m_pTextureUAV;
+		std::vector<ID3D11RenderTargetView*> m_aSliceRTVs; // Only with D3D11_BIND_RENDER_TARGET
+		UINT m_iSlices;
+	};
 
-	ID3D11VertexShader* m_pVertexShader;
-	ID3D11PixelShader* m_pPixelShader;
+	// Atlas tiles a streamed slice owns, FieldAtlas::Reserve of each. A transform gets its tiles
+	// once one is streamed into the slice, FieldAtlas::zeroTile until then.
+	struct StreamedSlice
+	{
+		uint32_t field;
+		uint32_t transform;
+	};
 
-	ID3D11DepthStencilView* m_pDepthStencilView;
+private:
+	AnimationSystem const& m_system;
 
-	ID3D11Buffer* m_pConstantBuffer;
-	ID3D11Buffer* m_pInterpolateBuffer;
+	ID3D11Device* m_pDevice;
+	ID3D11DeviceContext* m_pContext;
 
-	ID3D11SamplerState* m_pFieldSamplerState;
-	ID3D11SamplerState* m_pTextureSamplerState;
+	// Source/target pair of the layer pass, slice i is layer i
+	ArrayTexture m_aLayerArrays[2];
+	size_t m_iSourceLayers;
+
+	// Fields of all layers, the swapper of a layer tracks which slices are its own.
+	// A slice of m_fieldTiles is the tile indirection of a field and its transform, the tiles
+	// are in the pages of m_fieldAtlas as m_atlas lays them out.
+	FieldEncoding::Format m_eFieldFormat;
+	FieldAtlas m_atlas;
+	ArrayTexture m_fieldAtlas;
+	ArrayTexture m_fieldTiles;
+	std::vector<StreamedSlice> m_aStreamedSlices; // By slice, only streamed slices are set
+	std::vector<FieldSwapper*> m_aFieldSwappers;
+	// Encoded field and indirection staging, reused by every upload
+	std::vector<unsigned char> m_aFieldTexels;
+	std::vector<uint32_t> m_aSliceTiles;
 
-	std::vector<ID3D11SamplerState*> samplers;
+	// cbuffer AnimatedStuff of the materials it animates
+	ID3D11Buffer* m_pInterpolateBuffer;
 
+	int m_iScale;
 	size_t m_iInc;
 
+	// Steps crossed since the last layer pass, a skipped pass leaves them for the next one
+	size_t m_iPendingSteps;
+	// Set by the draws sampling the layers, rolled over by EndFrame
+	bool m_bSampled;
+	bool m_bSampledLastFrame;
+
+	// Steps of this texture, independent of other animated textures
+	AnimationClock m_clock;
+
 public:
 	struct CBuffer
 	{
@@ -48,19 +91,24 @@ public:
 		DirectX::XMVECTORI32 stepsNum;
 	};
 
+	// Mirrors cbuffer AnimatedStuff of PBRShaders.fx
 	struct InterpolateBuffer
 	{
 		DirectX::XMVECTORF32 info;
+		DirectX::XMVECTORF32 fieldDecode; // Filled by UpdateInterpolateBuffer
+		uint32_t fieldSlices[LayerBatch::maxLayers]; // Filled by UpdateInterpolateBuffer
 	};
 
+	// Default step period of the clock in seconds
 	static float constexpr expectedFrameTime = 1.0f / 1.0f;
 
 public:
-	AnimatedTexture(ID3D11Device* device, ID3D11DeviceContext* context, UINT width, UINT height);
-	AnimatedTexture(ID3D11Device* device, ID3D11DeviceContext* context, std::string const& filename);
+	// AnimationSystem::CreateTexture is the way to get one
+	AnimatedTexture(AnimationSystem const& system, ID3D11Device* device, ID3D11DeviceContext* context, UINT width, UINT height,
+		FieldEncoding::Format fieldFormat = FieldEncoding::Format::SNORM16);
 	~AnimatedTexture();
 
-	HRESULT CreateAnimationTextureResources(std::string const& vertexShader, std::string const& pixelShader);
+	HRESULT CreateResources();
 
 	void UpdateConstantBuffer(CBuffer const* buffer);
 	void UpdateInterpolateBuffer(InterpolateBuffer const* buffer);
@@ -74,41 +122,88 @@ public:
 
 	size_t GetLayersNum() const;
 
-	std::vector<ID3D11ShaderResourceView*> GetLayersSourceTexturesSRV() const;
+	// Texture2DArray views, slice i is layer i. The source holds the layers as of the
+	// last pass and is what materials sample, the target is scratch of the next pass.
+	ID3D11ShaderResourceView* GetLayersSourceSRV() const;
+	ID3D11ShaderResourceView* GetLayersTargetSRV() const;
 	std::vector<ID3D11ShaderResourceView*> GetLayersTargetTexturesSRV() const override;
-	std::vector<ID3D11RenderTargetView*> GetLayersTexturesRTV() const;
-	std::vector<ID3D11Texture2D*> GetLayersTextures() const;
 
-	HRESULT CreateVectorFieldTexture(VectorField const* vectorField, FieldSwapper* swapper) const;
+	// Texture2DArray of the atlas pages every field and transform tile is in, read through GetFieldTilesSRV()
+	ID3D11ShaderResourceView* GetFieldsSRV() const;
+	// Texture2DArray<uint2> of the tile indirections, atlas tile of the field (x) and transform (y) of every tile.
+	// FieldSwapper::CurrentFieldSlice() picks the slice of a layer.
+	ID3D11ShaderResourceView* GetFieldTilesSRV() const;
+
+	FieldEncoding::Format GetFieldFormat() const;
+
+	// The field must be the texture size and in range of the field format, E_INVALIDARG otherwise.
+	// Only its tiles that aren't constant are uploaded, a compact field or mapped texels are tiled as they are.
+	HRESULT CreateVectorFieldTexture(VectorField const* vectorField, FieldSwapper* swapper);
+	// The swapper streams `files` in order through `window` slices, they are loaded on a background thread.
+	// Same requirements as CreateVectorFieldTexture, a file that doesn't meet them is streamed as a zero field.
+	// Every slice keeps atlas tiles for a whole field, streamed fields aren't tiled.
+	HRESULT CreateStreamedFields(std::vector<std::string> const& files, size_t window, FieldSwapper* swapper);
 
 	std::vector<FieldSwapper*> GetFields() const override;
+	FieldSwapper* GetField(size_t ind) const;
 
 	void AddBackground(ID3D11Texture2D* texture, ID3D11ShaderResourceView* textureSRV);
-	void AddLayer(ID3D11Texture2D* texture, ID3D11ShaderResourceView* textureSRV, ID3D11RenderTargetView* textureRTV);
 
 	void SetUpFields(std::vector<FieldSwapper*> const& fields);
 
+	// Decode with ImageImport first to keep the file work off the rendering thread
+	HRESULT AddBackground(ImageImport::Image const& image);
+
+	// The image becomes a new slice of the layer arrays and must match the texture size
+	HRESULT AddLayer(ImageImport::Image const& image);
+
 	HRESULT AddBackgroundByName(std::string const& filename);
 	HRESULT AddLayerByName(std::string const& filename);
 
-	void Swap();
-
+	// The fields move by the steps of a pass once nothing samples them with the pass any more
 	void SaveIncrement(size_t inc);
 	void IncrementSaved();
 
+	// Steps the clock crossed wait until a layer pass runs
+	void AddPendingSteps(size_t steps);
+	// Takes the pending steps of the next pass, LayerBatch::PassSteps of them
+	size_t TakePassSteps();
+
+	// Called by every draw that samples the layers and passed the visibility tests
+	void MarkSampled();
+	bool WasSampledLastFrame() const;
+	// Nothing to advect or nobody looking: the pass would only cost GPU time
+	bool IsLayerPassNeeded() const;
+
+	// Steps the fields by the increment of this frame's pass, sampling is tracked anew
+	void EndFrame();
+
 	void IncrementStep(size_t incSize);
 
-	void Render(ID3D11RasterizerState* pRasterizerState,
-		ID3D11SamplerState* pSamplerState,
-		ID3D11Buffer* pConstantBuffer);
+	AnimationClock& GetClock();
+	// Moves the clock and every field sequence to an absolute step
+	void Seek(size_t step);
+
+	// Advects every layer from the source to the target array, which becomes the source
+	void Render(ID3D11SamplerState* pSamplerState);
 
 private:
-	void RenderTexture(size_t textureNum,
-		ID3D11RasterizerState* pRasterizerState,
-		ID3D11SamplerState* pSamplerState,
-		ID3D11Buffer* pConstantBuffer,
-		FieldSwapper* pFieldSwapper);
-
-	ID3D11VertexShader* CreateVertexShader(LPCTSTR shaderSource, ID3DBlob** ppBlob);
-	ID3D11PixelShader* CreatePixelShader(LPCTSTR shaderSource);
+	void Swap();
+
+	UINT LayersBindFlags() const;
+
+	void FieldDecode(float* scale) const;
+
+	// Grows the atlas to the pages m_atlas handed out, new pages are zeros, and writes the copies
+	HRESULT UploadAtlasTiles(std::vector<FieldAtlas::Copy> const& copies);
+	// An empty transform reads the zero tile everywhere
+	void UploadSliceTiles(UINT slice, std::vector<uint32_t> const& fieldTiles, std::vector<uint32_t> const& transformTiles);
+
+	void StreamFields(FieldSwapper* swapper);
+
+	// Reallocates the array with `slices` slices, the ones it had are copied over on the GPU
+	HRESULT ResizeArray(ArrayTexture& array, DXGI_FORMAT format, UINT bindFlags, UINT width, UINT height, UINT slices) const;
+
+	void RenderCompute(LayerBatch::Constants const& constants);
+	void RenderPixel(LayerBatch::Constants const& constants);
 };
@@ -0,0 +1,157 @@
+#include "AnimationClock.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+
+AnimationClock::ticks_t AnimationClock::Now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AnimationClock::AnimationClock(double stepsPerSecond)
+	: m_iStepTicks{ 1 }, m_fScale{ 1.0 }, m_bPaused{ false },
+	m_iStep{ 0 }, m_iAccumulated{ 0 }, m_fTickRemainder{ 0.0 }, m_iLastUpdate{ -1 },
+	m_bRecording{ false }, m_bReplaying{ false }, m_iReplayFrame{ 0 }
+{
+	SetRate(stepsPerSecond);
+}
+
+void AnimationClock::SetRate(double stepsPerSecond)
+{
+	assert(stepsPerSecond > 0.0);
+
+	float alpha = Alpha();
+
+	m_iStepTicks = std::max<ticks_t>(1, std::llround(ticksPerSecond / stepsPerSecond));
+	m_iAccumulated = std::min<ticks_t>(m_iStepTicks - 1, (ticks_t)(alpha * m_iStepTicks));
+}
+
+double AnimationClock::GetRate() const
+{
+	return (double)ticksPerSecond / m_iStepTicks;
+}
+
+void AnimationClock::SetScale(double scale)
+{
+	assert(scale >= 0.0);
+
+	m_fScale = scale;
+}
+
+double AnimationClock::GetScale() const
+{
+	return m_fScale;
+}
+
+void AnimationClock::Pause()
+{
+	m_bPaused = true;
+}
+
+void AnimationClock::Resume()
+{
+	m_bPaused = false;
+}
+
+bool AnimationClock::IsPaused() const
+{
+	return m_bPaused;
+}
+
+void AnimationClock::Seek(size_t step)
+{
+	m_iStep = step;
+	m_iAccumulated = 0;
+	m_fTickRemainder = 0.0;
+}
+
+size_t AnimationClock::Update(ticks_t now)
+{
+	ticks_t elapsed = 0;
+
+	if (m_bReplaying)
+	{
+		elapsed = m_iReplayFrame < m_aReplay.size() ? m_aReplay[m_iReplayFrame++] : 0;
+	}
+	else if (m_iLastUpdate >= 0)
+	{
+		elapsed = now - m_iLastUpdate;
+	}
+
+	// Paused time is consumed here too, resuming doesn't catch up on it
+	m_iLastUpdate = now;
+
+	if (m_bRecording)
+	{
+		m_aRecording.push_back(elapsed);
+	}
+
+	return Advance(elapsed);
+}
+
+size_t AnimationClock::Advance(ticks_t elapsed)
+{
+	if (m_bPaused || elapsed <= 0)
+	{
+		return 0;
+	}
+
+	double scaled = elapsed * m_fScale + m_fTickRemainder;
+	double whole = std::floor(scaled);
+
+	m_fTickRemainder = scaled - whole;
+	m_iAccumulated += (ticks_t)whole;
+
+	size_t steps = (size_t)(m_iAccumulated / m_iStepTicks);
+	m_iAccumulated %= m_iStepTicks;
+	m_iStep += steps;
+
+	return steps;
+}
+
+size_t AnimationClock::CurrentStep() const
+{
+	return m_iStep;
+}
+
+float AnimationClock::Alpha() const
+{
+	return (float)m_iAccumulated / m_iStepTicks;
+}
+
+void AnimationClock::StartRecording()
+{
+	m_aRecording.clear();
+	m_bRecording = true;
+}
+
+void AnimationClock::StopRecording()
+{
+	m_bRecording = false;
+}
+
+std::vector<AnimationClock::ticks_t> const& AnimationClock::Recording() const
+{
+	return m_aRecording;
+}
+
+void AnimationClock::Replay(std::vector<ticks_t> const& frameTimes)
+{
+	m_aReplay = frameTimes;
+	m_iReplayFrame = 0;
+	m_bReplaying = true;
+}
+
+void AnimationClock::StopReplay()
+{
+	m_bReplaying = false;
+	// The wall clock restarts from the next Update
+	m_iLastUpdate = -1;
+}
+
+bool AnimationClock::IsReplaying() const
+{
+	return m_bReplaying;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-step clock of an animation. Wall time is accumulated in integer microsecond
+// ticks and converted to whole steps, the leftover is the fraction of the next step,
+// so nothing drifts however long it runs. Doesn't touch D3D.
+class AnimationClock
+{
+public:
+	using ticks_t = int64_t;
+
+	static ticks_t constexpr ticksPerSecond = 1000000;
+
+	// steady_clock time in ticks
+	static ticks_t Now();
+
+private:
+	ticks_t m_iStepTicks;
+	double m_fScale;
+	bool m_bPaused;
+
+	size_t m_iStep;
+	ticks_t m_iAccumulated; // Scaled ticks towards the next step, below m_iStepTicks
+	double m_fTickRemainder; // Fraction of a tick left over by the scale
+
+	ticks_t m_iLastUpdate; // Negative until the first Update
+
+	bool m_bRecording;
+	std::vector<ticks_t> m_aRecording;
+
+	bool m_bReplaying;
+	std::vector<ticks_t> m_aReplay;
+	size_t m_iReplayFrame;
+
+public:
+	explicit AnimationClock(double stepsPerSecond = 1.0);
+
+	// Keeps the fraction of the current step
+	void SetRate(double stepsPerSecond);
+	double GetRate() const;
+
+	// Multiplies the elapsed time, 0 freezes the animation like Pause does
+	void SetScale(double scale);
+	double GetScale() const;
+
+	void Pause();
+	void Resume();
+	bool IsPaused() const;
+
+	// Starts the step over
+	void Seek(size_t step);
+
+	// Advances by the time since the previous call and returns the steps crossed.
+	// The first call only starts the clock.
+	size_t Update(ticks_t now);
+	// Advances by `elapsed` wall ticks
+	size_t Advance(ticks_t elapsed);
+
+	size_t CurrentStep() const;
+	// Accumulated fraction of the next step, in [0, 1)
+	float Alpha() const;
+
+	// The elapsed time of every Update is recorded, pause, scale and seeks are not
+	void StartRecording();
+	void StopRecording();
+	std::vector<ticks_t> const& Recording() const;
+
+	// Update ignores the wall clock and advances by `frameTimes` in order, then by nothing
+	void Replay(std::vector<ticks_t> const& frameTimes);
+	void StopReplay();
+	bool IsReplaying() const;
+};
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cassert>
+#include <d3dcompiler.h>
+
+#include "AnimationSystem.h"
+#include "Utils.h"
+
+#define SAFE_RELEASE(p) \
+if (p != NULL) { \
+	p->Release(); \
+	p = NULL;\
+}
+
+namespace
+{
+	std::wstring WidePath(std::string const& path)
+	{
+		return std::wstring(path.begin(), path.end());
+	}
+}
+
+AnimationSystem::AnimationSystem(ID3D11Device* device, ID3D11DeviceContext* context, Path path)
+	: m_pDevice{ device }, m_pContext{ context }, m_ePath{ path },
+	m_pComputeShader{ nullptr }, m_pVertexShader{ nullptr }, m_pPixelShader{ nullptr },
+	m_pConstantBuffer{ nullptr }, m_pFieldSamplerState{ nullptr }, m_pTextureSamplerState{ nullptr }
+{
+
+}
+
+AnimationSystem::~AnimationSystem()
+{
+	// Textures render with the shared state, they go first
+	m_aTextures.clear();
+
+	SAFE_RELEASE(m_pComputeShader);
+	SAFE_RELEASE(m_pVertexShader);
+	SAFE_RELEASE(m_pPixelShader);
+
+	SAFE_RELEASE(m_pConstantBuffer);
+
+	SAFE_RELEASE(m_pFieldSamplerState);
+	SAFE_RELEASE(m_pTextureSamplerState);
+}
+
+HRESULT AnimationSystem::CreateResources(ShaderFiles const& shaders)
+{
+	HRESULT result = CreateShaders(shaders);
+	assert(SUCCEEDED(result));
+
+	if (FAILED(result))
+	{
+		return result;
+	}
+
+	D3D11_BUFFER_DESC desc = { 0 };
+	desc.ByteWidth = sizeof(LayerBatch::Constants);
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+
+	result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pConstantBuffer);
+	assert(SUCCEEDED(result));
+
+	if (SUCCEEDED(result)) {
+		D3D11_SAMPLER_DESC sd = {};
+		ZeroMemory(&sd, sizeof(sd));
+
+		sd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+		sd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+		sd.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+		sd.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		sd.MinLOD = 0;
+		sd.MaxAnisotropy = 16;
+		sd.MaxLOD = D3D11_FLOAT32_MAX;
+
+		result = m_pDevice->CreateSamplerState(&sd, &m_pFieldSamplerState);
+		assert(SUCCEEDED(result));
+
+		sd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+
+		result = m_pDevice->CreateSamplerState(&sd, &m_pTextureSamplerState);
+		assert(SUCCEEDED(result));
+
+		m_aSamplers = { m_pFieldSamplerState, m_pTextureSamplerState };
+	}
+
+	return result;
+}
+
+std::shared_ptr<AnimatedTexture> AnimationSystem::CreateTexture(std::string const& materialName, UINT width, UINT height,
+	FieldEncoding::Format fieldFormat)
+{
+	auto texture = std::make_shared<AnimatedTexture>(*this, m_pDevice, m_pContext, width, height, fieldFormat);
+
+	HRESULT result = texture->CreateResources();
+	assert(SUCCEEDED(result));
+
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+
+	m_aTextures.push_back(texture);
+	m_aMaterialNames.push_back(materialName);
+
+	return texture;
+}
+
+std::shared_ptr<AnimatedTexture> AnimationSystem::FindTexture(std::string const& materialName) const
+{
+	for (size_t i = 0; i < m_aTextures.size(); ++i)
+	{
+		if (m_aMaterialNames[i] == materialName)
+		{
+			return m_aTextures[i];
+		}
+	}
+
+	return nullptr;
+}
+
+size_t AnimationSystem::GetTexturesNum() const
+{
+	return m_aTextures.size();
+}
+
+std::shared_ptr<AnimatedTexture> const& AnimationSystem::GetTexture(size_t ind) const
+{
+	assert(ind < m_aTextures.size());
+
+	return m_aTextures[ind];
+}
+
+std::string const& AnimationSystem::GetMaterialName(size_t ind) const
+{
+	assert(ind < m_aMaterialNames.size());
+
+	return m_aMaterialNames[ind];
+}
+
+void AnimationSystem::Update(AnimationClock::ticks_t now, ID3D11SamplerState* pSamplerState)
+{
+	for (auto& texture : m_aTextures)
+	{
+		AnimationClock& clock = texture->GetClock();
+		texture->AddPendingSteps(clock.Update(now));
+
+		// Off screen the steps only pile up, the first visible frame catches up on them
+		if (!texture->WasSampledLastFrame())
+		{
+			continue;
+		}
+
+		// Between step boundaries only the interpolation moves. Each pass stays within one field
+		// of every layer, the fields move on before the next one; the last pass moves them at EndFrame.
+		for (size_t pass = 0; pass < maxPassesPerFrame && texture->IsLayerPassNeeded(); ++pass)
+		{
+			texture->IncrementSaved();
+
+			int scaleFactor = (int)texture->TakePassSteps();
+
+			AnimatedTexture::CBuffer cb;
+			cb.secs = { scaleFactor, 0, 0, 0 };
+			texture->UpdateConstantBuffer(&cb);
+
+			texture->Render(pSamplerState);
+
+			texture->SaveIncrement(scaleFactor);
+		}
+
+		// Field slices of the last pass, the materials interpolate towards its next step
+		AnimatedTexture::InterpolateBuffer ib;
+		ib.info = { clock.Alpha(), (float)texture->GetWidth(), (float)texture->GetHeight(), 0.0 };
+		texture->UpdateInterpolateBuffer(&ib);
+	}
+}
+
+void AnimationSystem::EndFrame()
+{
+	for (auto& texture : m_aTextures)
+	{
+		texture->EndFrame();
+	}
+}
+
+AnimationSystem::Path AnimationSystem::GetPath() const
+{
+	return m_ePath;
+}
+
+ID3D11ComputeShader* AnimationSystem::GetComputeShader() const
+{
+	return m_pComputeShader;
+}
+
+ID3D11VertexShader* AnimationSystem::GetVertexShader() const
+{
+	return m_pVertexShader;
+}
+
+ID3D11PixelShader* AnimationSystem::GetPixelShader() const
+{
+	return m_pPixelShader;
+}
+
+ID3D11Buffer* AnimationSystem::GetConstantBuffer() const
+{
+	return m_pConstantBuffer;
+}
+
+ID3D11SamplerState* AnimationSystem::GetFieldSamplerState() const
+{
+	return m_pFieldSamplerState;
+}
+
+ID3D11SamplerState* const* AnimationSystem::GetSamplerAdress() const
+{
+	return m_aSamplers.data();
+}
+
+HRESULT AnimationSystem::CreateShaders(ShaderFiles const& shaders)
+{
+	std::vector<BYTE> bytes;
+	HRESULT result = S_OK;
+
+	if (m_ePath == Path::COMPUTE)
+	{
+		result = ::CreateComputeShader(m_pDevice, WidePath(shaders.computeShader).c_str(), bytes, &m_pComputeShader);
+	}
+	else
+	{
+		result = ::CreateVertexShader(m_pDevice, WidePath(shaders.vertexShader).c_str(), bytes, &m_pVertexShader);
+
+		if (SUCCEEDED(result))
+		{
+			result = ::CreatePixelShader(m_pDevice, WidePath(shaders.pixelShader).c_str(), bytes, &m_pPixelShader);
+		}
+	}
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Lets shader edits run without rebuilding the project
+	if (FAILED(result))
+	{
+		SAFE_RELEASE(m_pComputeShader);
+		SAFE_RELEASE(m_pVertexShader);
+
+		std::wstring source = WidePath(shaders.source);
+		ID3DBlob* pBlob = nullptr;
+
+		if (m_ePath == Path::COMPUTE)
+		{
+			result = CompileShaderFromFile(source.c_str(), "CS", "cs_5_0", &pBlob);
+			if (SUCCEEDED(result))
+			{
+				result = m_pDevice->CreateComputeShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, &m_pComputeShader);
+			}
+		}
+		else
+		{
+			result = CompileShaderFromFile(source.c_str(), "VS", "vs_5_0", &pBlob);
+			if (SUCCEEDED(result))
+			{
+				result = m_pDevice->CreateVertexShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, &m_pVertexShader);
+			}
+
+			SAFE_RELEASE(pBlob);
+
+			if (SUCCEEDED(result))
+			{
+				result = CompileShaderFromFile(source.c_str(), "PS", "ps_5_0", &pBlob);
+			}
+			if (SUCCEEDED(result))
+			{
+				result = m_pDevice->CreatePixelShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, &m_pPixelShader);
+			}
+		}
+
+		SAFE_RELEASE(pBlob);
+	}
+#endif
+
+	return result;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AnimatedTexture.h"
+#include "AnimationClock.h"
+
+
+// Pipeline state of the layer pass, created once and shared by every AnimatedTexture:
+// the shaders of the selected path, the layer constants and the samplers.
+// Textures are created through the system, each one animates the materials of one name
+// (Model::BindAnimatedTextures) and only owns its layers, fields, clock and AnimatedStuff buffer.
+class AnimationSystem
+{
+public:
+	// How the layer pass runs, both produce the same texels (TextureShader.hlsl Advect)
+	enum class Path
+	{
+		COMPUTE = 0, // One dispatch of 8x8 tiles per layer slice
+		PIXEL = 1 // One fullscreen triangle per layer slice
+	};
+
+	// Build-time compiled .cso files, debug builds compile `source` when one fails to load.
+	// Only the shaders of the selected path are loaded.
+	struct ShaderFiles
+	{
+		std::string computeShader;
+		std::string vertexShader;
+		std::string pixelShader;
+		std::string source;
+	};
+
+private:
+	ID3D11Device* m_pDevice;
+	ID3D11DeviceContext* m_pContext;
+
+	Path m_ePath;
+
+	ID3D11ComputeShader* m_pComputeShader;
+
+	ID3D11VertexShader* m_pVertexShader;
+	ID3D11PixelShader* m_pPixelShader;
+
+	ID3D11Buffer* m_pConstantBuffer;
+
+	ID3D11SamplerState* m_pFieldSamplerState;
+	ID3D11SamplerState* m_pTextureSamplerState;
+
+	// Field and texture samplers in the order PBRShaders.fx binds them
+	std::vector<ID3D11SamplerState*> m_aSamplers;
+
+	std::vector<std::shared_ptr<AnimatedTexture>> m_aTextures;
+	std::vector<std::string> m_aMaterialNames;
+
+public:
+	AnimationSystem(ID3D11Device* device, ID3D11DeviceContext* context, Path path = Path::COMPUTE);
+	~AnimationSystem();
+
+	HRESULT CreateResources(ShaderFiles const& shaders);
+
+	// nullptr if the texture resources can't be created
+	std::shared_ptr<AnimatedTexture> CreateTexture(std::string const& materialName, UINT width, UINT height,
+		FieldEncoding::Format fieldFormat = FieldEncoding::Format::SNORM16);
+
+	// nullptr when no texture animates the material
+	std::shared_ptr<AnimatedTexture> FindTexture(std::string const& materialName) const;
+
+	size_t GetTexturesNum() const;
+	std::shared_ptr<AnimatedTexture> const& GetTexture(size_t ind) const;
+	std::string const& GetMaterialName(size_t ind) const;
+
+	// Layer passes of one texture per Update, a longer catch-up continues next frame
+	static size_t constexpr maxPassesPerFrame = 16;
+
+	// Advances the clock of every texture and runs the layer passes that are needed: a texture
+	// waits for a step boundary and for a draw that sampled it last frame, then catches up on
+	// the steps it skipped in passes of LayerBatch::PassSteps, stepping the fields between them
+	void Update(AnimationClock::ticks_t now, ID3D11SamplerState* pSamplerState);
+	// Steps the fields once the frame has sampled the layers
+	void EndFrame();
+
+	Path GetPath() const;
+
+	ID3D11ComputeShader* GetComputeShader() const;
+	ID3D11VertexShader* GetVertexShader() const;
+	ID3D11PixelShader* GetPixelShader() const;
+
+	// Rewritten by every layer pass
+	ID3D11Buffer* GetConstantBuffer() const;
+
+	ID3D11SamplerState* GetFieldSamplerState() const;
+	ID3D11SamplerState* const* GetSamplerAdress() const;
+
+private:
+	HRESULT CreateShaders(ShaderFiles const& shaders);
+};
@@ -1,11 +1,21 @@
 #include "pch.h"
 
-#include <cmath>
-
 #include "AverageLuminanceProcess.h"
+#include "LuminanceAdaptation.h"
+#include "ShaderStructures.h"
 #include "Utils.h"
 
 AverageLuminanceProcess::AverageLuminanceProcess() :
+    m_readbacks(),
+    m_readbackWrite(0),
+    m_frame(0),
+    m_lastReadFrame(0),
+    m_luminance(0.0f),
+    m_hasLuminance(false),
+    m_adaptedTextures{ RenderTexture(DXGI_FORMAT_R32_FLOAT), RenderTexture(DXGI_FORMAT_R32_FLOAT) },
+    m_adaptedIndex(0),
+    m_resetAdaptedTexture(true),
+    m_adaptationMode(ADAPTATION_MODE::CPU_READBACK),
     m_adaptedLuminance(0.0)
 {
     QueryPerformanceFrequency(&m_qpcFrequency);
@@ -33,6 +43,11 @@ HRESULT AverageLuminanceProcess::CreateDeviceDependentResources(ID3D11Device* de
     if (FAILED(hr))
         return hr;
 
+    // Create the adaptation pixel shader
+    hr = CreatePixelShader(device, L"AdaptLuminancePixelShader.cso", bytes, &m_pAdaptPixelShader);
+    if (FAILED(hr))
+        return hr;
+
     // Create the sampler state
     D3D11_SAMPLER_DESC sd;
     ZeroMemory(&sd, sizeof(sd));
@@ -58,7 +73,30 @@ HRESULT AverageLuminanceProcess::CreateDeviceDependentResources(ID3D11Device* de
         D3D11_USAGE_STAGING,
         D3D11_CPU_ACCESS_READ
     );
-    hr = device->CreateTexture2D(&ltd, nullptr, &m_pLuminanceTexture);
+    CD3D11_QUERY_DESC qd(D3D11_QUERY_EVENT);
+    for (Readback& readback : m_readbacks)
+    {
+        hr = device->CreateTexture2D(&ltd, nullptr, readback.pTexture.ReleaseAndGetAddressOf());
+        if (FAILED(hr))
+            return hr;
+
+        hr = device->CreateQuery(&qd, readback.pQuery.ReleaseAndGetAddressOf());
+        if (FAILED(hr))
+            return hr;
+
+        readback.pending = false;
+    }
+
+    for (RenderTexture& texture : m_adaptedTextures)
+    {
+        hr = texture.CreateResources(device, 1, 1);
+        if (FAILED(hr))
+            return hr;
+    }
+    m_resetAdaptedTexture = true;
+
+    CD3D11_BUFFER_DESC abd(sizeof(AdaptationConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    hr = device->CreateBuffer(&abd, nullptr, &m_pAdaptationBuffer);
 	if (FAILED(hr))
 		return hr;
 
@@ -165,17 +203,136 @@ float AverageLuminanceProcess::Process(ID3D11DeviceContext* context, ID3D11Shade
     m_qpcLastTime = currentTime;
     double delta = static_cast<double>(timeDelta) / m_qpcFrequency.QuadPart;
 
-    D3D11_MAPPED_SUBRESOURCE luminanceAccessor;
-    context->CopyResource(m_pLuminanceTexture.Get(), m_renderTextures[m_renderTextures.size() - 1].GetRenderTarget());
-    context->Map(m_pLuminanceTexture.Get(), 0, D3D11_MAP_READ, 0, &luminanceAccessor);
-    float luminance = *(float*)luminanceAccessor.pData;
-    context->Unmap(m_pLuminanceTexture.Get(), 0);
+    RenderTexture& average = m_renderTextures[m_renderTextures.size() - 1];
+
+    if (m_adaptationMode == ADAPTATION_MODE::GPU)
+    {
+        AdaptOnGPU(context, average.GetShaderResourceView(), delta);
+        return m_adaptedLuminance;
+    }
+
+    // Until the first copy lands the adaptation holds still
+    if (ReadLuminance(context, average.GetRenderTarget(), m_luminance))
+        m_hasLuminance = true;
+
+    if (m_hasLuminance)
+        m_adaptedLuminance = LuminanceAdaptation::Adapt(m_adaptedLuminance, m_luminance, delta);
 
-    float sigma = 0.04f / (0.04f + luminance);
-    float tau = sigma * 0.4f + (1 - sigma) * 0.1f;
-    m_adaptedLuminance += (luminance - m_adaptedLuminance) * static_cast<float>(1 - std::exp(-delta * tau));
     return m_adaptedLuminance;
 }
 
+void AverageLuminanceProcess::SetAdaptationMode(ADAPTATION_MODE mode)
+{
+    // GPU adaptation continues from the CPU value
+    if (mode == ADAPTATION_MODE::GPU && m_adaptationMode != mode)
+        m_resetAdaptedTexture = true;
+
+    m_adaptationMode = mode;
+}
+
+bool AverageLuminanceProcess::ReadLuminance(ID3D11DeviceContext* context, ID3D11Texture2D* averageTexture, float& luminance)
+{
+    ++m_frame;
+
+    // Queues into the next free slot, the sample is dropped only when every copy is still in flight
+    for (UINT i = 0; i < readbackRingSize; ++i)
+    {
+        UINT ind = (m_readbackWrite + i) % readbackRingSize;
+        Readback& slot = m_readbacks[ind];
+        if (slot.pending)
+            continue;
+
+        context->CopyResource(slot.pTexture.Get(), averageTexture);
+        context->End(slot.pQuery.Get());
+
+        slot.frame = m_frame;
+        slot.pending = true;
+        m_readbackWrite = (ind + 1) % readbackRingSize;
+        break;
+    }
+
+    bool updated = false;
+    for (Readback& readback : m_readbacks)
+    {
+        if (!readback.pending)
+            continue;
+
+        // Present flushes the queue every frame, no need to flush here
+        if (context->GetData(readback.pQuery.Get(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            continue;
+
+        D3D11_MAPPED_SUBRESOURCE luminanceAccessor;
+        if (FAILED(context->Map(readback.pTexture.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &luminanceAccessor)))
+            continue;
+
+        // Slots may finish together, only the most recent frame is consumed
+        if (readback.frame > m_lastReadFrame)
+        {
+            luminance = *(float*)luminanceAccessor.pData;
+            m_lastReadFrame = readback.frame;
+            updated = true;
+        }
+        context->Unmap(readback.pTexture.Get(), 0);
+
+        readback.pending = false;
+    }
+
+    return updated;
+}
+
+void AverageLuminanceProcess::AdaptOnGPU(ID3D11DeviceContext* context, ID3D11ShaderResourceView* averageTexture, double delta)
+{
+    RenderTexture& previous = m_adaptedTextures[m_adaptedIndex];
+    RenderTexture& target = m_adaptedTextures[1 - m_adaptedIndex];
+
+    if (m_resetAdaptedTexture)
+    {
+        float adaptedColour[4] = { m_adaptedLuminance, m_adaptedLuminance, m_adaptedLuminance, m_adaptedLuminance };
+        context->ClearRenderTargetView(previous.GetRenderTargetView(), adaptedColour);
+        m_resetAdaptedTexture = false;
+    }
+
+    AdaptationConstantBuffer adaptationBufferData = { static_cast<float>(delta) };
+    context->UpdateSubresource(m_pAdaptationBuffer.Get(), 0, nullptr, &adaptationBufferData, 0, 0);
+
+    // The 1x1 scissor and the rasterizer state are put back after the draw, the passes after this one
+    // see the same state as in CPU_READBACK mode
+    Microsoft::WRL::ComPtr<ID3D11RasterizerState> pPreviousRasterizerState;
+    context->RSGetState(&pPreviousRasterizerState);
+
+    D3D11_RECT previousRects[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+    UINT previousRectsNum = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+    context->RSGetScissorRects(&previousRectsNum, previousRects);
+
+    ID3D11RenderTargetView* renderTarget = target.GetRenderTargetView();
+    D3D11_VIEWPORT viewport = target.GetViewPort();
+    context->OMSetRenderTargets(1, &renderTarget, nullptr);
+    context->RSSetViewports(1, &viewport);
+
+    D3D11_RECT rect = { 0, 0, 1, 1 };
+    context->RSSetScissorRects(1, &rect);
+    context->RSSetState(m_pRasterizerState.Get());
+
+    context->IASetInputLayout(nullptr);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+    context->VSSetShader(m_pVertexShader.Get(), nullptr, 0);
+
+    ID3D11ShaderResourceView* textures[] = { averageTexture, previous.GetShaderResourceView() };
+    context->PSSetShader(m_pAdaptPixelShader.Get(), nullptr, 0);
+    context->PSSetConstantBuffers(1, 1, m_pAdaptationBuffer.GetAddressOf());
+    context->PSSetShaderResources(0, 2, textures);
+
+    context->Draw(4, 0);
+
+    ID3D11ShaderResourceView* nullsrv[] = { nullptr, nullptr };
+    context->PSSetShaderResources(0, 2, nullsrv);
+
+    context->RSSetScissorRects(previousRectsNum, previousRectsNum != 0 ? previousRects : nullptr);
+    context->RSSetState(pPreviousRasterizerState.Get());
+
+    m_adaptedIndex = 1 - m_adaptedIndex;
+}
+
 AverageLuminanceProcess::~AverageLuminanceProcess()
 {}
@@ -7,25 +7,70 @@
 class AverageLuminanceProcess
 {
 public:
+    enum class ADAPTATION_MODE
+    {
+        // The average is read back to CPU a few frames late and adapted there
+        CPU_READBACK = 0,
+        // The adapted luminance never leaves GPU, see GetAdaptedLuminanceSRV
+        GPU
+    };
+
+    // Staging textures in flight, the readback lags the GPU by up to this many frames
+    static const UINT readbackRingSize = 3;
+
     AverageLuminanceProcess();
     ~AverageLuminanceProcess();
 
     HRESULT CreateDeviceDependentResources(ID3D11Device* device);
     HRESULT CreateWindowSizeDependentResources(ID3D11Device* device, UINT width, UINT height);
 
+    void SetAdaptationMode(ADAPTATION_MODE mode);
+    ADAPTATION_MODE GetAdaptationMode() const { return m_adaptationMode; };
+
+    // Returns the adapted luminance in CPU_READBACK mode, the last CPU value in GPU mode
     float Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture);
 
+    // 1x1 texture with the adapted luminance written by the last Process call in GPU mode
+    ID3D11ShaderResourceView* GetAdaptedLuminanceSRV() const { return m_adaptedTextures[m_adaptedIndex].GetShaderResourceView(); };
+
 private:
+    struct Readback
+    {
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> pTexture;
+        Microsoft::WRL::ComPtr<ID3D11Query>     pQuery;
+        UINT64 frame;
+        bool pending;
+    };
+
     void CopyTexture(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, RenderTexture& dst, ID3D11PixelShader* pixelShader);
 
+    // Never waits: queues the frame's average and picks up the newest finished copy
+    bool ReadLuminance(ID3D11DeviceContext* context, ID3D11Texture2D* averageTexture, float& luminance);
+    void AdaptOnGPU(ID3D11DeviceContext* context, ID3D11ShaderResourceView* averageTexture, double delta);
+
     std::vector<RenderTexture> m_renderTextures;
 
     Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pCopyPixelShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pLuminancePixelShader;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pAdaptPixelShader;
     Microsoft::WRL::ComPtr<ID3D11SamplerState> m_pSamplerState;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D>    m_pLuminanceTexture;
     Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_pRasterizerState;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>       m_pAdaptationBuffer;
+
+    Readback m_readbacks[readbackRingSize];
+    UINT     m_readbackWrite;
+    UINT64   m_frame;
+    UINT64   m_lastReadFrame;
+    float    m_luminance;
+    bool     m_hasLuminance;
+
+    // Ping-pong pair of the GPU adaptation
+    RenderTexture m_adaptedTextures[2];
+    UINT          m_adaptedIndex;
+    bool          m_resetAdaptedTexture;
+
+    ADAPTATION_MODE m_adaptationMode;
 
     float m_adaptedLuminance;
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// FNV-1a over file contents and parameters, stable across compilers and platforms unlike std::hash.
+// Keys of the on-disk caches, which must survive rebuilds and match between the tools and the app.
+class ContentHash
+{
+public:
+    static uint64_t constexpr offsetBasis = 0xCBF29CE484222325ull;
+    static uint64_t constexpr prime = 0x100000001B3ull;
+
+    static void Hash(uint64_t& hash, void const* data, size_t size)
+    {
+        unsigned char const* bytes = static_cast<unsigned char const*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * prime;
+        }
+    }
+
+    static void HashValue(uint64_t& hash, uint64_t value)
+    {
+        // Little endian regardless of the host
+        unsigned char bytes[8];
+        for (size_t i = 0; i < 8; ++i)
+        {
+            bytes[i] = (unsigned char)(value >> (8 * i));
+        }
+
+        Hash(hash, bytes, sizeof(bytes));
+    }
+
+    static void HashString(uint64_t& hash, std::string const& value)
+    {
+        HashValue(hash, value.size());
+        Hash(hash, value.data(), value.size());
+    }
+
+    // Line endings depend on the checkout, the text does not
+    static void HashText(uint64_t& hash, std::vector<unsigned char> const& text)
+    {
+        size_t size = 0;
+        for (unsigned char c : text)
+        {
+            size += c != '\r';
+        }
+
+        HashValue(hash, size);
+        for (unsigned char c : text)
+        {
+            if (c != '\r')
+            {
+                hash = (hash ^ c) * prime;
+            }
+        }
+    }
+};
@@ -0,0 +1,169 @@
+#include "DDSFile.h"
+
+#include <assert.h>
+#include <fstream>
+
+namespace
+{
+    uint32_t constexpr ddsMagic = 0x20534444; // "DDS "
+    uint32_t constexpr dx10FourCC = 0x30315844; // "DX10"
+
+    uint32_t constexpr ddsdCaps = 0x1;
+    uint32_t constexpr ddsdHeight = 0x2;
+    uint32_t constexpr ddsdWidth = 0x4;
+    uint32_t constexpr ddsdPitch = 0x8;
+    uint32_t constexpr ddsdPixelFormat = 0x1000;
+    uint32_t constexpr ddsdMipMapCount = 0x20000;
+
+    uint32_t constexpr ddpfFourCC = 0x4;
+
+    uint32_t constexpr ddsCapsComplex = 0x8;
+    uint32_t constexpr ddsCapsTexture = 0x1000;
+    uint32_t constexpr ddsCapsMipMap = 0x400000;
+    uint32_t constexpr ddsCaps2CubeMapAllFaces = 0xFE00;
+
+    // DXGI_FORMAT_R32G32B32A32_FLOAT, D3D11_RESOURCE_DIMENSION_TEXTURE2D, D3D11_RESOURCE_MISC_TEXTURECUBE
+    uint32_t constexpr dxgiFormatRGBA32Float = 2;
+    uint32_t constexpr resourceDimensionTexture2D = 3;
+    uint32_t constexpr resourceMiscTextureCube = 0x4;
+
+    uint32_t constexpr texelSize = 4 * sizeof(float);
+
+    struct PixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+    };
+
+    struct Header
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        PixelFormat pixelFormat;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct HeaderDX10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    static_assert(sizeof(Header) == 124, "DDS_HEADER is 124 bytes");
+    static_assert(sizeof(HeaderDX10) == 20, "DDS_HEADER_DXT10 is 20 bytes");
+}
+
+DDSFile::Texture DDSFile::Texture::Create(uint32_t width, uint32_t height, uint32_t arraySize, uint32_t mipLevels, bool cube)
+{
+    assert(width > 0 && height > 0 && arraySize > 0 && mipLevels > 0);
+    assert(!cube || (arraySize % 6 == 0 && width == height));
+
+    Texture texture = { width, height, arraySize, mipLevels, cube, {} };
+    texture.subresources.resize(arraySize * mipLevels);
+
+    for (uint32_t slice = 0; slice < arraySize; ++slice)
+    {
+        for (uint32_t mip = 0; mip < mipLevels; ++mip)
+        {
+            texture.Subresource(slice, mip).assign(4 * (size_t)texture.MipWidth(mip) * texture.MipHeight(mip), 0.0f);
+        }
+    }
+
+    return texture;
+}
+
+uint32_t DDSFile::Texture::MipWidth(uint32_t mip) const
+{
+    return width >> mip > 0 ? width >> mip : 1;
+}
+
+uint32_t DDSFile::Texture::MipHeight(uint32_t mip) const
+{
+    return height >> mip > 0 ? height >> mip : 1;
+}
+
+std::vector<float>& DDSFile::Texture::Subresource(uint32_t slice, uint32_t mip)
+{
+    assert(slice < arraySize && mip < mipLevels);
+
+    return subresources[slice * mipLevels + mip];
+}
+
+std::vector<float> const& DDSFile::Texture::Subresource(uint32_t slice, uint32_t mip) const
+{
+    assert(slice < arraySize && mip < mipLevels);
+
+    return subresources[slice * mipLevels + mip];
+}
+
+bool DDSFile::Write(std::string const& path, Texture const& texture)
+{
+    assert(texture.subresources.size() == texture.arraySize * texture.mipLevels);
+
+    Header header = {};
+    header.size = sizeof(Header);
+    header.flags = ddsdCaps | ddsdHeight | ddsdWidth | ddsdPitch | ddsdPixelFormat | ddsdMipMapCount;
+    header.height = texture.height;
+    header.width = texture.width;
+    header.pitchOrLinearSize = texture.width * texelSize;
+    header.mipMapCount = texture.mipLevels;
+    header.pixelFormat.size = sizeof(PixelFormat);
+    header.pixelFormat.flags = ddpfFourCC;
+    header.pixelFormat.fourCC = dx10FourCC;
+    header.caps = ddsCapsTexture;
+    if (texture.mipLevels > 1)
+    {
+        header.caps |= ddsCapsComplex | ddsCapsMipMap;
+    }
+    if (texture.cube)
+    {
+        header.caps |= ddsCapsComplex;
+        header.caps2 = ddsCaps2CubeMapAllFaces;
+    }
+
+    // Cube arrays count cubes, not faces
+    HeaderDX10 headerDX10 = {};
+    headerDX10.dxgiFormat = dxgiFormatRGBA32Float;
+    headerDX10.resourceDimension = resourceDimensionTexture2D;
+    headerDX10.miscFlag = texture.cube ? resourceMiscTextureCube : 0;
+    headerDX10.arraySize = texture.cube ? texture.arraySize / 6 : texture.arraySize;
+
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    if (!os.is_open())
+    {
+        return false;
+    }
+
+    os.write(reinterpret_cast<char const*>(&ddsMagic), sizeof(ddsMagic));
+    os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    os.write(reinterpret_cast<char const*>(&headerDX10), sizeof(headerDX10));
+
+    for (uint32_t slice = 0; slice < texture.arraySize; ++slice)
+    {
+        for (uint32_t mip = 0; mip < texture.mipLevels; ++mip)
+        {
+            std::vector<float> const& texels = texture.Subresource(slice, mip);
+            assert(texels.size() == 4 * (size_t)texture.MipWidth(mip) * texture.MipHeight(mip));
+
+            os.write(reinterpret_cast<char const*>(texels.data()), texels.size() * sizeof(float));
+        }
+    }
+
+    return os.good();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes float textures as DDS with the DX10 extension header, the layout
+// DirectX::CreateDDSTextureFromFile expects. No D3D dependency.
+class DDSFile
+{
+public:
+    // Tightly packed R32G32B32A32_FLOAT texels, subresources in D3D order:
+    // array slice major, mip minor. Cube maps have six slices.
+    struct Texture
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t arraySize;
+        uint32_t mipLevels;
+        bool cube;
+        std::vector<std::vector<float>> subresources;
+
+        static Texture Create(uint32_t width, uint32_t height, uint32_t arraySize, uint32_t mipLevels, bool cube);
+
+        uint32_t MipWidth(uint32_t mip) const;
+        uint32_t MipHeight(uint32_t mip) const;
+
+        std::vector<float>& Subresource(uint32_t slice, uint32_t mip);
+        std::vector<float> const& Subresource(uint32_t slice, uint32_t mip) const;
+    };
+
+    static bool Write(std::string const& path, Texture const& texture);
+};
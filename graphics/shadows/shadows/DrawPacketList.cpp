@@ -0,0 +1,137 @@
+#include "DrawPacketList.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    uint32_t constexpr shaderBits = 8;
+    uint32_t constexpr materialBits = 16;
+    uint32_t constexpr matrixBits = 16;
+    uint32_t constexpr topologyBits = 4;
+    uint32_t constexpr primitiveBits = 20;
+
+    static_assert(shaderBits + materialBits + matrixBits + topologyBits + primitiveBits == 64, "Draw packet key must fill 64 bits");
+
+    inline uint32_t PopCount(uint32_t bits)
+    {
+        uint32_t count = 0;
+
+        for (; bits != 0; bits &= bits - 1)
+        {
+            ++count;
+        }
+
+        return count;
+    }
+}
+
+DrawPacketList::StateFilter::StateFilter() : m_bEmpty{ true }, m_last{} {}
+
+void DrawPacketList::StateFilter::Reset()
+{
+    m_bEmpty = true;
+}
+
+uint32_t DrawPacketList::StateFilter::Apply(Packet const& packet)
+{
+    uint32_t changes = ALL_CHANGES;
+
+    if (!m_bEmpty)
+    {
+        changes = 0;
+
+        if (packet.shaderFlags != m_last.shaderFlags)
+            changes |= SHADER_CHANGE;
+        if (packet.material != m_last.material)
+            changes |= MATERIAL_CHANGE;
+        if (packet.matrix != m_last.matrix)
+            changes |= MATRIX_CHANGE;
+        if (packet.topology != m_last.topology)
+            changes |= TOPOLOGY_CHANGE;
+    }
+
+    m_bEmpty = false;
+    m_last = packet;
+
+    return changes;
+}
+
+uint64_t DrawPacketList::MakeKey(uint32_t shaderFlags, uint32_t material, uint32_t matrix, uint32_t topology, uint32_t primitive)
+{
+    assert(shaderFlags < (1u << shaderBits));
+    assert(material < (1u << materialBits));
+    assert(matrix < (1u << matrixBits));
+    assert(topology < (1u << topologyBits));
+    assert(primitive < (1u << primitiveBits));
+
+    uint64_t key = shaderFlags;
+    key = (key << materialBits) | material;
+    key = (key << matrixBits) | matrix;
+    key = (key << topologyBits) | topology;
+    key = (key << primitiveBits) | primitive;
+
+    return key;
+}
+
+void DrawPacketList::Clear()
+{
+    m_aPackets.clear();
+}
+
+void DrawPacketList::Add(uint32_t shaderFlags, uint32_t material, uint32_t matrix, uint32_t topology)
+{
+    Packet packet = {};
+    packet.primitive = static_cast<uint32_t>(m_aPackets.size());
+    packet.shaderFlags = shaderFlags;
+    packet.material = material;
+    packet.matrix = matrix;
+    packet.topology = topology;
+    packet.key = MakeKey(shaderFlags, material, matrix, topology, packet.primitive);
+
+    m_aPackets.push_back(packet);
+}
+
+void DrawPacketList::Sort()
+{
+    // Primitive index in the low bits keeps keys unique, the order is deterministic
+    std::sort(m_aPackets.begin(), m_aPackets.end(), [](Packet const& a, Packet const& b)
+        {
+            return a.key < b.key;
+        });
+}
+
+size_t DrawPacketList::Size() const
+{
+    return m_aPackets.size();
+}
+
+DrawPacketList::Packet const& DrawPacketList::operator[](size_t ind) const
+{
+    assert(ind < m_aPackets.size());
+
+    return m_aPackets[ind];
+}
+
+std::vector<DrawPacketList::Packet>::const_iterator DrawPacketList::begin() const
+{
+    return m_aPackets.begin();
+}
+
+std::vector<DrawPacketList::Packet>::const_iterator DrawPacketList::end() const
+{
+    return m_aPackets.end();
+}
+
+size_t DrawPacketList::CountStateChanges() const
+{
+    StateFilter filter;
+    size_t changes = 0;
+
+    for (Packet const& packet : m_aPackets)
+    {
+        changes += PopCount(filter.Apply(packet));
+    }
+
+    return changes;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draw packets of a Model: one immutable record per primitive with everything
+// the submission loop switches on. Sorting by key groups primitives sharing a
+// pixel shader, then a material, then a matrix, so StateFilter can skip the
+// redundant state changes. No D3D dependency, the same code runs in benchmarks.
+class DrawPacketList
+{
+public:
+    struct Packet
+    {
+        uint64_t key;
+        uint32_t primitive;
+        uint32_t shaderFlags;
+        uint32_t material;
+        uint32_t matrix;
+        uint32_t topology;
+    };
+
+    enum STATE_CHANGE
+    {
+        SHADER_CHANGE = 0x1,
+        MATERIAL_CHANGE = 0x2,
+        MATRIX_CHANGE = 0x4,
+        TOPOLOGY_CHANGE = 0x8,
+
+        ALL_CHANGES = 0xF
+    };
+
+    // Remembers the last submitted packet and reports what the next one has to rebind
+    class StateFilter
+    {
+    public:
+        StateFilter();
+
+        // Everything is rebound for the next packet, call at the start of a pass
+        void Reset();
+
+        // STATE_CHANGE bits the packet needs on top of the previously applied one
+        uint32_t Apply(Packet const& packet);
+
+    private:
+        bool m_bEmpty;
+        Packet m_last;
+    };
+
+    // Key bits, most expensive state change highest: shader 8 | material 16 | matrix 16 | topology 4 | primitive 20
+    static uint64_t MakeKey(uint32_t shaderFlags, uint32_t material, uint32_t matrix, uint32_t topology, uint32_t primitive);
+
+    void Clear();
+
+    // Appends the packet of primitive Size()
+    void Add(uint32_t shaderFlags, uint32_t material, uint32_t matrix, uint32_t topology);
+
+    void Sort();
+
+    size_t Size() const;
+    Packet const& operator[](size_t ind) const;
+
+    std::vector<Packet>::const_iterator begin() const;
+    std::vector<Packet>::const_iterator end() const;
+
+    // State changes needed to submit the packets in the current order
+    size_t CountStateChanges() const;
+
+private:
+    std::vector<Packet> m_aPackets;
+};
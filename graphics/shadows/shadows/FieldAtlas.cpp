@@ -0,0 +1,267 @@
+#include "FieldAtlas.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+
+#include "FieldStorage.h"
+
+namespace
+{
+	size_t constexpr tileTexels = FieldAtlas::tileSize * FieldAtlas::tileSize;
+
+	// Dense tile of a SparseField as a field of its own, payloads are x-major as FieldStorage columns
+	FieldStorage PayloadView(SparseField const& field, uint32_t payload)
+	{
+		int32_t* dx = const_cast<int32_t*>(field.Payload(payload));
+
+		return FieldStorage::View(dx, dx + tileTexels, FieldAtlas::tileSize, FieldAtlas::tileSize, FieldAtlas::tileSize);
+	}
+}
+
+FieldAtlas::FieldAtlas(FieldEncoding::Format format, size_t width, size_t height)
+	: m_eFormat{ format }, m_iTexelSize{ FieldEncoding::TexelSize(format) },
+	m_iWidth{ width }, m_iHeight{ height },
+	m_iTilesX{ (width + tileSize - 1) / tileSize },
+	m_iTilesY{ (height + tileSize - 1) / tileSize },
+	m_iTiles{ 1 }
+{
+	assert(m_iTexelSize <= sizeof(uint64_t));
+
+	// Every format encodes zero as zero bytes
+	m_aConstantTiles[0] = zeroTile;
+}
+
+size_t FieldAtlas::TilesX() const
+{
+	return m_iTilesX;
+}
+
+size_t FieldAtlas::TilesY() const
+{
+	return m_iTilesY;
+}
+
+size_t FieldAtlas::PageWidth() const
+{
+	return m_iTilesX * tileSize;
+}
+
+size_t FieldAtlas::PageHeight() const
+{
+	return pageRows * tileSize;
+}
+
+size_t FieldAtlas::PageTiles() const
+{
+	return m_iTilesX * pageRows;
+}
+
+size_t FieldAtlas::PagesNum() const
+{
+	return (m_iTiles + PageTiles() - 1) / PageTiles();
+}
+
+size_t FieldAtlas::TilesNum() const
+{
+	return m_iTiles;
+}
+
+void FieldAtlas::Origin(uint32_t tile, size_t& page, size_t& x, size_t& y) const
+{
+	size_t inPage = tile % PageTiles();
+
+	page = tile / PageTiles();
+	x = inPage % m_iTilesX * tileSize;
+	y = inPage / m_iTilesX * tileSize;
+}
+
+bool FieldAtlas::InRange(SparseField const& field, FieldEncoding::Format format)
+{
+	int32_t range = FieldEncoding::Range(format);
+	if (range == 0)
+	{
+		return true;
+	}
+
+	for (size_t tx = 0; tx < field.TilesX(); ++tx)
+	{
+		for (size_t ty = 0; ty < field.TilesY(); ++ty)
+		{
+			SparseField::Tile const& tile = field.GetTile(tx, ty);
+
+			bool inRange = tile.payload == SparseField::constantTile ?
+				std::abs(tile.dx) <= range && std::abs(tile.dy) <= range :
+				FieldEncoding::InRange(PayloadView(field, tile.payload), format);
+
+			if (!inRange)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void FieldAtlas::AddTiles(unsigned char const* texels, std::vector<uint32_t>& tiles, std::vector<Copy>& copies)
+{
+	assert(texels != nullptr);
+
+	tiles.resize(m_iTilesX * m_iTilesY);
+	copies.clear();
+	m_aStaging.clear();
+
+	size_t rowPitch = m_iTexelSize * m_iWidth;
+
+	for (size_t ty = 0; ty < m_iTilesY; ++ty)
+	{
+		size_t y0 = ty * tileSize;
+		size_t height = std::min(tileSize, m_iHeight - y0);
+
+		for (size_t tx = 0; tx < m_iTilesX; ++tx)
+		{
+			size_t x0 = tx * tileSize;
+			size_t width = std::min(tileSize, m_iWidth - x0);
+
+			unsigned char const* origin = texels + m_iTexelSize * x0 + rowPitch * y0;
+
+			bool constant = true;
+			for (size_t j = 0; j < height && constant; ++j)
+			{
+				unsigned char const* row = origin + rowPitch * j;
+
+				for (size_t i = 0; i < width && constant; ++i)
+				{
+					constant = std::memcmp(row + m_iTexelSize * i, origin, m_iTexelSize) == 0;
+				}
+			}
+
+			if (constant)
+			{
+				tiles[tx + ty * m_iTilesX] = ConstantTile(origin, copies);
+				continue;
+			}
+
+			uint32_t tile = NewTile();
+			tiles[tx + ty * m_iTilesX] = tile;
+			copies.push_back({ tile, origin, rowPitch, width, height });
+		}
+	}
+}
+
+void FieldAtlas::AddTiles(SparseField const& field, std::vector<uint32_t>& tiles, std::vector<Copy>& copies)
+{
+	assert(field.Width() == m_iWidth && field.Height() == m_iHeight && InRange(field, m_eFormat));
+
+	tiles.resize(m_iTilesX * m_iTilesY);
+	copies.clear();
+	m_aStaging.clear();
+
+	FieldStorage value(1, 1);
+	unsigned char texel[sizeof(uint64_t)];
+
+	for (size_t ty = 0; ty < m_iTilesY; ++ty)
+	{
+		size_t height = std::min(tileSize, m_iHeight - ty * tileSize);
+
+		for (size_t tx = 0; tx < m_iTilesX; ++tx)
+		{
+			size_t width = std::min(tileSize, m_iWidth - tx * tileSize);
+
+			SparseField::Tile const& sparseTile = field.GetTile(tx, ty);
+
+			if (sparseTile.payload == SparseField::constantTile)
+			{
+				value.Set(0, 0, sparseTile.dx, sparseTile.dy);
+				FieldEncoding::EncodeTile(value, m_eFormat, m_iWidth, m_iHeight, texel);
+
+				tiles[tx + ty * m_iTilesX] = ConstantTile(texel, copies);
+				continue;
+			}
+
+			unsigned char* staging = NewStagingTile();
+			FieldEncoding::EncodeTile(PayloadView(field, sparseTile.payload), m_eFormat, m_iWidth, m_iHeight, staging);
+
+			uint32_t tile = NewTile();
+			tiles[tx + ty * m_iTilesX] = tile;
+			copies.push_back({ tile, staging, m_iTexelSize * tileSize, width, height });
+		}
+	}
+}
+
+uint32_t FieldAtlas::Reserve()
+{
+	// Page aligned, so tile rows of the field are rows of its pages
+	size_t first = PagesNum() * PageTiles();
+
+	m_iTiles = first + m_iTilesX * m_iTilesY;
+
+	return (uint32_t)first;
+}
+
+void FieldAtlas::ReservedTiles(uint32_t first, std::vector<uint32_t>& tiles) const
+{
+	assert(first % PageTiles() == 0 && first + m_iTilesX * m_iTilesY <= m_iTiles);
+
+	tiles.resize(m_iTilesX * m_iTilesY);
+
+	for (size_t ind = 0; ind < tiles.size(); ++ind)
+	{
+		tiles[ind] = first + (uint32_t)ind;
+	}
+}
+
+void FieldAtlas::ReservedCopies(uint32_t first, unsigned char const* texels, std::vector<Copy>& copies) const
+{
+	assert(first % PageTiles() == 0 && texels != nullptr);
+
+	copies.clear();
+
+	size_t rowPitch = m_iTexelSize * m_iWidth;
+
+	for (size_t y0 = 0; y0 < m_iHeight; y0 += PageHeight())
+	{
+		uint32_t tile = first + (uint32_t)(y0 / tileSize * m_iTilesX);
+
+		copies.push_back({ tile, texels + rowPitch * y0, rowPitch, m_iWidth, std::min(PageHeight(), m_iHeight - y0) });
+	}
+}
+
+uint32_t FieldAtlas::ConstantTile(unsigned char const* texel, std::vector<Copy>& copies)
+{
+	uint64_t key = 0;
+	std::memcpy(&key, texel, m_iTexelSize);
+
+	auto found = m_aConstantTiles.find(key);
+	if (found != m_aConstantTiles.end())
+	{
+		return found->second;
+	}
+
+	// Whole tile even on the field edge, any field may share it
+	unsigned char* staging = NewStagingTile();
+	for (size_t ind = 0; ind < tileTexels; ++ind)
+	{
+		std::memcpy(staging + m_iTexelSize * ind, texel, m_iTexelSize);
+	}
+
+	uint32_t tile = NewTile();
+	m_aConstantTiles[key] = tile;
+	copies.push_back({ tile, staging, m_iTexelSize * tileSize, tileSize, tileSize });
+
+	return tile;
+}
+
+uint32_t FieldAtlas::NewTile()
+{
+	return (uint32_t)m_iTiles++;
+}
+
+unsigned char* FieldAtlas::NewStagingTile()
+{
+	m_aStaging.emplace_back(m_iTexelSize * tileTexels);
+
+	return m_aStaging.back().data();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "FieldEncoding.h"
+#include "SparseField.h"
+
+// Layout of the tiled field textures AnimatedTexture uploads, no D3D dependency.
+// Fields are cut into SparseField::tileSize square tiles. Only tiles that aren't constant get a tile
+// of their own in the atlas, constant tiles of one value share theirs, so GPU memory grows with the moving area.
+// The atlas is a texture array of pages, each page holds pageRows rows of TilesX() tiles.
+// A field slice is an indirection of TilesX() x TilesY() atlas tile indices, tile (tx, ty) at tx + ty * TilesX().
+// FieldAtlas.hlsli does the same lookup in the shaders.
+class FieldAtlas
+{
+public:
+	static size_t constexpr tileSize = SparseField::tileSize;
+
+	// Mirrors FIELD_PAGE_ROWS of FieldAtlas.hlsli
+	static size_t constexpr pageRows = 8;
+
+	// Zeros, the owner clears every page it allocates
+	static uint32_t constexpr zeroTile = 0;
+
+	// Texels to write at the origin of atlas tile `tile`, `rowPitch` bytes between rows.
+	// Tiles on the field edge are cut to the field, a copy of a reserved field spans a whole page.
+	struct Copy
+	{
+		uint32_t tile;
+		unsigned char const* texels;
+		size_t rowPitch;
+		size_t width;
+		size_t height;
+	};
+
+public:
+	FieldAtlas(FieldEncoding::Format format, size_t width, size_t height);
+
+	size_t TilesX() const;
+	size_t TilesY() const;
+
+	size_t PageWidth() const;
+	size_t PageHeight() const;
+	size_t PageTiles() const;
+
+	// Pages the tiles handed out so far take
+	size_t PagesNum() const;
+	size_t TilesNum() const;
+
+	// Page of atlas tile `tile` and the texel its tile starts at
+	void Origin(uint32_t tile, size_t& page, size_t& x, size_t& y) const;
+
+	static bool InRange(SparseField const& field, FieldEncoding::Format format);
+
+	// Encoded field (FieldEncoding::Encode layout) into the atlas, `tiles` gets its indirection
+	void AddTiles(unsigned char const* texels, std::vector<uint32_t>& tiles, std::vector<Copy>& copies);
+	// Only the dense tiles are encoded, the field has to be InRange
+	// `copies` of the constant and encoded tiles point into the atlas, valid until the next AddTiles
+	void AddTiles(SparseField const& field, std::vector<uint32_t>& tiles, std::vector<Copy>& copies);
+
+	// A tile for every field tile, whole pages so a new field is a copy per page. Returns the first tile,
+	// for fields streamed through one slice.
+	uint32_t Reserve();
+	void ReservedTiles(uint32_t first, std::vector<uint32_t>& tiles) const;
+	void ReservedCopies(uint32_t first, unsigned char const* texels, std::vector<Copy>& copies) const;
+
+private:
+	// Tile of a constant value, a new one the first time the value shows up
+	uint32_t ConstantTile(unsigned char const* texel, std::vector<Copy>& copies);
+
+	uint32_t NewTile();
+	unsigned char* NewStagingTile();
+
+private:
+	FieldEncoding::Format m_eFormat;
+	size_t m_iTexelSize;
+
+	size_t m_iWidth;
+	size_t m_iHeight;
+	size_t m_iTilesX;
+	size_t m_iTilesY;
+
+	size_t m_iTiles;
+
+	// Encoded value of a constant tile (zero padded) to its atlas tile
+	std::map<uint64_t, uint32_t> m_aConstantTiles;
+
+	// Tiles the last AddTiles encoded, one buffer each so earlier copies stay valid
+	std::vector<std::vector<unsigned char>> m_aStaging;
+};
@@ -0,0 +1,31 @@
+// Field lookup through the tile indirection of AnimatedTexture, FieldAtlas lays the textures out.
+// A field slice holds one texel per FIELD_TILE_SIZE square tile of the field: the atlas tile of the
+// displacement (x) and of the transform (y). Every atlas page holds FIELD_PAGE_ROWS rows of tiles,
+// as many per row as the field has. Loads pick the texel the point sampler with wrap addressing did.
+
+#define FIELD_TILE_SIZE 32 // SparseField::tileSize
+#define FIELD_PAGE_ROWS 8 // FieldAtlas::pageRows
+
+// Field texel under uv of a `size` field
+uint2 FieldTexel(float2 uv, uint2 size)
+{
+	return min((uint2)(frac(uv) * size), size - 1);
+}
+
+// Atlas tiles of the displacement (x) and the transform (y) of a field texel
+uint2 FieldTiles(Texture2DArray<uint2> tiles, uint2 texel, uint slice)
+{
+	return tiles.Load(int4(texel / FIELD_TILE_SIZE, slice, 0));
+}
+
+// Encoded value of a field texel in atlas tile `tile`, scale by the field decode
+float2 FieldAtlasLoad(Texture2DArray<float4> atlas, uint tile, uint2 texel, uint2 size)
+{
+	uint tilesX = (size.x + FIELD_TILE_SIZE - 1) / FIELD_TILE_SIZE;
+	uint pageTiles = tilesX * FIELD_PAGE_ROWS;
+	uint inPage = tile % pageTiles;
+
+	uint2 origin = uint2(inPage % tilesX, inPage / tilesX) * FIELD_TILE_SIZE;
+
+	return atlas.Load(int4(origin + texel % FIELD_TILE_SIZE, tile / pageTiles, 0)).rg;
+}
@@ -0,0 +1,206 @@
+#include "FieldEncoding.h"
+
+#include <assert.h>
+#include <cstdlib>
+
+#include "ThreadPool.h"
+
+namespace
+{
+	// Field columns handed to a worker at once, as VectorField::raw_data() splits them
+	size_t constexpr columnsGrain = 16;
+
+	template <typename T>
+	void EncodeInt(FieldStorage const& field, T* texels, size_t iBegin, size_t iEnd)
+	{
+		size_t x = field.Width();
+		size_t y = field.Height();
+
+		for (size_t i = iBegin; i < iEnd; ++i)
+		{
+			FieldStorage::ConstColumnView column = field.Column(i);
+
+			for (size_t j = 0; j < y; ++j)
+			{
+				texels[2 * (i + j * x) + 0] = (T)column.dx[j];
+				texels[2 * (i + j * x) + 1] = (T)column.dy[j];
+			}
+		}
+	}
+
+	// Uv displacement of a width x height field, `field` may be a tile of it
+	void EncodeFloat(FieldStorage const& field, float* uv, size_t iBegin, size_t iEnd, size_t width, size_t height)
+	{
+		size_t x = field.Width();
+		size_t y = field.Height();
+
+		for (size_t i = iBegin; i < iEnd; ++i)
+		{
+			FieldStorage::ConstColumnView column = field.Column(i);
+
+			for (size_t j = 0; j < y; ++j)
+			{
+				uv[2 * (i + j * x) + 0] = (float)column.dx[j] / (float)width;
+				uv[2 * (i + j * x) + 1] = (float)column.dy[j] / (float)height;
+			}
+		}
+	}
+}
+
+int32_t FieldEncoding::Range(Format format)
+{
+	switch (format)
+	{
+	case Format::SNORM16:
+		return 32767;
+	case Format::SNORM8:
+		return 127;
+	default:
+		return 0;
+	}
+}
+
+size_t FieldEncoding::TexelSize(Format format)
+{
+	switch (format)
+	{
+	case Format::SNORM16:
+		return 2 * sizeof(int16_t);
+	case Format::SNORM8:
+		return 2 * sizeof(int8_t);
+	default:
+		return 2 * sizeof(float);
+	}
+}
+
+char const* FieldEncoding::FormatName(Format format)
+{
+	switch (format)
+	{
+	case Format::SNORM16:
+		return "snorm16";
+	case Format::SNORM8:
+		return "snorm8";
+	default:
+		return "float32";
+	}
+}
+
+bool FieldEncoding::InRange(FieldStorage const& field, Format format)
+{
+	int32_t range = Range(format);
+	if (range == 0)
+	{
+		return true;
+	}
+
+	// -range - 1 would decode as -range, so it is out of range too
+	for (size_t i = 0; i < field.Width(); ++i)
+	{
+		FieldStorage::ConstColumnView column = field.Column(i);
+
+		for (size_t j = 0; j < field.Height(); ++j)
+		{
+			if (std::abs(column.dx[j]) > range || std::abs(column.dy[j]) > range)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool FieldEncoding::IsZero(FieldStorage const& field)
+{
+	for (size_t i = 0; i < field.Width(); ++i)
+	{
+		FieldStorage::ConstColumnView column = field.Column(i);
+
+		for (size_t j = 0; j < field.Height(); ++j)
+		{
+			if (column.dx[j] != 0 || column.dy[j] != 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void FieldEncoding::Encode(FieldStorage const& field, Format format, void* texels)
+{
+	assert(texels != nullptr && InRange(field, format));
+
+	ThreadPool::Get().ParallelFor(0, field.Width(), columnsGrain, [&](size_t iBegin, size_t iEnd)
+		{
+			EncodeColumns(field, format, texels, iBegin, iEnd);
+		});
+}
+
+void FieldEncoding::EncodeColumns(FieldStorage const& field, Format format, void* texels, size_t iBegin, size_t iEnd)
+{
+	assert(texels != nullptr && iBegin <= iEnd && iEnd <= field.Width());
+
+	switch (format)
+	{
+	case Format::SNORM16:
+		EncodeInt(field, static_cast<int16_t*>(texels), iBegin, iEnd);
+		break;
+	case Format::SNORM8:
+		EncodeInt(field, static_cast<int8_t*>(texels), iBegin, iEnd);
+		break;
+	default:
+		EncodeFloat(field, static_cast<float*>(texels), iBegin, iEnd, field.Width(), field.Height());
+		break;
+	}
+}
+
+void FieldEncoding::EncodeTile(FieldStorage const& tile, Format format, size_t width, size_t height, void* texels)
+{
+	assert(texels != nullptr);
+
+	if (Range(format) != 0)
+	{
+		EncodeColumns(tile, format, texels, 0, tile.Width());
+		return;
+	}
+
+	EncodeFloat(tile, static_cast<float*>(texels), 0, tile.Width(), width, height);
+}
+
+void FieldEncoding::DecodeScale(Format format, size_t width, size_t height, float* scale)
+{
+	int32_t range = Range(format);
+
+	scale[0] = range == 0 ? 1.0f : (float)range / (float)width;
+	scale[1] = range == 0 ? 1.0f : (float)range / (float)height;
+}
+
+float FieldEncoding::Sample(Format format, void const* texels, size_t ind, size_t c)
+{
+	assert(c < 2);
+
+	switch (format)
+	{
+	case Format::SNORM16:
+		return (float)static_cast<int16_t const*>(texels)[2 * ind + c] / 32767.0f;
+	case Format::SNORM8:
+		return (float)static_cast<int8_t const*>(texels)[2 * ind + c] / 127.0f;
+	default:
+		return static_cast<float const*>(texels)[2 * ind + c];
+	}
+}
+
+void FieldEncoding::Decode(Format format, void const* texels, size_t width, size_t height, float* uv, size_t uvStride)
+{
+	float scale[2];
+	DecodeScale(format, width, height, scale);
+
+	for (size_t ind = 0; ind < width * height; ++ind)
+	{
+		uv[ind * uvStride + 0] = Sample(format, texels, ind, 0) * scale[0];
+		uv[ind * uvStride + 1] = Sample(format, texels, ind, 1) * scale[1];
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FieldStorage.h"
+
+// GPU encodings of a displacement plane. Every format holds the (dx, dy) pair of one plane,
+// texel (i, j) at i + j * width, the transform plane goes to a texture of its own.
+// SNORM formats store displacements in texels, the sampler returns c / Range() and
+// DecodeScale() turns that into the uv displacement VectorField::raw_data() computes.
+// No D3D dependency, the reference renderer decodes with the same arithmetic.
+class FieldEncoding
+{
+public:
+	enum class Format
+	{
+		FLOAT32 = 0, // R32G32_FLOAT, uv displacement as raw_data() has it
+		SNORM16 = 1, // R16G16_SNORM, |d| <= 32767 texels
+		SNORM8 = 2 // R8G8_SNORM, |d| <= 127 texels
+	};
+
+	// Largest |dx| and |dy| in texels, 0 when any int32 fits
+	static int32_t Range(Format format);
+
+	static size_t TexelSize(Format format);
+	static char const* FormatName(Format format);
+
+	static bool InRange(FieldStorage const& field, Format format);
+	static bool IsZero(FieldStorage const& field);
+
+	// `texels` holds Width() * Height() * TexelSize() bytes. Runs a ThreadPool region, which waits for
+	// the region of any other thread: threads a JobGraph MAIN job may wait on use EncodeColumns.
+	static void Encode(FieldStorage const& field, Format format, void* texels);
+	// Encode of the columns [iBegin, iEnd) on the calling thread
+	static void EncodeColumns(FieldStorage const& field, Format format, void* texels, size_t iBegin, size_t iEnd);
+	// Encode of a tile cut from a width x height field, FLOAT32 texels are relative to the whole field
+	static void EncodeTile(FieldStorage const& tile, Format format, size_t width, size_t height, void* texels);
+
+	// Uv displacement per sampled unit, fields of width x height
+	static void DecodeScale(Format format, size_t width, size_t height, float* scale);
+
+	// What the sampler returns for component c of texel ind
+	static float Sample(Format format, void const* texels, size_t ind, size_t c);
+
+	// Sample() * DecodeScale() of every texel into uv[ind * uvStride + 0..1]
+	static void Decode(Format format, void const* texels, size_t width, size_t height, float* uv, size_t uvStride);
+};
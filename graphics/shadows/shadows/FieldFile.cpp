@@ -0,0 +1,314 @@
+#include "FieldFile.h"
+
+#include <assert.h>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "FieldStorage.h"
+#include "VectorField.h"
+
+namespace
+{
+	char const fieldFileMagic[4] = { 'V', 'F', 'L', 'D' };
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + FieldFile::payloadAlignment - 1) / FieldFile::payloadAlignment * FieldFile::payloadAlignment;
+	}
+
+	void WritePlane(std::ofstream& os, FieldStorage::value_t const* plane, size_t width, size_t height, size_t srcStride, size_t dstStride)
+	{
+		std::vector<int32_t> row(dstStride, 0);
+
+		for (size_t i = 0; i < width; ++i)
+		{
+			std::memcpy(row.data(), plane + i * srcStride, height * sizeof(int32_t));
+			os.write(reinterpret_cast<char const*>(row.data()), dstStride * sizeof(int32_t));
+		}
+	}
+
+	void WritePadding(std::ofstream& os, uint64_t offset)
+	{
+		static char const zeros[FieldFile::payloadAlignment] = {};
+
+		uint64_t pos = (uint64_t)os.tellp();
+		assert(pos <= offset);
+
+		os.write(zeros, (std::streamsize)(offset - pos));
+	}
+}
+
+FieldFile::FieldFile() : m_pData{ nullptr }, m_iSize{ 0 },
+#ifdef _WIN32
+	m_hFile{ INVALID_HANDLE_VALUE }, m_hMapping{ nullptr }
+#else
+	m_iFile{ -1 }
+#endif
+{}
+
+FieldFile::~FieldFile()
+{
+#ifdef _WIN32
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+	}
+
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+	}
+#else
+	if (m_pData)
+	{
+		munmap(m_pData, m_iSize);
+	}
+
+	if (m_iFile >= 0)
+	{
+		close(m_iFile);
+	}
+#endif
+}
+
+std::shared_ptr<FieldFile> FieldFile::Open(std::string const& filename)
+{
+	std::shared_ptr<FieldFile> file(new FieldFile());
+
+	if (!file->Map(filename) || !file->Validate())
+	{
+		return nullptr;
+	}
+
+	return file;
+}
+
+bool FieldFile::Write(std::string const& filename, VectorField const& field, bool withTexels, FieldEncoding::Format format)
+{
+	FieldStorage const& storage = field.Storage();
+	FieldStorage const& transformStorage = field.TransformStorage();
+
+	size_t width = storage.Width();
+	size_t height = storage.Height();
+	size_t stride = FieldStorage::AlignedStride(height);
+	size_t texelsSize = FieldEncoding::TexelSize(format) * width * height;
+
+	withTexels = withTexels && FieldEncoding::InRange(storage, format) && FieldEncoding::InRange(transformStorage, format);
+	bool withTransformTexels = withTexels && !FieldEncoding::IsZero(transformStorage);
+
+	Header header = {};
+	std::memcpy(header.magic, fieldFileMagic, sizeof(header.magic));
+	header.version = version;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.stride = (uint32_t)stride;
+	header.componentType = (uint32_t)ComponentType::INT32;
+	header.flags = (withTexels ? (uint32_t)HAS_TEXELS : 0u) | (withTransformTexels ? (uint32_t)HAS_TRANSFORM_TEXELS : 0u);
+	header.texelsFormat = (uint32_t)format;
+	header.planesOffset = AlignOffset(sizeof(Header));
+	header.texelsOffset = withTexels ? AlignOffset(header.planesOffset + planesNum * stride * width * sizeof(int32_t)) : 0;
+	header.transformTexelsOffset = withTransformTexels ? AlignOffset(header.texelsOffset + texelsSize) : 0;
+
+	std::ofstream os(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!os.is_open())
+	{
+		return false;
+	}
+
+	os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+	WritePadding(os, header.planesOffset);
+	WritePlane(os, storage.DX(), width, height, storage.Stride(), stride);
+	WritePlane(os, storage.DY(), width, height, storage.Stride(), stride);
+	WritePlane(os, transformStorage.DX(), width, height, transformStorage.Stride(), stride);
+	WritePlane(os, transformStorage.DY(), width, height, transformStorage.Stride(), stride);
+
+	if (withTexels)
+	{
+		std::vector<unsigned char> texels(texelsSize);
+
+		FieldEncoding::Encode(storage, format, texels.data());
+		WritePadding(os, header.texelsOffset);
+		os.write(reinterpret_cast<char const*>(texels.data()), (std::streamsize)texelsSize);
+
+		if (withTransformTexels)
+		{
+			FieldEncoding::Encode(transformStorage, format, texels.data());
+			WritePadding(os, header.transformTexelsOffset);
+			os.write(reinterpret_cast<char const*>(texels.data()), (std::streamsize)texelsSize);
+		}
+	}
+
+	return os.good();
+}
+
+bool FieldFile::Convert(std::string const& fldFilename, std::string const& filename, bool withTexels, FieldEncoding::Format format)
+{
+	VectorField* field = VectorField::loadFromFile(fldFilename);
+
+	if (field == nullptr)
+	{
+		return false;
+	}
+
+	bool result = Write(filename, *field, withTexels, format);
+
+	delete field;
+
+	return result;
+}
+
+FieldFile::Header const& FieldFile::GetHeader() const
+{
+	return *reinterpret_cast<Header const*>(m_pData);
+}
+
+int32_t* FieldFile::Plane(size_t ind) const
+{
+	assert(ind < planesNum);
+
+	Header const& header = GetHeader();
+
+	return reinterpret_cast<int32_t*>(static_cast<char*>(m_pData) + header.planesOffset) + ind * (size_t)header.stride * header.width;
+}
+
+unsigned char const* FieldFile::Texels(FieldEncoding::Format format) const
+{
+	Header const& header = GetHeader();
+
+	if ((header.flags & HAS_TEXELS) == 0 || header.texelsFormat != (uint32_t)format)
+	{
+		return nullptr;
+	}
+
+	return static_cast<unsigned char const*>(m_pData) + header.texelsOffset;
+}
+
+unsigned char const* FieldFile::TransformTexels(FieldEncoding::Format format) const
+{
+	Header const& header = GetHeader();
+
+	if ((header.flags & HAS_TRANSFORM_TEXELS) == 0 || header.texelsFormat != (uint32_t)format)
+	{
+		return nullptr;
+	}
+
+	return static_cast<unsigned char const*>(m_pData) + header.transformTexelsOffset;
+}
+
+bool FieldFile::Map(std::string const& filename)
+{
+#ifdef _WIN32
+	m_hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart < (LONGLONG)sizeof(Header))
+	{
+		return false;
+	}
+	m_iSize = (size_t)size.QuadPart;
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+	if (m_hMapping == nullptr)
+	{
+		return false;
+	}
+
+	m_pData = MapViewOfFile(m_hMapping, FILE_MAP_COPY, 0, 0, 0);
+#else
+	m_iFile = open(filename.c_str(), O_RDONLY);
+
+	if (m_iFile < 0)
+	{
+		return false;
+	}
+
+	struct stat st = {};
+	if (fstat(m_iFile, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+	{
+		return false;
+	}
+	m_iSize = (size_t)st.st_size;
+
+	void* data = mmap(nullptr, m_iSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_iFile, 0);
+
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_pData = data;
+	madvise(m_pData, m_iSize, MADV_WILLNEED);
+#endif
+
+	return m_pData != nullptr;
+}
+
+bool FieldFile::Validate() const
+{
+	Header const& header = GetHeader();
+
+	if (std::memcmp(header.magic, fieldFileMagic, sizeof(header.magic)) != 0 ||
+		header.version != version ||
+		header.componentType != (uint32_t)ComponentType::INT32 ||
+		header.stride < header.height)
+	{
+		return false;
+	}
+
+	uint64_t planesSize = planesNum * (uint64_t)header.stride * header.width * sizeof(int32_t);
+
+	if (header.planesOffset % sizeof(int32_t) != 0 || header.planesOffset + planesSize > m_iSize)
+	{
+		return false;
+	}
+
+	if (header.flags & (HAS_TEXELS | HAS_TRANSFORM_TEXELS))
+	{
+		if (header.texelsFormat > (uint32_t)FieldEncoding::Format::SNORM8 || (header.flags & HAS_TEXELS) == 0)
+		{
+			return false;
+		}
+
+		FieldEncoding::Format format = (FieldEncoding::Format)header.texelsFormat;
+		uint64_t texelsSize = (uint64_t)FieldEncoding::TexelSize(format) * header.width * header.height;
+
+		// Components are read in place, offsets keep them aligned
+		if (header.texelsOffset % sizeof(float) != 0 || header.texelsOffset + texelsSize > m_iSize)
+		{
+			return false;
+		}
+
+		if ((header.flags & HAS_TRANSFORM_TEXELS) &&
+			(header.transformTexelsOffset % sizeof(float) != 0 || header.transformTexelsOffset + texelsSize > m_iSize))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
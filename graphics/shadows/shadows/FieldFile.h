@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "FieldEncoding.h"
+
+class VectorField;
+
+// Binary vector field container (*.vfb), little-endian:
+//   Header
+//   4 int32 planes at planesOffset: dx, dy, transform dx, transform dy,
+//     each `width` columns of `stride` elements, (x, y) at x * stride + y (FieldStorage layout)
+//   optional texels at texelsOffset: the displacement as FieldEncoding::Encode writes it in texelsFormat,
+//     the transform follows at transformTexelsOffset unless it is zero
+// The file is mapped copy-on-write, so planes can be used in place and even modified,
+// the texels go to the GPU straight from the mapping.
+class FieldFile
+{
+public:
+	static uint32_t constexpr version = 3;
+	static size_t constexpr planesNum = 4;
+	static size_t constexpr payloadAlignment = 64;
+
+	enum class ComponentType : uint32_t
+	{
+		INT32 = 0
+	};
+
+	enum Flags : uint32_t
+	{
+		HAS_TEXELS = 1u << 0,
+		HAS_TRANSFORM_TEXELS = 1u << 1
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride;
+		uint32_t componentType;
+		uint32_t flags;
+		uint32_t texelsFormat; // FieldEncoding::Format
+		uint64_t planesOffset;
+		uint64_t texelsOffset;
+		uint64_t transformTexelsOffset;
+	};
+
+public:
+	static std::shared_ptr<FieldFile> Open(std::string const& filename);
+
+	// Texels are left out when the field doesn't fit `format`
+	static bool Write(std::string const& filename, VectorField const& field, bool withTexels = true,
+		FieldEncoding::Format format = FieldEncoding::Format::SNORM16);
+	static bool Convert(std::string const& fldFilename, std::string const& filename, bool withTexels = true,
+		FieldEncoding::Format format = FieldEncoding::Format::SNORM16);
+
+	~FieldFile();
+
+	FieldFile(FieldFile const&) = delete;
+	FieldFile& operator=(FieldFile const&) = delete;
+
+	Header const& GetHeader() const;
+
+	int32_t* Plane(size_t ind) const;
+	// Encoded texels, nullptr unless the file has them in `format`. A zero transform has none.
+	unsigned char const* Texels(FieldEncoding::Format format) const;
+	unsigned char const* TransformTexels(FieldEncoding::Format format) const;
+
+private:
+	FieldFile();
+
+	bool Map(std::string const& filename);
+	bool Validate() const;
+
+	void* m_pData;
+	size_t m_iSize;
+
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_iFile;
+#endif
+};
@@ -0,0 +1,542 @@
+#include "FieldKernels.h"
+
+#include <assert.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FIELD_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts any intrinsic, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define FIELD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define FIELD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FIELD_TARGET_SSE41
+#define FIELD_TARGET_AVX2
+#endif
+
+namespace
+{
+	std::atomic<int> forcedISA{ -1 };
+
+	// Below this many pixels the serial kernels win over waking the pool
+	size_t constexpr parallelMinPixels = 256 * 256;
+	size_t constexpr parallelGrain = 16;
+
+	// Rows converted per pass over the field columns, a cache line of every plane
+	size_t constexpr texelRowsBlock = 16;
+
+	inline float* TexelRow(float* texels, size_t rowPitch, size_t j)
+	{
+		return reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(texels) + j * rowPitch);
+	}
+
+	// Column i, rows [jBegin, jEnd) of FieldTexels
+	inline void FieldTexelsColumnScalar(FieldStorage::ConstColumnView column, FieldStorage::ConstColumnView transformColumn,
+		float* texels, size_t rowPitch, float x, float y, size_t i, size_t jBegin, size_t jEnd)
+	{
+		for (size_t j = jBegin; j < jEnd; ++j)
+		{
+			float* texel = TexelRow(texels, rowPitch, j) + 4 * i;
+
+			texel[0] = (float)column.dx[j] / x;
+			texel[1] = (float)column.dy[j] / y;
+			texel[2] = (float)transformColumn.dx[j] / x;
+			texel[3] = (float)transformColumn.dy[j] / y;
+		}
+	}
+
+	inline void CopyPixel(unsigned char* dst, unsigned char const* src, size_t channels)
+	{
+		switch (channels)
+		{
+		case 1:
+			dst[0] = src[0];
+			break;
+		case 2:
+			std::memcpy(dst, src, 2);
+			break;
+		default:
+			std::memcpy(dst, src, 3);
+			break;
+		}
+	}
+
+	// Tail of a column that does not fill a whole vector
+	inline void ApplyColumnScalar(int32_t const* dxCol, int32_t const* dyCol, unsigned char const* src, unsigned char* dst,
+		size_t x, size_t y, size_t n, size_t i, size_t jBegin)
+	{
+		size_t channels = n < 3 ? n : 3;
+
+		for (size_t j = jBegin; j < y; ++j)
+		{
+			size_t n_i = i + dxCol[j];
+			size_t n_j = j + dyCol[j];
+
+			if (n_i < x && n_j < y)
+			{
+				CopyPixel(dst + n * (n_j + n_i * x), src + n * (j + i * x), channels);
+			}
+		}
+	}
+}
+
+FieldKernels::ISA FieldKernels::DetectISA()
+{
+#ifdef FIELD_KERNELS_X86
+#ifdef _MSC_VER
+	int info[4] = {};
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse41 = __builtin_cpu_supports("sse4.1");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (avx2)
+	{
+		return ISA::AVX2;
+	}
+	if (sse41)
+	{
+		return ISA::SSE41;
+	}
+#endif
+
+	return ISA::SCALAR;
+}
+
+FieldKernels::ISA FieldKernels::ActiveISA()
+{
+	static ISA const detected = DetectISA();
+
+	int forced = forcedISA.load(std::memory_order_relaxed);
+
+	if (forced >= 0 && forced < (int)detected)
+	{
+		return (ISA)forced;
+	}
+
+	return detected;
+}
+
+void FieldKernels::ForceISA(ISA isa)
+{
+	forcedISA.store((int)isa, std::memory_order_relaxed);
+}
+
+char const* FieldKernels::ISAName(ISA isa)
+{
+	switch (isa)
+	{
+	case ISA::AVX2:
+		return "avx2";
+	case ISA::SSE41:
+		return "sse4.1";
+	default:
+		return "scalar";
+	}
+}
+
+void FieldKernels::ApplyField(FieldStorage const& field, unsigned char const* src, unsigned char* dst, size_t x, size_t y, size_t n)
+{
+	assert(field.Width() >= x && field.Height() >= y);
+
+	if (ThreadPool::Get().ThreadCount() > 1 && x == y && x * y >= parallelMinPixels && x * y < UINT32_MAX)
+	{
+		ApplyFieldParallel(field, src, dst, x, y, n);
+		return;
+	}
+
+	switch (ActiveISA())
+	{
+	case ISA::AVX2:
+		ApplyFieldAVX2(field, src, dst, x, y, n, 0, x);
+		break;
+	case ISA::SSE41:
+		ApplyFieldSSE41(field, src, dst, x, y, n, 0, x);
+		break;
+	default:
+		ApplyFieldScalar(field, src, dst, x, y, n, 0, x);
+		break;
+	}
+}
+
+void FieldKernels::ApplyFieldParallel(FieldStorage const& field, unsigned char const* src, unsigned char* dst, size_t x, size_t y, size_t n)
+{
+	size_t channels = n < 3 ? n : 3;
+	size_t pixelsNum = x * y;
+	assert(pixelsNum < UINT32_MAX);
+
+	ThreadPool& pool = ThreadPool::Get();
+
+	// Per target (n_i, n_j) at n_i * y + n_j: 0 - untouched, otherwise 1 + (i * y + j) of the last pixel landing on it
+	std::unique_ptr<std::atomic<uint32_t>[]> winners(new std::atomic<uint32_t>[pixelsNum]);
+
+	pool.ParallelFor(0, pixelsNum, parallelGrain * y, [&](size_t begin, size_t end)
+		{
+			for (size_t t = begin; t < end; ++t)
+			{
+				winners[t].store(0, std::memory_order_relaxed);
+			}
+		});
+
+	pool.ParallelFor(0, x, parallelGrain, [&](size_t iBegin, size_t iEnd)
+		{
+			for (size_t i = iBegin; i < iEnd; ++i)
+			{
+				FieldStorage::ConstColumnView column = field.Column(i);
+
+				for (size_t j = 0; j < y; ++j)
+				{
+					size_t n_i = i + column.dx[j];
+					size_t n_j = j + column.dy[j];
+
+					if (n_i < x && n_j < y)
+					{
+						std::atomic<uint32_t>& winner = winners[n_i * y + n_j];
+						uint32_t key = (uint32_t)(i * y + j + 1);
+						uint32_t current = winner.load(std::memory_order_relaxed);
+
+						while (current < key && !winner.compare_exchange_weak(current, key, std::memory_order_relaxed)) {}
+					}
+				}
+			}
+		});
+
+	pool.ParallelFor(0, pixelsNum, parallelGrain * y, [&](size_t begin, size_t end)
+		{
+			for (size_t t = begin; t < end; ++t)
+			{
+				uint32_t key = winners[t].load(std::memory_order_relaxed);
+
+				if (key != 0)
+				{
+					size_t n_i = t / y;
+					size_t n_j = t % y;
+					size_t i = (key - 1) / y;
+					size_t j = (key - 1) % y;
+
+					CopyPixel(dst + n * (n_j + n_i * x), src + n * (j + i * x), channels);
+				}
+			}
+		});
+}
+
+void FieldKernels::ApplyFieldScalar(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+	size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd)
+{
+	for (size_t i = iBegin; i < iEnd; ++i)
+	{
+		FieldStorage::ConstColumnView column = field.Column(i);
+
+		ApplyColumnScalar(column.dx, column.dy, src, dst, x, y, n, i, 0);
+	}
+}
+
+void FieldKernels::FieldTexels(FieldStorage const& field, FieldStorage const& transform, float* texels, size_t rowPitch,
+	size_t jBegin, size_t jEnd)
+{
+	assert(field.Width() == transform.Width() && field.Height() == transform.Height() && jEnd <= field.Height());
+	assert(rowPitch >= 4 * sizeof(float) * field.Width());
+
+	switch (ActiveISA())
+	{
+	case ISA::AVX2:
+	case ISA::SSE41:
+		FieldTexelsSSE41(field, transform, texels, rowPitch, jBegin, jEnd);
+		break;
+	default:
+		FieldTexelsScalar(field, transform, texels, rowPitch, jBegin, jEnd);
+		break;
+	}
+}
+
+void FieldKernels::FieldTexelsScalar(FieldStorage const& field, FieldStorage const& transform, float* texels, size_t rowPitch,
+	size_t jBegin, size_t jEnd)
+{
+	float x = (float)field.Width();
+	float y = (float)field.Height();
+
+	for (size_t jBlock = jBegin; jBlock < jEnd; jBlock += texelRowsBlock)
+	{
+		size_t jBlockEnd = jBlock + texelRowsBlock < jEnd ? jBlock + texelRowsBlock : jEnd;
+
+		for (size_t i = 0; i < field.Width(); ++i)
+		{
+			FieldTexelsColumnScalar(field.Column(i), transform.Column(i), texels, rowPitch, x, y, i, jBlock, jBlockEnd);
+		}
+	}
+}
+
+#ifdef FIELD_KERNELS_X86
+
+FIELD_TARGET_SSE41 void FieldKernels::FieldTexelsSSE41(FieldStorage const& field, FieldStorage const& transform, float* texels,
+	size_t rowPitch, size_t jBegin, size_t jEnd)
+{
+	float x = (float)field.Width();
+	float y = (float)field.Height();
+
+	// Division rather than a reciprocal keeps the result bit-exact with the scalar path
+	__m128 const xs = _mm_set1_ps(x);
+	__m128 const ys = _mm_set1_ps(y);
+
+	for (size_t jBlock = jBegin; jBlock < jEnd; jBlock += texelRowsBlock)
+	{
+		size_t jBlockEnd = jBlock + texelRowsBlock < jEnd ? jBlock + texelRowsBlock : jEnd;
+
+		for (size_t i = 0; i < field.Width(); ++i)
+		{
+			FieldStorage::ConstColumnView column = field.Column(i);
+			FieldStorage::ConstColumnView transformColumn = transform.Column(i);
+
+			size_t j = jBlock;
+			for (; j + 4 <= jBlockEnd; j += 4)
+			{
+				__m128 dx = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i const*)(column.dx + j))), xs);
+				__m128 dy = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i const*)(column.dy + j))), ys);
+				__m128 tdx = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i const*)(transformColumn.dx + j))), xs);
+				__m128 tdy = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i const*)(transformColumn.dy + j))), ys);
+
+				// Planes x rows into one texel per row
+				_MM_TRANSPOSE4_PS(dx, dy, tdx, tdy);
+
+				_mm_storeu_ps(TexelRow(texels, rowPitch, j + 0) + 4 * i, dx);
+				_mm_storeu_ps(TexelRow(texels, rowPitch, j + 1) + 4 * i, dy);
+				_mm_storeu_ps(TexelRow(texels, rowPitch, j + 2) + 4 * i, tdx);
+				_mm_storeu_ps(TexelRow(texels, rowPitch, j + 3) + 4 * i, tdy);
+			}
+
+			FieldTexelsColumnScalar(column, transformColumn, texels, rowPitch, x, y, i, j, jBlockEnd);
+		}
+	}
+}
+
+FIELD_TARGET_SSE41 void FieldKernels::ApplyFieldSSE41(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+	size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd)
+{
+	size_t channels = n < 3 ? n : 3;
+
+	__m128i const lane = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i const xs = _mm_set1_epi32((int)x);
+	__m128i const ys = _mm_set1_epi32((int)y);
+	__m128i const minusOne = _mm_set1_epi32(-1);
+	__m128i const rgbMask = _mm_set1_epi32(0x00FFFFFF);
+	__m128i const alphaMask = _mm_set1_epi32((int)0xFF000000);
+
+	for (size_t i = iBegin; i < iEnd; ++i)
+	{
+		FieldStorage::ConstColumnView column = field.Column(i);
+		int32_t const* dxCol = column.dx;
+		int32_t const* dyCol = column.dy;
+		unsigned char const* srcCol = src + n * i * x;
+
+		__m128i const is = _mm_set1_epi32((int)i);
+
+		size_t j = 0;
+		for (; j + 4 <= y; j += 4)
+		{
+			__m128i dx = _mm_loadu_si128((__m128i const*)(dxCol + j));
+			__m128i dy = _mm_loadu_si128((__m128i const*)(dyCol + j));
+
+			__m128i ni = _mm_add_epi32(is, dx);
+			__m128i nj = _mm_add_epi32(_mm_add_epi32(_mm_set1_epi32((int)j), lane), dy);
+
+			__m128i valid = _mm_and_si128(
+				_mm_and_si128(_mm_cmpgt_epi32(ni, minusOne), _mm_cmpgt_epi32(xs, ni)),
+				_mm_and_si128(_mm_cmpgt_epi32(nj, minusOne), _mm_cmpgt_epi32(ys, nj)));
+
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(valid));
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			unsigned char const* srcPix = srcCol + n * j;
+
+			// One displacement for all lanes lands them on consecutive texels, the common case of
+			// piecewise constant fields: distinct addresses, so one store is the same as four in order
+			__m128i uniform = _mm_and_si128(
+				_mm_cmpeq_epi32(dx, _mm_shuffle_epi32(dx, 0)), _mm_cmpeq_epi32(dy, _mm_shuffle_epi32(dy, 0)));
+
+			if (mask == 0xF && _mm_movemask_epi8(uniform) == 0xFFFF && n <= 4)
+			{
+				size_t first = (size_t)_mm_cvtsi128_si32(_mm_add_epi32(nj, _mm_mullo_epi32(ni, xs)));
+
+				if (n == 4)
+				{
+					__m128i rgb = _mm_and_si128(_mm_loadu_si128((__m128i const*)srcPix), rgbMask);
+					__m128i alpha = _mm_and_si128(_mm_loadu_si128((__m128i const*)(src + 4 * first)), alphaMask);
+					_mm_storeu_si128((__m128i*)(dst + 4 * first), _mm_or_si128(rgb, alpha));
+				}
+				else
+				{
+					std::memcpy(dst + n * first, srcPix, 4 * n);
+				}
+				continue;
+			}
+
+			alignas(16) int32_t dstInd[4];
+			_mm_store_si128((__m128i*)dstInd, _mm_add_epi32(nj, _mm_mullo_epi32(ni, xs)));
+
+			// Lane order keeps the scalar "last writer wins" result
+			for (int k = 0; k < 4; ++k)
+			{
+				if (mask & (1 << k))
+				{
+					CopyPixel(dst + n * (size_t)dstInd[k], srcPix + n * k, channels);
+				}
+			}
+		}
+
+		ApplyColumnScalar(dxCol, dyCol, src, dst, x, y, n, i, j);
+	}
+}
+
+FIELD_TARGET_AVX2 void FieldKernels::ApplyFieldAVX2(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+	size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd)
+{
+	size_t channels = n < 3 ? n : 3;
+
+	__m256i const lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i const xs = _mm256_set1_epi32((int)x);
+	__m256i const ys = _mm256_set1_epi32((int)y);
+	__m256i const minusOne = _mm256_set1_epi32(-1);
+	__m256i const rgbMask = _mm256_set1_epi32(0x00FFFFFF);
+	__m256i const alphaMask = _mm256_set1_epi32((int)0xFF000000);
+
+	for (size_t i = iBegin; i < iEnd; ++i)
+	{
+		FieldStorage::ConstColumnView column = field.Column(i);
+		int32_t const* dxCol = column.dx;
+		int32_t const* dyCol = column.dy;
+		unsigned char const* srcCol = src + n * i * x;
+
+		__m256i const is = _mm256_set1_epi32((int)i);
+
+		size_t j = 0;
+		for (; j + 8 <= y; j += 8)
+		{
+			__m256i dx = _mm256_loadu_si256((__m256i const*)(dxCol + j));
+			__m256i dy = _mm256_loadu_si256((__m256i const*)(dyCol + j));
+
+			__m256i ni = _mm256_add_epi32(is, dx);
+			__m256i nj = _mm256_add_epi32(_mm256_add_epi32(_mm256_set1_epi32((int)j), lane), dy);
+
+			__m256i valid = _mm256_and_si256(
+				_mm256_and_si256(_mm256_cmpgt_epi32(ni, minusOne), _mm256_cmpgt_epi32(xs, ni)),
+				_mm256_and_si256(_mm256_cmpgt_epi32(nj, minusOne), _mm256_cmpgt_epi32(ys, nj)));
+
+			int mask = _mm256_movemask_ps(_mm256_castsi256_ps(valid));
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			__m256i dstPix = _mm256_add_epi32(nj, _mm256_mullo_epi32(ni, xs));
+			unsigned char const* srcPix = srcCol + n * j;
+
+			// Same consecutive texels case as the SSE4.1 path, one store per vector
+			__m256i uniform = _mm256_and_si256(
+				_mm256_cmpeq_epi32(dx, _mm256_broadcastd_epi32(_mm256_castsi256_si128(dx))),
+				_mm256_cmpeq_epi32(dy, _mm256_broadcastd_epi32(_mm256_castsi256_si128(dy))));
+
+			if (mask == 0xFF && _mm256_movemask_epi8(uniform) == -1 && n <= 4)
+			{
+				size_t first = (size_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(dstPix));
+
+				if (n == 4)
+				{
+					__m256i rgb = _mm256_and_si256(_mm256_loadu_si256((__m256i const*)srcPix), rgbMask);
+					__m256i alpha = _mm256_and_si256(_mm256_loadu_si256((__m256i const*)(src + 4 * first)), alphaMask);
+					_mm256_storeu_si256((__m256i*)(dst + 4 * first), _mm256_or_si256(rgb, alpha));
+				}
+				else
+				{
+					std::memcpy(dst + n * first, srcPix, 8 * n);
+				}
+				continue;
+			}
+
+			alignas(32) int32_t dstInd[8];
+			_mm256_store_si256((__m256i*)dstInd, dstPix);
+
+			if (n == 4)
+			{
+				// Alpha is never moved, so the destination keeps the source alpha at that texel:
+				// merge it in registers and store whole pixels
+				__m256i rgb = _mm256_and_si256(_mm256_loadu_si256((__m256i const*)srcPix), rgbMask);
+				__m256i alpha = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (int const*)src, dstPix, valid, 4);
+				__m256i pixels = _mm256_or_si256(rgb, _mm256_and_si256(alpha, alphaMask));
+
+				alignas(32) uint32_t values[8];
+				_mm256_store_si256((__m256i*)values, pixels);
+
+				for (int k = 0; k < 8; ++k)
+				{
+					if (mask & (1 << k))
+					{
+						std::memcpy(dst + 4 * (size_t)dstInd[k], values + k, 4);
+					}
+				}
+			}
+			else
+			{
+				for (int k = 0; k < 8; ++k)
+				{
+					if (mask & (1 << k))
+					{
+						CopyPixel(dst + n * (size_t)dstInd[k], srcPix + n * k, channels);
+					}
+				}
+			}
+		}
+
+		ApplyColumnScalar(dxCol, dyCol, src, dst, x, y, n, i, j);
+	}
+}
+
+#else
+
+void FieldKernels::FieldTexelsSSE41(FieldStorage const& field, FieldStorage const& transform, float* texels, size_t rowPitch,
+	size_t jBegin, size_t jEnd)
+{
+	FieldTexelsScalar(field, transform, texels, rowPitch, jBegin, jEnd);
+}
+
+void FieldKernels::ApplyFieldSSE41(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+	size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd)
+{
+	ApplyFieldScalar(field, src, dst, x, y, n, iBegin, iEnd);
+}
+
+void FieldKernels::ApplyFieldAVX2(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+	size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd)
+{
+	ApplyFieldScalar(field, src, dst, x, y, n, iBegin, iEnd);
+}
+
+#endif
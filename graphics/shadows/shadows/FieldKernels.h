@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+#include "FieldStorage.h"
+
+// CPU kernels for vector field passes with runtime instruction set dispatch.
+// Every SIMD path is bit-exact with the scalar one.
+class FieldKernels
+{
+public:
+	enum class ISA
+	{
+		SCALAR = 0,
+		SSE41 = 1,
+		AVX2 = 2
+	};
+
+	// Best instruction set supported by the CPU and the build
+	static ISA DetectISA();
+
+	// Instruction set used by dispatched kernels, DetectISA() unless forced
+	static ISA ActiveISA();
+	static void ForceISA(ISA isa);
+	static char const* ISAName(ISA isa);
+
+	// Moves every pixel (i, j) of `src` to (i + dx, j + dy), pixels moved outside the image are dropped.
+	// `dst` must hold a copy of `src`, only the first min(n, 3) channels are moved and
+	// when several pixels land on the same texel the last one in (i, j) order wins.
+	// The image is x * y pixels of n bytes, pixel (i, j) at n * (j + i * x).
+	static void ApplyField(FieldStorage const& field, unsigned char const* src, unsigned char* dst, size_t x, size_t y, size_t n);
+
+	// Same result as ApplyField for square images, split over ThreadPool workers: pixels are ranked
+	// by their (i, j) order per target (n_i, n_j) first, then every target copies its winner.
+	// When x != y different targets share a texel of the j + i * x layout, so ApplyField keeps those serial
+	static void ApplyFieldParallel(FieldStorage const& field, unsigned char const* src, unsigned char* dst, size_t x, size_t y, size_t n);
+
+	static void ApplyFieldScalar(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+		size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd);
+	static void ApplyFieldSSE41(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+		size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd);
+	static void ApplyFieldAVX2(FieldStorage const& field, unsigned char const* src, unsigned char* dst,
+		size_t x, size_t y, size_t n, size_t iBegin, size_t iEnd);
+
+	// float4 texels (dx / x, dy / y, transform dx / x, transform dy / y) of the x * y fields, rows [jBegin, jEnd).
+	// Texel (i, j) at i floats after row j, which starts j * rowPitch bytes into `texels`.
+	// Field columns are read in blocks of rows so every row is written front to back.
+	static void FieldTexels(FieldStorage const& field, FieldStorage const& transform, float* texels, size_t rowPitch,
+		size_t jBegin, size_t jEnd);
+
+	static void FieldTexelsScalar(FieldStorage const& field, FieldStorage const& transform, float* texels, size_t rowPitch,
+		size_t jBegin, size_t jEnd);
+	static void FieldTexelsSSE41(FieldStorage const& field, FieldStorage const& transform, float* texels, size_t rowPitch,
+		size_t jBegin, size_t jEnd);
+};
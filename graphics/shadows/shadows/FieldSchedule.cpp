@@ -0,0 +1,169 @@
+#include "FieldSchedule.h"
+
+#include <algorithm>
+#include <assert.h>
+
+FieldSchedule::FieldSchedule()
+	: m_iFieldsNum{ 0 }, m_ePlayback{ Playback::LOOP }, m_iStep{ 0 },
+	m_iSegment{ 0 }, m_iCurStepsNum{ 0 }, m_iCurStepsCounter{ 0 } {}
+
+void FieldSchedule::SetUpStepPerFiled(std::vector<size_t> const& stepsPerField)
+{
+	m_aStepsPerField = stepsPerField;
+	m_iStep = 0;
+
+	Rebuild();
+}
+
+void FieldSchedule::SetFieldsNum(size_t fieldsNum)
+{
+	m_iFieldsNum = fieldsNum;
+
+	Rebuild();
+}
+
+void FieldSchedule::SetPlayback(Playback playback)
+{
+	m_ePlayback = playback;
+
+	Rebuild();
+}
+
+FieldSchedule::Playback FieldSchedule::GetPlayback() const
+{
+	return m_ePlayback;
+}
+
+size_t FieldSchedule::CurrentStepsNum() const
+{
+	return m_iCurStepsNum;
+}
+
+size_t FieldSchedule::StepsPerFieldByIndex(size_t ind) const
+{
+	assert(ind < m_aStepsPerField.size());
+
+	return m_aStepsPerField[ind];
+}
+
+size_t FieldSchedule::CurrentStep() const
+{
+	return m_iStep;
+}
+
+size_t FieldSchedule::CurrentStepInField() const
+{
+	return m_iCurStepsCounter;
+}
+
+size_t FieldSchedule::StepsLeftInField() const
+{
+	if (m_aSegmentEnds.empty() || m_aSegmentEnds.back() == 0)
+	{
+		return SIZE_MAX;
+	}
+
+	return StepsOfField(m_iCurStepsNum) - m_iCurStepsCounter;
+}
+
+size_t FieldSchedule::CurrentSegment() const
+{
+	return m_iSegment;
+}
+
+std::vector<size_t> const& FieldSchedule::Order() const
+{
+	return m_aOrder;
+}
+
+size_t FieldSchedule::IncStep(size_t inc)
+{
+	size_t segment = m_iSegment;
+
+	Seek(m_iStep + inc);
+
+	return m_iSegment - segment;
+}
+
+void FieldSchedule::Seek(size_t step)
+{
+	m_iStep = step;
+
+	Locate();
+}
+
+void FieldSchedule::NextField()
+{
+	size_t period = m_aSegmentEnds.empty() ? 0 : m_aSegmentEnds.back();
+
+	if (period == 0)
+	{
+		return;
+	}
+
+	// The next segment starts where the current one ends
+	size_t segment = m_iSegment % m_aOrder.size();
+
+	Seek(m_iStep - m_iCurStepsCounter + StepsOfField(m_aOrder[segment]));
+}
+
+size_t FieldSchedule::StepsOfField(size_t ind) const
+{
+	// Fields without a step count yet are skipped
+	return ind < m_aStepsPerField.size() ? m_aStepsPerField[ind] : 0;
+}
+
+void FieldSchedule::Rebuild()
+{
+	m_aOrder.clear();
+
+	for (size_t i = 0; i < m_iFieldsNum; ++i)
+	{
+		m_aOrder.push_back(i);
+	}
+
+	if (m_ePlayback == Playback::PING_PONG)
+	{
+		// The ends aren't repeated on the turn
+		for (size_t i = m_iFieldsNum > 1 ? m_iFieldsNum - 2 : 0; i > 0; --i)
+		{
+			m_aOrder.push_back(i);
+		}
+	}
+
+	m_aSegmentEnds.resize(m_aOrder.size());
+
+	size_t end = 0;
+	for (size_t i = 0; i < m_aOrder.size(); ++i)
+	{
+		end += StepsOfField(m_aOrder[i]);
+		m_aSegmentEnds[i] = end;
+	}
+
+	Locate();
+}
+
+void FieldSchedule::Locate()
+{
+	size_t period = m_aSegmentEnds.empty() ? 0 : m_aSegmentEnds.back();
+
+	if (period == 0)
+	{
+		// Nothing to play, the first field stays
+		m_iSegment = 0;
+		m_iCurStepsNum = 0;
+		m_iCurStepsCounter = 0;
+		return;
+	}
+
+	size_t periods = m_iStep / period;
+	size_t stepInPeriod = m_iStep % period;
+
+	// First segment that ends after the step, zero step segments are never current
+	size_t segment = std::upper_bound(m_aSegmentEnds.begin(), m_aSegmentEnds.end(), stepInPeriod) - m_aSegmentEnds.begin();
+	size_t segmentStart = m_aSegmentEnds[segment] - StepsOfField(m_aOrder[segment]);
+
+	m_iSegment = periods * m_aOrder.size() + segment;
+	m_iCurStepsNum = m_aOrder[segment];
+	m_iCurStepsCounter = stepInPeriod - segmentStart;
+}
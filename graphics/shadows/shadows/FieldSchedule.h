@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Step counting of FieldSwapper without the D3D resources: field k is shown
+// for stepsPerField[k] steps, then the next one follows.
+// The schedule is a timeline over the absolute step count. Segments are the fields in
+// playback order, a prefix sum over one period of them maps any step to its segment
+// in logarithmic time, so neither big increments nor seeks iterate over steps.
+class FieldSchedule
+{
+public:
+	enum class Playback
+	{
+		LOOP = 0, // 0, 1, ..., n - 1, 0, 1, ...
+		PING_PONG = 1 // 0, 1, ..., n - 1, n - 2, ..., 1, 0, 1, ...
+	};
+
+private:
+	std::vector<size_t> m_aStepsPerField;
+	size_t m_iFieldsNum;
+	Playback m_ePlayback;
+
+	// One period: field of every segment and the step its segment ends at
+	std::vector<size_t> m_aOrder;
+	std::vector<size_t> m_aSegmentEnds;
+
+	size_t m_iStep;
+
+	// Derived from m_iStep
+	size_t m_iSegment;
+	size_t m_iCurStepsNum;
+	size_t m_iCurStepsCounter;
+
+public:
+	FieldSchedule();
+
+	// Restarts from step 0
+	void SetUpStepPerFiled(std::vector<size_t> const& stepsPerField);
+	void SetFieldsNum(size_t fieldsNum);
+	void SetPlayback(Playback playback);
+	Playback GetPlayback() const;
+
+	// Current field
+	size_t CurrentStepsNum() const;
+	size_t StepsPerFieldByIndex(size_t ind) const;
+
+	// Steps since the start, the step within the current field and the segment counter
+	size_t CurrentStep() const;
+	size_t CurrentStepInField() const;
+	// Steps until the next segment starts, SIZE_MAX when nothing plays and the field never changes
+	size_t StepsLeftInField() const;
+	size_t CurrentSegment() const;
+
+	// Fields of one period of segments, segment k shows Order()[k % Order().size()]
+	std::vector<size_t> const& Order() const;
+
+	// Returns how many times the field changed
+	size_t IncStep(size_t inc = 1);
+	void Seek(size_t step);
+	// Seeks to the first step of the next segment
+	void NextField();
+
+private:
+	size_t StepsOfField(size_t ind) const;
+
+	void Rebuild();
+	void Locate();
+};
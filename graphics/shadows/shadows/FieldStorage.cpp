@@ -0,0 +1,181 @@
+#include "FieldStorage.h"
+
+#include <algorithm>
+#include <assert.h>
+
+FieldStorage::ColumnView FieldStorage::TileView::Column(size_t x) const
+{
+	assert(x < width);
+
+	return { dx + x * stride, dy + x * stride, height };
+}
+
+FieldStorage::FieldStorage() : m_iWidth{ 0 }, m_iHeight{ 0 }, m_iStride{ 0 }, m_pDX{ nullptr }, m_pDY{ nullptr } {}
+
+FieldStorage::FieldStorage(size_t width, size_t height) : FieldStorage()
+{
+	Resize(width, height);
+}
+
+FieldStorage::FieldStorage(FieldStorage const& other) : FieldStorage()
+{
+	*this = other;
+}
+
+FieldStorage::FieldStorage(FieldStorage&& other) noexcept : FieldStorage()
+{
+	*this = std::move(other);
+}
+
+FieldStorage& FieldStorage::operator=(FieldStorage const& other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+
+	m_iWidth = other.m_iWidth;
+	m_iHeight = other.m_iHeight;
+	m_iStride = other.m_iStride;
+
+	m_aDX.assign(other.m_pDX, other.m_pDX + m_iStride * m_iWidth);
+	m_aDY.assign(other.m_pDY, other.m_pDY + m_iStride * m_iWidth);
+
+	m_pDX = m_aDX.data();
+	m_pDY = m_aDY.data();
+
+	return *this;
+}
+
+FieldStorage& FieldStorage::operator=(FieldStorage&& other) noexcept
+{
+	m_iWidth = other.m_iWidth;
+	m_iHeight = other.m_iHeight;
+	m_iStride = other.m_iStride;
+
+	m_aDX = std::move(other.m_aDX);
+	m_aDY = std::move(other.m_aDY);
+
+	m_pDX = other.m_pDX;
+	m_pDY = other.m_pDY;
+
+	other.m_iWidth = other.m_iHeight = other.m_iStride = 0;
+	other.m_pDX = other.m_pDY = nullptr;
+
+	return *this;
+}
+
+FieldStorage FieldStorage::View(value_t* dx, value_t* dy, size_t width, size_t height, size_t stride)
+{
+	assert(dx != nullptr && dy != nullptr && stride >= height);
+
+	FieldStorage storage;
+
+	storage.m_iWidth = width;
+	storage.m_iHeight = height;
+	storage.m_iStride = stride;
+	storage.m_pDX = dx;
+	storage.m_pDY = dy;
+
+	return storage;
+}
+
+size_t FieldStorage::AlignedStride(size_t height)
+{
+	return (height + columnAlignment - 1) / columnAlignment * columnAlignment;
+}
+
+void FieldStorage::Resize(size_t width, size_t height)
+{
+	m_iWidth = width;
+	m_iHeight = height;
+	m_iStride = AlignedStride(height);
+
+	m_aDX.assign(m_iStride * m_iWidth, 0);
+	m_aDY.assign(m_iStride * m_iWidth, 0);
+
+	m_pDX = m_aDX.data();
+	m_pDY = m_aDY.data();
+}
+
+size_t FieldStorage::Width() const
+{
+	return m_iWidth;
+}
+
+size_t FieldStorage::Height() const
+{
+	return m_iHeight;
+}
+
+size_t FieldStorage::Stride() const
+{
+	return m_iStride;
+}
+
+FieldStorage::value_t* FieldStorage::DX()
+{
+	return m_pDX;
+}
+
+FieldStorage::value_t* FieldStorage::DY()
+{
+	return m_pDY;
+}
+
+FieldStorage::value_t const* FieldStorage::DX() const
+{
+	return m_pDX;
+}
+
+FieldStorage::value_t const* FieldStorage::DY() const
+{
+	return m_pDY;
+}
+
+std::pair<int, int> FieldStorage::Get(size_t x, size_t y) const
+{
+	size_t ind = x * m_iStride + y;
+
+	return { m_pDX[ind], m_pDY[ind] };
+}
+
+void FieldStorage::Set(size_t x, size_t y, int dx, int dy)
+{
+	size_t ind = x * m_iStride + y;
+
+	m_pDX[ind] = dx;
+	m_pDY[ind] = dy;
+}
+
+void FieldStorage::Fill(int dx, int dy)
+{
+	std::fill(m_pDX, m_pDX + m_iStride * m_iWidth, dx);
+	std::fill(m_pDY, m_pDY + m_iStride * m_iWidth, dy);
+}
+
+FieldStorage::ColumnView FieldStorage::Column(size_t x)
+{
+	assert(x < m_iWidth);
+
+	return { m_pDX + x * m_iStride, m_pDY + x * m_iStride, m_iHeight };
+}
+
+FieldStorage::ConstColumnView FieldStorage::Column(size_t x) const
+{
+	assert(x < m_iWidth);
+
+	return { m_pDX + x * m_iStride, m_pDY + x * m_iStride, m_iHeight };
+}
+
+FieldStorage::TileView FieldStorage::Tile(size_t x0, size_t y0, size_t width, size_t height)
+{
+	x0 = std::min(x0, m_iWidth);
+	y0 = std::min(y0, m_iHeight);
+	width = std::min(width, m_iWidth - x0);
+	height = std::min(height, m_iHeight - y0);
+
+	size_t offset = x0 * m_iStride + y0;
+
+	return { m_pDX + offset, m_pDY + offset, x0, y0, width, height, m_iStride };
+}
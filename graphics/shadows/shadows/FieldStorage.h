@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Contiguous storage for a 2D displacement field.
+// Components are kept as two int32 planes (structure of arrays), x-major as the
+// field[x][y] indexing: column x holds `height` elements, element (x, y) lives at
+// x * stride + y with the stride padded to columnAlignment elements.
+// Images are row-major, so a column of the field runs across the rows of an image.
+// Storage either owns its planes or views external memory (e.g. a mapped field file),
+// copies are always owning.
+class FieldStorage
+{
+public:
+	using value_t = int32_t;
+
+	static size_t constexpr columnAlignment = 8;
+
+	// Column x: elements (x, 0) ... (x, length - 1)
+	struct ColumnView
+	{
+		value_t* dx;
+		value_t* dy;
+		size_t length;
+	};
+
+	struct ConstColumnView
+	{
+		value_t const* dx;
+		value_t const* dy;
+		size_t length;
+	};
+
+	struct TileView
+	{
+		value_t* dx;
+		value_t* dy;
+		size_t x0, y0;
+		size_t width, height;
+		size_t stride;
+
+		// Column x0 + x clipped to the tile, `height` elements from y0
+		ColumnView Column(size_t x) const;
+	};
+
+public:
+	FieldStorage();
+	FieldStorage(size_t width, size_t height);
+	FieldStorage(FieldStorage const& other);
+	FieldStorage(FieldStorage&& other) noexcept;
+
+	FieldStorage& operator=(FieldStorage const& other);
+	FieldStorage& operator=(FieldStorage&& other) noexcept;
+
+	static FieldStorage View(value_t* dx, value_t* dy, size_t width, size_t height, size_t stride);
+	static size_t AlignedStride(size_t height);
+
+	void Resize(size_t width, size_t height);
+
+	size_t Width() const;
+	size_t Height() const;
+	size_t Stride() const;
+
+	value_t* DX();
+	value_t* DY();
+	value_t const* DX() const;
+	value_t const* DY() const;
+
+	value_t& DX(size_t x, size_t y) { return m_pDX[x * m_iStride + y]; }
+	value_t& DY(size_t x, size_t y) { return m_pDY[x * m_iStride + y]; }
+	value_t DX(size_t x, size_t y) const { return m_pDX[x * m_iStride + y]; }
+	value_t DY(size_t x, size_t y) const { return m_pDY[x * m_iStride + y]; }
+
+	std::pair<int, int> Get(size_t x, size_t y) const;
+	void Set(size_t x, size_t y, int dx, int dy);
+
+	void Fill(int dx, int dy);
+
+	ColumnView Column(size_t x);
+	ConstColumnView Column(size_t x) const;
+
+	// Clamped to the field bounds
+	TileView Tile(size_t x0, size_t y0, size_t width, size_t height);
+
+private:
+	size_t m_iWidth;
+	size_t m_iHeight;
+	size_t m_iStride;
+
+	value_t* m_pDX;
+	value_t* m_pDY;
+
+	std::vector<value_t> m_aDX;
+	std::vector<value_t> m_aDY;
+};
@@ -0,0 +1,223 @@
+#include "FieldStream.h"
+
+#include <assert.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#include "VectorField.h"
+
+FieldStream::FieldStream(std::vector<std::string> const& files, size_t width, size_t height, FieldEncoding::Format format, size_t window)
+	: m_aFiles{ files }, m_iWidth{ width }, m_iHeight{ height }, m_eFormat{ format }, m_iWindow{ window },
+	m_iFirst{ 0 }, m_iNext{ 0 }, m_iEpoch{ 0 }, m_bStop{ false }
+{
+	assert(!m_aFiles.empty() && m_iWindow > 0);
+
+	for (size_t i = 0; i < m_aFiles.size(); ++i)
+	{
+		m_aOrder.push_back(i);
+	}
+
+	m_loader = std::thread(&FieldStream::LoaderLoop, this);
+}
+
+FieldStream::~FieldStream()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_loadCondition.notify_all();
+
+	m_loader.join();
+}
+
+size_t FieldStream::FieldsNum() const
+{
+	return m_aFiles.size();
+}
+
+size_t FieldStream::Window() const
+{
+	return m_iWindow;
+}
+
+void FieldStream::SetOrder(std::vector<size_t> const& order)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		assert(!order.empty());
+
+		m_aOrder = order;
+
+		m_aReady.clear();
+		m_iNext = m_iFirst;
+		++m_iEpoch;
+	}
+	m_loadCondition.notify_all();
+}
+
+void FieldStream::Advance(size_t first)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (first < m_iFirst)
+		{
+			m_aReady.clear();
+			m_iNext = first;
+			++m_iEpoch;
+		}
+
+		m_iFirst = first;
+		m_iNext = m_iNext < first ? first : m_iNext;
+
+		DropBefore(first);
+	}
+	m_loadCondition.notify_all();
+}
+
+bool FieldStream::TryTake(size_t position, Prepared& prepared)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Positions are taken in order, anything before `position` is never asked for again
+	DropBefore(position);
+
+	if (m_aReady.empty() || m_aReady.front().position != position)
+	{
+		return false;
+	}
+
+	prepared = std::move(m_aReady.front());
+	m_aReady.pop_front();
+
+	return true;
+}
+
+double FieldStream::Take(size_t position, Prepared& prepared)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	assert(position >= m_iFirst && position < m_iFirst + m_iWindow);
+
+	auto ready = [&]()
+	{
+		DropBefore(position);
+
+		return !m_aReady.empty() && m_aReady.front().position == position;
+	};
+
+	double waited = 0.0;
+
+	if (!ready())
+	{
+		auto start = std::chrono::steady_clock::now();
+		m_readyCondition.wait(lock, ready);
+		waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	prepared = std::move(m_aReady.front());
+	m_aReady.pop_front();
+
+	return waited;
+}
+
+void FieldStream::LoaderLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_loadCondition.wait(lock, [this]()
+			{
+				return m_bStop || m_iNext < m_iFirst + m_iWindow;
+			});
+
+		if (m_bStop)
+		{
+			return;
+		}
+
+		Prepared prepared;
+		prepared.position = m_iNext++;
+
+		std::string const& file = m_aFiles[m_aOrder[prepared.position % m_aOrder.size()]];
+		size_t epoch = m_iEpoch;
+
+		lock.unlock();
+		Prepare(prepared, file);
+		lock.lock();
+
+		// The consumer may have moved past it or restarted while it was loading
+		if (epoch == m_iEpoch && prepared.position >= m_iFirst)
+		{
+			m_aReady.push_back(std::move(prepared));
+			m_readyCondition.notify_all();
+		}
+	}
+}
+
+void FieldStream::Prepare(Prepared& prepared, std::string const& file) const
+{
+	size_t texelSize = FieldEncoding::TexelSize(m_eFormat);
+
+	prepared.valid = false;
+	prepared.field.assign(texelSize * m_iWidth * m_iHeight, 0);
+	prepared.transform.clear();
+
+	std::unique_ptr<VectorField> field(VectorField::loadFromFile(file));
+
+	if (field == nullptr)
+	{
+		return;
+	}
+
+	FieldStorage const& storage = field->Storage();
+	FieldStorage const& transform = field->TransformStorage();
+
+	if (storage.Width() != m_iWidth || storage.Height() != m_iHeight)
+	{
+		return;
+	}
+
+	// A *.vfb already holds the texels in this format
+	if (unsigned char const* mapped = field->mapped_texels(m_eFormat))
+	{
+		std::memcpy(prepared.field.data(), mapped, prepared.field.size());
+
+		if (unsigned char const* mappedTransform = field->mapped_transform_texels(m_eFormat))
+		{
+			prepared.transform.assign(mappedTransform, mappedTransform + prepared.field.size());
+		}
+
+		prepared.valid = true;
+		return;
+	}
+
+	if (!FieldEncoding::InRange(storage, m_eFormat) || !FieldEncoding::InRange(transform, m_eFormat))
+	{
+		return;
+	}
+
+	// Serial: a ThreadPool region here would wait on m_regionMutex while the main thread,
+	// possibly in a JobGraph MAIN job, holds it and waits in Take for this very field
+	FieldEncoding::EncodeColumns(storage, m_eFormat, prepared.field.data(), 0, m_iWidth);
+
+	if (!FieldEncoding::IsZero(transform))
+	{
+		prepared.transform.resize(prepared.field.size());
+		FieldEncoding::EncodeColumns(transform, m_eFormat, prepared.transform.data(), 0, m_iWidth);
+	}
+
+	prepared.valid = true;
+}
+
+void FieldStream::DropBefore(size_t position)
+{
+	while (!m_aReady.empty() && m_aReady.front().position < position)
+	{
+		m_aReady.pop_front();
+	}
+}
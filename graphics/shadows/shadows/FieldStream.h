@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FieldEncoding.h"
+
+// Background preparation of a streamed field sequence. Sequence position k is
+// files[order[k % order.size()]], loaded and encoded on the loader thread in position order.
+// Only positions in [first, first + window) are prepared, so at most `window`
+// encoded fields exist at once however long the sequence is.
+class FieldStream
+{
+public:
+	struct Prepared
+	{
+		size_t position;
+		bool valid; // False when the file failed to load or doesn't fit, the texels are zeros then
+		std::vector<unsigned char> field;
+		std::vector<unsigned char> transform; // Empty when the field has no transform
+	};
+
+public:
+	FieldStream(std::vector<std::string> const& files, size_t width, size_t height, FieldEncoding::Format format, size_t window);
+	~FieldStream();
+
+	size_t FieldsNum() const;
+	size_t Window() const;
+
+	// Playback order of the files, 0, 1, ..., n - 1 by default. Prepared fields are dropped.
+	void SetOrder(std::vector<size_t> const& order);
+
+	// Positions below `first` are dropped, the loader skips ahead if it is behind.
+	// Moving back drops everything and restarts the loader from `first`.
+	void Advance(size_t first);
+
+	// Takes the prepared field at `position` if the loader already finished it
+	bool TryTake(size_t position, Prepared& prepared);
+	// Waits for the field at `position`, returns the seconds spent waiting
+	double Take(size_t position, Prepared& prepared);
+
+public:
+	FieldStream(FieldStream const&) = delete;
+	FieldStream& operator=(FieldStream const&) = delete;
+
+private:
+	void LoaderLoop();
+	void Prepare(Prepared& prepared, std::string const& file) const;
+
+	// The caller holds m_mutex
+	void DropBefore(size_t position);
+
+private:
+	std::vector<std::string> m_aFiles;
+	std::vector<size_t> m_aOrder;
+	size_t m_iWidth;
+	size_t m_iHeight;
+	FieldEncoding::Format m_eFormat;
+	size_t m_iWindow;
+
+	std::mutex m_mutex;
+	std::condition_variable m_loadCondition;
+	std::condition_variable m_readyCondition;
+
+	std::deque<Prepared> m_aReady; // In position order
+	size_t m_iFirst;
+	size_t m_iNext; // Next position the loader prepares
+	size_t m_iEpoch; // Bumped by every restart, fields prepared before one are stale
+	bool m_bStop;
+
+	std::thread m_loader;
+};
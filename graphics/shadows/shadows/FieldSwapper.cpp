@@ -2,47 +2,27 @@
 
 #include <assert.h>
 
-FieldSwapper::VectorFieldResources::VectorFieldResources(ID3D11Texture2D* vectorFieldTexture, ID3D11ShaderResourceView* vectorFieldTextureSRV) :
-	m_pVectorFieldTexture{ vectorFieldTexture }, m_pVectorFieldTextureSRV{ vectorFieldTextureSRV } {}
+FieldSwapper::FieldSwapper() : m_iCurFieldIndex{ 0 }, m_iPosition{ 0 }, m_iUploaded{ 0 }, m_streamStats{} {}
 
-FieldSwapper::VectorFieldResources::~VectorFieldResources()
-{
-	if (m_pVectorFieldTexture)
-	{
-		m_pVectorFieldTexture->Release();
-		m_pVectorFieldTexture = nullptr;
-	}
+FieldSwapper::~FieldSwapper() {}
 
-	if (m_pVectorFieldTextureSRV)
-	{
-		m_pVectorFieldTextureSRV->Release();
-		m_pVectorFieldTextureSRV = nullptr;
-	}
-}
-
-FieldSwapper::FieldSwapper() : m_iCurFieldIndex{ 0 }, m_iCurStepsNum{ 0 }, m_iCurStepsCounter{ 0 } {}
-
-FieldSwapper::~FieldSwapper()
+size_t FieldSwapper::CurrentFieldSlice() const
 {
-	for (size_t i = 0; i < m_aFeildsResources.size(); ++i)
+	if (m_pStream)
 	{
-		delete m_aFeildsResources[i];
+		return m_aFieldSlices[m_iPosition % m_aFieldSlices.size()];
 	}
-}
 
-ID3D11ShaderResourceView* FieldSwapper::CurrentVectorFieldSRV() const
-{
-	return m_aFeildsResources[m_iCurFieldIndex]->m_pVectorFieldTextureSRV;
+	assert(m_iCurFieldIndex < m_aFieldSlices.size());
+
+	return m_aFieldSlices[m_iCurFieldIndex];
 }
 
-ID3D11ShaderResourceView* FieldSwapper::FieldSRVByIndex(size_t ind) const
+size_t FieldSwapper::FieldSliceByIndex(size_t ind) const
 {
-	if (ind < m_aFeildsResources.size())
-	{
-		return m_aFeildsResources[ind]->m_pVectorFieldTextureSRV;
-	}
+	assert(ind < m_aFieldSlices.size());
 
-	return nullptr;
+	return m_aFieldSlices[ind];
 }
 
 int FieldSwapper::CurrentFieldIndex() const
@@ -52,7 +32,7 @@ int FieldSwapper::CurrentFieldIndex() const
 
 int FieldSwapper::CurrentStepsNum() const
 {
-	return (int)m_iCurStepsNum;
+	return (int)m_schedule.CurrentStepsNum();
 }
 
 ///////////////////////////////////
@@ -69,32 +49,36 @@ int FieldSwapper::CurrentInterpolateType() const
 
 int FieldSwapper::TotalFieldsNum() const
 {
-	return (int)m_aFeildsResources.size();
+	return (int)(m_pStream ? m_pStream->FieldsNum() : m_aFieldSlices.size());
 }
 
 int FieldSwapper::StepsPerFieldByIndex(size_t ind) const
 {
-	assert(ind < m_aStepsPerField.size());
-
-	return (int)m_aStepsPerField[ind];
+	return (int)m_schedule.StepsPerFieldByIndex(ind);
 }
 
-void FieldSwapper::AddField(ID3D11Texture2D* vectorFieldTexture, ID3D11ShaderResourceView* vectorFieldTextureSRV)
+void FieldSwapper::AddField(size_t fieldSlice)
 {
-	assert(vectorFieldTexture && vectorFieldTextureSRV);
+	assert(!m_pStream);
 
-	m_aFeildsResources.push_back(new VectorFieldResources(vectorFieldTexture, vectorFieldTextureSRV));
+	m_aFieldSlices.push_back(fieldSlice);
+	m_schedule.SetFieldsNum(m_aFieldSlices.size());
+
+	Sync();
 }
 
 void FieldSwapper::NextField()
 {
-	m_iCurFieldIndex = (m_iCurFieldIndex + 1) % m_aFeildsResources.size();
+	m_schedule.NextField();
+
+	Sync();
 }
 
 void FieldSwapper::SetUpStepPerFiled(std::vector<size_t> const& stepsPerField)
 {
-	m_aStepsPerField = stepsPerField;
-	m_iCurStepsNum = 0;
+	m_schedule.SetUpStepPerFiled(stepsPerField);
+
+	Sync();
 }
 
 ///////////////////////////////////
@@ -106,16 +90,123 @@ void FieldSwapper::SetUpInterpolateType(std::vector<int> const& interpolateTypes
 
 void FieldSwapper::IncStep(size_t inc)
 {
-	for (size_t i = 0; i < inc; ++i)
+	if (m_schedule.IncStep(inc) > 0)
+	{
+		Sync();
+	}
+}
+
+void FieldSwapper::Seek(size_t step)
+{
+	m_schedule.Seek(step);
+
+	Sync();
+}
+
+size_t FieldSwapper::CurrentStep() const
+{
+	return m_schedule.CurrentStep();
+}
+
+size_t FieldSwapper::StepsLeftInField() const
+{
+	return m_schedule.StepsLeftInField();
+}
+
+void FieldSwapper::SetPlayback(FieldSchedule::Playback playback)
+{
+	m_schedule.SetPlayback(playback);
+
+	if (m_pStream)
 	{
-		++m_iCurStepsCounter;
+		// Prepared fields follow the old order, the current one is taken again
+		m_pStream->SetOrder(m_schedule.Order());
+		m_iUploaded = m_schedule.CurrentSegment();
+	}
+
+	Sync();
+}
 
-		if (m_iCurStepsCounter == m_aStepsPerField[m_iCurStepsNum])
+void FieldSwapper::SetUpStreaming(std::unique_ptr<FieldStream> stream, std::vector<size_t> const& slices)
+{
+	assert(stream && m_aFieldSlices.empty() && slices.size() == stream->Window());
+
+	m_pStream = std::move(stream);
+	m_aFieldSlices = slices;
+	m_schedule.SetFieldsNum(m_pStream->FieldsNum());
+	m_pStream->SetOrder(m_schedule.Order());
+
+	Sync();
+}
+
+bool FieldSwapper::IsStreaming() const
+{
+	return (bool)m_pStream;
+}
+
+void FieldSwapper::Stream(Upload const& upload)
+{
+	if (!m_pStream)
+	{
+		return;
+	}
+
+	size_t window = m_aFieldSlices.size();
+	FieldStream::Prepared prepared;
+
+	auto uploadPrepared = [&]()
+	{
+		upload(m_aFieldSlices[prepared.position % window], prepared);
+
+		++m_streamStats.uploads;
+		m_streamStats.failed += prepared.valid ? 0 : 1;
+		m_iUploaded = prepared.position + 1;
+	};
+
+	// Skipped positions are never uploaded
+	if (m_iUploaded <= m_iPosition)
+	{
+		double waited = m_pStream->Take(m_iPosition, prepared);
+
+		// The very first field is a load, not a stall
+		if (waited > 0.0 && m_streamStats.uploads > 0)
 		{
-			m_iCurStepsNum = (m_iCurStepsNum + 1) % m_aFeildsResources.size();
-			m_iCurStepsCounter = 0;
+			++m_streamStats.stalls;
+			m_streamStats.stallSeconds += waited;
+			m_streamStats.maxStallSeconds = waited > m_streamStats.maxStallSeconds ? waited : m_streamStats.maxStallSeconds;
+		}
+
+		uploadPrepared();
+	}
 
-			NextField();
+	// The slice of position k + window is free once position k is behind
+	while (m_iUploaded < m_iPosition + window && m_pStream->TryTake(m_iUploaded, prepared))
+	{
+		uploadPrepared();
+	}
+}
+
+FieldSwapper::StreamStats FieldSwapper::GetStreamStats() const
+{
+	return m_streamStats;
+}
+
+void FieldSwapper::Sync()
+{
+	size_t position = m_schedule.CurrentSegment();
+
+	m_iCurFieldIndex = m_schedule.CurrentStepsNum();
+
+	if (m_pStream)
+	{
+		// Resident slices hold later positions after a seek back
+		if (position < m_iPosition)
+		{
+			m_iUploaded = position;
 		}
+
+		m_pStream->Advance(position);
 	}
+
+	m_iPosition = position;
 }
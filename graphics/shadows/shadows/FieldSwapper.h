@@ -1,35 +1,43 @@
 #pragma once
 
-#include <d3d11.h>
-#include <dxgi.h>
-
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <vector>
 
+#include "FieldSchedule.h"
+#include "FieldStream.h"
+
 
+// Field sequence of one animated layer. The fields themselves are slices of the
+// AnimatedTexture field array, the swapper only tracks which slice is current.
+// A streaming swapper owns a fixed window of slices that FieldStream refills: schedule
+// segment k lives in slice k % window, the upcoming ones are uploaded as they are prepared.
 class FieldSwapper
 {
-private:
-	struct VectorFieldResources
+public:
+	struct StreamStats
 	{
-		VectorFieldResources() = default;
-		VectorFieldResources(ID3D11Texture2D* vectorFieldTexture, ID3D11ShaderResourceView* vectorFieldTextureSRV);
-
-		~VectorFieldResources();
-
-		ID3D11Texture2D* m_pVectorFieldTexture;
-		ID3D11ShaderResourceView* m_pVectorFieldTextureSRV;
+		size_t uploads;
+		size_t failed; // Uploaded as zeros
+		size_t stalls; // Switches that waited for the loader
+		double stallSeconds;
+		double maxStallSeconds;
 	};
 
-private:
-	using fields_t = std::vector<VectorFieldResources*>;
+	// upload(slice, prepared) copies a prepared field into its slice
+	using Upload = std::function<void(size_t, FieldStream::Prepared const&)>;
 
 private:
-	fields_t m_aFeildsResources;
+	std::vector<size_t> m_aFieldSlices;
 	size_t m_iCurFieldIndex;
 
-	std::vector<size_t> m_aStepsPerField;
-	size_t m_iCurStepsNum;
-	size_t m_iCurStepsCounter;
+	std::unique_ptr<FieldStream> m_pStream;
+	size_t m_iPosition; // FieldSchedule::CurrentSegment()
+	size_t m_iUploaded; // Positions below this were uploaded
+	StreamStats m_streamStats;
+
+	FieldSchedule m_schedule;
 
 	std::vector<int> m_aInterplateTypes;
 
@@ -37,8 +45,8 @@ public:
 	FieldSwapper();
 	~FieldSwapper();
 
-	ID3D11ShaderResourceView* CurrentVectorFieldSRV() const;
-	ID3D11ShaderResourceView* FieldSRVByIndex(size_t ind) const;
+	size_t CurrentFieldSlice() const;
+	size_t FieldSliceByIndex(size_t ind) const;
 
 	int CurrentFieldIndex() const;
 	int CurrentStepsNum() const;
@@ -46,11 +54,28 @@ public:
 	int TotalFieldsNum() const;
 	int StepsPerFieldByIndex(size_t ind) const;
 
-	void AddField(ID3D11Texture2D* vectorFieldTexture, ID3D11ShaderResourceView* vectorFieldTextureSRV);
+	void AddField(size_t fieldSlice);
 	void NextField();
 	void SetUpStepPerFiled(std::vector<size_t> const& stepsPerField);
 	void IncStep(size_t inc = 1);
+	// Jumps to an absolute step, backwards as well
+	void Seek(size_t step);
+	size_t CurrentStep() const;
+	size_t StepsLeftInField() const;
+	void SetPlayback(FieldSchedule::Playback playback);
 
 	void SetUpInterpolateType(std::vector<int> const& interpolateTypes);
 	int CurrentInterpolateType() const;
+
+	// Replaces AddField, `slices` are the window the stream cycles through
+	void SetUpStreaming(std::unique_ptr<FieldStream> stream, std::vector<size_t> const& slices);
+	bool IsStreaming() const;
+
+	// Uploads the fields the stream has ready, waits for the current one if it isn't resident
+	void Stream(Upload const& upload);
+	StreamStats GetStreamStats() const;
+
+private:
+	// Follows the schedule to its current segment
+	void Sync();
 };
@@ -0,0 +1,470 @@
+#include "IBLBaker.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+#include "IBLCache.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    float constexpr PI = 3.14159265358979323846f;
+
+    // IBLShaders.fx constants
+    int constexpr N1 = 200;
+    int constexpr N2 = 50;
+    uint32_t constexpr prefilteredColorSampleCount = 1024u;
+    uint32_t constexpr preintegratedBRDFSampleCount = 1024u;
+    uint32_t constexpr resolution = 512u;
+
+    size_t constexpr rowsGrain = 4;
+
+    struct Vec3
+    {
+        float x, y, z;
+    };
+
+    inline Vec3 operator+(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+    inline Vec3 operator-(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Vec3 operator*(Vec3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+
+    inline float Dot(Vec3 a, Vec3 b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    inline Vec3 Cross(Vec3 a, Vec3 b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    inline Vec3 Normalize(Vec3 v)
+    {
+        return v * (1.0f / std::sqrt(Dot(v, v)));
+    }
+
+    // Renderer::m_targers / m_ups, right = cross(up, forward) as XMMatrixLookAtLH builds it
+    struct Face
+    {
+        Vec3 forward;
+        Vec3 up;
+        Vec3 right;
+    };
+
+    Face const faces[6] =
+    {
+        { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, -1 } },
+        { { -1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+        { { 0, 1, 0 }, { 0, 0, -1 }, { 1, 0, 0 } },
+        { { 0, -1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },
+        { { 0, 0, 1 }, { 0, 1, 0 }, { 1, 0, 0 } },
+        { { 0, 0, -1 }, { 0, 1, 0 }, { -1, 0, 0 } }
+    };
+
+    // Interpolated quad position at the pixel center of a face render target
+    inline Vec3 FaceDirection(uint32_t face, uint32_t px, uint32_t py, uint32_t size)
+    {
+        float s = 2.0f * (px + 0.5f) / size - 1.0f;
+        float t = 1.0f - 2.0f * (py + 0.5f) / size;
+
+        Face const& f = faces[face];
+
+        return Normalize(f.forward + f.right * s + f.up * t);
+    }
+
+    inline void CubeCoords(Vec3 dir, uint32_t& face, float& u, float& v)
+    {
+        float ax = std::fabs(dir.x);
+        float ay = std::fabs(dir.y);
+        float az = std::fabs(dir.z);
+
+        float major;
+        if (ax >= ay && ax >= az)
+        {
+            face = dir.x >= 0.0f ? 0 : 1;
+            major = ax;
+        }
+        else if (ay >= az)
+        {
+            face = dir.y >= 0.0f ? 2 : 3;
+            major = ay;
+        }
+        else
+        {
+            face = dir.z >= 0.0f ? 4 : 5;
+            major = az;
+        }
+
+        Vec3 p = dir * (1.0f / major);
+
+        u = 0.5f * (Dot(p, faces[face].right) + 1.0f);
+        v = 0.5f * (1.0f - Dot(p, faces[face].up));
+    }
+
+    inline void Store(float* texel, float const* rgb)
+    {
+        texel[0] = rgb[0];
+        texel[1] = rgb[1];
+        texel[2] = rgb[2];
+        texel[3] = 1.0f;
+    }
+
+    // Bilinear sample of a 2D float4 image
+    template <bool wrap>
+    inline void SampleBilinear(float const* texels, size_t width, size_t height, float u, float v, float* rgb)
+    {
+        float x = u * width - 0.5f;
+        float y = v * height - 0.5f;
+
+        float x0 = std::floor(x);
+        float y0 = std::floor(y);
+
+        float fx = x - x0;
+        float fy = y - y0;
+
+        long long cols[2] = { (long long)x0, (long long)x0 + 1 };
+        long long rows[2] = { (long long)y0, (long long)y0 + 1 };
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            if (wrap)
+            {
+                cols[i] = ((cols[i] % (long long)width) + width) % width;
+                rows[i] = ((rows[i] % (long long)height) + height) % height;
+            }
+            else
+            {
+                cols[i] = std::min(std::max(cols[i], 0LL), (long long)width - 1);
+                rows[i] = std::min(std::max(rows[i], 0LL), (long long)height - 1);
+            }
+        }
+
+        float const* t00 = texels + 4 * (cols[0] + rows[0] * width);
+        float const* t10 = texels + 4 * (cols[1] + rows[0] * width);
+        float const* t01 = texels + 4 * (cols[0] + rows[1] * width);
+        float const* t11 = texels + 4 * (cols[1] + rows[1] * width);
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            float top = t00[c] + fx * (t10[c] - t00[c]);
+            float bottom = t01[c] + fx * (t11[c] - t01[c]);
+
+            rgb[c] = top + fy * (bottom - top);
+        }
+    }
+
+    void SampleCube(DDSFile::Texture const& cube, Vec3 dir, uint32_t mip, float* rgb)
+    {
+        uint32_t face;
+        float u, v;
+        CubeCoords(dir, face, u, v);
+
+        SampleBilinear<false>(cube.Subresource(face, mip).data(), cube.MipWidth(mip), cube.MipHeight(mip), u, v, rgb);
+    }
+
+    // SampleLevel with MIN_MAG_MIP_LINEAR
+    void SampleCubeLevel(DDSFile::Texture const& cube, Vec3 dir, float lod, float* rgb)
+    {
+        lod = std::min(std::max(lod, 0.0f), (float)(cube.mipLevels - 1));
+
+        uint32_t mip0 = (uint32_t)lod;
+        uint32_t mip1 = std::min(mip0 + 1, cube.mipLevels - 1);
+        float f = lod - mip0;
+
+        SampleCube(cube, dir, mip0, rgb);
+        if (f > 0.0f && mip1 != mip0)
+        {
+            float next[3];
+            SampleCube(cube, dir, mip1, next);
+
+            for (size_t c = 0; c < 3; ++c)
+            {
+                rgb[c] += f * (next[c] - rgb[c]);
+            }
+        }
+    }
+
+    // body(face, px, py, texel) for every texel of a mip of all faces
+    template <typename Body>
+    void ForFaceTexels(DDSFile::Texture& cube, uint32_t mip, Body const& body)
+    {
+        uint32_t size = cube.MipWidth(mip);
+
+        ThreadPool::Get().ParallelFor(0, 6 * size, rowsGrain, [&](size_t rowBegin, size_t rowEnd)
+            {
+                for (size_t row = rowBegin; row < rowEnd; ++row)
+                {
+                    uint32_t face = (uint32_t)(row / size);
+                    uint32_t py = (uint32_t)(row % size);
+
+                    float* dst = cube.Subresource(face, mip).data() + 4 * py * size;
+
+                    for (uint32_t px = 0; px < size; ++px)
+                    {
+                        body(face, px, py, dst + 4 * px);
+                    }
+                }
+            });
+    }
+
+    float RadicalInverse_VdC(uint32_t bits)
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return float(bits) * 2.3283064365386963e-10f;
+    }
+
+    Vec3 ImportanceSampleGGX(float xi0, float xi1, Vec3 norm, float roughness)
+    {
+        float a = roughness * roughness;
+        float phi = 2.0f * PI * xi0;
+        float cosTheta = std::sqrt((1.0f - xi1) / (1.0f + (a * a - 1.0f) * xi1));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+        Vec3 H = { std::cos(phi) * sinTheta, cosTheta, std::sin(phi) * sinTheta };
+
+        Vec3 up = std::fabs(norm.z) < 0.999f ? Vec3{ 0.0f, 0.0f, 1.0f } : Vec3{ 1.0f, 0.0f, 0.0f };
+        Vec3 tangent = Normalize(Cross(up, norm));
+        Vec3 bitangent = Cross(norm, tangent);
+
+        return Normalize(tangent * H.x + bitangent * H.z + norm * H.y);
+    }
+
+    float DistributionGGX(Vec3 n, Vec3 h, float roughness)
+    {
+        float roughnessSqr = std::pow(std::max(roughness, 0.01f), 2.0f);
+        float ndoth = std::max(Dot(n, h), 0.0f);
+
+        return roughnessSqr / (PI * std::pow(ndoth * ndoth * (roughnessSqr - 1.0f) + 1.0f, 2.0f));
+    }
+
+    float SchlickGGX(float ndotv, float k)
+    {
+        float value = std::max(ndotv, 0.0f);
+        return value / (value * (1.0f - k) + k);
+    }
+}
+
+DDSFile::Texture IBLBaker::EnvironmentCube(float const* rgba, size_t width, size_t height, uint32_t size)
+{
+    assert(rgba != nullptr && width > 0 && height > 0 && size > 0);
+
+    uint32_t mipLevels = 1;
+    while ((size >> mipLevels) > 0)
+    {
+        ++mipLevels;
+    }
+
+    DDSFile::Texture cube = DDSFile::Texture::Create(size, size, 6, mipLevels, true);
+
+    ForFaceTexels(cube, 0, [&](uint32_t face, uint32_t px, uint32_t py, float* texel)
+        {
+            Vec3 pos = FaceDirection(face, px, py, size);
+
+            float u = 1.0f - std::atan2(pos.z, pos.x) / (2 * PI);
+            float v = 0.5f - std::asin(pos.y) / PI;
+
+            float rgb[3];
+            SampleBilinear<true>(rgba, width, height, u, v, rgb);
+            Store(texel, rgb);
+        });
+
+    // GenerateMips, 2x2 box filter
+    for (uint32_t mip = 1; mip < mipLevels; ++mip)
+    {
+        uint32_t srcSize = cube.MipWidth(mip - 1);
+
+        ForFaceTexels(cube, mip, [&](uint32_t face, uint32_t px, uint32_t py, float* texel)
+            {
+                float const* src = cube.Subresource(face, mip - 1).data();
+
+                float const* t00 = src + 4 * (2 * px + 2 * py * srcSize);
+                float const* t10 = t00 + 4;
+                float const* t01 = t00 + 4 * srcSize;
+                float const* t11 = t01 + 4;
+
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    texel[c] = 0.25f * (t00[c] + t10[c] + t01[c] + t11[c]);
+                }
+            });
+    }
+
+    return cube;
+}
+
+DDSFile::Texture IBLBaker::Irradiance(DDSFile::Texture const& environmentCube, uint32_t size)
+{
+    assert(environmentCube.cube && size > 0);
+
+    DDSFile::Texture cube = DDSFile::Texture::Create(size, size, 6, 1, true);
+
+    ForFaceTexels(cube, 0, [&](uint32_t face, uint32_t px, uint32_t py, float* texel)
+        {
+            Vec3 normal = FaceDirection(face, px, py, size);
+
+            Vec3 dir = std::fabs(normal.z) < 0.999f ? Vec3{ 0.0f, 0.0f, 1.0f } : Vec3{ 1.0f, 0.0f, 0.0f };
+            Vec3 tangent = Normalize(Cross(dir, normal));
+            Vec3 bitangent = Cross(normal, tangent);
+
+            float irradiance[3] = { 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < N1; i++)
+            {
+                float phi = i * (2 * PI / N1);
+
+                for (int j = 0; j < N2; j++)
+                {
+                    float theta = j * (PI / 2 / N2);
+
+                    float sinTheta = std::sin(theta);
+                    float cosTheta = std::cos(theta);
+
+                    Vec3 sampleVec = tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + normal * cosTheta;
+
+                    float rgb[3];
+                    SampleCube(environmentCube, sampleVec, 0, rgb);
+
+                    for (size_t c = 0; c < 3; ++c)
+                    {
+                        irradiance[c] += rgb[c] * cosTheta * sinTheta;
+                    }
+                }
+            }
+
+            for (size_t c = 0; c < 3; ++c)
+            {
+                irradiance[c] = PI * irradiance[c] / (N1 * N2);
+            }
+
+            Store(texel, irradiance);
+        });
+
+    return cube;
+}
+
+DDSFile::Texture IBLBaker::PrefilteredColor(DDSFile::Texture const& environmentCube, uint32_t size, uint32_t mipLevels)
+{
+    assert(environmentCube.cube && size > 0 && mipLevels > 0 && (size >> (mipLevels - 1)) > 0);
+
+    DDSFile::Texture cube = DDSFile::Texture::Create(size, size, 6, mipLevels, true);
+
+    float const saTexel = 4.0f * PI / (6.0f * resolution * resolution);
+
+    for (uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        float roughness = IBLCache::PrefilteredColorRoughness(mip, mipLevels);
+        uint32_t mipSize = cube.MipWidth(mip);
+
+        ForFaceTexels(cube, mip, [&](uint32_t face, uint32_t px, uint32_t py, float* texel)
+            {
+                Vec3 norm = FaceDirection(face, px, py, mipSize);
+                Vec3 view = norm;
+
+                float totalWeight = 0.0f;
+                float prefilteredColor[3] = { 0.0f, 0.0f, 0.0f };
+
+                for (uint32_t i = 0u; i < prefilteredColorSampleCount; ++i)
+                {
+                    float xi0 = float(i) / float(prefilteredColorSampleCount);
+                    float xi1 = RadicalInverse_VdC(i);
+
+                    Vec3 H = ImportanceSampleGGX(xi0, xi1, norm, roughness);
+                    Vec3 L = Normalize(H * (2.0f * Dot(view, H)) - view);
+
+                    float ndotl = std::max(Dot(norm, L), 0.0f);
+                    float ndoth = std::max(Dot(norm, H), 0.0f);
+                    float hdotv = std::max(Dot(H, view), 0.0f);
+
+                    float D = DistributionGGX(norm, H, roughness);
+                    float pdf = (D * ndoth / (4.0f * hdotv)) + 0.0001f;
+                    float saSample = 1.0f / (float(prefilteredColorSampleCount) * pdf + 0.0001f);
+                    float mipLevel = roughness == 0.0f ? 0.0f : 0.5f * std::log2(saSample / saTexel);
+
+                    if (ndotl > 0.0f)
+                    {
+                        float rgb[3];
+                        SampleCubeLevel(environmentCube, L, mipLevel, rgb);
+
+                        for (size_t c = 0; c < 3; ++c)
+                        {
+                            prefilteredColor[c] += rgb[c] * ndotl;
+                        }
+                        totalWeight += ndotl;
+                    }
+                }
+
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    prefilteredColor[c] /= totalWeight;
+                }
+
+                Store(texel, prefilteredColor);
+            });
+    }
+
+    return cube;
+}
+
+DDSFile::Texture IBLBaker::PreintegratedBRDF(uint32_t size)
+{
+    assert(size > 0);
+
+    DDSFile::Texture brdf = DDSFile::Texture::Create(size, size, 1, 1, false);
+    float* texels = brdf.Subresource(0, 0).data();
+
+    ThreadPool::Get().ParallelFor(0, size, rowsGrain, [&](size_t rowBegin, size_t rowEnd)
+        {
+            for (size_t py = rowBegin; py < rowEnd; ++py)
+            {
+                // The quad spans the viewport with y up and the shader takes roughness = 1 - Tex.y
+                float roughness = (py + 0.5f) / size;
+
+                for (size_t px = 0; px < size; ++px)
+                {
+                    float NdotV = (px + 0.5f) / size;
+
+                    Vec3 V = { std::sqrt(1.0f - NdotV * NdotV), NdotV, 0.0f };
+                    Vec3 N = { 0.0f, 1.0f, 0.0f };
+
+                    float k = std::pow(roughness, 2.0f) / 2;
+
+                    float A = 0.0f;
+                    float B = 0.0f;
+                    for (uint32_t i = 0u; i < preintegratedBRDFSampleCount; ++i)
+                    {
+                        float xi0 = float(i) / float(preintegratedBRDFSampleCount);
+                        float xi1 = RadicalInverse_VdC(i);
+
+                        Vec3 H = ImportanceSampleGGX(xi0, xi1, N, roughness);
+                        Vec3 L = Normalize(H * (2.0f * Dot(V, H)) - V);
+
+                        float NdotL = std::max(L.y, 0.0f);
+                        float NdotH = std::max(H.y, 0.0f);
+                        float VdotH = std::max(Dot(V, H), 0.0f);
+
+                        if (NdotL > 0.0f)
+                        {
+                            float G = SchlickGGX(Dot(N, V), k) * SchlickGGX(Dot(N, L), k);
+                            float G_Vis = (G * VdotH) / (NdotH * NdotV);
+                            float Fc = std::pow(1.0f - VdotH, 5.0f);
+
+                            A += (1.0f - Fc) * G_Vis;
+                            B += Fc * G_Vis;
+                        }
+                    }
+
+                    float* texel = texels + 4 * (px + py * size);
+                    texel[0] = A / float(preintegratedBRDFSampleCount);
+                    texel[1] = B / float(preintegratedBRDFSampleCount);
+                    texel[2] = 0.0f;
+                    texel[3] = 1.0f;
+                }
+            }
+        });
+
+    return brdf;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "DDSFile.h"
+
+// CPU implementation of the image based lighting precomputation
+// (EnvironmentCubeShaders.fx and IBLShaders.fx) producing the textures Renderer keeps in the
+// IBL cache. Cube faces follow the D3D layout the renderer draws them with, sampling is bilinear
+// within a face with clamped edges where the hardware filters across faces, so texels next to
+// cube seams and float rounding differ slightly from the GPU path. No D3D dependency.
+class IBLBaker
+{
+public:
+    // Equirectangular RGBA float environment -> cube with a full box filtered mip chain
+    static DDSFile::Texture EnvironmentCube(float const* rgba, size_t width, size_t height, uint32_t size);
+
+    static DDSFile::Texture Irradiance(DDSFile::Texture const& environmentCube, uint32_t size);
+
+    // GGX prefiltered environment, mip m is convoluted with IBLCache::PrefilteredColorRoughness(m)
+    static DDSFile::Texture PrefilteredColor(DDSFile::Texture const& environmentCube, uint32_t size, uint32_t mipLevels);
+
+    // (scale, bias) of the split sum approximation, NdotV along u and roughness along v
+    static DDSFile::Texture PreintegratedBRDF(uint32_t size);
+};
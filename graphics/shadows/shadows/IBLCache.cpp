@@ -0,0 +1,66 @@
+#include "IBLCache.h"
+
+#include <assert.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "ContentHash.h"
+
+std::vector<std::string> IBLCache::ShaderSources()
+{
+    return { "EnvironmentCubeShaders.fx", "IBLShaders.fx" };
+}
+
+uint64_t IBLCache::Key(std::vector<unsigned char> const& hdr, std::vector<std::vector<unsigned char>> const& shaderSources, Parameters const& parameters)
+{
+    uint64_t hash = ContentHash::offsetBasis;
+
+    ContentHash::HashValue(hash, version);
+
+    ContentHash::HashValue(hash, hdr.size());
+    ContentHash::Hash(hash, hdr.data(), hdr.size());
+
+    for (auto const& source : shaderSources)
+    {
+        ContentHash::HashText(hash, source);
+    }
+
+    ContentHash::HashValue(hash, parameters.cubeSize);
+    ContentHash::HashValue(hash, parameters.irradianceSize);
+    ContentHash::HashValue(hash, parameters.prefilteredColorSize);
+    ContentHash::HashValue(hash, parameters.prefilteredColorMipLevels);
+    ContentHash::HashValue(hash, parameters.preintegratedBRDFSize);
+
+    return hash;
+}
+
+std::string IBLCache::Path(std::string const& directory, uint64_t key, TEXTURE texture)
+{
+    static char const* const names[] = { "cube", "irradiance", "prefiltered", "brdf" };
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "ibl_%016llx_%s.dds", (unsigned long long)key, names[static_cast<int>(texture)]);
+
+    return directory + "/" + name;
+}
+
+float IBLCache::PrefilteredColorRoughness(uint32_t mip, uint32_t mipLevels)
+{
+    assert(mip < mipLevels);
+
+    return mipLevels > 1 ? static_cast<float>(mip) / (mipLevels - 1) : 0.0f;
+}
+
+bool IBLCache::ReadFile(std::string const& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is.is_open())
+    {
+        return false;
+    }
+
+    bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+
+    return !is.bad();
+}
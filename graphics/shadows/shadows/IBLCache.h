@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Naming and invalidation of the precomputed image based lighting textures.
+// Files are named after a hash of the HDR environment, the shader sources and the
+// parameters, so any change to them misses the cache. Shared by the renderer and the
+// offline baker, no D3D dependency.
+class IBLCache
+{
+public:
+    enum class TEXTURE
+    {
+        ENVIRONMENT_CUBE = 0,
+        IRRADIANCE,
+        PREFILTERED_COLOR,
+        PREINTEGRATED_BRDF
+    };
+
+    struct Parameters
+    {
+        uint32_t cubeSize = 512;
+        uint32_t irradianceSize = 32;
+        uint32_t prefilteredColorSize = 128;
+        uint32_t prefilteredColorMipLevels = 5;
+        uint32_t preintegratedBRDFSize = 128;
+    };
+
+    // Bumped whenever the stored layout or the baking code changes
+    static uint32_t const version = 1;
+
+    // Shader sources the baked data depends on, relative to the project directory
+    static std::vector<std::string> ShaderSources();
+
+    static uint64_t Key(std::vector<unsigned char> const& hdr, std::vector<std::vector<unsigned char>> const& shaderSources, Parameters const& parameters);
+
+    // <directory>/ibl_<key>_<texture>.dds
+    static std::string Path(std::string const& directory, uint64_t key, TEXTURE texture);
+
+    // Roughness the prefiltered color mip is convoluted with, 0 at the top mip and 1 at the last one
+    static float PrefilteredColorRoughness(uint32_t mip, uint32_t mipLevels);
+
+    static bool ReadFile(std::string const& path, std::vector<unsigned char>& bytes);
+};
@@ -0,0 +1,248 @@
+#include "ImageImport.h"
+
+#include <assert.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "FieldKernels.h"
+#include "../../stb_image.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define IMAGE_IMPORT_X86
+#include <immintrin.h>
+#endif
+
+// MSVC accepts any intrinsic, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define IMAGE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define IMAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define IMAGE_TARGET_SSE41
+#define IMAGE_TARGET_AVX2
+#endif
+
+namespace
+{
+	struct SRGBTable
+	{
+		SRGBTable()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				float linear = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+
+				values[i] = (int32_t)(linear * 255.0f + 0.5f);
+			}
+		}
+
+		// Widened to 32 bits for the AVX2 gather
+		int32_t values[256];
+	};
+
+	SRGBTable const& GetSRGBTable()
+	{
+		static SRGBTable const table;
+
+		return table;
+	}
+
+	bool Decoded(unsigned char* pixels, int x, int y, ImageImport::Image& image)
+	{
+		if (pixels == nullptr)
+		{
+			return false;
+		}
+
+		image.width = (size_t)x;
+		image.height = (size_t)y;
+		image.format = ImageImport::Format::RGBA8;
+		image.pixels.reset(pixels);
+
+		return true;
+	}
+}
+
+void ImageImport::PixelsDeleter::operator()(unsigned char* pixels) const
+{
+	stbi_image_free(pixels);
+}
+
+size_t ImageImport::Image::RowPitch() const
+{
+	return 4 * width;
+}
+
+size_t ImageImport::Image::Size() const
+{
+	return RowPitch() * height;
+}
+
+bool ImageImport::Load(std::string const& filename, Image& image)
+{
+	int x, y, n;
+	unsigned char* pixels = stbi_load(filename.c_str(), &x, &y, &n, STBI_rgb_alpha);
+
+	return Decoded(pixels, x, y, image);
+}
+
+bool ImageImport::LoadFromMemory(unsigned char const* data, size_t size, Image& image)
+{
+	int x, y, n;
+	unsigned char* pixels = stbi_load_from_memory(data, (int)size, &x, &y, &n, STBI_rgb_alpha);
+
+	return Decoded(pixels, x, y, image);
+}
+
+void ImageImport::Convert(Image& image, Format format, bool linearize)
+{
+	size_t count = image.width * image.height;
+	assert(image.Data() != nullptr || count == 0);
+
+	if (linearize)
+	{
+		// R, G and B share the curve, so it commutes with the swizzle
+		SRGBToLinear(image.Data(), count);
+	}
+
+	if (image.format != format)
+	{
+		SwizzleRB(image.Data(), count);
+		image.format = format;
+	}
+}
+
+void ImageImport::SwizzleRB(unsigned char* pixels, size_t count)
+{
+	switch (FieldKernels::ActiveISA())
+	{
+	case FieldKernels::ISA::AVX2:
+		SwizzleRBAVX2(pixels, count);
+		break;
+	case FieldKernels::ISA::SSE41:
+		SwizzleRBSSE41(pixels, count);
+		break;
+	default:
+		SwizzleRBScalar(pixels, count);
+		break;
+	}
+}
+
+void ImageImport::SwizzleRBScalar(unsigned char* pixels, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned char* pixel = pixels + 4 * i;
+
+		unsigned char r = pixel[0];
+		pixel[0] = pixel[2];
+		pixel[2] = r;
+	}
+}
+
+#ifdef IMAGE_IMPORT_X86
+
+IMAGE_TARGET_SSE41 void ImageImport::SwizzleRBSSE41(unsigned char* pixels, size_t count)
+{
+	__m128i const shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i* ptr = (__m128i*)(pixels + 4 * i);
+		_mm_storeu_si128(ptr, _mm_shuffle_epi8(_mm_loadu_si128(ptr), shuffle));
+	}
+
+	SwizzleRBScalar(pixels + 4 * i, count - i);
+}
+
+IMAGE_TARGET_AVX2 void ImageImport::SwizzleRBAVX2(unsigned char* pixels, size_t count)
+{
+	// vpshufb works per 128 bit lane, both lanes use the same pattern
+	__m256i const shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i* ptr = (__m256i*)(pixels + 4 * i);
+		_mm256_storeu_si256(ptr, _mm256_shuffle_epi8(_mm256_loadu_si256(ptr), shuffle));
+	}
+
+	SwizzleRBScalar(pixels + 4 * i, count - i);
+}
+
+IMAGE_TARGET_AVX2 void ImageImport::SRGBToLinearAVX2(unsigned char* pixels, size_t count)
+{
+	int32_t const* table = GetSRGBTable().values;
+
+	__m256i const byteMask = _mm256_set1_epi32(0xFF);
+	__m256i const alphaMask = _mm256_set1_epi32((int)0xFF000000);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i* ptr = (__m256i*)(pixels + 4 * i);
+		__m256i rgba = _mm256_loadu_si256(ptr);
+
+		// One gather per channel of 8 pixels, the looked up bytes go back to their place
+		__m256i r = _mm256_i32gather_epi32(table, _mm256_and_si256(rgba, byteMask), 4);
+		__m256i g = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(rgba, 8), byteMask), 4);
+		__m256i b = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(rgba, 16), byteMask), 4);
+
+		__m256i result = _mm256_or_si256(_mm256_and_si256(rgba, alphaMask), r);
+		result = _mm256_or_si256(result, _mm256_slli_epi32(g, 8));
+		result = _mm256_or_si256(result, _mm256_slli_epi32(b, 16));
+
+		_mm256_storeu_si256(ptr, result);
+	}
+
+	SRGBToLinearScalar(pixels + 4 * i, count - i);
+}
+
+#else
+
+void ImageImport::SwizzleRBSSE41(unsigned char* pixels, size_t count)
+{
+	SwizzleRBScalar(pixels, count);
+}
+
+void ImageImport::SwizzleRBAVX2(unsigned char* pixels, size_t count)
+{
+	SwizzleRBScalar(pixels, count);
+}
+
+void ImageImport::SRGBToLinearAVX2(unsigned char* pixels, size_t count)
+{
+	SRGBToLinearScalar(pixels, count);
+}
+
+#endif
+
+void ImageImport::SRGBToLinear(unsigned char* pixels, size_t count)
+{
+	if (FieldKernels::ActiveISA() == FieldKernels::ISA::AVX2)
+	{
+		SRGBToLinearAVX2(pixels, count);
+	}
+	else
+	{
+		SRGBToLinearScalar(pixels, count);
+	}
+}
+
+void ImageImport::SRGBToLinearScalar(unsigned char* pixels, size_t count)
+{
+	SRGBTable const& table = GetSRGBTable();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned char* pixel = pixels + 4 * i;
+
+		pixel[0] = (unsigned char)table.values[pixel[0]];
+		pixel[1] = (unsigned char)table.values[pixel[1]];
+		pixel[2] = (unsigned char)table.values[pixel[2]];
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Platform-neutral texture import: every file is decoded once with stb_image to 8 bit RGBA
+// and the same buffer is converted in place to the format the texture is created with.
+// Conversions dispatch on FieldKernels::ActiveISA() and every SIMD path is bit-exact with the scalar one.
+class ImageImport
+{
+public:
+	// Channel orders of DXGI_FORMAT_R8G8B8A8_UNORM and DXGI_FORMAT_B8G8R8A8_UNORM
+	enum class Format
+	{
+		RGBA8 = 0,
+		BGRA8 = 1
+	};
+
+	// Releases pixels allocated by stb_image
+	struct PixelsDeleter
+	{
+		void operator()(unsigned char* pixels) const;
+	};
+
+	struct Image
+	{
+		size_t width = 0;
+		size_t height = 0;
+		Format format = Format::RGBA8;
+		// The decoder's own buffer, adopted without a copy
+		std::unique_ptr<unsigned char, PixelsDeleter> pixels;
+
+		unsigned char* Data() { return pixels.get(); }
+		unsigned char const* Data() const { return pixels.get(); }
+
+		size_t RowPitch() const;
+		size_t Size() const;
+	};
+
+	static bool Load(std::string const& filename, Image& image);
+	static bool LoadFromMemory(unsigned char const* data, size_t size, Image& image);
+
+	// Reorders channels to `format`, with `linearize` the color channels are decoded from sRGB
+	// for targets that are sampled as linear UNORM. Alpha is never touched.
+	static void Convert(Image& image, Format format, bool linearize = false);
+
+	// Swaps the R and B bytes of `count` 4 byte pixels
+	static void SwizzleRB(unsigned char* pixels, size_t count);
+	static void SwizzleRBScalar(unsigned char* pixels, size_t count);
+	static void SwizzleRBSSE41(unsigned char* pixels, size_t count);
+	static void SwizzleRBAVX2(unsigned char* pixels, size_t count);
+
+	// Rounded sRGB -> linear transfer of the first three bytes of `count` 4 byte pixels.
+	// Every path reads the same 256 entry table, SSE4.1 has no gather and runs the scalar loop
+	static void SRGBToLinear(unsigned char* pixels, size_t count);
+	static void SRGBToLinearScalar(unsigned char* pixels, size_t count);
+	static void SRGBToLinearAVX2(unsigned char* pixels, size_t count);
+};
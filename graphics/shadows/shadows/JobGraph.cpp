@@ -0,0 +1,197 @@
+#include "JobGraph.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+
+#include "ThreadPool.h"
+
+JobGraph::JobId JobGraph::Add(const std::string& name, std::function<bool()> body, std::vector<JobId> dependencies, THREAD thread)
+{
+    JobId id = m_jobs.size();
+
+    Job job;
+    job.name = name;
+    job.body = std::move(body);
+    job.dependenciesNum = dependencies.size();
+    job.thread = thread;
+    m_jobs.push_back(std::move(job));
+
+    for (JobId dependency : dependencies)
+    {
+        // Dependencies are added first, so the graph has no cycles
+        assert(dependency < id);
+        m_jobs[dependency].dependents.push_back(id);
+    }
+
+    m_timings.push_back({ name, STATE::PENDING, 0, 0.0, 0.0 });
+
+    return id;
+}
+
+bool JobGraph::Run()
+{
+    m_start = std::chrono::steady_clock::now();
+
+    m_ready.clear();
+    m_readyMain.clear();
+    m_waiting.assign(m_jobs.size(), 0);
+    m_finished = 0;
+
+    for (JobId id = 0; id < m_jobs.size(); ++id)
+    {
+        m_waiting[id] = m_jobs[id].dependenciesNum;
+        m_timings[id].state = STATE::PENDING;
+
+        if (m_waiting[id] == 0)
+        {
+            (m_jobs[id].thread == THREAD::MAIN ? m_readyMain : m_ready).push_back(id);
+        }
+    }
+
+    // The first job added runs first
+    std::reverse(m_ready.begin(), m_ready.end());
+    std::reverse(m_readyMain.begin(), m_readyMain.end());
+
+    std::thread::id mainThread = std::this_thread::get_id();
+    ThreadPool& pool = ThreadPool::Get();
+
+    // Every participant holds its chunk until the graph is done, the caller always gets one
+    pool.ParallelFor(0, pool.ThreadCount(), 1, [&](size_t begin, size_t)
+        {
+            bool main = std::this_thread::get_id() == mainThread;
+
+            Participate(main ? 0 : begin + 1, main);
+        });
+
+    m_wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+
+    for (const Timing& timing : m_timings)
+    {
+        if (timing.state != STATE::SUCCEEDED)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void JobGraph::Participate(size_t thread, bool main)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_condition.wait(lock, [&]()
+            {
+                return m_finished == m_jobs.size() || !m_ready.empty() || (main && !m_readyMain.empty());
+            });
+
+        if (m_finished == m_jobs.size())
+        {
+            return;
+        }
+
+        std::vector<JobId>& queue = main && !m_readyMain.empty() ? m_readyMain : m_ready;
+        JobId id = queue.back();
+        queue.pop_back();
+
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        bool succeeded = m_jobs[id].body();
+        auto end = std::chrono::steady_clock::now();
+
+        Timing& timing = m_timings[id];
+        timing.thread = thread;
+        timing.startMs = std::chrono::duration<double, std::milli>(start - m_start).count();
+        timing.durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+        lock.lock();
+
+        Finish(id, succeeded ? STATE::SUCCEEDED : STATE::FAILED);
+        m_condition.notify_all();
+    }
+}
+
+void JobGraph::Finish(JobId job, STATE state)
+{
+    m_timings[job].state = state;
+    ++m_finished;
+
+    for (JobId dependent : m_jobs[job].dependents)
+    {
+        if (state != STATE::SUCCEEDED)
+        {
+            if (m_timings[dependent].state == STATE::PENDING)
+            {
+                Finish(dependent, STATE::SKIPPED);
+            }
+            continue;
+        }
+
+        if (--m_waiting[dependent] == 0 && m_timings[dependent].state == STATE::PENDING)
+        {
+            (m_jobs[dependent].thread == THREAD::MAIN ? m_readyMain : m_ready).push_back(dependent);
+        }
+    }
+}
+
+size_t JobGraph::Size() const
+{
+    return m_jobs.size();
+}
+
+JobGraph::STATE JobGraph::State(JobId job) const
+{
+    assert(job < m_jobs.size());
+
+    return m_timings[job].state;
+}
+
+const std::vector<JobGraph::Timing>& JobGraph::Timings() const
+{
+    return m_timings;
+}
+
+double JobGraph::WallTimeMs() const
+{
+    return m_wallTimeMs;
+}
+
+std::string JobGraph::Report() const
+{
+    static const char* const states[] = { "pending", "ok", "failed", "skipped" };
+
+    std::vector<const Timing*> order;
+    for (const Timing& timing : m_timings)
+    {
+        order.push_back(&timing);
+    }
+    // Skipped jobs never started, they go last
+    std::stable_sort(order.begin(), order.end(), [](const Timing* a, const Timing* b)
+        {
+            bool aSkipped = a->state == STATE::SKIPPED;
+            bool bSkipped = b->state == STATE::SKIPPED;
+
+            return aSkipped != bSkipped ? bSkipped : a->startMs < b->startMs;
+        });
+
+    std::string report;
+    char line[256];
+    double total = 0.0;
+
+    for (const Timing* timing : order)
+    {
+        std::snprintf(line, sizeof(line), "  %-24s thread %2zu  start %9.2f ms  %9.2f ms  %s\n",
+            timing->name.c_str(), timing->thread, timing->startMs, timing->durationMs, states[static_cast<int>(timing->state)]);
+        report += line;
+        total += timing->durationMs;
+    }
+
+    std::snprintf(line, sizeof(line), "  %zu jobs: %.2f ms of work in %.2f ms wall time\n", m_jobs.size(), total, m_wallTimeMs);
+    report += line;
+
+    return report;
+}
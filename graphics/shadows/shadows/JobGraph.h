@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Dependency graph of loading jobs run on the ThreadPool threads.
+// Every pool thread, the calling one included, takes ready jobs until the graph is done.
+// MAIN jobs only run on the thread that called Run, which keeps device context work off the workers.
+// A job failing (returning false) skips everything that depends on it.
+// Regions started from inside a job run inline, the graph is the unit of parallelism.
+class JobGraph
+{
+public:
+    using JobId = size_t;
+
+    enum class THREAD
+    {
+        ANY = 0,
+        MAIN = 1
+    };
+
+    enum class STATE
+    {
+        PENDING = 0,
+        SUCCEEDED,
+        FAILED,
+        SKIPPED
+    };
+
+    struct Timing
+    {
+        std::string name;
+        STATE state;
+        size_t thread;    // 0 is the calling thread
+        double startMs;   // since Run started
+        double durationMs;
+    };
+
+    JobId Add(const std::string& name, std::function<bool()> body, std::vector<JobId> dependencies = {}, THREAD thread = THREAD::ANY);
+
+    // False when any job failed or was skipped
+    bool Run();
+
+    size_t Size() const;
+    STATE State(JobId job) const;
+
+    const std::vector<Timing>& Timings() const;
+    double WallTimeMs() const;
+
+    // One line per job in start order and the sum of job times against the wall time
+    std::string Report() const;
+
+private:
+    struct Job
+    {
+        std::string name;
+        std::function<bool()> body;
+        std::vector<JobId> dependents;
+        size_t dependenciesNum;
+        THREAD thread;
+    };
+
+    void Participate(size_t thread, bool main);
+    void Finish(JobId job, STATE state);
+
+    std::vector<Job> m_jobs;
+    std::vector<Timing> m_timings;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<JobId> m_ready;
+    std::vector<JobId> m_readyMain;
+    std::vector<size_t> m_waiting;
+    size_t m_finished = 0;
+
+    std::chrono::steady_clock::time_point m_start;
+    double m_wallTimeMs = 0.0;
+};
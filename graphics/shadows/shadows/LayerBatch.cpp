@@ -0,0 +1,70 @@
+#include "LayerBatch.h"
+
+#include <algorithm>
+#include <assert.h>
+
+#include "FieldSwapper.h"
+
+LayerBatch::Constants LayerBatch::Build(int scale, size_t width, size_t height, float const* fieldDecode, std::vector<FieldSwapper*> const& fields)
+{
+	assert(scale >= -maxWalkSteps && scale <= maxWalkSteps);
+
+	Constants constants = {};
+
+	constants.scale = scale;
+	constants.layersNum = (uint32_t)fields.size();
+	constants.width = (uint32_t)width;
+	constants.height = (uint32_t)height;
+	constants.fieldDecode[0] = fieldDecode[0];
+	constants.fieldDecode[1] = fieldDecode[1];
+
+	FieldSlices(fields, constants.fieldSlices);
+
+	return constants;
+}
+
+void LayerBatch::FieldSlices(std::vector<FieldSwapper*> const& fields, uint32_t* slices)
+{
+	assert(fields.size() <= maxLayers);
+
+	for (size_t i = 0; i < maxLayers; ++i)
+	{
+		slices[i] = i < fields.size() ? (uint32_t)fields[i]->CurrentFieldSlice() : 0;
+	}
+}
+
+LayerBatch::Groups LayerBatch::GroupsNum(Constants const& constants)
+{
+	return {
+		(constants.width + groupSize - 1) / groupSize,
+		(constants.height + groupSize - 1) / groupSize,
+		constants.layersNum
+	};
+}
+
+size_t LayerBatch::PassSteps(size_t pending, std::vector<FieldSwapper*> const& fields)
+{
+	size_t steps = std::min<size_t>(pending, maxWalkSteps);
+
+	for (auto const& field : fields)
+	{
+		steps = std::min(steps, field->StepsLeftInField());
+	}
+
+	return steps;
+}
+
+int32_t LayerBatch::WalkSteps(int32_t scale)
+{
+	int32_t steps = scale < 0 ? -scale : scale;
+
+	// A longer walk can't be split into unit steps within one pass
+	assert(steps <= maxWalkSteps);
+
+	return steps < maxWalkSteps ? steps : maxWalkSteps;
+}
+
+float LayerBatch::WalkStepScale(int32_t scale)
+{
+	return scale < 0 ? -1.0f : 1.0f;
+}
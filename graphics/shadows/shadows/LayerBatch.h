@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FieldSwapper;
+
+// Constants and thread layout of the batched layer pass (TextureShader.hlsl CS).
+// Layers and fields are slices of texture arrays, one dispatch runs a thread per texel
+// per layer, so the pass cost does not grow with per-layer pass overhead.
+// No D3D dependency, the reference renderer runs the same layout on the CPU.
+class LayerBatch
+{
+public:
+	// Size of the field slice table in the constant buffers
+	static size_t constexpr maxLayers = 16;
+
+	// numthreads of the compute shader
+	static uint32_t constexpr groupSize = 8;
+
+	// Longest field walk of one pass, mirrors MAX_WALK_STEPS of TextureShader.hlsl.
+	// More steps than this take several passes, see PassSteps.
+	static int32_t constexpr maxWalkSteps = 32;
+
+	// Mirrors cbuffer LayerBatch, fieldSlices is a uint4[maxLayers / 4] in HLSL
+	struct Constants
+	{
+		int32_t scale;
+		uint32_t layersNum;
+		uint32_t width;
+		uint32_t height;
+		float fieldDecode[4]; // xy - FieldEncoding::DecodeScale of the field array
+		uint32_t fieldSlices[maxLayers];
+	};
+
+	struct Groups
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t z;
+	};
+
+	// Current field slice of every layer, fields[i] belongs to layer i
+	static Constants Build(int scale, size_t width, size_t height, float const* fieldDecode, std::vector<FieldSwapper*> const& fields);
+
+	static void FieldSlices(std::vector<FieldSwapper*> const& fields, uint32_t* slices);
+
+	// z runs over the layers
+	static Groups GroupsNum(Constants const& constants);
+
+	// Steps of the next pass out of `pending`: at most maxWalkSteps, and none of `fields` switches
+	// to its next field within them. Catching up on more takes several passes stepping the fields in between.
+	static size_t PassSteps(size_t pending, std::vector<FieldSwapper*> const& fields);
+
+	// Field lookups of a pass advecting by `scale` steps, |scale| <= maxWalkSteps.
+	// Every lookup moves by one whole displacement, backwards for a negative scale.
+	static int32_t WalkSteps(int32_t scale);
+	static float WalkStepScale(int32_t scale);
+};
@@ -0,0 +1,11 @@
+#include "LuminanceAdaptation.h"
+
+#include <cmath>
+
+float LuminanceAdaptation::Adapt(float adaptedLuminance, float luminance, double delta)
+{
+    float sigma = 0.04f / (0.04f + luminance);
+    float tau = sigma * 0.4f + (1 - sigma) * 0.1f;
+
+    return adaptedLuminance + (luminance - adaptedLuminance) * static_cast<float>(1 - std::exp(-delta * tau));
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Temporal filter of the tone mapping luminance, ps_adapt_main in PostProcessShaders.fx
+// runs the same filter on GPU. No D3D dependency.
+class LuminanceAdaptation
+{
+public:
+    // Moves the adapted luminance towards the measured one over delta seconds,
+    // dark scenes are adapted to faster than bright ones
+    static float Adapt(float adaptedLuminance, float luminance, double delta);
+};
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include <algorithm>
+#include <assert.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -10,27 +11,60 @@
 #undef STB_IMAGE_WRITE_IMPLEMENTATION
 #undef TINYGLTF_IMPLEMENTATION
 
+#include "AnimationSystem.h"
 #include "Utils.h"
 
+// Share of the viewport an animated primitive has to span for its layer pass to run
+const float minAnimatedScreenSize = 0.01f;
+
 Model::Model(const char* modelPath, const std::shared_ptr<ModelShaders>& modelShaders, DirectX::XMMATRIX globalWorldMatrix) :
     m_modelPath(modelsPath + modelPath),
     m_globalWorldMatrix(globalWorldMatrix),
     m_pModelShaders(modelShaders),
     m_max(),
-    m_min()
+    m_min(),
+    m_loaded(false),
+    m_blendStateSet(false)
 {};
 
-HRESULT Model::CreateDeviceDependentResources(ID3D11Device* device)
+HRESULT Model::Load()
+{
+    tinygltf::TinyGLTF loader;
+
+    m_gltfModel = tinygltf::Model();
+    m_loaded = loader.LoadASCIIFromFile(&m_gltfModel, nullptr, nullptr, m_modelPath.c_str());
+
+    return m_loaded ? S_OK : E_FAIL;
+}
+
+HRESULT Model::CompileShaders()
 {
     HRESULT hr = S_OK;
 
-    tinygltf::TinyGLTF loader;
+    assert(m_loaded);
+
+    for (const tinygltf::Material& gltfMaterial : m_gltfModel.materials)
+    {
+        hr = m_pModelShaders->CompilePixelShader(GetPixelShaderDefinesFlags(gltfMaterial));
+        if (FAILED(hr))
+            return hr;
+    }
 
-    tinygltf::Model model;
+    return hr;
+}
 
-    bool ret = loader.LoadASCIIFromFile(&model, nullptr, nullptr, m_modelPath.c_str());
-    if (!ret)
-        return E_FAIL;
+HRESULT Model::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    if (!m_loaded)
+    {
+        hr = Load();
+        if (FAILED(hr))
+            return hr;
+    }
+
+    tinygltf::Model& model = m_gltfModel;
 
     m_pShaderResourceViews.resize(model.images.size());
 
@@ -46,6 +80,14 @@ HRESULT Model::CreateDeviceDependentResources(ID3D11Device* device)
     m_min = DirectX::XMVectorSet(INFINITY, INFINITY, INFINITY, 0);
 
     hr = CreatePrimitives(device, model);
+    if (FAILED(hr))
+        return hr;
+
+    BuildDrawPackets();
+
+    // Buffers and images live on the GPU now
+    m_gltfModel = tinygltf::Model();
+    m_loaded = false;
 
     return hr;
 }
@@ -158,20 +200,89 @@ HRESULT Model::CreateSamplerState(ID3D11Device* device, tinygltf::Model& model)
     return hr;
 }
 
-HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
+void Model::AnimateMaterial(const std::string& materialName)
 {
-    HRESULT hr = S_OK;
+    m_animatedMaterials.push_back(materialName);
+}
 
-    for (tinygltf::Material& gltfMaterial : model.materials)
+HRESULT Model::BindAnimatedTexture(ID3D11Device* device, const std::string& materialName, const std::shared_ptr<AnimatedTexture>& animatedTexture)
+{
+    HRESULT hr = S_FALSE;
+    bool flagsChanged = false;
+
+    for (Material& material : m_materials)
     {
-        // AAV
-        // Small hack here to add animated texture to sword material
-        bool hasAnimatedTexture = false;
-        if (gltfMaterial.name == "Mat_Sword")
+        if (material.name != materialName)
+            continue;
+
+        material.pAnimatedTexture = animatedTexture;
+
+        // Not named before CompileShaders, the variant is compiled here
+        if (!(material.pixelShaderDefinesFlags & ModelShaders::MODEL_HAS_ANIMATED_TEXTURE))
         {
-            hasAnimatedTexture = true;
+            material.pixelShaderDefinesFlags |= ModelShaders::MODEL_HAS_ANIMATED_TEXTURE;
+            flagsChanged = true;
+
+            hr = m_pModelShaders->CreatePixelShader(device, material.pixelShaderDefinesFlags);
+            if (FAILED(hr))
+                return hr;
         }
 
+        hr = S_OK;
+    }
+
+    // Packets are keyed by shader flags
+    if (flagsChanged)
+        BuildDrawPackets();
+
+    return hr;
+}
+
+HRESULT Model::BindAnimatedTextures(ID3D11Device* device, const AnimationSystem& animationSystem)
+{
+    HRESULT hr = S_FALSE;
+
+    for (size_t i = 0; i < animationSystem.GetTexturesNum(); ++i)
+    {
+        HRESULT result = BindAnimatedTexture(device, animationSystem.GetMaterialName(i), animationSystem.GetTexture(i));
+        if (FAILED(result))
+            return result;
+
+        if (result == S_OK)
+            hr = S_OK;
+    }
+
+    return hr;
+}
+
+UINT Model::GetPixelShaderDefinesFlags(const tinygltf::Material& gltfMaterial) const
+{
+    UINT flags = 0;
+
+    if (gltfMaterial.pbrMetallicRoughness.baseColorTexture.index >= 0)
+        flags |= ModelShaders::MATERIAL_HAS_COLOR_TEXTURE;
+
+    if (gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
+        flags |= ModelShaders::MATERIAL_HAS_METAL_ROUGH_TEXTURE;
+
+    if (gltfMaterial.normalTexture.index >= 0)
+        flags |= ModelShaders::MATERIAL_HAS_NORMAL_TEXTURE;
+
+    if (gltfMaterial.occlusionTexture.index >= 0)
+        flags |= ModelShaders::MATERIAL_HAS_OCCLUSION_TEXTURE;
+
+    if (std::find(m_animatedMaterials.begin(), m_animatedMaterials.end(), gltfMaterial.name) != m_animatedMaterials.end())
+        flags |= ModelShaders::MODEL_HAS_ANIMATED_TEXTURE;
+
+    return flags;
+}
+
+HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
+{
+    HRESULT hr = S_OK;
+
+    for (tinygltf::Material& gltfMaterial : model.materials)
+    {
         Material material = {};
         material.name = gltfMaterial.name;
         material.blend = false;
@@ -215,12 +326,11 @@ HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
         material.materialBufferData.Metalness = static_cast<float>(gltfMaterial.pbrMetallicRoughness.metallicFactor);
         material.materialBufferData.Roughness = static_cast<float>(gltfMaterial.pbrMetallicRoughness.roughnessFactor);
 
-        material.pixelShaderDefinesFlags = 0;
+        material.pixelShaderDefinesFlags = GetPixelShaderDefinesFlags(gltfMaterial);
 
         material.baseColorTexture = gltfMaterial.pbrMetallicRoughness.baseColorTexture.index;
         if (material.baseColorTexture >= 0)
         {
-            material.pixelShaderDefinesFlags |= ModelShaders::MATERIAL_HAS_COLOR_TEXTURE;
             hr = CreateTexture(device, model, material.baseColorTexture, true);
             if (FAILED(hr))
                 return hr;
@@ -229,7 +339,6 @@ HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
         material.metallicRoughnessTexture = gltfMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index;
         if (material.metallicRoughnessTexture >= 0)
         {
-            material.pixelShaderDefinesFlags |= ModelShaders::MATERIAL_HAS_METAL_ROUGH_TEXTURE;
             hr = CreateTexture(device, model, material.metallicRoughnessTexture);
             if (FAILED(hr))
                 return hr;
@@ -238,20 +347,11 @@ HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
         material.normalTexture = gltfMaterial.normalTexture.index;
         if (material.normalTexture >= 0)
         {
-            material.pixelShaderDefinesFlags |= ModelShaders::MATERIAL_HAS_NORMAL_TEXTURE;
             hr = CreateTexture(device, model, material.normalTexture);
             if (FAILED(hr))
                 return hr;
         }
 
-        if (gltfMaterial.occlusionTexture.index >= 0)
-            material.pixelShaderDefinesFlags |= ModelShaders::MATERIAL_HAS_OCCLUSION_TEXTURE;
-
-        if (hasAnimatedTexture)
-        {
-            material.pixelShaderDefinesFlags |= ModelShaders::MODEL_HAS_ANIMATED_TEXTURE;
-        }
-
         hr = m_pModelShaders->CreatePixelShader(device, material.pixelShaderDefinesFlags);
         if (FAILED(hr))
             return hr;
@@ -357,18 +457,37 @@ HRESULT Model::CreatePrimitive(ID3D11Device* device, tinygltf::Model& model, tin
             DirectX::XMFLOAT3 maxPosition(static_cast<float>(gltfAccessor.maxValues[0]), static_cast<float>(gltfAccessor.maxValues[1]), static_cast<float>(gltfAccessor.maxValues[2]));
             DirectX::XMFLOAT3 minPosition(static_cast<float>(gltfAccessor.minValues[0]), static_cast<float>(gltfAccessor.minValues[1]), static_cast<float>(gltfAccessor.minValues[2]));
 
+            // A rotated box does not map its min and max corners onto the world box, every corner is transformed
             DirectX::XMMATRIX world = DirectX::XMMatrixMultiply(m_worldMatricies[primitive.matrix], m_globalWorldMatrix);
-            primitive.max = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&maxPosition), world);
-            primitive.min = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&minPosition), world);
+            DirectX::XMVECTOR localMin = DirectX::XMLoadFloat3(&minPosition);
+            DirectX::XMVECTOR localMax = DirectX::XMLoadFloat3(&maxPosition);
 
-            for (size_t i = 0; i < 3; ++i)
+            primitive.max = DirectX::XMVectorReplicate(-INFINITY);
+            primitive.min = DirectX::XMVectorReplicate(INFINITY);
+            for (UINT i = 0; i < 8; ++i)
             {
-                m_max.m128_f32[i] = max(m_max.m128_f32[i], max(primitive.max.m128_f32[i], primitive.min.m128_f32[i]));
-                m_min.m128_f32[i] = min(m_min.m128_f32[i], min(primitive.max.m128_f32[i], primitive.min.m128_f32[i]));
+                DirectX::XMVECTOR corner = DirectX::XMVectorSelect(localMin, localMax, DirectX::XMVectorSelectControl(i & 1, (i >> 1) & 1, (i >> 2) & 1, 0));
+                corner = DirectX::XMVector3Transform(corner, world);
+
+                primitive.max = DirectX::XMVectorMax(primitive.max, corner);
+                primitive.min = DirectX::XMVectorMin(primitive.min, corner);
             }
+
+            m_max = DirectX::XMVectorSelect(m_max, DirectX::XMVectorMax(m_max, primitive.max), DirectX::g_XMSelect1110);
+            m_min = DirectX::XMVectorSelect(m_min, DirectX::XMVectorMin(m_min, primitive.min), DirectX::g_XMSelect1110);
         }
     }
 
+    assert(primitive.attributes.size() <= D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT);
+
+    primitive.vertexBindings.count = static_cast<UINT>(primitive.attributes.size());
+    for (UINT i = 0; i < primitive.vertexBindings.count; ++i)
+    {
+        primitive.vertexBindings.buffers[i] = primitive.attributes[i].pVertexBuffer.Get();
+        primitive.vertexBindings.strides[i] = primitive.attributes[i].byteStride;
+        primitive.vertexBindings.offsets[i] = 0;
+    }
+
     switch (gltfPrimitive.mode)
     {
     case TINYGLTF_MODE_POINTS:
@@ -488,29 +607,73 @@ HRESULT Model::CreatePrimitives(ID3D11Device* device, tinygltf::Model& model)
     return hr;
 }
 
-void Model::Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool emissive, bool usePS)
+void Model::BuildDrawPackets()
+{
+    struct Pass
+    {
+        std::vector<Primitive>* primitives;
+        DrawPacketList* packets;
+        bool emissive;
+        bool sorted;
+    };
+
+    // Transparent passes keep creation order, they are sorted by distance every frame
+    Pass passes[] = {
+        { &m_primitives, &m_packets, false, true },
+        { &m_emissivePrimitives, &m_emissivePackets, true, true },
+        { &m_transparentPrimitives, &m_transparentPackets, false, false },
+        { &m_emissiveTransparentPrimitives, &m_emissiveTransparentPackets, true, false }
+    };
+
+    for (Pass& pass : passes)
+    {
+        pass.packets->Clear();
+        for (Primitive& primitive : *pass.primitives)
+        {
+            // Emissive passes use a single pixel shader
+            UINT shaderFlags = pass.emissive ? 0 : m_materials[primitive.material].pixelShaderDefinesFlags;
+            pass.packets->Add(shaderFlags, primitive.material, primitive.matrix, static_cast<UINT>(primitive.primitiveTopology));
+        }
+
+        if (pass.sorted)
+            pass.packets->Sort();
+    }
+}
+
+void Model::BeginPass(ID3D11DeviceContext* context, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots)
 {
     context->VSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
     context->PSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
     context->PSSetConstantBuffers(slots.materialConstantBufferSlot, 1, &materialConstantBuffer);
     context->PSSetSamplers(slots.samplerStateSlot, 1, m_pSamplerState.GetAddressOf());
 
-    transformationData.World = DirectX::XMMatrixIdentity();
+    context->IASetInputLayout(m_pModelShaders->GetInputLayout());
+    context->VSSetShader(m_pModelShaders->GetVertexShader(), nullptr, 0);
+
+    m_stateFilter.Reset();
+    m_blendStateSet = false;
+}
+
+void Model::EndPass(ID3D11DeviceContext* context)
+{
+    if (m_blendStateSet)
+        context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+
+    m_blendStateSet = false;
+}
+
+void Model::Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool emissive, bool usePS)
+{
+    BeginPass(context, transformationConstantBuffer, materialConstantBuffer, slots);
+
     std::vector<Primitive>& primitives = emissive ? m_emissivePrimitives : m_primitives;
-    for (Primitive& primitive : primitives)
+    DrawPacketList& packets = emissive ? m_emissivePackets : m_packets;
+    for (const DrawPacketList::Packet& packet : packets)
     {
-        RenderPrimitive(primitive, context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
+        RenderPacket(packet, primitives[packet.primitive], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
     }
 
-    // for (size_t i = 0; i < primitives.size(); ++i)
-    // {
-    //     RenderPrimitive(primitives[i], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
-    // }
-
-    // if (primitives.size() > 3)
-    // {
-    //     RenderPrimitive(primitives[3], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
-    // }
+    EndPass(context);
 }
 
 bool CompareDistancePairs(const std::pair<float, size_t>& p1, const std::pair<float, size_t>& p2)
@@ -520,16 +683,12 @@ bool CompareDistancePairs(const std::pair<float, size_t>& p1, const std::pair<fl
 
 void Model::RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, DirectX::XMVECTOR cameraDir, bool emissive, bool usePS)
 {
-    context->VSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
-    context->PSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
-    context->PSSetConstantBuffers(slots.materialConstantBufferSlot, 1, &materialConstantBuffer);
-    context->PSSetSamplers(slots.samplerStateSlot, 1, m_pSamplerState.GetAddressOf());
-
-    transformationData.World = DirectX::XMMatrixIdentity();
+    BeginPass(context, transformationConstantBuffer, materialConstantBuffer, slots);
 
     std::vector<Primitive>& primitives = emissive ? m_emissiveTransparentPrimitives : m_transparentPrimitives;
-    
-    std::vector<std::pair<float, size_t>> distances;
+    DrawPacketList& packets = emissive ? m_emissiveTransparentPackets : m_transparentPackets;
+
+    m_transparentOrder.clear();
     float distance;
     DirectX::XMVECTOR center;
     DirectX::XMVECTOR cameraPos = DirectX::XMLoadFloat4(&transformationData.CameraPos);
@@ -537,75 +696,149 @@ void Model::RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionC
     {
         center = DirectX::XMVectorDivide(DirectX::XMVectorAdd(primitives[i].max, primitives[i].min), DirectX::XMVectorReplicate(2));
         distance = DirectX::XMVector3Dot(DirectX::XMVectorSubtract(center, cameraPos), cameraDir).m128_f32[0];
-        distances.push_back(std::pair<float, size_t>(distance, i));
+        m_transparentOrder.push_back(std::pair<float, size_t>(distance, i));
     }
 
-    std::sort(distances.begin(), distances.end(), CompareDistancePairs);
+    std::sort(m_transparentOrder.begin(), m_transparentOrder.end(), CompareDistancePairs);
+
+    for (auto iter = m_transparentOrder.rbegin(); iter != m_transparentOrder.rend(); ++iter)
+        RenderPacket(packets[(*iter).second], primitives[(*iter).second], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
 
-    for (auto iter = distances.rbegin(); iter != distances.rend(); ++iter)
-        RenderPrimitive(primitives[(*iter).second], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
+    EndPass(context);
 }
 
-void Model::RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots, bool emissive, bool usePS)
+void Model::RenderPacket(const DrawPacketList::Packet& packet, Primitive& primitive, ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots, bool emissive, bool usePS)
 {
-    std::vector<ID3D11Buffer*> combined;
-    std::vector<UINT> offset;
-    std::vector<UINT> stride;
-
-    size_t attributesCount = primitive.attributes.size();
-    combined.resize(attributesCount);
-    offset.resize(attributesCount);
-    stride.resize(attributesCount);
-    for (size_t i = 0; i < attributesCount; ++i)
-    {
-        combined[i] = primitive.attributes[i].pVertexBuffer.Get();
-        stride[i] = primitive.attributes[i].byteStride;
-    }
-    context->IASetVertexBuffers(0, static_cast<UINT>(attributesCount), combined.data(), stride.data(), offset.data());
+    UINT changes = m_stateFilter.Apply(packet);
 
+    VertexBindings& bindings = primitive.vertexBindings;
+    context->IASetVertexBuffers(0, bindings.count, bindings.buffers, bindings.strides, bindings.offsets);
     context->IASetIndexBuffer(primitive.pIndexBuffer.Get(), primitive.indexFormat, 0);
-    context->IASetPrimitiveTopology(primitive.primitiveTopology);
 
-    Material& material = m_materials[primitive.material];
-    if (material.blend)
-        context->OMSetBlendState(material.pBlendState.Get(), nullptr, 0xFFFFFFFF);
+    if (changes & DrawPacketList::TOPOLOGY_CHANGE)
+        context->IASetPrimitiveTopology(primitive.primitiveTopology);
 
-    context->IASetInputLayout(m_pModelShaders->GetInputLayout());
-    context->VSSetShader(m_pModelShaders->GetVertexShader(), nullptr, 0);
-
-    transformationData.World = DirectX::XMMatrixMultiplyTranspose(m_worldMatricies[primitive.matrix], m_globalWorldMatrix);
+    if (changes & DrawPacketList::MATRIX_CHANGE)
+    {
+        transformationData.World = DirectX::XMMatrixMultiplyTranspose(m_worldMatricies[packet.matrix], m_globalWorldMatrix);
+        context->UpdateSubresource(transformationConstantBuffer, 0, NULL, &transformationData, 0, 0);
+    }
 
-    context->UpdateSubresource(transformationConstantBuffer, 0, NULL, &transformationData, 0, 0);
+    if (changes & DrawPacketList::SHADER_CHANGE)
+    {
+        if (!usePS)
+            context->PSSetShader(nullptr, nullptr, 0);
+        else if (emissive)
+            context->PSSetShader(m_pModelShaders->GetEmissivePixelShader(), nullptr, 0);
+        else
+            context->PSSetShader(m_pModelShaders->GetPixelShader(packet.shaderFlags), nullptr, 0);
+    }
 
-    MaterialConstantBuffer materialBufferData = material.materialBufferData;
-    if (usePS)
+    if (changes & DrawPacketList::MATERIAL_CHANGE)
     {
-        if (emissive)
+        Material& material = m_materials[packet.material];
+        if (material.blend || m_blendStateSet)
         {
-            materialBufferData.Albedo = DirectX::XMFLOAT4(1, 1, 1, materialBufferData.Albedo.w);
-            context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.emissiveTexture].GetAddressOf());
-            context->PSSetShader(m_pModelShaders->GetEmissivePixelShader(), nullptr, 0);
+            context->OMSetBlendState(material.blend ? material.pBlendState.Get() : nullptr, nullptr, 0xFFFFFFFF);
+            m_blendStateSet = material.blend;
         }
-        else
+
+        if (usePS)
         {
-            context->PSSetShader(m_pModelShaders->GetPixelShader(material.pixelShaderDefinesFlags), nullptr, 0);
-            if (material.baseColorTexture >= 0)
-                context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.baseColorTexture].GetAddressOf());
-            if (material.metallicRoughnessTexture >= 0)
-                context->PSSetShaderResources(slots.metallicRoughnessTextureSlot, 1, m_pShaderResourceViews[material.metallicRoughnessTexture].GetAddressOf());
-            if (material.normalTexture >= 0)
-                context->PSSetShaderResources(slots.normalTextureSlot, 1, m_pShaderResourceViews[material.normalTexture].GetAddressOf());
+            if (emissive)
+                context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.emissiveTexture].GetAddressOf());
+            else
+            {
+                if (material.baseColorTexture >= 0)
+                    context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.baseColorTexture].GetAddressOf());
+                if (material.metallicRoughnessTexture >= 0)
+                    context->PSSetShaderResources(slots.metallicRoughnessTextureSlot, 1, m_pShaderResourceViews[material.metallicRoughnessTexture].GetAddressOf());
+                if (material.normalTexture >= 0)
+                    context->PSSetShaderResources(slots.normalTextureSlot, 1, m_pShaderResourceViews[material.normalTexture].GetAddressOf());
+
+                // Slots of PBRShaders.fx HAS_ANIMATED_TEXTURE
+                if (material.pAnimatedTexture)
+                {
+                    AnimatedTexture* animatedTexture = material.pAnimatedTexture.get();
+                    ID3D11ShaderResourceView* textures[] = {
+                        animatedTexture->GetLayersSourceSRV(), animatedTexture->GetFieldsSRV(), animatedTexture->GetFieldTilesSRV() };
+
+                    context->PSSetShaderResources(8, 3, textures);
+                    context->PSSetConstantBuffers(4, 1, animatedTexture->GetInterpolateBufferAdress());
+                    context->PSSetSamplers(5, 2, animatedTexture->GetSamplerAdress());
+                }
+            }
+            context->RSSetState(material.pRasterizerState.Get());
         }
-        context->RSSetState(material.pRasterizerState.Get());
+        context->UpdateSubresource(materialConstantBuffer, 0, NULL, &material.materialBufferData, 0, 0);
+    }
+
+    // Animated textures nobody can see skip their layer passes
+    if (usePS && !emissive)
+    {
+        const Material& material = m_materials[packet.material];
+        if (material.pAnimatedTexture && IsOnScreen(primitive, transformationData))
+            material.pAnimatedTexture->MarkSampled();
     }
-    else
-        context->PSSetShader(nullptr, nullptr, 0);
-    context->UpdateSubresource(materialConstantBuffer, 0, NULL, &material.materialBufferData, 0, 0);
 
     context->DrawIndexed(primitive.indexCount, 0, 0);
+}
 
-    if (material.blend)
-        context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+bool Model::IsOnScreen(const Primitive& primitive, const WorldViewProjectionConstantBuffer& transformationData)
+{
+    // The constant buffer holds the matrices transposed
+    DirectX::XMMATRIX viewProjection = DirectX::XMMatrixMultiply(DirectX::XMMatrixTranspose(transformationData.View), DirectX::XMMatrixTranspose(transformationData.Projection));
+
+    DirectX::XMVECTOR boxMin = primitive.min;
+    DirectX::XMVECTOR boxMax = primitive.max;
+
+    // Corners outside of the left, right, bottom, top, near and far planes
+    UINT outside[6] = {};
+    bool behindCamera = false;
+    float screenMin[2] = { 1.0f, 1.0f };
+    float screenMax[2] = { -1.0f, -1.0f };
+
+    for (UINT i = 0; i < 8; ++i)
+    {
+        DirectX::XMVECTOR corner = DirectX::XMVectorSelect(boxMin, boxMax, DirectX::XMVectorSelectControl(i & 1, (i >> 1) & 1, (i >> 2) & 1, 0));
+
+        DirectX::XMFLOAT4 clip;
+        DirectX::XMStoreFloat4(&clip, DirectX::XMVector3Transform(corner, viewProjection));
+
+        outside[0] += clip.x < -clip.w;
+        outside[1] += clip.x > clip.w;
+        outside[2] += clip.y < -clip.w;
+        outside[3] += clip.y > clip.w;
+        outside[4] += clip.z < 0.0f;
+        outside[5] += clip.z > clip.w;
+
+        if (clip.w <= 0.0f)
+        {
+            behindCamera = true;
+            continue;
+        }
+
+        screenMin[0] = min(screenMin[0], clip.x / clip.w);
+        screenMin[1] = min(screenMin[1], clip.y / clip.w);
+        screenMax[0] = max(screenMax[0], clip.x / clip.w);
+        screenMax[1] = max(screenMax[1], clip.y / clip.w);
+    }
+
+    for (UINT count : outside)
+    {
+        if (count == 8)
+            return false;
+    }
+
+    // Crosses the camera plane, so it is close by whatever the other corners project to
+    if (behindCamera)
+        return true;
+
+    float width = min(screenMax[0], 1.0f) - max(screenMin[0], -1.0f);
+    float height = min(screenMax[1], 1.0f) - max(screenMin[1], -1.0f);
+
+    // Clip space spans 2 across the viewport
+    return max(width, height) * 0.5f >= minAnimatedScreenSize;
 }
 
 Model::~Model()
@@ -4,10 +4,14 @@
 
 #include "ShaderStructures.h"
 #include "ModelShaders.h"
+#include "DrawPacketList.h"
 #include "../../tiny_gltf.h"
 
 const std::string modelsPath = srcPath + "../../models/";
 
+class AnimatedTexture;
+class AnimationSystem;
+
 class Model
 {
 public:
@@ -24,8 +28,21 @@ public:
     Model(const char* modelPath, const std::shared_ptr<ModelShaders>& modelShaders, DirectX::XMMATRIX globalWorldMatrix = DirectX::XMMatrixIdentity());
     ~Model();
 
+    // Parses the glTF file and decodes its images, no device access
+    HRESULT Load();
+    // Compiles the pixel shader variants of the loaded materials, no device access
+    HRESULT CompileShaders();
+
+    // Loads first unless Load already ran, the parsed file is released afterwards
     HRESULT CreateDeviceDependentResources(ID3D11Device* device);
 
+    // Materials named before CompileShaders get their animated variant compiled with the rest
+    void AnimateMaterial(const std::string& materialName);
+    // S_FALSE when the model has no material of that name
+    HRESULT BindAnimatedTexture(ID3D11Device* device, const std::string& materialName, const std::shared_ptr<AnimatedTexture>& animatedTexture);
+    // Binds every texture of the system to the materials it animates
+    HRESULT BindAnimatedTextures(ID3D11Device* device, const AnimationSystem& animationSystem);
+
     virtual void Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool emissive = false, bool usePS = true);
     void RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, DirectX::XMVECTOR cameraDir, bool emissive = false, bool usePS = true);
 
@@ -45,6 +62,7 @@ protected:
         int normalTexture;
         int emissiveTexture;
         UINT pixelShaderDefinesFlags;
+        std::shared_ptr<AnimatedTexture> pAnimatedTexture;
     };
 
     struct Attribute
@@ -53,10 +71,21 @@ protected:
         Microsoft::WRL::ComPtr<ID3D11Buffer> pVertexBuffer;
     };
 
+    // Input assembler state gathered once in CreatePrimitive, buffers are owned by the attributes
+    struct VertexBindings
+    {
+        UINT count;
+        ID3D11Buffer* buffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+        UINT strides[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+        UINT offsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+    };
+
     struct Primitive
     {
         std::vector<Attribute> attributes;
+        VertexBindings vertexBindings;
         UINT vertexCount;
+        // World space box around all 8 transformed corners of the POSITION bounds
         DirectX::XMVECTOR max;
         DirectX::XMVECTOR min;
         D3D11_PRIMITIVE_TOPOLOGY primitiveTopology;
@@ -67,6 +96,8 @@ protected:
         UINT matrix;
     };
 
+    UINT GetPixelShaderDefinesFlags(const tinygltf::Material& gltfMaterial) const;
+
     HRESULT CreateTexture(ID3D11Device* device, tinygltf::Model& model, size_t imageIdx, bool useSRGB = false);
     HRESULT CreateSamplerState(ID3D11Device* device, tinygltf::Model& model);
     HRESULT CreateMaterials(ID3D11Device* device, tinygltf::Model& model);
@@ -75,7 +106,18 @@ protected:
     
     virtual HRESULT CreatePrimitive(ID3D11Device* device, tinygltf::Model& model, tinygltf::Primitive& gltfPrimitive, UINT matrix);
     
-    virtual void RenderPrimitive(Primitive& primitive,
+    // Compiles the primitive lists into draw packets, call after the lists change
+    void BuildDrawPackets();
+
+    void BeginPass(ID3D11DeviceContext* context, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots);
+    void EndPass(ID3D11DeviceContext* context);
+
+    // Frustum and screen size test of the primitive bounds
+    static bool IsOnScreen(const Primitive& primitive, const WorldViewProjectionConstantBuffer& transformationData);
+
+    // Binds only the state that differs from the previous packet of the pass
+    void RenderPacket(const DrawPacketList::Packet& packet,
+        Primitive& primitive,
         ID3D11DeviceContext* context,
         WorldViewProjectionConstantBuffer& transformationData,
         ID3D11Buffer* transformationConstantBuffer,
@@ -86,6 +128,9 @@ protected:
 
     std::string m_modelPath;
 
+    tinygltf::Model m_gltfModel;
+    bool m_loaded;
+
     std::shared_ptr<ModelShaders> m_pModelShaders;
 
     std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_pShaderResourceViews;
@@ -93,6 +138,7 @@ protected:
     Microsoft::WRL::ComPtr<ID3D11SamplerState> m_pSamplerState;
 
     std::vector<Material> m_materials;
+    std::vector<std::string> m_animatedMaterials;
 
     std::vector<DirectX::XMMATRIX> m_worldMatricies;
     
@@ -101,6 +147,18 @@ protected:
     std::vector<Primitive> m_emissivePrimitives;
     std::vector<Primitive> m_emissiveTransparentPrimitives;
 
+    // Opaque packets are sorted by key, transparent ones follow the primitive lists
+    DrawPacketList m_packets;
+    DrawPacketList m_emissivePackets;
+    DrawPacketList m_transparentPackets;
+    DrawPacketList m_emissiveTransparentPackets;
+
+    DrawPacketList::StateFilter m_stateFilter;
+    bool m_blendStateSet;
+
+    // Back to front order of the transparent pass, keeps its capacity between frames
+    std::vector<std::pair<float, size_t>> m_transparentOrder;
+
     DirectX::XMMATRIX m_globalWorldMatrix;
 
     DirectX::XMVECTOR m_max;
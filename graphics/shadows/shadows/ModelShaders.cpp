@@ -4,38 +4,23 @@
 
 #include "Utils.h"
 
-ModelShaders::ModelShaders()
+// Variants are indexed by MODEL_PIXEL_SHADER_DEFINES flags
+const UINT pixelShaderVariantsNum = 32;
+
+ModelShaders::ModelShaders() :
+    m_pPixelShaders(pixelShaderVariantsNum),
+    m_pPixelShaderBlobs(pixelShaderVariantsNum)
 {};
 
-HRESULT ModelShaders::CreateDeviceDependentResources(ID3D11Device* device)
+HRESULT ModelShaders::Compile()
 {
     HRESULT hr = S_OK;
 
-    m_pPixelShaders.resize(32);
-
-    Microsoft::WRL::ComPtr<ID3DBlob> blob;
-
     std::vector<D3D_SHADER_MACRO> defines;
     defines.push_back({ "HAS_TANGENT", "1" });
     defines.push_back({ nullptr, nullptr });
 
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "vs_main", "vs_5_0", &blob, defines.data());
-    if (FAILED(hr))
-        return hr;
-
-    hr = device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pVertexShader);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_INPUT_ELEMENT_DESC layout[] =
-    {
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD_", 0, DXGI_FORMAT_R32G32_FLOAT, 3, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-    };
-
-    hr = device->CreateInputLayout(layout, ARRAYSIZE(layout), blob->GetBufferPointer(), blob->GetBufferSize(), &m_pInputLayout);
+    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "vs_main", "vs_5_0", &m_pVertexShaderBlob, defines.data());
     if (FAILED(hr))
         return hr;
 
@@ -43,11 +28,7 @@ HRESULT ModelShaders::CreateDeviceDependentResources(ID3D11Device* device)
     defines.push_back({ "HAS_EMISSIVE", "1" });
     defines.push_back({ nullptr, nullptr });
 
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &blob, defines.data());
-    if (FAILED(hr))
-        return hr;
-
-    hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pEmissivePixelShader);
+    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &m_pEmissivePixelShaderBlob, defines.data());
     if (FAILED(hr))
         return hr;
 
@@ -57,26 +38,18 @@ HRESULT ModelShaders::CreateDeviceDependentResources(ID3D11Device* device)
     defines.push_back({ "HAS_COLOR_TEXTURE", "1" });
     defines.push_back({ nullptr, nullptr });
 
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &blob, defines.data());
-    if (FAILED(hr))
-        return hr;
-
-    hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pAnimatedEmissivePixelShader);
-    if (FAILED(hr))
-        return hr;
+    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &m_pAnimatedEmissivePixelShaderBlob, defines.data());
 
     return hr;
 }
 
-HRESULT ModelShaders::CreatePixelShader(ID3D11Device* device, UINT definesFlags)
+HRESULT ModelShaders::CompilePixelShader(UINT definesFlags)
 {
     HRESULT hr = S_OK;
 
-    if (m_pPixelShaders[definesFlags])
+    if (m_pPixelShaderBlobs[definesFlags])
         return hr;
 
-    Microsoft::WRL::ComPtr<ID3DBlob> blob;
-
     std::vector<D3D_SHADER_MACRO> defines;
     defines.push_back({ "HAS_TANGENT", "1" });
 
@@ -97,10 +70,59 @@ HRESULT ModelShaders::CreatePixelShader(ID3D11Device* device, UINT definesFlags)
 
     defines.push_back({ nullptr, nullptr });
 
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &blob, defines.data());
+    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &m_pPixelShaderBlobs[definesFlags], defines.data());
+
+    return hr;
+}
+
+HRESULT ModelShaders::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    if (!m_pVertexShaderBlob || !m_pEmissivePixelShaderBlob || !m_pAnimatedEmissivePixelShaderBlob)
+    {
+        hr = Compile();
+        if (FAILED(hr))
+            return hr;
+    }
+
+    hr = device->CreateVertexShader(m_pVertexShaderBlob->GetBufferPointer(), m_pVertexShaderBlob->GetBufferSize(), nullptr, &m_pVertexShader);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_INPUT_ELEMENT_DESC layout[] =
+    {
+        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD_", 0, DXGI_FORMAT_R32G32_FLOAT, 3, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
+
+    hr = device->CreateInputLayout(layout, ARRAYSIZE(layout), m_pVertexShaderBlob->GetBufferPointer(), m_pVertexShaderBlob->GetBufferSize(), &m_pInputLayout);
+    if (FAILED(hr))
+        return hr;
+
+    hr = device->CreatePixelShader(m_pEmissivePixelShaderBlob->GetBufferPointer(), m_pEmissivePixelShaderBlob->GetBufferSize(), nullptr, &m_pEmissivePixelShader);
+    if (FAILED(hr))
+        return hr;
+
+    hr = device->CreatePixelShader(m_pAnimatedEmissivePixelShaderBlob->GetBufferPointer(), m_pAnimatedEmissivePixelShaderBlob->GetBufferSize(), nullptr, &m_pAnimatedEmissivePixelShader);
+
+    return hr;
+}
+
+HRESULT ModelShaders::CreatePixelShader(ID3D11Device* device, UINT definesFlags)
+{
+    HRESULT hr = S_OK;
+
+    if (m_pPixelShaders[definesFlags])
+        return hr;
+
+    hr = CompilePixelShader(definesFlags);
     if (FAILED(hr))
         return hr;
 
+    ID3DBlob* blob = m_pPixelShaderBlobs[definesFlags].Get();
     hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pPixelShaders[definesFlags]);
 
     return hr;
@@ -18,6 +18,11 @@ public:
     ModelShaders();
     ~ModelShaders();
 
+    // Compiles the shared shaders without touching the device, safe on a loader thread.
+    // CreateDeviceDependentResources compiles whatever was not compiled beforehand.
+    HRESULT Compile();
+    HRESULT CompilePixelShader(UINT definesFlags);
+
     HRESULT CreateDeviceDependentResources(ID3D11Device* device);
 
     HRESULT CreatePixelShader(ID3D11Device* device, UINT definesFlags);
@@ -35,4 +40,9 @@ private:
     Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pAnimatedEmissivePixelShader;
 
     std::vector<Microsoft::WRL::ComPtr<ID3D11PixelShader>> m_pPixelShaders;
+
+    Microsoft::WRL::ComPtr<ID3DBlob> m_pVertexShaderBlob;
+    Microsoft::WRL::ComPtr<ID3DBlob> m_pEmissivePixelShaderBlob;
+    Microsoft::WRL::ComPtr<ID3DBlob> m_pAnimatedEmissivePixelShaderBlob;
+    std::vector<Microsoft::WRL::ComPtr<ID3DBlob>> m_pPixelShaderBlobs;
 };
@@ -1,5 +1,7 @@
 #define NUM_LIGHTS 1
 
+#include "FieldAtlas.hlsli"
+
 TextureCube irradianceTexture : register(t0);
 TextureCube prefilteredColorTexture : register(t1);
 Texture2D<float4> preintegratedBRDFTexture : register(t2);
@@ -11,10 +13,10 @@ Texture2D<float4> normalTexture : register(t5);
 Texture2D simpleShadowMapTexture : register(t6);
 Texture2DArray PSSMTexture : register(t7);
 
-Texture2D<float4> layer1Texture : register(t8);
-Texture2D<float4> field1Texture : register(t9);
-Texture2D<float4> layer2Texture : register(t10);
-Texture2D<float4> field2Texture : register(t11);
+// Animated layers and their fields, slice i of layerTextures is layer i
+Texture2DArray<float4> layerTextures : register(t8);
+Texture2DArray<float4> fieldTextures : register(t9); // Atlas pages of the fields and transforms
+Texture2DArray<uint2> fieldTiles : register(t10); // Tile indirection, slice i is field slice i
 
 SamplerState MinMagMipLinear : register(s0);
 SamplerState MinMagLinearMipPointClamp : register(s1);
@@ -63,7 +65,9 @@ cbuffer Shadows : register(b3)
 
 cbuffer AnimatedStuff : register(b4)
 {
-    float4 AnimatedTextureInfo; // x - scale factor, y - width
+    float4 AnimatedTextureInfo; // x - scale factor, yz - field size
+    float4 AnimatedFieldDecode; // xy - uv displacement per sampled field unit (FieldEncoding)
+    uint4 AnimatedFieldSlices[4]; // field slice of layer i in [i / 4][i % 4]
 }
 
 
@@ -244,10 +248,15 @@ float4 GetAlbedo(float2 uv)
     return albedo;
 }
 
-float2 GetAnimatedTextureCoords(in float2 uv)
+float2 GetAnimatedTextureCoords(in float2 uv, unsigned int ind)
 {
-    float dx = field1Texture.Sample(FieldSampler, uv).r;
-    float dy = field1Texture.Sample(FieldSampler, uv).g;
+    uint2 fieldSize = (uint2)AnimatedTextureInfo.yz;
+    uint2 fieldTexel = FieldTexel(uv, fieldSize);
+    uint2 tiles = FieldTiles(fieldTiles, fieldTexel, AnimatedFieldSlices[ind / 4][ind % 4]);
+
+    float2 d = FieldAtlasLoad(fieldTextures, tiles.x, fieldTexel, fieldSize) * AnimatedFieldDecode.xy;
+    float dx = d.x;
+    float dy = d.y;
 
     float2 dstPixCoords = uv;
     float2 srcPixCoords = dstPixCoords + float2(dx, dy);
@@ -256,8 +265,10 @@ float2 GetAnimatedTextureCoords(in float2 uv)
 
     float2 newCoords = uv + t * float2(dx, dy);
 
-    float transformdx = field1Texture.Sample(FieldSampler, uv).b;
-    float transformdy = field1Texture.Sample(FieldSampler, uv).a;
+    // The zero tile where there's no transform
+    float2 transform = FieldAtlasLoad(fieldTextures, tiles.y, fieldTexel, fieldSize) * AnimatedFieldDecode.xy;
+    float transformdx = transform.x;
+    float transformdy = transform.y;
 
     if (transformdx * transformdx + transformdy * transformdy > 0)
     {
@@ -270,13 +281,12 @@ float2 GetAnimatedTextureCoords(in float2 uv)
 
 float4 GetAnimatedTextureAlbedo(float2 uv, unsigned int ind)
 {
-    Texture2D textures[] = { layer1Texture, layer2Texture };
     float4 albedo = Albedo;
 
-    float2 animatedCoords = GetAnimatedTextureCoords(uv);
+    float2 animatedCoords = GetAnimatedTextureCoords(uv, ind);
 
 #ifdef HAS_COLOR_TEXTURE
-    albedo *= textures[ind].Sample(TextureSampler, animatedCoords);
+    albedo *= layerTextures.Sample(TextureSampler, float3(animatedCoords, ind));
 #else
     albedo = pow(albedo, 2.2f);
 #endif
@@ -288,9 +298,9 @@ float4 GetAnimatedTextureAlbedo(float2 uv, unsigned int ind)
 
 float4 GetAlbedoByPixel(float2 uv)
 {
-    float2 animatedCoords = GetAnimatedTextureCoords(uv);
+    float2 animatedCoords = GetAnimatedTextureCoords(uv, 0);
 
-    float4 pix = layer1Texture.Sample(TextureSampler, animatedCoords);
+    float4 pix = layerTextures.Sample(TextureSampler, float3(animatedCoords, 0));
 
     // Color interpolation
     /* {
@@ -1,4 +1,5 @@
 Texture2D<float4> sourceTexture : register(t0);
+Texture2D<float4> adaptedLuminanceTexture : register(t1);
 
 SamplerState MinMagMipLinear : register(s0);
 
@@ -9,6 +10,11 @@ cbuffer AverageLuminanceBuffer : register(b0)
     float AverageLuminance;
 }
 
+cbuffer AdaptationBuffer : register(b1)
+{
+    float DeltaTime;
+}
+
 struct PS_INPUT
 {
     float4 Pos : SV_POSITION;
@@ -35,9 +41,23 @@ float4 ps_luminance_main(PS_INPUT input) : SV_TARGET
     return log(l + 1);
 }
 
+// Same filter as LuminanceAdaptation::Adapt, keeps the adapted luminance on GPU
+float4 ps_adapt_main(PS_INPUT input) : SV_TARGET
+{
+    float luminance = sourceTexture.Load(int3(0, 0, 0)).r;
+    float adapted = adaptedLuminanceTexture.Load(int3(0, 0, 0)).r;
+    float sigma = 0.04f / (0.04f + luminance);
+    float tau = sigma * 0.4f + (1 - sigma) * 0.1f;
+    return adapted + (luminance - adapted) * (1 - exp(-DeltaTime * tau));
+}
+
 float Exposure()
 {
+#ifdef ADAPTED_LUMINANCE_TEXTURE
+    float luminance = adaptedLuminanceTexture.Load(int3(0, 0, 0)).r;
+#else
     float luminance = AverageLuminance;
+#endif
     float keyValue = 1.03 - 2 / (2 + log10(luminance + 1));
     return keyValue / luminance;
 }
@@ -0,0 +1,450 @@
+#include "ReferenceRenderer.h"
+
+#include <assert.h>
+
+#include "FieldSwapper.h"
+#include "LayerBatch.h"
+#include "ThreadPool.h"
+#include "VectorField.h"
+
+namespace
+{
+	size_t constexpr rowsGrain = 8;
+	size_t constexpr tilesGrain = 64;
+
+	// std::floor is a library call without SSE4.1 code generation
+	inline long long Floor(float coord)
+	{
+		long long ind = (long long)coord;
+
+		return (float)ind > coord ? ind - 1 : ind;
+	}
+
+	inline size_t Wrap(float coord, size_t size)
+	{
+		long long ind = Floor(coord);
+
+		if (ind >= 0 && ind < (long long)size)
+		{
+			return (size_t)ind;
+		}
+
+		ind %= (long long)size;
+
+		return (size_t)(ind < 0 ? ind + (long long)size : ind);
+	}
+
+	// Filtering runs on 0..255 channel values, the UNORM target rounds to nearest
+	inline unsigned char ToUnorm(float value)
+	{
+		value = value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+
+		return (unsigned char)(value + 0.5f);
+	}
+
+	inline void SamplePoint(ReferenceRenderer::Image const& image, float u, float v, unsigned char* rgb)
+	{
+		unsigned char const* texel = image.pixels.data() +
+			4 * (Wrap(u * image.width, image.width) + Wrap(v * image.height, image.height) * image.width);
+
+		rgb[0] = texel[0];
+		rgb[1] = texel[1];
+		rgb[2] = texel[2];
+	}
+
+	inline void SampleLinear(ReferenceRenderer::Image const& image, float u, float v, unsigned char* rgb)
+	{
+		float x = u * image.width - 0.5f;
+		float y = v * image.height - 0.5f;
+
+		float x0 = (float)Floor(x);
+		float y0 = (float)Floor(y);
+
+		float fx = x - x0;
+		float fy = y - y0;
+
+		unsigned char const* pixels = image.pixels.data();
+
+		size_t col0 = Wrap(x0, image.width);
+		size_t col1 = Wrap(x0 + 1.0f, image.width);
+		size_t row0 = Wrap(y0, image.height) * image.width;
+		size_t row1 = Wrap(y0 + 1.0f, image.height) * image.width;
+
+		unsigned char const* t00 = pixels + 4 * (col0 + row0);
+		unsigned char const* t10 = pixels + 4 * (col1 + row0);
+		unsigned char const* t01 = pixels + 4 * (col0 + row1);
+		unsigned char const* t11 = pixels + 4 * (col1 + row1);
+
+		float sum[3];
+		for (size_t c = 0; c < 3; ++c)
+		{
+			float top = t00[c] + fx * (t10[c] - t00[c]);
+			float bottom = t01[c] + fx * (t11[c] - t01[c]);
+
+			sum[c] = top + fy * (bottom - top);
+		}
+
+		rgb[0] = ToUnorm(sum[0]);
+		rgb[1] = ToUnorm(sum[1]);
+		rgb[2] = ToUnorm(sum[2]);
+	}
+
+	// Field walk of a pass, LayerBatch::WalkSteps unit steps
+	struct Walk
+	{
+		explicit Walk(int scale) : steps{ LayerBatch::WalkSteps(scale) }, stepScale{ LayerBatch::WalkStepScale(scale) } {}
+
+		int steps;
+		float stepScale;
+	};
+
+	// One thread of TextureShader.hlsl Advect
+	inline void AdvectTexel(ReferenceRenderer::Image const& source, ReferenceRenderer::FieldTexture const& field, Walk const& walk,
+		ReferenceRenderer::Filter filter, ReferenceRenderer::Image& target, size_t px, size_t py)
+	{
+		// Texel center uv, v grows downwards
+		float su = (px + 0.5f) / target.width;
+		float sv = (py + 0.5f) / target.height;
+
+		for (int i = 0; i < walk.steps; ++i)
+		{
+			float const* texel = field.texels + 4 * (Wrap(su * field.width, field.width) + Wrap(sv * field.height, field.height) * field.width);
+
+			su += walk.stepScale * texel[0];
+			sv += walk.stepScale * texel[1];
+		}
+
+		unsigned char* dst = target.pixels.data() + 4 * (px + py * target.width);
+
+		if (filter == ReferenceRenderer::Filter::POINT)
+		{
+			SamplePoint(source, su, sv, dst);
+		}
+		else
+		{
+			SampleLinear(source, su, sv, dst);
+		}
+
+		dst[3] = 255;
+	}
+
+	void RenderRow(ReferenceRenderer::Image const& source, ReferenceRenderer::FieldTexture const& field, Walk const& walk,
+		ReferenceRenderer::Filter filter, ReferenceRenderer::Image& target, size_t py)
+	{
+		for (size_t px = 0; px < target.width; ++px)
+		{
+			AdvectTexel(source, field, walk, filter, target, px, py);
+		}
+	}
+}
+
+ReferenceRenderer::Image::Image() : width{ 0 }, height{ 0 } {}
+
+ReferenceRenderer::Image::Image(size_t width, size_t height) : width{ width }, height{ height }, pixels(4 * width * height, 0) {}
+
+ReferenceRenderer::Image ReferenceRenderer::Image::FromPixels(unsigned char const* pixels, size_t width, size_t height, size_t n)
+{
+	assert(pixels != nullptr && n >= 1 && n <= 4);
+
+	Image image(width, height);
+
+	for (size_t i = 0; i < width * height; ++i)
+	{
+		unsigned char const* src = pixels + n * i;
+		unsigned char* dst = image.pixels.data() + 4 * i;
+
+		dst[0] = src[0];
+		dst[1] = n >= 3 ? src[1] : src[0];
+		dst[2] = n >= 3 ? src[2] : src[0];
+		dst[3] = n == 4 ? src[3] : (n == 2 ? src[1] : 255);
+	}
+
+	return image;
+}
+
+ReferenceRenderer::Layer::Layer(Image const& source, size_t width, size_t height) : m_iSource{ 0 }
+{
+	m_aImages[1] = Image(width, height);
+
+	if (source.width == width && source.height == height)
+	{
+		m_aImages[0] = source;
+		return;
+	}
+
+	// Both slices of a layer array are the texture size, a different source is point resampled to it
+	m_aImages[0] = Image(width, height);
+
+	for (size_t py = 0; py < height; ++py)
+	{
+		for (size_t px = 0; px < width; ++px)
+		{
+			unsigned char* dst = m_aImages[0].pixels.data() + 4 * (px + py * width);
+
+			SamplePoint(source, (px + 0.5f) / width, (py + 0.5f) / height, dst);
+			dst[3] = 255;
+		}
+	}
+}
+
+ReferenceRenderer::Image const& ReferenceRenderer::Layer::Source() const
+{
+	return m_aImages[m_iSource];
+}
+
+ReferenceRenderer::Image& ReferenceRenderer::Layer::Target()
+{
+	return m_aImages[1 - m_iSource];
+}
+
+ReferenceRenderer::Image const& ReferenceRenderer::Layer::Target() const
+{
+	return m_aImages[1 - m_iSource];
+}
+
+void ReferenceRenderer::Layer::Swap()
+{
+	m_iSource = 1 - m_iSource;
+}
+
+ReferenceRenderer::ReferenceRenderer(size_t width, size_t height, Filter textureFilter)
+	: m_iWidth{ width }, m_iHeight{ height }, m_eTextureFilter{ textureFilter } {}
+
+ReferenceRenderer::~ReferenceRenderer()
+{
+	for (auto& layer : m_aLayers)
+	{
+		if (layer)
+		{
+			delete layer;
+		}
+	}
+}
+
+size_t ReferenceRenderer::GetWidth() const
+{
+	return m_iWidth;
+}
+
+size_t ReferenceRenderer::GetHeight() const
+{
+	return m_iHeight;
+}
+
+size_t ReferenceRenderer::AddLayer(Image const& image)
+{
+	m_aLayers.push_back(new Layer(image, m_iWidth, m_iHeight));
+	m_aFields.push_back({ 0, 0, nullptr });
+	m_aOwnedFieldTexels.emplace_back();
+	m_aFieldSwappers.push_back(nullptr);
+
+	return m_aLayers.size() - 1;
+}
+
+size_t ReferenceRenderer::GetLayersNum() const
+{
+	return m_aLayers.size();
+}
+
+ReferenceRenderer::Layer const& ReferenceRenderer::GetLayer(size_t ind) const
+{
+	assert(ind < m_aLayers.size());
+
+	return *m_aLayers[ind];
+}
+
+void ReferenceRenderer::SetField(size_t layer, VectorField const* field)
+{
+	assert(layer < m_aLayers.size() && field != nullptr);
+
+	field->raw_data(m_aOwnedFieldTexels[layer]);
+
+	m_aFields[layer] = { field->Width(), field->Height(), m_aOwnedFieldTexels[layer].data() };
+}
+
+void ReferenceRenderer::SetField(size_t layer, FieldTexture const& field)
+{
+	assert(layer < m_aLayers.size() && field.texels != nullptr);
+
+	m_aOwnedFieldTexels[layer].clear();
+	m_aFields[layer] = field;
+}
+
+void ReferenceRenderer::SetField(size_t layer, VectorField const* field, FieldEncoding::Format format)
+{
+	assert(layer < m_aLayers.size() && field != nullptr);
+
+	size_t width = field->Width();
+	size_t height = field->Height();
+
+	std::vector<unsigned char> encoded;
+	std::vector<float>& texels = m_aOwnedFieldTexels[layer];
+	texels.assign(4 * width * height, 0.0f);
+
+	// The texels of a *.vfb in this format are decoded from the mapping as the GPU path uploads them
+	unsigned char const* mapped = field->mapped_texels(format);
+	auto encode = [&](FieldStorage const& storage)
+	{
+		encoded.resize(FieldEncoding::TexelSize(format) * width * height);
+		FieldEncoding::Encode(storage, format, encoded.data());
+
+		return encoded.data();
+	};
+
+	// Displacement in rg, transform in ba as raw_data() lays them out, a zero transform stays zero
+	FieldEncoding::Decode(format, mapped != nullptr ? mapped : encode(field->Storage()), width, height, texels.data(), 4);
+
+	if (mapped == nullptr)
+	{
+		FieldEncoding::Decode(format, encode(field->TransformStorage()), width, height, texels.data() + 2, 4);
+	}
+	else if (unsigned char const* transform = field->mapped_transform_texels(format))
+	{
+		FieldEncoding::Decode(format, transform, width, height, texels.data() + 2, 4);
+	}
+
+	m_aFields[layer] = { width, height, texels.data() };
+}
+
+size_t ReferenceRenderer::AddFieldSlice(FieldTexture const& field)
+{
+	assert(field.texels != nullptr);
+
+	m_aFieldSlices.push_back(field);
+
+	return m_aFieldSlices.size() - 1;
+}
+
+void ReferenceRenderer::SetFieldSwapper(size_t layer, FieldSwapper* swapper)
+{
+	assert(layer < m_aLayers.size());
+
+	m_aFieldSwappers[layer] = swapper;
+}
+
+void ReferenceRenderer::Advance(size_t steps, bool tiles)
+{
+	std::vector<FieldSwapper*> swappers;
+	for (auto& swapper : m_aFieldSwappers)
+	{
+		if (swapper)
+		{
+			swappers.push_back(swapper);
+		}
+	}
+
+	while (steps > 0)
+	{
+		for (size_t i = 0; i < m_aLayers.size(); ++i)
+		{
+			if (m_aFieldSwappers[i])
+			{
+				assert(m_aFieldSwappers[i]->CurrentFieldSlice() < m_aFieldSlices.size());
+				m_aFields[i] = m_aFieldSlices[m_aFieldSwappers[i]->CurrentFieldSlice()];
+			}
+		}
+
+		size_t passSteps = LayerBatch::PassSteps(steps, swappers);
+
+		if (tiles)
+		{
+			RenderTiles((int)passSteps);
+		}
+		else
+		{
+			Render((int)passSteps);
+		}
+		Swap();
+
+		for (auto& swapper : swappers)
+		{
+			swapper->IncStep(passSteps);
+		}
+
+		steps -= passSteps;
+	}
+}
+
+void ReferenceRenderer::Render(int scale)
+{
+	for (size_t i = 0; i < m_aLayers.size(); ++i)
+	{
+		assert(m_aFields[i].texels != nullptr);
+	}
+
+	Walk walk(scale);
+
+	ThreadPool::Get().ParallelFor(0, m_aLayers.size() * m_iHeight, rowsGrain, [&](size_t rowBegin, size_t rowEnd)
+		{
+			for (size_t row = rowBegin; row < rowEnd; ++row)
+			{
+				Layer* layer = m_aLayers[row / m_iHeight];
+
+				RenderRow(layer->Source(), m_aFields[row / m_iHeight], walk, m_eTextureFilter, layer->Target(), row % m_iHeight);
+			}
+		});
+}
+
+void ReferenceRenderer::RenderTiles(int scale)
+{
+	LayerBatch::Constants constants = {};
+	constants.scale = scale;
+	constants.layersNum = (uint32_t)m_aLayers.size();
+	constants.width = (uint32_t)m_iWidth;
+	constants.height = (uint32_t)m_iHeight;
+
+	LayerBatch::Groups groups = LayerBatch::GroupsNum(constants);
+	size_t groupSize = LayerBatch::groupSize;
+
+	Walk walk(scale);
+
+	ThreadPool::Get().ParallelFor(0, (size_t)groups.x * groups.y * groups.z, tilesGrain, [&](size_t groupBegin, size_t groupEnd)
+		{
+			for (size_t group = groupBegin; group < groupEnd; ++group)
+			{
+				size_t layer = group / ((size_t)groups.x * groups.y);
+				size_t tileX = group % groups.x * groupSize;
+				size_t tileY = group / groups.x % groups.y * groupSize;
+
+				assert(m_aFields[layer].texels != nullptr);
+
+				// SV_DispatchThreadID of every thread in the group, out of range ones return early
+				for (size_t py = tileY; py < tileY + groupSize; ++py)
+				{
+					for (size_t px = tileX; px < tileX + groupSize; ++px)
+					{
+						if (px >= m_iWidth || py >= m_iHeight)
+						{
+							continue;
+						}
+
+						AdvectTexel(m_aLayers[layer]->Source(), m_aFields[layer], walk, m_eTextureFilter, m_aLayers[layer]->Target(), px, py);
+					}
+				}
+			}
+		});
+}
+
+void ReferenceRenderer::Swap()
+{
+	for (auto& layer : m_aLayers)
+	{
+		layer->Swap();
+	}
+}
+
+void ReferenceRenderer::RenderLayer(Image const& source, FieldTexture const& field, int scale, Filter filter, Image& target)
+{
+	assert(&source != &target && source.width > 0 && source.height > 0);
+	assert(field.width > 0 && field.height > 0);
+
+	Walk walk(scale);
+
+	ThreadPool::Get().ParallelFor(0, target.height, rowsGrain, [&](size_t rowBegin, size_t rowEnd)
+		{
+			for (size_t py = rowBegin; py < rowEnd; ++py)
+			{
+				RenderRow(source, field, walk, filter, target, py);
+			}
+		});
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "FieldEncoding.h"
+
+class FieldSwapper;
+class VectorField;
+
+// CPU implementation of the AnimatedTexture layer pass (TextureShader.hlsl Advect):
+// every target texel walks `scale` steps through the field from its uv, each one displaced
+// by the field where the previous ended (at most LayerBatch::maxWalkSteps of them),
+// and samples its layer where the walk ends. One step is uv + field(uv).
+// Advance runs longer catch-ups through field sequences as AnimationSystem::Update does.
+// The field is point sampled, the layer with point or bilinear filtering, both with WRAP
+// addressing and from the top mip only. Layers are RGBA8 as the R8G8B8A8_UNORM layer arrays.
+// No D3D dependency, meant for offline baking, golden images and benchmarks.
+class ReferenceRenderer
+{
+public:
+	enum class Filter
+	{
+		POINT = 0,
+		LINEAR = 1
+	};
+
+	struct Image
+	{
+		Image();
+		Image(size_t width, size_t height);
+
+		// Expands 1-4 channel 8 bit pixels to RGBA, missing alpha is opaque
+		static Image FromPixels(unsigned char const* pixels, size_t width, size_t height, size_t n);
+
+		size_t width;
+		size_t height;
+		std::vector<unsigned char> pixels;
+	};
+
+	// float4 texels in VectorField::raw_data() layout, not owned
+	struct FieldTexture
+	{
+		size_t width;
+		size_t height;
+		float const* texels;
+	};
+
+	// Source/target pair of a layer, mirrors the AnimatedTexture layer arrays
+	class Layer
+	{
+	public:
+		Layer(Image const& source, size_t width, size_t height);
+
+		Image const& Source() const;
+		Image& Target();
+		Image const& Target() const;
+
+		void Swap();
+
+	private:
+		Image m_aImages[2];
+		size_t m_iSource;
+	};
+
+public:
+	ReferenceRenderer(size_t width, size_t height, Filter textureFilter = Filter::LINEAR);
+	~ReferenceRenderer();
+
+	size_t GetWidth() const;
+	size_t GetHeight() const;
+
+	// An image of another size is point resampled to the renderer size
+	size_t AddLayer(Image const& image);
+	size_t GetLayersNum() const;
+	Layer const& GetLayer(size_t ind) const;
+
+	// Copies raw_data()
+	void SetField(size_t layer, VectorField const* field);
+	void SetField(size_t layer, FieldTexture const& field);
+	// As AnimatedTexture uploads it: quantized to `format`, or the texels a mapped *.vfb holds in it,
+	// and decoded as the shaders decode it
+	void SetField(size_t layer, VectorField const* field, FieldEncoding::Format format);
+
+	// Field array of the swappers, the texels are not owned. Returns the slice index.
+	size_t AddFieldSlice(FieldTexture const& field);
+	// The layer plays the field sequence of `swapper`, whose slices come from AddFieldSlice.
+	// Every layer needs a swapper of its own as in AnimatedTexture, nullptr goes back to SetField.
+	void SetFieldSwapper(size_t layer, FieldSwapper* swapper);
+
+	// Advects by `steps` as AnimationSystem::Update catches up: passes of LayerBatch::PassSteps
+	// with the current field of every layer, each one swapped and followed by stepping the swappers
+	void Advance(size_t steps, bool tiles = false);
+
+	// One AnimatedTexture::Render call advecting by `scale` steps, |scale| <= LayerBatch::maxWalkSteps: source -> target for every layer,
+	// rows of all layers are spread over the pool as the dispatch spreads its groups
+	void Render(int scale);
+
+	// Same result as Render, run as the compute path runs it: 8x8 thread groups per layer
+	// with the bounds check of TextureShader.hlsl CS
+	void RenderTiles(int scale);
+	void Swap();
+
+	static void RenderLayer(Image const& source, FieldTexture const& field, int scale, Filter filter, Image& target);
+
+private:
+	size_t m_iWidth;
+	size_t m_iHeight;
+	Filter m_eTextureFilter;
+
+	std::vector<Layer*> m_aLayers;
+	std::vector<FieldTexture> m_aFields;
+	std::vector<std::vector<float>> m_aOwnedFieldTexels;
+
+	std::vector<FieldTexture> m_aFieldSlices;
+	std::vector<FieldSwapper*> m_aFieldSwappers; // Per layer, nullptr for a SetField layer
+};
@@ -4,11 +4,15 @@
 
 #include <math.h>
 #include <vector>
-#include <chrono>
+#include <mutex>
 
 #include "Renderer.h"
 #include "Utils.h"
 #include "Artorias.h"
+#include "AllocationCounter.h"
+#include "IBLCache.h"
+#include "JobGraph.h"
+#include "ShaderCache.h"
 
 #include "../../stb_image.h"
 #include "../../DDSTextureLoader11.h"
@@ -18,18 +22,55 @@ const float sphereRadius = 0.5f;
 const UINT cubeSize = 512;
 const UINT irradianceSize = 32;
 const UINT prefilteredColorSize = 128;
+const UINT prefilteredColorMipLevels = 5;
 const UINT preintegratedBRDFSize = 128;
 const UINT simpleShadowMapSize = 1024;
 const UINT PSSMSize = 1024;
 const float PSSMSplit = 250.0f;
 const float projectionNear = 0.1f;
 const float projectionFar = 10000.0f;
+const UINT drawWarmUpFrames = 2;
+const std::string iblCacheDirectory = "IBLCache";
+
+namespace
+{
+    IBLCache::Parameters IBLParameters()
+    {
+        IBLCache::Parameters parameters;
+        parameters.cubeSize = cubeSize;
+        parameters.irradianceSize = irradianceSize;
+        parameters.prefilteredColorSize = prefilteredColorSize;
+        parameters.prefilteredColorMipLevels = prefilteredColorMipLevels;
+        parameters.preintegratedBRDFSize = preintegratedBRDFSize;
+        return parameters;
+    }
+
+    // Order of the cached files in LoadedAssets::iblCacheFiles
+    const IBLCache::TEXTURE iblTextures[] =
+    {
+        IBLCache::TEXTURE::ENVIRONMENT_CUBE,
+        IBLCache::TEXTURE::IRRADIANCE,
+        IBLCache::TEXTURE::PREFILTERED_COLOR,
+        IBLCache::TEXTURE::PREINTEGRATED_BRDF
+    };
+
+    HRESULT CompilePlanePixelShader(ID3DBlob** blob)
+    {
+        D3D_SHADER_MACRO defines[] =
+        {
+            { "HAS_COLOR_TEXTURE", "1" },
+            { nullptr, nullptr }
+        };
+        return CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", blob, defines);
+    }
+}
 
 Renderer::Renderer(const std::shared_ptr<DeviceResources>& deviceResources, const std::shared_ptr<Camera>& camera, const std::shared_ptr<Settings>& settings) :
     m_pDeviceResources(deviceResources),
     m_pCamera(camera),
     m_pSettings(settings),
     m_frameCount(0),
+    m_drawAllocations(0),
     m_indexCount(0),
     m_planeIndexCount(0),
     m_constantBufferData(),
@@ -40,7 +81,7 @@ Renderer::Renderer(const std::shared_ptr<DeviceResources>& deviceResources, cons
     m_sceneRadius(0)
 {};
 
-HRESULT Renderer::CreateShaders()
+HRESULT Renderer::CreateShaders(ID3DBlob* planePixelShaderBlob)
 {
     HRESULT hr = S_OK;
 
@@ -138,16 +179,14 @@ HRESULT Renderer::CreateShaders()
     if (FAILED(hr))
         return hr;
 
-    // Create the pixel shader for plane
-    D3D_SHADER_MACRO defines[] =
+    // Create the pixel shader for plane, the loading jobs compile it ahead when they can
+    Microsoft::WRL::ComPtr<ID3DBlob> blob = planePixelShaderBlob;
+    if (!blob)
     {
-        { "HAS_COLOR_TEXTURE", "1" },
-        { nullptr, nullptr }
-    };
-    Microsoft::WRL::ComPtr<ID3DBlob> blob;
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &blob, defines);
-    if (FAILED(hr))
-        return hr;
+        hr = CompilePlanePixelShader(&blob);
+        if (FAILED(hr))
+            return hr;
+    }
     hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pPlanePixelShader);
     if (FAILED(hr))
         return hr;
@@ -285,30 +324,32 @@ HRESULT Renderer::CreatePlane()
     return hr;
 }
 
-HRESULT Renderer::CreateTexture()
+HRESULT Renderer::CreateEnvironmentTexture(const float* texels, int width, int height)
 {
     HRESULT hr = S_OK;
 
-    int w, h, n;
-    float* data = stbi_loadf("env.hdr", &w, &h, &n, STBI_rgb_alpha);
-    if (data == nullptr)
-        return E_FAIL;
-
     ID3D11Device* device = m_pDeviceResources->GetDevice();
 
-    CD3D11_TEXTURE2D_DESC td(DXGI_FORMAT_R32G32B32A32_FLOAT, w, h, 1, 1, D3D11_BIND_SHADER_RESOURCE);
+    CD3D11_TEXTURE2D_DESC td(DXGI_FORMAT_R32G32B32A32_FLOAT, width, height, 1, 1, D3D11_BIND_SHADER_RESOURCE);
     D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = data;
-    initData.SysMemPitch = 4 * w * sizeof(float);
+    initData.pSysMem = texels;
+    initData.SysMemPitch = 4 * width * sizeof(float);
+    initData.SysMemSlicePitch = 0;
     hr = device->CreateTexture2D(&td, &initData, &m_pEnvironmentTexture);
-    stbi_image_free(data);
     if (FAILED(hr))
         return hr;
 
     CD3D11_SHADER_RESOURCE_VIEW_DESC srvd(D3D11_SRV_DIMENSION_TEXTURE2D, td.Format);
     hr = device->CreateShaderResourceView(m_pEnvironmentTexture.Get(), &srvd, &m_pEnvironmentShaderResourceView);
-    if (FAILED(hr))
-        return hr;
+
+    return hr;
+}
+
+HRESULT Renderer::CreateSamplers()
+{
+    HRESULT hr = S_OK;
+
+    ID3D11Device* device = m_pDeviceResources->GetDevice();
 
     m_pSamplerStates.resize(4);
     D3D11_SAMPLER_DESC sd;
@@ -346,6 +387,165 @@ HRESULT Renderer::CreateTexture()
     return hr;
 }
 
+HRESULT Renderer::LoadIBLSource(LoadedAssets& assets)
+{
+    if (!IBLCache::ReadFile("env.hdr", assets.environmentHdr))
+        return E_FAIL;
+
+    // A missing source still hashes (as empty), the cache is only ever a shortcut
+    std::vector<std::vector<unsigned char>> shaderSources;
+    for (const auto& name : IBLCache::ShaderSources())
+    {
+        shaderSources.emplace_back();
+        IBLCache::ReadFile(srcPath + name, shaderSources.back());
+    }
+
+    assets.iblKey = IBLCache::Key(assets.environmentHdr, shaderSources, IBLParameters());
+
+    std::vector<std::vector<unsigned char>> files(ARRAYSIZE(iblTextures));
+    bool cached = true;
+    for (size_t i = 0; i < files.size() && cached; ++i)
+        cached = IBLCache::ReadFile(IBLCache::Path(iblCacheDirectory, assets.iblKey, iblTextures[i]), files[i]);
+
+    if (cached)
+    {
+        assets.iblCacheFiles = std::move(files);
+        return S_OK;
+    }
+
+    return DecodeEnvironment(assets);
+}
+
+HRESULT Renderer::DecodeEnvironment(LoadedAssets& assets)
+{
+    const std::vector<unsigned char>& hdr = assets.environmentHdr;
+
+    int w, h, n;
+    float* data = stbi_loadf_from_memory(hdr.data(), static_cast<int>(hdr.size()), &w, &h, &n, STBI_rgb_alpha);
+    if (data == nullptr)
+        return E_FAIL;
+
+    assets.environment = std::shared_ptr<float>(data, stbi_image_free);
+    assets.environmentWidth = w;
+    assets.environmentHeight = h;
+
+    return S_OK;
+}
+
+HRESULT Renderer::CreateIBLTextures(LoadedAssets& assets)
+{
+    HRESULT hr = S_OK;
+
+    if (!assets.iblCacheFiles.empty() && SUCCEEDED(LoadIBLTextures(assets.iblCacheFiles)))
+        return hr;
+
+    // A cache that read but did not load falls back to the bake with the source decoded here
+    if (!assets.environment)
+    {
+        hr = DecodeEnvironment(assets);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    hr = CreateEnvironmentTexture(assets.environment.get(), assets.environmentWidth, assets.environmentHeight);
+    if (FAILED(hr))
+        return hr;
+
+    hr = CreateCubeTexture();
+    if (FAILED(hr))
+        return hr;
+
+    hr = CreateIrradianceTexture();
+    if (FAILED(hr))
+        return hr;
+
+    hr = CreatePrefilteredColorTexture();
+    if (FAILED(hr))
+        return hr;
+
+    hr = CreatePreintegratedBRDFTexture();
+    if (FAILED(hr))
+        return hr;
+
+    // Failing to store the cache only costs the next start another bake
+    SaveIBLTextures(assets.iblKey);
+
+    return hr;
+}
+
+HRESULT Renderer::LoadIBLTextures(const std::vector<std::vector<unsigned char>>& files)
+{
+    HRESULT hr = S_OK;
+
+    ID3D11Device* device = m_pDeviceResources->GetDevice();
+
+    // Same order as iblTextures
+    struct
+    {
+        Microsoft::WRL::ComPtr<ID3D11Texture2D>* pTexture;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* pShaderResourceView;
+    } targets[] =
+    {
+        { &m_pEnvironmentCubeTexture, &m_pEnvironmentCubeShaderResourceView },
+        { &m_pIrradianceTexture, &m_pIrradianceShaderResourceView },
+        { &m_pPrefilteredColorTexture, &m_pPrefilteredColorShaderResourceView },
+        { &m_pPreintegratedBRDFTexture, &m_pPreintegratedBRDFShaderResourceView }
+    };
+
+    if (files.size() != ARRAYSIZE(targets))
+        return E_INVALIDARG;
+
+    for (size_t i = 0; i < ARRAYSIZE(targets); ++i)
+    {
+        auto& target = targets[i];
+
+        Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+        hr = DirectX::CreateDDSTextureFromMemoryEx(device, files[i].data(), files[i].size(), 0,
+            D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, false, &resource, target.pShaderResourceView->ReleaseAndGetAddressOf());
+        if (SUCCEEDED(hr))
+            hr = resource.As(target.pTexture);
+
+        if (FAILED(hr))
+        {
+            for (auto& loaded : targets)
+            {
+                loaded.pTexture->Reset();
+                loaded.pShaderResourceView->Reset();
+            }
+            return hr;
+        }
+    }
+
+    return hr;
+}
+
+HRESULT Renderer::SaveIBLTextures(uint64_t key)
+{
+    HRESULT hr = S_OK;
+
+    if (!CreateDirectoryA(iblCacheDirectory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    ID3D11Device* device = m_pDeviceResources->GetDevice();
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+
+    hr = SaveTextureToDDS(device, context, m_pEnvironmentCubeTexture.Get(), IBLCache::Path(iblCacheDirectory, key, IBLCache::TEXTURE::ENVIRONMENT_CUBE));
+    if (FAILED(hr))
+        return hr;
+
+    hr = SaveTextureToDDS(device, context, m_pIrradianceTexture.Get(), IBLCache::Path(iblCacheDirectory, key, IBLCache::TEXTURE::IRRADIANCE));
+    if (FAILED(hr))
+        return hr;
+
+    hr = SaveTextureToDDS(device, context, m_pPrefilteredColorTexture.Get(), IBLCache::Path(iblCacheDirectory, key, IBLCache::TEXTURE::PREFILTERED_COLOR));
+    if (FAILED(hr))
+        return hr;
+
+    hr = SaveTextureToDDS(device, context, m_pPreintegratedBRDFTexture.Get(), IBLCache::Path(iblCacheDirectory, key, IBLCache::TEXTURE::PREINTEGRATED_BRDF));
+
+    return hr;
+}
+
 HRESULT Renderer::CreateCubeTextureFromResource(UINT size, ID3D11Texture2D* dst, ID3D11ShaderResourceView* src, ID3D11VertexShader* vs, ID3D11PixelShader* ps, UINT mipSlice)
 {
     HRESULT hr = S_OK;
@@ -510,9 +710,7 @@ HRESULT Renderer::CreatePrefilteredColorTexture()
 {
     HRESULT hr = S_OK;
 
-    float roughness[5] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f };
-
-    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32G32B32A32_FLOAT, prefilteredColorSize, prefilteredColorSize, 6, ARRAYSIZE(roughness),
+    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32G32B32A32_FLOAT, prefilteredColorSize, prefilteredColorSize, 6, prefilteredColorMipLevels,
         D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, 1, 0, D3D11_RESOURCE_MISC_TEXTURECUBE);
     hr = m_pDeviceResources->GetDevice()->CreateTexture2D(&td, nullptr, &m_pPrefilteredColorTexture);
     if (FAILED(hr))
@@ -522,7 +720,7 @@ HRESULT Renderer::CreatePrefilteredColorTexture()
     context->PSSetConstantBuffers(1, 1, m_pMaterialBuffer.GetAddressOf());
     for (UINT i = 0; i < td.MipLevels; ++i)
     {
-        m_materialBufferData.Roughness = roughness[i];
+        m_materialBufferData.Roughness = IBLCache::PrefilteredColorRoughness(i, td.MipLevels);
         context->UpdateSubresource(m_pMaterialBuffer.Get(), 0, nullptr, &m_materialBufferData, 0, 0);
 
         hr = CreateCubeTextureFromResource(prefilteredColorSize / (UINT)pow(2, i), m_pPrefilteredColorTexture.Get(), m_pEnvironmentCubeShaderResourceView.Get(),
@@ -634,16 +832,10 @@ void Renderer::UpdatePerspective()
     );
 }
 
-HRESULT Renderer::CreateModels()
+void Renderer::AddModels()
 {
-    HRESULT hr = S_OK;
-
-    ID3D11Device* device = m_pDeviceResources->GetDevice();
-
     m_pModelShaders = std::shared_ptr<ModelShaders>(new ModelShaders());
-    hr = m_pModelShaders->CreateDeviceDependentResources(device);
-    if (FAILED(hr))
-        return hr;
+    m_pModels.clear();
 
     DirectX::XMMATRIX translation;
     DirectX::XMMATRIX rotation;
@@ -657,56 +849,16 @@ HRESULT Renderer::CreateModels()
     Artorias* artorias = new Artorias("artorias/scene.gltf", m_pModelShaders,
         DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale));
 
-	m_pModels.push_back(std::unique_ptr<Model>(artorias));
-	hr = m_pModels[0]->CreateDeviceDependentResources(device);
-	if (FAILED(hr))
-		return hr;
-
-    {
-        m_pAnimatedTexture = std::make_shared<AnimatedTexture>(device, m_pDeviceResources->GetDeviceContext(), 2048, 2048);
-        assert(m_pAnimatedTexture != nullptr);
-
-        if (m_pAnimatedTexture == nullptr)
-            return S_FALSE;
-
-        hr = m_pAnimatedTexture->AddBackgroundByName(srcPath + "Assets//NewMat//Sword.jpg");
-        assert(SUCCEEDED(hr));
-
-        hr = m_pAnimatedTexture->AddLayerByName(srcPath + "Assets//NewMat//Mat1.jpg");
-        assert(SUCCEEDED(hr));
-
-        {
-            FieldSwapper* swapper = new FieldSwapper();
-            VectorField* vectorField = VectorField::loadFromFile(srcPath + "Assets//NewMat//Fields//matnorm.fld");
-            assert(vectorField != nullptr);
-
-            vectorField->AddDots4();
-            m_pAnimatedTexture->CreateVectorFieldTexture(vectorField, swapper);
-            swapper->SetUpStepPerFiled({ 1000 });
-            swapper->SetUpInterpolateType({ 0 });
-
-            delete vectorField;
-
-            m_pAnimatedTexture->SetUpFields({ swapper });
-        }
-
-        hr = m_pAnimatedTexture->CreateAnimationTextureResources(srcPath + "TextureShader.hlsl", srcPath + "TextureShader.hlsl");
-        assert(SUCCEEDED(hr));
+    // The sword samples the animated texture, see CreateAnimatedTexture
+    artorias->AnimateMaterial("Mat_Sword");
 
-        if (FAILED(hr))
-            return S_FALSE;
-
-        artorias->SetAnimatedTexture(m_pAnimatedTexture, 3);
-    }
+	m_pModels.push_back(std::unique_ptr<Model>(artorias));
 
     /*translation = DirectX::XMMatrixTranslation(0, 0, 0);
     rotation = DirectX::XMMatrixRotationY(static_cast<float>(M_PI_2));
     scale = DirectX::XMMatrixScaling(1.0f, 1.0f, 1.0f);
     m_pModels.push_back(std::unique_ptr<Model>(new Model("dragon_head/scene.gltf", m_pModelShaders,
-        DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));
-    hr = m_pModels[0]->CreateDeviceDependentResources(device);
-    if (FAILED(hr))
-        return hr;*/
+        DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));*/
 
     // AAV TEMP
     /*translation = DirectX::XMMatrixTranslation(0, 0.5f, 1000);
@@ -714,32 +866,38 @@ HRESULT Renderer::CreateModels()
     scale = DirectX::XMMatrixScaling(0.12f, 0.12f, 0.12f);
     m_pModels.push_back(std::unique_ptr<Model>(new Model("car_scene/scene.gltf", m_pModelShaders,
         DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));
-    hr = m_pModels[0]->CreateDeviceDependentResources(device);
-    if (FAILED(hr))
-        return hr;
 
     translation = DirectX::XMMatrixTranslation(25, -5.43f, 10);
     rotation = DirectX::XMMatrixRotationY(static_cast<float>(-M_PI_2));
     scale = DirectX::XMMatrixScaling(10, 10, 10);
     m_pModels.push_back(std::unique_ptr<Model>(new Model("msz-006/scene.gltf", m_pModelShaders,
         DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));
-    hr = m_pModels[1]->CreateDeviceDependentResources(device);
-    if (FAILED(hr))
-        return hr;
 
     translation = DirectX::XMMatrixTranslation(-200, 300, 500);
     scale = DirectX::XMMatrixScaling(0.3f, 0.3f, 0.3f);
     m_pModels.push_back(std::unique_ptr<Model>(new Model("spitfire/scene.gltf", m_pModelShaders, DirectX::XMMatrixMultiply(translation, scale))));
-    hr = m_pModels[2]->CreateDeviceDependentResources(device);
-    if (FAILED(hr))
-        return hr;
 
     translation = DirectX::XMMatrixTranslation(0, 0.566f, 0);
     scale = DirectX::XMMatrixScaling(100, 100, 100);
-    m_pModels.push_back(std::unique_ptr<Model>(new Model("red_barn/scene.gltf", m_pModelShaders, DirectX::XMMatrixMultiply(translation, scale))));
-    hr = m_pModels[3]->CreateDeviceDependentResources(device);
+    m_pModels.push_back(std::unique_ptr<Model>(new Model("red_barn/scene.gltf", m_pModelShaders, DirectX::XMMatrixMultiply(translation, scale))));*/
+}
+
+HRESULT Renderer::CreateModels()
+{
+    HRESULT hr = S_OK;
+
+    ID3D11Device* device = m_pDeviceResources->GetDevice();
+
+    hr = m_pModelShaders->CreateDeviceDependentResources(device);
     if (FAILED(hr))
-        return hr;*/
+        return hr;
+
+    for (std::unique_ptr<Model>& model : m_pModels)
+    {
+        hr = model->CreateDeviceDependentResources(device);
+        if (FAILED(hr))
+            return hr;
+    }
 
     DirectX::XMVECTOR maxPosition = DirectX::XMVectorSet(-INFINITY, -INFINITY, -INFINITY, 0);
     DirectX::XMVECTOR minPosition = DirectX::XMVectorSet(INFINITY, INFINITY, INFINITY, 0);
@@ -760,6 +918,51 @@ HRESULT Renderer::CreateModels()
     return hr;
 }
 
+HRESULT Renderer::CreateAnimatedTexture(LoadedAssets& assets)
+{
+    HRESULT hr = S_OK;
+
+    ID3D11Device* device = m_pDeviceResources->GetDevice();
+
+    m_pAnimationSystem = std::unique_ptr<AnimationSystem>(new AnimationSystem(device, m_pDeviceResources->GetDeviceContext(), AnimationSystem::Path::COMPUTE));
+
+    hr = m_pAnimationSystem->CreateResources({
+        "TextureComputeShader.cso", "TextureVertexShader.cso", "TexturePixelShader.cso", srcPath + "TextureShader.hlsl" });
+    assert(SUCCEEDED(hr));
+
+    if (FAILED(hr))
+        return S_FALSE;
+
+    std::shared_ptr<AnimatedTexture> animatedTexture = m_pAnimationSystem->CreateTexture("Mat_Sword", 2048, 2048);
+    assert(animatedTexture != nullptr);
+
+    if (animatedTexture == nullptr)
+        return S_FALSE;
+
+    hr = animatedTexture->AddBackground(assets.background);
+    assert(SUCCEEDED(hr));
+
+    hr = animatedTexture->AddLayer(assets.layer);
+    assert(SUCCEEDED(hr));
+
+    {
+        FieldSwapper* swapper = new FieldSwapper();
+
+        animatedTexture->CreateVectorFieldTexture(assets.vectorField.get(), swapper);
+        swapper->SetUpStepPerFiled({ 1000 });
+        swapper->SetUpInterpolateType({ 0 });
+
+        assets.vectorField.reset();
+
+        animatedTexture->SetUpFields({ swapper });
+    }
+
+    hr = m_pModels[0]->BindAnimatedTextures(device, *m_pAnimationSystem);
+    assert(SUCCEEDED(hr));
+
+    return hr;
+}
+
 HRESULT Renderer::CreateShadows()
 {
     HRESULT hr = S_OK;
@@ -816,59 +1019,117 @@ HRESULT Renderer::CreateDeviceDependentResources()
 {
     HRESULT hr = S_OK;
 
-    hr = CreateShaders();
-    if (FAILED(hr))
-        return hr;
+    LoadedAssets assets;
+    AddModels();
 
-    hr = CreateSphere();
-    if (FAILED(hr))
-        return hr;
+    // The first failure is the one reported, everything depending on it is skipped
+    std::mutex errorMutex;
+    auto job = [&hr, &errorMutex](std::function<HRESULT()> body) -> std::function<bool()>
+    {
+        return [&hr, &errorMutex, body]()
+        {
+            HRESULT result = body();
+            if (FAILED(result))
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (SUCCEEDED(hr))
+                    hr = result;
+            }
+            return SUCCEEDED(result);
+        };
+    };
 
-    hr = CreatePlane();
-    if (FAILED(hr))
-        return hr;
+    JobGraph jobs;
 
-    hr = CreateTexture();
-    if (FAILED(hr))
-        return hr;
+    // File reads, decoding, parsing and shader compilation run on the workers
+    JobGraph::JobId iblSource = jobs.Add("ibl source", job([&]() { return LoadIBLSource(assets); }));
+    JobGraph::JobId planeShader = jobs.Add("plane shader", job([&]() { return CompilePlanePixelShader(&assets.planePixelShaderBlob); }));
+    JobGraph::JobId modelShaders = jobs.Add("model shaders", job([&]() { return m_pModelShaders->Compile(); }));
 
-    hr = CreateCubeTexture();
-    if (FAILED(hr))
-        return hr;
+    JobGraph::JobId gltf = jobs.Add("gltf", job([&]()
+    {
+        for (std::unique_ptr<Model>& model : m_pModels)
+        {
+            HRESULT result = model->Load();
+            if (FAILED(result))
+                return result;
+        }
+        return S_OK;
+    }));
 
-    hr = CreateLights();
-    if (FAILED(hr))
-        return hr;
+    // One job for all models, materials of different models share shader variants
+    JobGraph::JobId materialShaders = jobs.Add("material shaders", job([&]()
+    {
+        for (std::unique_ptr<Model>& model : m_pModels)
+        {
+            HRESULT result = model->CompileShaders();
+            if (FAILED(result))
+                return result;
+        }
+        return S_OK;
+    }), { gltf });
 
-    hr = CreateIrradianceTexture();
-    if (FAILED(hr))
-       return hr;
+    JobGraph::JobId background = jobs.Add("background image", job([&]()
+    {
+        return ImageImport::Load(srcPath + "Assets//NewMat//Sword.jpg", assets.background) ? S_OK : E_FAIL;
+    }));
 
-    hr = CreatePrefilteredColorTexture();
-    if (FAILED(hr))
-        return hr;
+    JobGraph::JobId layer = jobs.Add("layer image", job([&]()
+    {
+        return ImageImport::Load(srcPath + "Assets//NewMat//Mat1.jpg", assets.layer) ? S_OK : E_FAIL;
+    }));
 
-    hr = CreatePreintegratedBRDFTexture();
-    if (FAILED(hr))
-        return hr;
+    JobGraph::JobId field = jobs.Add("vector field", job([&]()
+    {
+        assets.vectorField.reset(VectorField::loadFromFile(srcPath + "Assets//NewMat//Fields//matnorm.fld"));
+        if (!assets.vectorField)
+            return E_FAIL;
 
-    hr = CreateModels();
-    if (FAILED(hr))
-        return hr;
+        assets.vectorField->AddDots4();
 
-    m_pBloom = std::unique_ptr<BloomProcess>(new BloomProcess());
-    hr = m_pBloom->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
-    if (FAILED(hr))
-        return hr;
+        // Only the moving tiles are kept and uploaded
+        assets.vectorField->Compact();
+        return S_OK;
+    }));
+
+    // Everything touching the device stays on this thread
+    const JobGraph::THREAD main = JobGraph::THREAD::MAIN;
+
+    JobGraph::JobId shaders = jobs.Add("shaders", job([&]() { return CreateShaders(assets.planePixelShaderBlob.Get()); }), { planeShader }, main);
+    jobs.Add("sphere", job([&]() { return CreateSphere(); }), {}, main);
+    jobs.Add("plane", job([&]() { return CreatePlane(); }), {}, main);
+    JobGraph::JobId samplers = jobs.Add("samplers", job([&]() { return CreateSamplers(); }), {}, main);
+    jobs.Add("lights", job([&]() { return CreateLights(); }), {}, main);
+    jobs.Add("ibl textures", job([&]() { return CreateIBLTextures(assets); }), { iblSource, shaders, samplers }, main);
+
+    JobGraph::JobId models = jobs.Add("models", job([&]() { return CreateModels(); }), { modelShaders, materialShaders }, main);
+    jobs.Add("animated texture", job([&]() { return CreateAnimatedTexture(assets); }), { models, background, layer, field }, main);
+
+    jobs.Add("bloom", job([&]()
+    {
+        m_pBloom = std::unique_ptr<BloomProcess>(new BloomProcess());
+        return m_pBloom->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
+    }), {}, main);
+
+    jobs.Add("tone map", job([&]()
+    {
+        m_pToneMap = std::unique_ptr<ToneMapPostProcess>(new ToneMapPostProcess());
+        return m_pToneMap->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
+    }), {}, main);
+
+    jobs.Add("shadows", job([&]() { return CreateShadows(); }), {}, main);
+
+    bool succeeded = jobs.Run();
+
+    OutputDebugStringA(("Loading jobs:\n" + jobs.Report()).c_str());
+
+    ShaderCache::Stats shaderCache = ShaderCache::GetStats();
+    OutputDebugStringA(("Shader cache: " + std::to_string(shaderCache.hits) + " hits, " + std::to_string(shaderCache.misses) + " misses\n").c_str());
 
-    m_pToneMap = std::unique_ptr<ToneMapPostProcess>(new ToneMapPostProcess());
-    hr = m_pToneMap->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
     if (FAILED(hr))
         return hr;
 
-    hr = CreateShadows();
-    
-    return hr;
+    return succeeded ? S_OK : E_FAIL;
 }
 
 HRESULT Renderer::CreateLights()
@@ -926,33 +1187,7 @@ HRESULT Renderer::Update()
 {
     HRESULT hr = S_OK;
 
-    static float remaindedSec = 0.0;
-    {
-        size_t usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-        if (m_usec == 0)
-        {
-            m_usec = usec;
-        }
-
-        float timeBetweenFrames = (usec - m_usec) / 1000000.0f;
-        m_usec = usec;
-
-        int scaleFactor = (int)((timeBetweenFrames + remaindedSec) / AnimatedTexture::expectedFrameTime);
-        remaindedSec = timeBetweenFrames + remaindedSec - scaleFactor * AnimatedTexture::expectedFrameTime;
-        float scaleRemainder = remaindedSec / AnimatedTexture::expectedFrameTime;
-
-        AnimatedTexture::CBuffer cb;
-        cb.secs = { scaleFactor, 0, 0, 0 };
-        m_pAnimatedTexture->UpdateConstantBuffer(&cb);
-
-        AnimatedTexture::InterpolateBuffer ib;
-        ib.info = { scaleRemainder, (float)m_pAnimatedTexture->GetWidth(), 0.0, 0.0 };
-        m_pAnimatedTexture->UpdateInterpolateBuffer(&ib);
-
-        m_pAnimatedTexture->Render(m_pSimpleShadowMapRasterizerState.Get(), m_pSamplerStates[0].Get(), nullptr);
-
-        m_pAnimatedTexture->SaveIncrement(scaleFactor);
-    }
+    m_pAnimationSystem->Update(AnimationClock::Now(), m_pSamplerStates[0].Get());
 
     m_frameCount++;
 
@@ -1182,6 +1417,8 @@ void Renderer::RenderModels()
     context->PSSetSamplers(3, 1, m_pSamplerStates[2].GetAddressOf());
     context->PSSetSamplers(4, 1, m_pSamplerStates[3].GetAddressOf());
 
+    AllocationCounter::Scope allocations;
+
     Model::ShadersSlots slots = { 3, 4, 5, 2, 0, 2 };
     context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
     for (size_t i = 0; i < m_pModels.size(); ++i)
@@ -1201,6 +1438,9 @@ void Renderer::RenderModels()
     for (size_t i = 0; i < m_pModels.size(); ++i)
         m_pModels[i]->RenderTransparent(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, m_pCamera->GetDirection(), true);
 
+    m_drawAllocations = allocations.Allocations();
+    assert(m_frameCount < drawWarmUpFrames || m_drawAllocations == 0);
+
     ID3D11ShaderResourceView* nullsrv[] = { nullptr };
     context->PSSetShaderResources(0, 1, nullsrv);
     context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
@@ -1255,10 +1495,7 @@ void Renderer::Render()
         RenderSphere(m_constantBufferData);
     }
 
-    {
-        m_pAnimatedTexture->Swap();
-        m_pAnimatedTexture->IncrementSaved();
-    }
+    m_pAnimationSystem->EndFrame();
 }
 
 void Renderer::RenderSimpleShadow()
@@ -8,7 +8,7 @@
 #include "BloomProcess.h"
 #include "Settings.h"
 #include "Model.h"
-#include "AnimatedTexture.h"
+#include "AnimationSystem.h"
 
 class Renderer
 {
@@ -26,17 +26,40 @@ public:
     void Render();
 
 private:
-    HRESULT CreateShaders();
+    // CPU side results of the loading jobs, consumed by the device jobs on the main thread
+    struct LoadedAssets
+    {
+        uint64_t iblKey = 0;
+        std::vector<unsigned char> environmentHdr;
+        std::vector<std::vector<unsigned char>> iblCacheFiles; // Empty unless every cached IBL texture was read
+        std::shared_ptr<float> environment;                    // Decoded only when the cache misses
+        int environmentWidth = 0;
+        int environmentHeight = 0;
+        Microsoft::WRL::ComPtr<ID3DBlob> planePixelShaderBlob;
+        ImageImport::Image background;
+        ImageImport::Image layer;
+        std::unique_ptr<VectorField> vectorField;
+    };
+
+    HRESULT CreateShaders(ID3DBlob* planePixelShaderBlob = nullptr);
     HRESULT CreateSphere();
     HRESULT CreatePlane();
     HRESULT CreateLights();
-    HRESULT CreateTexture();
+    HRESULT CreateSamplers();
+    HRESULT CreateEnvironmentTexture(const float* texels, int width, int height);
+    HRESULT LoadIBLSource(LoadedAssets& assets);
+    HRESULT DecodeEnvironment(LoadedAssets& assets);
+    HRESULT CreateIBLTextures(LoadedAssets& assets);
+    HRESULT LoadIBLTextures(const std::vector<std::vector<unsigned char>>& files);
+    HRESULT SaveIBLTextures(uint64_t key);
     HRESULT CreateCubeTexture();
     HRESULT CreateIrradianceTexture();
     HRESULT CreatePrefilteredColorTexture();
     HRESULT CreatePreintegratedBRDFTexture();
     HRESULT CreateCubeTextureFromResource(UINT size, ID3D11Texture2D* dst, ID3D11ShaderResourceView* src, ID3D11VertexShader* vs, ID3D11PixelShader* ps, UINT mipSlice = 0);
+    void AddModels();
     HRESULT CreateModels();
+    HRESULT CreateAnimatedTexture(LoadedAssets& assets);
     HRESULT CreateShadows();
 
     void UpdatePerspective();
@@ -115,12 +138,13 @@ private:
     UINT32 m_planeIndexCount;
     UINT32 m_frameCount;
 
+    // Heap allocations of the last RenderModels call, zero once the first frame has sized the scratch buffers
+    size_t m_drawAllocations;
+
     DirectX::XMVECTOR m_sceneCenter;
     FLOAT m_sceneRadius;
 
-    size_t m_usec = 0;
-
-    std::shared_ptr<AnimatedTexture> m_pAnimatedTexture;
+    std::unique_ptr<AnimationSystem> m_pAnimationSystem;
 
     DirectX::XMVECTOR m_targers[6] = {
         DirectX::XMVectorSet(1, 0, 0, 0),
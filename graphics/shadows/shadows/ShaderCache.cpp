@@ -0,0 +1,329 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ContentHash.h"
+
+namespace
+{
+    std::atomic<size_t> hits{ 0 };
+    std::atomic<size_t> misses{ 0 };
+
+    char const entryMagic[4] = { 'S', 'H', 'C', 'E' };
+
+    // Precedes the bytecode of every entry, a truncated or overwritten file fails the size or hash check
+    struct EntryHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t size;
+        uint64_t hash;
+    };
+
+    static_assert(sizeof(EntryHeader) == 24, "Shader cache entry header must be packed");
+
+    uint64_t HashBytecode(void const* data, size_t size)
+    {
+        uint64_t hash = ContentHash::offsetBasis;
+        ContentHash::Hash(hash, data, size);
+
+        return hash;
+    }
+
+    // Distinct for every process and thread, concurrent writers of one key never share a temporary file
+    std::string TemporaryPath(std::string const& path)
+    {
+#ifdef _WIN32
+        unsigned long long pid = (unsigned long long)_getpid();
+#else
+        unsigned long long pid = (unsigned long long)getpid();
+#endif
+        unsigned long long thread = (unsigned long long)std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        char suffix[64];
+        std::snprintf(suffix, sizeof(suffix), ".%llu.%llx.tmp", pid, thread);
+
+        return path + suffix;
+    }
+
+#ifdef _WIN32
+    // Paths are UTF-8, the narrow CRT file functions would read them in the ANSI code page
+    std::wstring NativePath(std::string const& path)
+    {
+        int size = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.size(), nullptr, 0);
+
+        std::wstring native((size_t)size, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.size(), &native[0], size);
+
+        return native;
+    }
+
+    int RemoveFile(std::string const& path)
+    {
+        return _wremove(NativePath(path).c_str());
+    }
+
+    int RenameFile(std::string const& from, std::string const& to)
+    {
+        return _wrename(NativePath(from).c_str(), NativePath(to).c_str());
+    }
+#else
+    std::string const& NativePath(std::string const& path)
+    {
+        return path;
+    }
+
+    int RemoveFile(std::string const& path)
+    {
+        return std::remove(path.c_str());
+    }
+
+    int RenameFile(std::string const& from, std::string const& to)
+    {
+        return std::rename(from.c_str(), to.c_str());
+    }
+#endif
+
+    bool ReadText(std::string const& path, std::vector<unsigned char>& bytes)
+    {
+        std::ifstream is(NativePath(path), std::ios::binary);
+        if (!is.is_open())
+        {
+            return false;
+        }
+
+        bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+
+        return !is.bad();
+    }
+
+    std::string Directory(std::string const& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // Names of the quoted #include directives, <...> includes are not resolved by the standard handler
+    std::vector<std::string> Includes(std::vector<unsigned char> const& text)
+    {
+        std::vector<std::string> names;
+
+        size_t i = 0;
+        size_t size = text.size();
+        while (i < size)
+        {
+            size_t lineEnd = i;
+            while (lineEnd < size && text[lineEnd] != '\n')
+            {
+                ++lineEnd;
+            }
+
+            size_t c = i;
+            while (c < lineEnd && (text[c] == ' ' || text[c] == '\t'))
+            {
+                ++c;
+            }
+
+            if (c < lineEnd && text[c] == '#')
+            {
+                ++c;
+                while (c < lineEnd && (text[c] == ' ' || text[c] == '\t'))
+                {
+                    ++c;
+                }
+
+                static char const directive[] = "include";
+                size_t directiveSize = sizeof(directive) - 1;
+                if (lineEnd - c > directiveSize && std::equal(directive, directive + directiveSize, text.begin() + c))
+                {
+                    c += directiveSize;
+                    while (c < lineEnd && (text[c] == ' ' || text[c] == '\t'))
+                    {
+                        ++c;
+                    }
+
+                    if (c < lineEnd && text[c] == '"')
+                    {
+                        size_t nameEnd = c + 1;
+                        while (nameEnd < lineEnd && text[nameEnd] != '"')
+                        {
+                            ++nameEnd;
+                        }
+
+                        if (nameEnd < lineEnd)
+                        {
+                            names.emplace_back(text.begin() + c + 1, text.begin() + nameEnd);
+                        }
+                    }
+                }
+            }
+
+            i = lineEnd + 1;
+        }
+
+        return names;
+    }
+}
+
+bool ShaderCache::ReadSources(std::string const& path, std::vector<std::vector<unsigned char>>& sources)
+{
+    sources.clear();
+    sources.emplace_back();
+
+    if (!ReadText(path, sources.back()))
+    {
+        return false;
+    }
+
+    // Breadth first over the include tree, every file is hashed once whatever its include guards
+    std::vector<std::string> paths = { path };
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        std::string directory = Directory(paths[i]);
+
+        for (auto const& name : Includes(sources[i]))
+        {
+            std::string include = directory + name;
+            if (std::find(paths.begin(), paths.end(), include) != paths.end())
+            {
+                continue;
+            }
+
+            paths.push_back(include);
+            sources.emplace_back();
+            ReadText(include, sources.back());
+        }
+    }
+
+    return true;
+}
+
+uint64_t ShaderCache::Key(std::vector<std::vector<unsigned char>> const& sources, std::vector<Define> const& defines,
+    std::string const& entryPoint, std::string const& profile, uint32_t flags)
+{
+    uint64_t hash = ContentHash::offsetBasis;
+
+    ContentHash::HashValue(hash, version);
+
+    ContentHash::HashValue(hash, sources.size());
+    for (auto const& source : sources)
+    {
+        ContentHash::HashText(hash, source);
+    }
+
+    ContentHash::HashValue(hash, defines.size());
+    for (auto const& define : defines)
+    {
+        ContentHash::HashString(hash, define.name);
+        ContentHash::HashString(hash, define.value);
+    }
+
+    ContentHash::HashString(hash, entryPoint);
+    ContentHash::HashString(hash, profile);
+    ContentHash::HashValue(hash, flags);
+
+    return hash;
+}
+
+std::string ShaderCache::Path(std::string const& directory, uint64_t key)
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "shader_%016llx.cso", (unsigned long long)key);
+
+    return directory + "/" + name;
+}
+
+bool ShaderCache::ReadFile(std::string const& path, std::vector<unsigned char>& bytecode)
+{
+    bytecode.clear();
+
+    std::vector<unsigned char> bytes;
+    if (!ReadText(path, bytes) || bytes.size() < sizeof(EntryHeader))
+    {
+        return false;
+    }
+
+    EntryHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, entryMagic, sizeof(header.magic)) != 0 || header.version != version ||
+        header.size != bytes.size() - sizeof(header) || header.hash != HashBytecode(bytes.data() + sizeof(header), (size_t)header.size))
+    {
+        return false;
+    }
+
+    bytecode.assign(bytes.begin() + sizeof(header), bytes.end());
+
+    return true;
+}
+
+bool ShaderCache::WriteFile(std::string const& path, void const* data, size_t size)
+{
+    std::string temporary = TemporaryPath(path);
+
+    EntryHeader header;
+    std::memcpy(header.magic, entryMagic, sizeof(header.magic));
+    header.version = version;
+    header.size = size;
+    header.hash = HashBytecode(data, size);
+
+    {
+        std::ofstream os(NativePath(temporary), std::ios::binary | std::ios::trunc);
+        if (!os.is_open())
+        {
+            return false;
+        }
+
+        os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        os.write(static_cast<char const*>(data), (std::streamsize)size);
+        if (!os.good())
+        {
+            os.close();
+            RemoveFile(temporary);
+            return false;
+        }
+    }
+
+    // Another thread or process may have stored the same key meanwhile, its bytecode is as good
+    RemoveFile(path);
+    if (RenameFile(temporary, path) != 0)
+    {
+        RemoveFile(temporary);
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderCache::CountHit()
+{
+    ++hits;
+}
+
+void ShaderCache::CountMiss()
+{
+    ++misses;
+}
+
+ShaderCache::Stats ShaderCache::GetStats()
+{
+    return { hits.load(), misses.load() };
+}
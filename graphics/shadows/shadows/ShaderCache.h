@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Content addressed store of compiled shader bytecode.
+// The key covers the source, every file it includes, the defines, entry point, profile and
+// compile flags, so editing any of them misses. No D3D dependency, the compiler side lives in Utils.
+// Every path is UTF-8.
+class ShaderCache
+{
+public:
+    struct Define
+    {
+        std::string name;
+        std::string value;
+    };
+
+    struct Stats
+    {
+        size_t hits;
+        size_t misses;
+    };
+
+    // Bumped whenever the key or the stored layout changes
+    static uint32_t const version = 2;
+
+    // Text of the file followed by every file it pulls in with a quoted #include, each once.
+    // Includes resolve against the directory of the including file as the standard D3D include handler does,
+    // a missing include reads as empty. False only when the file itself cannot be read.
+    static bool ReadSources(std::string const& path, std::vector<std::vector<unsigned char>>& sources);
+
+    static uint64_t Key(std::vector<std::vector<unsigned char>> const& sources, std::vector<Define> const& defines,
+        std::string const& entryPoint, std::string const& profile, uint32_t flags);
+
+    // <directory>/shader_<key>.cso
+    static std::string Path(std::string const& directory, uint64_t key);
+
+    // Bytecode of an entry written by WriteFile, false for a missing, truncated or corrupt file
+    static bool ReadFile(std::string const& path, std::vector<unsigned char>& bytecode);
+
+    // Writes the bytecode with its size and hash through a temporary file private to the calling thread,
+    // a torn entry is never picked up as bytecode
+    static bool WriteFile(std::string const& path, void const* data, size_t size);
+
+    static void CountHit();
+    static void CountMiss();
+    static Stats GetStats();
+};
@@ -36,6 +36,12 @@ struct LuminanceConstantBuffer
 	float AverageLuminance;
 };
 
+__declspec(align(16))
+struct AdaptationConstantBuffer
+{
+	float DeltaTime;
+};
+
 __declspec(align(16))
 struct MaterialConstantBuffer
 {
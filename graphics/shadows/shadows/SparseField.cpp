@@ -0,0 +1,265 @@
+#include "SparseField.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+
+namespace
+{
+	size_t constexpr tileTexels = SparseField::tileSize * SparseField::tileSize;
+}
+
+SparseField::SparseField() : m_iWidth{ 0 }, m_iHeight{ 0 }, m_iTilesX{ 0 }, m_iTilesY{ 0 } {}
+
+SparseField::SparseField(FieldStorage const& field)
+	: m_iWidth{ field.Width() }, m_iHeight{ field.Height() },
+	m_iTilesX{ (field.Width() + tileSize - 1) / tileSize },
+	m_iTilesY{ (field.Height() + tileSize - 1) / tileSize }
+{
+	m_aTiles.resize(m_iTilesX * m_iTilesY);
+	m_aActiveBits.assign((m_aTiles.size() + 63) / 64, 0);
+
+	for (size_t tx = 0; tx < m_iTilesX; ++tx)
+	{
+		size_t x0 = tx * tileSize;
+		size_t x1 = std::min(x0 + tileSize, m_iWidth);
+
+		for (size_t ty = 0; ty < m_iTilesY; ++ty)
+		{
+			size_t y0 = ty * tileSize;
+			size_t y1 = std::min(y0 + tileSize, m_iHeight);
+
+			int32_t dx = field.DX(x0, y0);
+			int32_t dy = field.DY(x0, y0);
+
+			bool constant = true;
+			bool zero = dx == 0 && dy == 0;
+
+			for (size_t i = x0; i < x1 && (constant || zero); ++i)
+			{
+				FieldStorage::ConstColumnView column = field.Column(i);
+
+				for (size_t j = y0; j < y1; ++j)
+				{
+					constant = constant && column.dx[j] == dx && column.dy[j] == dy;
+					zero = zero && column.dx[j] == 0 && column.dy[j] == 0;
+				}
+			}
+
+			size_t ind = tx * m_iTilesY + ty;
+			Tile& tile = m_aTiles[ind];
+
+			if (!zero)
+			{
+				m_aActiveBits[ind / 64] |= uint64_t(1) << (ind % 64);
+			}
+
+			if (constant)
+			{
+				tile = { dx, dy, constantTile };
+				continue;
+			}
+
+			// Texels past the field edge stay zero
+			tile = { 0, 0, (uint32_t)(m_aPayloads.size() / (2 * tileTexels)) };
+			m_aPayloads.resize(m_aPayloads.size() + 2 * tileTexels, 0);
+
+			int32_t* payloadDX = m_aPayloads.data() + tile.payload * 2 * tileTexels;
+			int32_t* payloadDY = payloadDX + tileTexels;
+
+			for (size_t i = x0; i < x1; ++i)
+			{
+				FieldStorage::ConstColumnView column = field.Column(i);
+
+				std::copy(column.dx + y0, column.dx + y1, payloadDX + (i - x0) * tileSize);
+				std::copy(column.dy + y0, column.dy + y1, payloadDY + (i - x0) * tileSize);
+			}
+		}
+	}
+}
+
+size_t SparseField::Width() const
+{
+	return m_iWidth;
+}
+
+size_t SparseField::Height() const
+{
+	return m_iHeight;
+}
+
+size_t SparseField::TilesX() const
+{
+	return m_iTilesX;
+}
+
+size_t SparseField::TilesY() const
+{
+	return m_iTilesY;
+}
+
+SparseField::Tile const& SparseField::GetTile(size_t tx, size_t ty) const
+{
+	assert(tx < m_iTilesX && ty < m_iTilesY);
+
+	return m_aTiles[tx * m_iTilesY + ty];
+}
+
+bool SparseField::IsActive(size_t tx, size_t ty) const
+{
+	size_t ind = tx * m_iTilesY + ty;
+
+	return (m_aActiveBits[ind / 64] >> (ind % 64) & 1) != 0;
+}
+
+size_t SparseField::ActiveTilesNum() const
+{
+	size_t active = 0;
+
+	for (uint64_t bits : m_aActiveBits)
+	{
+		for (; bits != 0; bits &= bits - 1)
+		{
+			++active;
+		}
+	}
+
+	return active;
+}
+
+size_t SparseField::DenseTilesNum() const
+{
+	return m_aPayloads.size() / (2 * tileTexels);
+}
+
+int32_t const* SparseField::Payload(uint32_t payload) const
+{
+	assert(payload < DenseTilesNum());
+
+	return m_aPayloads.data() + payload * 2 * tileTexels;
+}
+
+std::pair<int, int> SparseField::Get(size_t x, size_t y) const
+{
+	Tile const& tile = GetTile(x / tileSize, y / tileSize);
+
+	if (tile.payload == constantTile)
+	{
+		return { tile.dx, tile.dy };
+	}
+
+	size_t texel = (x % tileSize) * tileSize + y % tileSize;
+	int32_t const* payload = Payload(tile.payload);
+
+	return { payload[texel], payload[tileTexels + texel] };
+}
+
+size_t SparseField::MemorySize() const
+{
+	return m_aTiles.size() * sizeof(Tile) + m_aActiveBits.size() * sizeof(uint64_t) + m_aPayloads.size() * sizeof(int32_t);
+}
+
+FieldStorage SparseField::ToStorage() const
+{
+	FieldStorage field(m_iWidth, m_iHeight);
+
+	for (size_t i = 0; i < m_iWidth; ++i)
+	{
+		FieldStorage::ColumnView column = field.Column(i);
+
+		for (size_t j = 0; j < m_iHeight; ++j)
+		{
+			std::pair<int, int> d = Get(i, j);
+
+			column.dx[j] = d.first;
+			column.dy[j] = d.second;
+		}
+	}
+
+	return field;
+}
+
+void SparseField::Apply(unsigned char const* src, unsigned char* dst, size_t x, size_t y, size_t n) const
+{
+	assert(x <= m_iWidth && y <= m_iHeight);
+
+	size_t channels = n < 3 ? n : 3;
+
+	// dst starts as a copy of src, so a texel that stays in place only matters when it has to
+	// win over an earlier texel landing on it. Moving texels are visited in the (i, j) order of
+	// the dense kernel; a write loses to the in-place texel of a later order it lands on.
+	for (size_t tx = 0; tx < m_iTilesX; ++tx)
+	{
+		size_t x0 = tx * tileSize;
+		size_t x1 = std::min(x0 + tileSize, x);
+
+		for (size_t i = x0; i < x1; ++i)
+		{
+			for (size_t ty = 0; ty < m_iTilesY; ++ty)
+			{
+				if (!IsActive(tx, ty))
+				{
+					continue;
+				}
+
+				Tile const& tile = GetTile(tx, ty);
+				int32_t const* payload = tile.payload == constantTile ? nullptr : Payload(tile.payload) + (i - x0) * tileSize;
+
+				size_t y0 = ty * tileSize;
+				size_t y1 = std::min(y0 + tileSize, y);
+
+				for (size_t j = y0; j < y1; ++j)
+				{
+					int32_t dx = payload ? payload[j - y0] : tile.dx;
+					int32_t dy = payload ? payload[tileTexels + j - y0] : tile.dy;
+
+					if (dx == 0 && dy == 0)
+					{
+						continue;
+					}
+
+					size_t n_i = i + dx;
+					size_t n_j = j + dy;
+
+					if (n_i >= x || n_j >= y)
+					{
+						continue;
+					}
+
+					size_t address = n_j + n_i * x;
+					if (KeptInPlace(address, i * y + j, x, y))
+					{
+						continue;
+					}
+
+					std::memcpy(dst + n * address, src + n * (j + i * x), channels);
+				}
+			}
+		}
+	}
+}
+
+bool SparseField::KeptInPlace(size_t address, size_t order, size_t x, size_t y) const
+{
+	// Texels (s_i, address - s_i * x) own the address, one unless y > x. Later ones come first,
+	// the order s_i * y + s_j grows with s_i once y >= x.
+	for (size_t s_i = std::min(address / x, x - 1); ; --s_i)
+	{
+		size_t s_j = address - s_i * x;
+		if (s_j >= y || s_i * y + s_j <= order)
+		{
+			return false;
+		}
+
+		std::pair<int, int> d = Get(s_i, s_j);
+		if (d.first == 0 && d.second == 0)
+		{
+			return true;
+		}
+
+		if (s_i == 0)
+		{
+			return false;
+		}
+	}
+}
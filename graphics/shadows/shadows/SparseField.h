@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FieldStorage.h"
+
+// Tiled form of a displacement field for fields that are constant (mostly zero) apart from
+// a few regions of motion, e.g. AddDots* over an empty field.
+// Every tileSize x tileSize tile is either a single (dx, dy) or a dense payload, so memory
+// and the Apply cost grow with the moving area rather than the resolution.
+// VectorField::apply_field switches to it when few tiles move, VectorField::Compact() keeps only
+// the tiles, and FieldAtlas uploads only the dense tiles to the GPU.
+class SparseField
+{
+public:
+	static size_t constexpr tileSize = 32;
+
+	// Tile::payload of a constant tile
+	static uint32_t constexpr constantTile = UINT32_MAX;
+
+	struct Tile
+	{
+		int32_t dx;
+		int32_t dy;
+		uint32_t payload;
+	};
+
+public:
+	SparseField();
+	explicit SparseField(FieldStorage const& field);
+
+	size_t Width() const;
+	size_t Height() const;
+
+	size_t TilesX() const;
+	size_t TilesY() const;
+
+	// Tile (tx, ty) covers field texels [tx * tileSize, ...) x [ty * tileSize, ...)
+	Tile const& GetTile(size_t tx, size_t ty) const;
+
+	// Tiles with a non-zero texel
+	bool IsActive(size_t tx, size_t ty) const;
+	size_t ActiveTilesNum() const;
+	size_t DenseTilesNum() const;
+
+	// dx plane then dy plane of dense tile `payload`, texel (i, j) of the tile at i * tileSize + j
+	int32_t const* Payload(uint32_t payload) const;
+
+	std::pair<int, int> Get(size_t x, size_t y) const;
+
+	// Bytes held by the tiles, the bitmap and the payloads
+	size_t MemorySize() const;
+
+	FieldStorage ToStorage() const;
+
+	// Same result as FieldKernels::ApplyField with the dense field, only moving texels are visited.
+	// Fields active almost everywhere are faster with the vectorized dense kernel.
+	void Apply(unsigned char const* src, unsigned char* dst, size_t x, size_t y, size_t n) const;
+
+private:
+	// Whether a texel staying in place at pixel `address` of a x * y image comes after `order`
+	// in the (i, j) order of the dense kernel, and so writes its own value back over a move there
+	bool KeptInPlace(size_t address, size_t order, size_t x, size_t y) const;
+
+	size_t m_iWidth;
+	size_t m_iHeight;
+	size_t m_iTilesX;
+	size_t m_iTilesY;
+
+	// Tile (tx, ty) at tx * m_iTilesY + ty, columns first as FieldStorage rows
+	std::vector<Tile> m_aTiles;
+	std::vector<uint64_t> m_aActiveBits;
+	std::vector<int32_t> m_aPayloads;
+};
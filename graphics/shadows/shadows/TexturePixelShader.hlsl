@@ -0,0 +1 @@
+#include "TextureShader.hlsl"
@@ -1,108 +1,88 @@
-cbuffer ConstantBuffer : register(b0)
-{
-	int4 secs; // x - scale factor
-	int4 framesPerTex;
-}
-
-texture2D Texture : register(t0);
-
-texture2D VectorField1 : register(t1);
-texture2D VectorField2 : register(t2);
+// Layer pass of AnimatedTexture, all layers in one dispatch (LayerBatch).
+// CS is the default path, VS/PS draw a fullscreen triangle per layer with the same Advect
+// for devices or profiles where the pixel pipeline wins. No depth buffer in either one.
 
-SamplerState Sampler : register(s0);
-SamplerState FieldSampler : register(s1);
+#include "FieldAtlas.hlsli"
 
-struct VSInput
+cbuffer LayerBatch : register(b0)
 {
-	float4 pos : POSITION;
-	float2 uv : TEXCOORD;
-};
+	int4 batch; // x - scale factor, y - layers number, zw - layer size
+	float4 fieldDecode; // xy - uv displacement per sampled field unit (FieldEncoding)
+	uint4 fieldSlices[4]; // field slice of layer i in [i / 4][i % 4]
+}
 
-struct VSOutput
-{
-	float4 pos : SV_Position;
-	float2 uv : TEXCOORD;
-};
+Texture2DArray<float4> SourceLayers : register(t0);
+Texture2DArray<float4> Fields : register(t1); // Atlas pages
+Texture2DArray<uint2> FieldTileSlices : register(t2); // Tile indirection, slice i is field slice i
 
-VSOutput VS(in VSInput vertex)
-{
-	VSOutput output;
+RWTexture2DArray<unorm float4> TargetLayers : register(u0);
 
-	output.pos = vertex.pos;
-	output.uv = vertex.uv;
+#define MAX_WALK_STEPS 32 // LayerBatch::maxWalkSteps
 
-	return output;
-}
+SamplerState Sampler : register(s0);
 
-float4 PS(in VSOutput input) : SV_Target0
+// Target texel of one layer, ReferenceRenderer runs the same kernel on the CPU.
+// Every step looks the field up where the previous one ended, so several steps in one pass
+// follow a non-uniform field instead of stretching the first displacement.
+float4 Advect(uint2 texel, uint layer)
 {
-	float4 color = float4(0, 0, 0, 1);
-	
-	// float ddx = VectorField1.Sample(Sampler, input.uv).r;
-	// float ddy = VectorField1.Sample(Sampler, input.uv).g;
-
-	float d = 1 / 2048.0;
-	int scale = secs.x;
-	// int curIndex = secs.y;
-	// int curFrameCounter = secs.z;
-	// int totalFieldNum = secs.w;
+	uint2 size = (uint2)batch.zw;
+	uint fieldSlice = fieldSlices[layer / 4][layer % 4];
 
-	float2 vec = input.uv;
+	float2 uv = (texel + 0.5f) / size;
 
-	float ddx = VectorField1.Sample(FieldSampler, vec).r;
-	float ddy = VectorField1.Sample(FieldSampler, vec).g;
+	// LayerBatch::WalkSteps and WalkStepScale, PassSteps keeps the scale within MAX_WALK_STEPS
+	int steps = min(abs(batch.x), MAX_WALK_STEPS);
+	float stepScale = batch.x < 0 ? -1.0f : 1.0f;
 
-	/*for (int i = 0; i < scale; ++i)
+	[loop]
+	for (int i = 0; i < steps; ++i)
 	{
-		float ddx = VectorField1.Sample(Sampler, vec).r;
-		float ddy = VectorField1.Sample(Sampler, vec).g;
+		uint2 fieldTexel = FieldTexel(uv, size);
+		uint tile = FieldTiles(FieldTileSlices, fieldTexel, fieldSlice).x;
 
-		if (curIndex == 0)
-		{
-			ddx = VectorField1.Sample(Sampler, vec).r;
-			ddy = VectorField1.Sample(Sampler, vec).g;
-		}
-		else
-		{
-			ddx = VectorField2.Sample(Sampler, vec).r;
-			ddy = VectorField2.Sample(Sampler, vec).g;
-		}
+		float2 d = FieldAtlasLoad(Fields, tile, fieldTexel, size) * fieldDecode.xy;
+		uv += stepScale * d;
+	}
 
-		vec = vec + float2(ddy, ddx);
-
-		++curFrameCounter;
-		if (curFrameCounter >= framesPerTex.y)
-		{
-			curFrameCounter = 0;
-			curIndex = (curIndex + 1) % totalFieldNum;
-		}
-	}*/
-
-	color.rgb = Texture.Sample(Sampler, vec + scale * float2(ddx, ddy)).rgb;
+	float4 color = float4(0, 0, 0, 1);
+	color.rgb = SourceLayers.SampleLevel(Sampler, float3(uv, layer), 0).rgb;
 
-	/*float3 I_i_j = Texture.Sample(Sampler, vec).rgb;
-	
-	float3 I_i1_j = Texture.Sample(Sampler, vec + float2(d, 0)).rgb;
-	float3 I_1i_j = Texture.Sample(Sampler, vec + float2(-d, 0)).rgb;
+	return color;
+}
 
-	float3 I_i_j1 = Texture.Sample(Sampler, vec + float2(0, d)).rgb;
-	float3 I_i_1j = Texture.Sample(Sampler, vec + float2(0, -d)).rgb;
+[numthreads(8, 8, 1)]
+void CS(uint3 id : SV_DispatchThreadID)
+{
+	uint2 size = (uint2)batch.zw;
+	if (id.x >= size.x || id.y >= size.y)
+	{
+		return;
+	}
 
-	color.rgb = I_i_j + scale * (ddy * (I_i1_j - I_1i_j) + ddx * (I_i_j1 - I_i_1j));*/
+	TargetLayers[id] = Advect(id.xy, id.z);
+}
 
-	// color.rgb = Texture.Sample(Sampler, input.uv + scale * float2(VectorField1.Sample(Sampler, input.uv).g, VectorField1.Sample(Sampler, input.uv).r));
+struct VS_OUTPUT
+{
+	float4 Pos : SV_POSITION;
+	nointerpolation uint Layer : LAYER;
+};
 
-	/*color.rgb = (Texture.Sample(Sampler, input.uv) +
-		( ddx * 2048.0 * (Texture.Sample(Sampler, input.uv + float2(0, d)) - Texture.Sample(Sampler, input.uv + float2(0, -d))) ) +
-		( ddy * 2048.0 * (Texture.Sample(Sampler, input.uv + float2(d, 0)) - Texture.Sample(Sampler, input.uv + float2(-d, 0))) )).rgb;*/
+// Draw(3, 3 * layer) covers the viewport with one triangle, no vertex or index buffer
+VS_OUTPUT VS(uint id : SV_VertexID)
+{
+	VS_OUTPUT output;
 
+	float2 corner = float2((id % 3 << 1) & 2, id % 3 & 2);
 
+	output.Pos = float4(corner * float2(2, -2) + float2(-1, 1), 0, 1);
+	output.Layer = id / 3;
 
-	/*color.rgb = Texture.Sample(Sampler, input.uv) -
-		(ddy / 4.0 * (-Texture.Sample(Sampler, input.uv + float2(2 * d, 0)) + 4 * Texture.Sample(Sampler, input.uv + float2(d, 0)) - 4 * Texture.Sample(Sampler, input.uv + float2(-d, 0)) + Texture.Sample(Sampler, input.uv + float2(-2 * d, 0)))) +
-		(ddy / 12.0 * (Texture.Sample(Sampler, input.uv + float2(2 * d, 0)) - 4 * Texture.Sample(Sampler, input.uv + float2(d, 0)) + 6 * Texture.Sample(Sampler, input.uv) - 4 * Texture.Sample(Sampler, input.uv + float2(-d, 0)) + Texture.Sample(Sampler, +float2(-2 * d, 0)))) +
-		(ddx / 4.0 * (-Texture.Sample(Sampler, input.uv + float2(0, 2 * d)) + 4 * Texture.Sample(Sampler, input.uv + float2(0, d)) - 4 * Texture.Sample(Sampler, input.uv + float2(0, -d)) + Texture.Sample(Sampler, input.uv + float2(0, -2 * d)))) +
-		(ddx / 12.0 * (Texture.Sample(Sampler, input.uv + float2(0, 2 * d)) - 4 * Texture.Sample(Sampler, input.uv + float2(0, d)) + 6 * Texture.Sample(Sampler, input.uv) - 4 * Texture.Sample(Sampler, input.uv + float2(0, -d)) + Texture.Sample(Sampler, +float2(0, -2 * d))));*/
+	return output;
+}
 
-	return color;
+float4 PS(VS_OUTPUT input) : SV_TARGET
+{
+	return Advect((uint2)input.Pos.xy, input.Layer);
 }
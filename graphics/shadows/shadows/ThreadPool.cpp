@@ -0,0 +1,198 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+	// Set on workers and on a thread running a region, nested regions run inline
+	thread_local bool insideRegion = false;
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool;
+
+	return pool;
+}
+
+ThreadPool::ThreadPool() : m_iThreadCount{ 1 }, m_bActive{ false }, m_iGeneration{ 0 }, m_iBusyWorkers{ 0 }, m_bStop{ false }
+{
+	m_job.body = nullptr;
+	m_job.begin = m_job.end = m_job.grain = 0;
+
+	SetThreadCount(0);
+}
+
+ThreadPool::~ThreadPool()
+{
+	StopWorkers();
+}
+
+void ThreadPool::SetThreadCount(size_t threadsNum)
+{
+	std::lock_guard<std::mutex> region(m_regionMutex);
+
+	if (threadsNum == 0)
+	{
+		threadsNum = std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+
+	StopWorkers();
+	StartWorkers(threadsNum - 1);
+
+	m_iThreadCount.store(threadsNum, std::memory_order_relaxed);
+}
+
+size_t ThreadPool::ThreadCount() const
+{
+	return m_iThreadCount.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> const& body)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+
+	grain = std::max<size_t>(1, grain);
+	size_t chunksNum = (end - begin + grain - 1) / grain;
+
+	if (insideRegion || chunksNum == 1 || m_aWorkers.empty())
+	{
+		for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain)
+		{
+			body(chunkBegin, std::min(end, chunkBegin + grain));
+		}
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> region(m_regionMutex);
+
+	m_job.body = &body;
+	m_job.begin = begin;
+	m_job.end = end;
+	m_job.grain = grain;
+	m_job.next.store(0, std::memory_order_relaxed);
+	m_job.pending.store(chunksNum, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bActive = true;
+		++m_iGeneration;
+	}
+	m_wakeCondition.notify_all();
+
+	insideRegion = true;
+	RunChunks(m_job);
+	insideRegion = false;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]()
+		{
+			return m_iBusyWorkers == 0 && m_job.pending.load(std::memory_order_acquire) == 0;
+		});
+	m_bActive = false;
+}
+
+void ThreadPool::ForTiles(FieldStorage& storage, std::function<void(FieldStorage::TileView const&)> const& body,
+	size_t tileWidth, size_t tileHeight)
+{
+	assert(tileWidth > 0 && tileHeight > 0);
+
+	size_t tilesX = (storage.Width() + tileWidth - 1) / tileWidth;
+	size_t tilesY = (storage.Height() + tileHeight - 1) / tileHeight;
+
+	ParallelFor(0, tilesX * tilesY, 1, [&](size_t tileBegin, size_t tileEnd)
+		{
+			for (size_t tile = tileBegin; tile < tileEnd; ++tile)
+			{
+				size_t x0 = tile / tilesY * tileWidth;
+				size_t y0 = tile % tilesY * tileHeight;
+
+				body(storage.Tile(x0, y0, tileWidth, tileHeight));
+			}
+		});
+}
+
+void ThreadPool::StartWorkers(size_t workersNum)
+{
+	m_bStop = false;
+
+	// Workers join regions newer than this one. Reading the generation on the worker itself
+	// raced with a region started right after SetThreadCount, which a late worker then skipped
+	size_t generation = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		generation = m_iGeneration;
+	}
+
+	for (size_t i = 0; i < workersNum; ++i)
+	{
+		m_aWorkers.emplace_back(&ThreadPool::WorkerLoop, this, generation);
+	}
+}
+
+void ThreadPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_aWorkers)
+	{
+		worker.join();
+	}
+
+	m_aWorkers.clear();
+}
+
+void ThreadPool::WorkerLoop(size_t generation)
+{
+	insideRegion = true;
+
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_wakeCondition.wait(lock, [&]()
+			{
+				return m_bStop || (m_bActive && m_iGeneration != generation);
+			});
+
+		if (m_bStop)
+		{
+			return;
+		}
+
+		generation = m_iGeneration;
+		++m_iBusyWorkers;
+		lock.unlock();
+
+		RunChunks(m_job);
+
+		lock.lock();
+		if (--m_iBusyWorkers == 0)
+		{
+			m_doneCondition.notify_all();
+		}
+	}
+}
+
+void ThreadPool::RunChunks(Job& job)
+{
+	size_t chunksNum = (job.end - job.begin + job.grain - 1) / job.grain;
+
+	for (size_t chunk = job.next.fetch_add(1, std::memory_order_relaxed); chunk < chunksNum;
+		chunk = job.next.fetch_add(1, std::memory_order_relaxed))
+	{
+		size_t chunkBegin = job.begin + chunk * job.grain;
+
+		(*job.body)(chunkBegin, std::min(job.end, chunkBegin + job.grain));
+
+		job.pending.fetch_sub(1, std::memory_order_release);
+	}
+}
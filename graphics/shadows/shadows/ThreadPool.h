@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FieldStorage.h"
+
+// Persistent worker pool for per-texel field passes.
+// A parallel region splits [begin, end) into chunks that workers and the calling thread
+// claim from a shared counter, so every chunk runs exactly once and results only depend
+// on the chunking, never on scheduling. Regions started from inside a region run inline.
+class ThreadPool
+{
+public:
+	static size_t constexpr defaultTileWidth = 64;
+	static size_t constexpr defaultTileHeight = 256;
+
+	static ThreadPool& Get();
+
+	// 0 selects std::thread::hardware_concurrency()
+	void SetThreadCount(size_t threadsNum);
+	size_t ThreadCount() const;
+
+	// body(chunkBegin, chunkEnd) for consecutive chunks of at most `grain` indices
+	void ParallelFor(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> const& body);
+
+	// body(tile) for every tile of the storage, tiles never overlap
+	void ForTiles(FieldStorage& storage, std::function<void(FieldStorage::TileView const&)> const& body,
+		size_t tileWidth = defaultTileWidth, size_t tileHeight = defaultTileHeight);
+
+public:
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+private:
+	struct Job
+	{
+		std::function<void(size_t, size_t)> const* body;
+		size_t begin, end, grain;
+		std::atomic<size_t> next;
+		std::atomic<size_t> pending;
+	};
+
+	ThreadPool();
+	~ThreadPool();
+
+	void StartWorkers(size_t workersNum);
+	void StopWorkers();
+
+	void WorkerLoop(size_t generation);
+	static void RunChunks(Job& job);
+
+private:
+	std::vector<std::thread> m_aWorkers;
+
+	// Workers plus the calling thread, readable while SetThreadCount rebuilds m_aWorkers
+	std::atomic<size_t> m_iThreadCount;
+
+	std::mutex m_regionMutex;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	Job m_job;
+	bool m_bActive;
+	size_t m_iGeneration;
+	size_t m_iBusyWorkers;
+	bool m_bStop;
+};
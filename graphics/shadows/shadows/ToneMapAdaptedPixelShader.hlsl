@@ -0,0 +1,2 @@
+#define ADAPTED_LUMINANCE_TEXTURE
+#include "PostProcessShaders.fx"
@@ -23,6 +23,11 @@ HRESULT ToneMapPostProcess::CreateDeviceDependentResources(ID3D11Device* device)
     if (FAILED(hr))
         return hr;
 
+    // Create the pixel shader reading the GPU adapted luminance
+    hr = CreatePixelShader(device, L"ToneMapAdaptedPixelShader.cso", bytes, &m_pAdaptedPixelShader);
+    if (FAILED(hr))
+        return hr;
+
     // Create the sampler state
     D3D11_SAMPLER_DESC sd;
     ZeroMemory(&sd, sizeof(sd));
@@ -79,15 +84,22 @@ void ToneMapPostProcess::Process(ID3D11DeviceContext* context, ID3D11ShaderResou
     context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
     context->VSSetShader(m_pVertexShader.Get(), nullptr, 0);
-    context->PSSetShader(m_pPixelShader.Get(), nullptr, 0);
+    ID3D11ShaderResourceView* textures[] = { sourceTexture, nullptr };
+    if (m_pAverageLuminance->GetAdaptationMode() == AverageLuminanceProcess::ADAPTATION_MODE::GPU)
+    {
+        textures[1] = m_pAverageLuminance->GetAdaptedLuminanceSRV();
+        context->PSSetShader(m_pAdaptedPixelShader.Get(), nullptr, 0);
+    }
+    else
+        context->PSSetShader(m_pPixelShader.Get(), nullptr, 0);
     context->PSSetConstantBuffers(0, 1, m_pLuminanceBuffer.GetAddressOf());
-    context->PSSetShaderResources(0, 1, &sourceTexture);
+    context->PSSetShaderResources(0, 2, textures);
     context->PSSetSamplers(0, 1, m_pSamplerState.GetAddressOf());
     
     context->Draw(4, 0);
 
-    ID3D11ShaderResourceView* nullsrv[] = { nullptr };
-    context->PSSetShaderResources(0, 1, nullsrv);
+    ID3D11ShaderResourceView* nullsrv[] = { nullptr, nullptr };
+    context->PSSetShaderResources(0, 2, nullsrv);
 }
 
 ToneMapPostProcess::~ToneMapPostProcess()
@@ -14,11 +14,14 @@ public:
 
     void Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport);
 
+    void SetLuminanceAdaptationMode(AverageLuminanceProcess::ADAPTATION_MODE mode) { m_pAverageLuminance->SetAdaptationMode(mode); };
+
 private:
     std::unique_ptr<AverageLuminanceProcess> m_pAverageLuminance;
 
     Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pPixelShader;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pAdaptedPixelShader;
     Microsoft::WRL::ComPtr<ID3D11SamplerState> m_pSamplerState;
     Microsoft::WRL::ComPtr<ID3D11Buffer>       m_pLuminanceBuffer;
 };
@@ -3,6 +3,10 @@
 #include <fstream>
 
 #include "Utils.h"
+#include "DDSFile.h"
+#include "ShaderCache.h"
+
+const std::string shaderCacheDirectory = "ShaderCache";
 
 HRESULT ReadCompiledShader(const WCHAR* szFileName, std::vector<BYTE>& bytes)
 {
@@ -76,10 +80,106 @@ HRESULT CompileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCS
     dwShaderFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
+    // ShaderCache takes UTF-8 paths
+    std::string path;
+    int pathSize = WideCharToMultiByte(CP_UTF8, 0, szFileName, -1, nullptr, 0, nullptr, nullptr);
+    if (pathSize > 1)
+    {
+        path.resize(static_cast<size_t>(pathSize));
+        WideCharToMultiByte(CP_UTF8, 0, szFileName, -1, &path[0], pathSize, nullptr, nullptr);
+        path.resize(static_cast<size_t>(pathSize) - 1);
+    }
+
+    std::vector<ShaderCache::Define> defines;
+    for (const D3D_SHADER_MACRO* define = pDefines; define != nullptr && define->Name != nullptr; ++define)
+        defines.push_back({ define->Name, define->Definition != nullptr ? define->Definition : "" });
+
+    // An unreadable source is left to the compiler to report
+    std::vector<std::vector<unsigned char>> sources;
+    bool cacheable = ShaderCache::ReadSources(path, sources);
+
+    std::string cachePath;
+    if (cacheable)
+    {
+        cachePath = ShaderCache::Path(shaderCacheDirectory, ShaderCache::Key(sources, defines, szEntryPoint, szShaderModel, dwShaderFlags));
+
+        // Not ReadCompiledShader: an entry is the bytecode behind a size and hash header, which
+        // ShaderCache::ReadFile checks so a torn or stale file is compiled again instead of loaded
+        std::vector<BYTE> bytes;
+        if (ShaderCache::ReadFile(cachePath, bytes) && !bytes.empty())
+        {
+            hr = D3DCreateBlob(bytes.size(), ppBlobOut);
+            if (SUCCEEDED(hr))
+            {
+                memcpy((*ppBlobOut)->GetBufferPointer(), bytes.data(), bytes.size());
+                ShaderCache::CountHit();
+                return hr;
+            }
+        }
+    }
+
+    ShaderCache::CountMiss();
+
     Microsoft::WRL::ComPtr<ID3DBlob> err;
     hr = D3DCompileFromFile(szFileName, pDefines, D3D_COMPILE_STANDARD_FILE_INCLUDE, szEntryPoint, szShaderModel, dwShaderFlags, 0, ppBlobOut, &err);
     if (FAILED(hr) && err)
         OutputDebugStringA(reinterpret_cast<const char*>(err->GetBufferPointer()));
 
+    // Failing to store the bytecode only costs the next launch another compile
+    if (SUCCEEDED(hr) && cacheable && (CreateDirectoryA(shaderCacheDirectory.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS))
+        ShaderCache::WriteFile(cachePath, (*ppBlobOut)->GetBufferPointer(), (*ppBlobOut)->GetBufferSize());
+
+    return hr;
+}
+
+HRESULT SaveTextureToDDS(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D* texture, const std::string& path)
+{
+    HRESULT hr = S_OK;
+
+    D3D11_TEXTURE2D_DESC td;
+    texture->GetDesc(&td);
+    if (td.Format != DXGI_FORMAT_R32G32B32A32_FLOAT || td.SampleDesc.Count != 1)
+        return E_INVALIDARG;
+
+    bool cube = (td.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE) != 0;
+
+    D3D11_TEXTURE2D_DESC sd = td;
+    sd.Usage = D3D11_USAGE_STAGING;
+    sd.BindFlags = 0;
+    sd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    sd.MiscFlags = td.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+    hr = device->CreateTexture2D(&sd, nullptr, &staging);
+    if (FAILED(hr))
+        return hr;
+
+    context->CopyResource(staging.Get(), texture);
+
+    DDSFile::Texture dds = DDSFile::Texture::Create(td.Width, td.Height, td.ArraySize, td.MipLevels, cube);
+    for (UINT slice = 0; slice < td.ArraySize; ++slice)
+    {
+        for (UINT mip = 0; mip < td.MipLevels; ++mip)
+        {
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            UINT subresource = D3D11CalcSubresource(mip, slice, td.MipLevels);
+            hr = context->Map(staging.Get(), subresource, D3D11_MAP_READ, 0, &mapped);
+            if (FAILED(hr))
+                return hr;
+
+            std::vector<float>& texels = dds.Subresource(slice, mip);
+            size_t rowSize = 4 * sizeof(float) * dds.MipWidth(mip);
+            for (UINT row = 0; row < dds.MipHeight(mip); ++row)
+            {
+                memcpy(reinterpret_cast<BYTE*>(texels.data()) + row * rowSize, static_cast<const BYTE*>(mapped.pData) + row * mapped.RowPitch, rowSize);
+            }
+
+            context->Unmap(staging.Get(), subresource);
+        }
+    }
+
+    if (!DDSFile::Write(path, dds))
+        return E_FAIL;
+
     return hr;
 }
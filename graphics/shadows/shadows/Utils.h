@@ -8,4 +8,10 @@ HRESULT CreatePixelShader(ID3D11Device* device, const WCHAR* szFileName, std::ve
 
 HRESULT CreateComputeShader(ID3D11Device* device, const WCHAR* szFileName, std::vector<BYTE>& bytes, ID3D11ComputeShader** computeShader);
 
+HRESULT ReadCompiledShader(const WCHAR* szFileName, std::vector<BYTE>& bytes);
+
+// Compiles through the on-disk ShaderCache, a launch with unchanged sources compiles nothing
 HRESULT CompileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut, D3D_SHADER_MACRO* pDefines=nullptr);
+
+// Reads back an R32G32B32A32_FLOAT texture with all its subresources into a DDS file
+HRESULT SaveTextureToDDS(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D* texture, const std::string& path);
@@ -1,11 +1,45 @@
 #include "VectorField.h"
+#include "FieldFile.h"
+#include "FieldKernels.h"
+#include "SparseField.h"
+#include "ThreadPool.h"
 #include <fstream>
 #include <assert.h>
-#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
 
+namespace
+{
+	// Field columns handed to a worker at once
+	size_t constexpr columnsGrain = 16;
+
+	// Texel rows handed to a worker at once
+	size_t constexpr texelRowsGrain = 32;
+
+	// apply_field visits only moving tiles when at most 1 / sparseApplyRatio of them move,
+	// a moving tile costs SparseField::Apply about five times what the vectorized kernel spends on it
+	size_t constexpr sparseApplyRatio = 8;
+
+	// Compact() keeps the tiles when at most 1 / compactRatio of them need a dense payload
+	size_t constexpr compactRatio = 8;
+
+	bool IsCompact(SparseField const& sparse)
+	{
+		return sparse.DenseTilesNum() * compactRatio <= sparse.TilesX() * sparse.TilesY();
+	}
+}
 
 VectorField* VectorField::loadFromFile(std::string const& filename)
 {
+	std::string const binaryExtension = ".vfb";
+
+	if (filename.size() >= binaryExtension.size() &&
+		filename.compare(filename.size() - binaryExtension.size(), binaryExtension.size(), binaryExtension) == 0)
+	{
+		return loadFromBinary(filename);
+	}
+
 	std::ifstream is(filename);
 
 	if (!is.is_open())
@@ -35,8 +69,7 @@ VectorField* VectorField::loadFromFile(std::string const& filename)
 		{
 			for (size_t j = y1; j < y2; ++j)
 			{
-				field->field[i][j].first = x;
-				field->field[i][j].second = y;
+				field->field.Set(i, j, x, y);
 			}
 		}
 	}
@@ -44,6 +77,18 @@ VectorField* VectorField::loadFromFile(std::string const& filename)
 	return field;
 }
 
+VectorField* VectorField::loadFromBinary(std::string const& filename)
+{
+	std::shared_ptr<FieldFile> file = FieldFile::Open(filename);
+
+	if (file == nullptr)
+	{
+		return nullptr;
+	}
+
+	return new VectorField(file);
+}
+
 // TODO:    
 std::vector<VectorField*> VectorField::loadAllFromDir(std::string const& path)
 {
@@ -83,8 +128,7 @@ VectorField* VectorField::customField(size_t width, size_t height)
 	{
 		for (size_t j = 0; j < height; ++j)
 		{
-			field->field[i][j].first = 20;
-			field->field[i][j].second = 0;
+			field->field.Set(i, j, 20, 0);
 		}
 	}
 
@@ -92,8 +136,7 @@ VectorField* VectorField::customField(size_t width, size_t height)
 	{
 		for (size_t j = 120; j < height; ++j)
 		{
-			field->field[i][j].first = 0;
-			field->field[i][j].second = 100;
+			field->field.Set(i, j, 0, 100);
 		}
 	}*/
 
@@ -101,8 +144,8 @@ VectorField* VectorField::customField(size_t width, size_t height)
 }
 
 VectorField::VectorField(size_t x, size_t y)
-	: field(x, std::vector<std::pair<int, int>>(y, { 0, 0 })),
-	transformField(x, std::vector<std::pair<int, int>>(y, { 0, 0 }))
+	: field(x, y), transformField(x, y), m_bMappedTexels{ false },
+	m_bSparseFieldChecked{ false }, m_bCompact{ false }, m_bDense{ true }
 {
 	// setHalfSpeedTransformField(2);
 	// setDiagField(4);
@@ -115,134 +158,240 @@ VectorField::VectorField(size_t x, size_t y)
 	// setField();
 
 	// SetUp 1
-	for (size_t i = 0; i < 300; ++i)
+	for (size_t i = 0; i < std::min<size_t>(300, x); ++i)
 	{
 		for (size_t j = 0; j < y; ++j)
 		{
-			field[i][j].first = 0;
-			field[i][j].second = 0;
+			field.Set(i, j, 0, 0);
 		}
 	}
 }
 
+VectorField::VectorField(std::shared_ptr<FieldFile> const& file)
+	: m_pFile{ file }, m_bMappedTexels{ true },
+	m_bSparseFieldChecked{ false }, m_bCompact{ false }, m_bDense{ true }
+{
+	FieldFile::Header const& header = file->GetHeader();
+
+	field = FieldStorage::View(file->Plane(0), file->Plane(1), header.width, header.height, header.stride);
+	transformField = FieldStorage::View(file->Plane(2), file->Plane(3), header.width, header.height, header.stride);
+}
+
 VectorField::~VectorField() {}
 
-unsigned char* VectorField::apply_field(unsigned char const* imageData, size_t x, size_t y, size_t n) const
+void VectorField::DropCachedData()
 {
-	size_t size = x * y * n;
-	unsigned char* newImageData = new unsigned char[size * sizeof(unsigned char)];
+	m_bMappedTexels = false;
 
-	if (newImageData == nullptr)
+	std::lock_guard<std::mutex> lock(m_sparseFieldMutex);
+
+	// Modifications write the planes
+	Expand();
+
+	m_pSparseField.reset();
+	m_pSparseTransform.reset();
+	m_bSparseFieldChecked = false;
+	m_bCompact = false;
+}
+
+void VectorField::Expand() const
+{
+	if (m_bDense)
 	{
-		return nullptr;
+		return;
 	}
 
-	std::memcpy(newImageData, imageData, size);
+	field = m_pSparseField->ToStorage();
+	transformField = m_pSparseTransform->ToStorage();
+	m_bDense = true;
+}
 
-	for (size_t i = 0; i < x; ++i)
+bool VectorField::Compact()
+{
+	std::lock_guard<std::mutex> lock(m_sparseFieldMutex);
+
+	if (!m_bCompact)
 	{
-		for (size_t j = 0; j < y; ++j)
+		auto sparse = std::make_shared<SparseField const>(field);
+		auto sparseTransform = std::make_shared<SparseField const>(transformField);
+
+		if (!IsCompact(*sparse) || !IsCompact(*sparseTransform))
 		{
-			std::pair<int, int> const& vec = field[i][j];
+			return false;
+		}
 
-			size_t n_i = i + vec.first;
-			size_t n_j = j + vec.second;
+		// apply_field takes the tiles from now on, the dense kernel would need the planes back
+		m_pSparseField = sparse;
+		m_pSparseTransform = sparseTransform;
+		m_bSparseFieldChecked = true;
+		m_bCompact = true;
+	}
 
-			if (n_i < x && n_j < y)
-			{
-				size_t n_ind = n * (n_j + n_i * x);
-				size_t ind = n * (j + i * x);
+	// Views of a mapped file only let go of the mapping's pages, the texels stay mapped
+	field = FieldStorage();
+	transformField = FieldStorage();
+	m_bDense = false;
 
-				newImageData[n_ind + 0] = imageData[ind + 0];
-				newImageData[n_ind + 1] = imageData[ind + 1];
-				newImageData[n_ind + 2] = imageData[ind + 2];
-			}
+	return true;
+}
+
+SparseField const* VectorField::Sparse() const
+{
+	return m_bCompact ? m_pSparseField.get() : nullptr;
+}
+
+SparseField const* VectorField::SparseTransform() const
+{
+	return m_bCompact ? m_pSparseTransform.get() : nullptr;
+}
+
+std::shared_ptr<SparseField const> VectorField::GetSparseField() const
+{
+	std::lock_guard<std::mutex> lock(m_sparseFieldMutex);
+
+	if (!m_bSparseFieldChecked)
+	{
+		auto sparse = std::make_shared<SparseField>(field);
+		if (sparse->ActiveTilesNum() * sparseApplyRatio <= sparse->TilesX() * sparse->TilesY())
+		{
+			m_pSparseField = sparse;
 		}
+
+		m_bSparseFieldChecked = true;
 	}
 
-	return newImageData;
+	return m_pSparseField;
 }
 
-float* VectorField::raw_data() const
+size_t VectorField::Width() const
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	return m_bCompact ? m_pSparseField->Width() : field.Width();
+}
 
-	size_t n = 4;
+size_t VectorField::Height() const
+{
+	return m_bCompact ? m_pSparseField->Height() : field.Height();
+}
 
-	float* srcData = new float[n * x * y];
-	assert(srcData);
+FieldStorage const& VectorField::Storage() const
+{
+	std::lock_guard<std::mutex> lock(m_sparseFieldMutex);
+	Expand();
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		for (size_t j = 0; j < y; ++j) {
-			float q = (float)field[i][j].first / (float)x;
-			float p = (float)field[i][j].second / (float)y;
+	return field;
+}
 
-			srcData[n * (i + j * x) + 0] = q;
-			srcData[n * (i + j * x) + 1] = p;
+FieldStorage const& VectorField::TransformStorage() const
+{
+	std::lock_guard<std::mutex> lock(m_sparseFieldMutex);
+	Expand();
 
-			//  
-			if (p > 0 || p < 0)
-			{
-				srcData[n * (i + j * x) + 2] = 1.0f;
-			}
-			else
-			{
-				srcData[n * (i + j * x) + 2] = 0.0f;
-			}
+	return transformField;
+}
 
-			float transformQ = (float)transformField[i][j].first / (float)x;
-			float transformP = (float)transformField[i][j].second / (float)y;
+unsigned char* VectorField::apply_field(unsigned char const* imageData, size_t x, size_t y, size_t n) const
+{
+	size_t size = x * y * n;
+	unsigned char* newImageData = new unsigned char[size * sizeof(unsigned char)];
 
-			srcData[n * (i + j * x) + 2] = transformQ;
-			srcData[n * (i + j * x) + 3] = transformP;
-		}
+	if (newImageData == nullptr)
+	{
+		return nullptr;
 	}
 
-	return srcData;
+	std::memcpy(newImageData, imageData, size);
+
+	// The tiling is built once per modification of the field
+	std::shared_ptr<SparseField const> sparse = GetSparseField();
+	if (sparse)
+	{
+		sparse->Apply(imageData, newImageData, x, y, n);
+	}
+	else
+	{
+		FieldKernels::ApplyField(field, imageData, newImageData, x, y, n);
+	}
+
+	return newImageData;
 }
 
-void VectorField::invert()
+void VectorField::raw_data(float* texels, size_t rowPitch) const
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	FieldStorage const& storage = Storage();
+	FieldStorage const& transform = TransformStorage();
 
-	std::vector<std::vector<std::pair<int, int>>> newField(x, std::vector<std::pair<int, int>>(y, { 0, 0 }));
+	size_t x = storage.Width();
+	size_t y = storage.Height();
 
-	for (int i = 0; i < x; ++i)
+	if (rowPitch == 0)
 	{
-		for (int j = 0; j < y; ++j)
+		rowPitch = 4 * x * sizeof(float);
+	}
+
+	assert(texels != nullptr && rowPitch >= 4 * x * sizeof(float));
+
+	// Workers own whole rows, so every output row is written sequentially by one thread
+	ThreadPool::Get().ParallelFor(0, y, texelRowsGrain, [&](size_t jBegin, size_t jEnd)
 		{
-			auto& vec = field[i][j];
+			FieldKernels::FieldTexels(storage, transform, texels, rowPitch, jBegin, jEnd);
+		});
+}
 
-			int new_i = i + vec.first;
-			int new_j = j + vec.second;
+void VectorField::raw_data(std::vector<float>& texels) const
+{
+	texels.resize(4 * Width() * Height());
 
-			// newField[new_i % x][new_j % y].first = -vec.first;
-			// newField[new_i % x][new_j % y].second = -vec.second;
+	raw_data(texels.data(), 0);
+}
 
-			newField[i][j].first = -vec.first;
-			newField[i][j].second = -vec.second;
-		}
-	}
+unsigned char const* VectorField::mapped_texels(FieldEncoding::Format format) const
+{
+	return m_bMappedTexels ? m_pFile->Texels(format) : nullptr;
+}
 
-	field = newField;
+unsigned char const* VectorField::mapped_transform_texels(FieldEncoding::Format format) const
+{
+	return m_bMappedTexels ? m_pFile->TransformTexels(format) : nullptr;
+}
+
+bool VectorField::saveToBinary(std::string const& filename, bool withTexels, FieldEncoding::Format format) const
+{
+	return FieldFile::Write(filename, *this, withTexels, format);
+}
+
+void VectorField::invert()
+{
+	DropCachedData();
+
+	ThreadPool::Get().ForTiles(field, [](FieldStorage::TileView const& tile)
+		{
+			for (size_t i = 0; i < tile.width; ++i)
+			{
+				FieldStorage::ColumnView column = tile.Column(i);
+
+				for (size_t j = 0; j < column.length; ++j)
+				{
+					column.dx[j] = -column.dx[j];
+					column.dy[j] = -column.dy[j];
+				}
+			}
+		});
 }
 
 void VectorField::inv()
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
+
+	size_t x = field.Width();
+	size_t y = field.Height();
 
 	for (size_t i = 0; i < x; ++i)
 	{
 		for (size_t j = 0; j < y; ++j)
 		{
-			elem_t elem = field[i][j];
+			elem_t elem = field.Get(i, j);
 
-			field[i + elem.first][j + elem.second].first = -elem.first;
-			field[i + elem.first][j + elem.second].second = -elem.second;
+			field.Set(i + elem.first, j + elem.second, -elem.first, -elem.second);
 		}
 	}
 
@@ -250,25 +399,29 @@ void VectorField::inv()
 
 void VectorField::setCycleField()
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
+
+	size_t x = field.Width();
+	size_t y = field.Height();
 
 
 	for (size_t j = 0; j < y; ++j)
 	{
-		int speed_x = field[0][j].first;
+		int speed_x = field.DX(0, j);
 
-		for (size_t i = 0; i < speed_x; ++i)
+		for (int i = 0; i < speed_x; ++i)
 		{
-			field[x - i - 1][j] = std::make_pair(-((int)x - speed_x), field[x - i - 1][j].second);
+			field.DX(x - i - 1, j) = -((int)x - speed_x);
 		}
 	}
 }
 
 void VectorField::setHalfSpeedTransformField(int speed)
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
+
+	size_t x = field.Width();
+	size_t y = field.Height();
 
 	size_t half_y = y / 2;
 
@@ -276,139 +429,147 @@ void VectorField::setHalfSpeedTransformField(int speed)
 	{
 		for (size_t j = 0; j < half_y; ++j)
 		{
-			field[i][j] = std::make_pair(speed, 0);
+			field.Set(i, j, speed, 0);
 		}
 	}
 }
 
 void VectorField::setDiagField(size_t turnsNum)
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
 
-	size_t len = (size_t)(x / pow(2, turnsNum));
+	size_t x = field.Width();
 
-	int direction = 1;
-	size_t p_counter = 0;
+	size_t len = (size_t)(x / pow(2, turnsNum));
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		if (p_counter == len)
+	// Direction flips every `len` columns, a zero length flips it once before the first column
+	ThreadPool::Get().ForTiles(field, [len](FieldStorage::TileView const& tile)
 		{
-			direction *= -1;
-			p_counter = 0;
-		}
-		++p_counter;
+			for (size_t i = 0; i < tile.width; ++i)
+			{
+				size_t turns = len == 0 ? 1 : (tile.x0 + i) / len;
+				int direction = turns % 2 == 0 ? 1 : -1;
 
-		for (size_t j = 0; j < y; ++j)
-		{
-			field[i][j].second = 1 * direction;
-		}
-	}
+				FieldStorage::ColumnView column = tile.Column(i);
+
+				for (size_t j = 0; j < column.length; ++j)
+				{
+					column.dy[j] = 1 * direction;
+				}
+			}
+		});
 }
 
 void VectorField::setCircleField()
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
-
-	int centerX = (int)x / 2;
-	int centerY = (int)y / 2;
+	DropCachedData();
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		for (size_t j = 0; j < y; ++j)
+	ThreadPool::Get().ForTiles(field, [](FieldStorage::TileView const& tile)
 		{
+			for (size_t i = 0; i < tile.width; ++i)
+			{
+				FieldStorage::ColumnView column = tile.Column(i);
 
-			int newX = (int)i - centerX;
-			int newY = (int)j - centerY;
-
-			field[i][j].first = -(int)j;
-			field[i][j].second = (int)i;
-		}
-	}
-
+				for (size_t j = 0; j < column.length; ++j)
+				{
+					column.dx[j] = -(int)(tile.y0 + j);
+					column.dy[j] = (int)(tile.x0 + i);
+				}
+			}
+		});
 }
 
 void VectorField::setSinField()
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
 
-	int centerX = (int)x / 2;
-	int centerY = (int)y / 2;
+	size_t y = field.Height();
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		for (size_t j = 0; j < y; ++j)
+	ThreadPool::Get().ForTiles(field, [y](FieldStorage::TileView const& tile)
 		{
-			if (i > j && i >= y - j)
-			{
-				field[i][j].first = 0;
-				field[i][j].second = 20;
-			}
-
-			if (i >= j && i < y - j)
-			{
-				field[i][j].first = 20;
-				field[i][j].second = 0;
-			}
-
-			if (i < j && i <= y - j)
+			for (size_t ti = 0; ti < tile.width; ++ti)
 			{
-				field[i][j].first = 0;
-				field[i][j].second = -20;
+				FieldStorage::ColumnView column = tile.Column(ti);
+				size_t i = tile.x0 + ti;
+
+				for (size_t tj = 0; tj < column.length; ++tj)
+				{
+					size_t j = tile.y0 + tj;
+
+					if (i > j && i >= y - j)
+					{
+						column.dx[tj] = 0;
+						column.dy[tj] = 20;
+					}
+
+					if (i >= j && i < y - j)
+					{
+						column.dx[tj] = 20;
+						column.dy[tj] = 0;
+					}
+
+					if (i < j && i <= y - j)
+					{
+						column.dx[tj] = 0;
+						column.dy[tj] = -20;
+					}
+
+					if (i <= j && i > y - j)
+					{
+						column.dx[tj] = -20;
+						column.dy[tj] = 0;
+					}
+				}
 			}
-
-			if (i <= j && i > y - j)
-			{
-				field[i][j].first = -20;
-				field[i][j].second = 0;
-			}
-		}
-	}
+		});
 }
 
 void VectorField::setField()
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		for (size_t j = 0; j < y; ++j)
+	size_t y = field.Height();
+
+	ThreadPool::Get().ForTiles(field, [y](FieldStorage::TileView const& tile)
 		{
-			field[i][j].first = (int)(100 * sin(3.141 * j / (float(y) / 2)));
-			field[i][j].second = 0;
-		}
-	}
+			for (size_t i = 0; i < tile.width; ++i)
+			{
+				FieldStorage::ColumnView column = tile.Column(i);
+
+				for (size_t j = 0; j < column.length; ++j)
+				{
+					column.dx[j] = (int)(100 * sin(3.141 * (tile.y0 + j) / (float(y) / 2)));
+					column.dy[j] = 0;
+				}
+			}
+		});
 }
 
 void VectorField::setSnakeField()
 {
-	size_t x = field.size();
-	size_t y = field[0].size();
+	DropCachedData();
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		for (size_t j = 0; j < y; ++j)
+	ThreadPool::Get().ForTiles(field, [](FieldStorage::TileView const& tile)
 		{
-			field[i][j].first = 0;
-			field[i][j].second = 0;
-		}
-	}
+			for (size_t i = 0; i < tile.width; ++i)
+			{
+				FieldStorage::ColumnView column = tile.Column(i);
 
-	for (size_t i = 0; i < x; ++i)
-	{
-		for (size_t j = 0; j < 290; ++j)
-		{
-			field[i][j].first = (int)(15 * sin(3.141 * j / (290.0 / 2)));
-		}
-	}
+				for (size_t j = 0; j < column.length; ++j)
+				{
+					size_t y = tile.y0 + j;
+
+					column.dx[j] = y < 290 ? (int)(15 * sin(3.141 * y / (290.0 / 2))) : 0;
+					column.dy[j] = 0;
+				}
+			}
+		});
 }
 
 void VectorField::AddDots1()
 {
+	DropCachedData();
+
 	std::vector<std::pair<int, int>> srcDots;
 	std::vector<std::pair<int, int>> dstDots;
 
@@ -436,25 +597,19 @@ void VectorField::AddDots1()
 		auto& dst = dstDots[j];
 		auto& src = srcDots[j];
 
-		field[dst.first][dst.second] = { src.first - dst.first, src.second - dst.second };
-		transformField[dst.first][dst.second] = { src.first - dst.first, src.second - dst.second };
+		field.Set(dst.first, dst.second, src.first - dst.first, src.second - dst.second);
+		transformField.Set(dst.first, dst.second, src.first - dst.first, src.second - dst.second);
 	}
 }
 
 void VectorField::AddDots2()
 {
+	DropCachedData();
+
 	std::vector<std::pair<int, int>> srcDots;
 	std::vector<std::pair<int, int>> dstDots;
 
-	/// :(
-	for (size_t i = 0; i < field.size(); ++i)
-	{
-		for (size_t j = 0; j < field[i].size(); ++j)
-		{
-			transformField[i][j].first = field[i][j].first;
-			transformField[i][j].second = field[i][j].second;
-		}
-	}
+	transformField = field;
 
 	for (int j = 25; j < 55; ++j)
 	{
@@ -496,14 +651,16 @@ void VectorField::AddDots2()
 		auto& dst = dstDots[j];
 		auto& src = srcDots[j];
 
-		field[dst.first][dst.second] = { src.first - dst.first, src.second - dst.second };
-		transformField[dst.first][dst.second] = { -field[src.first][src.second].first, -field[src.first][src.second].second };
+		field.Set(dst.first, dst.second, src.first - dst.first, src.second - dst.second);
+		transformField.Set(dst.first, dst.second, -field.DX(src.first, src.second), -field.DY(src.first, src.second));
 	}
 
 }
 
 void VectorField::AddDots3()
 {
+	DropCachedData();
+
 	std::vector<std::pair<int, int>> srcDots;
 	std::vector<std::pair<int, int>> dstDots;
 
@@ -531,13 +688,15 @@ void VectorField::AddDots3()
 		auto& dst = dstDots[j];
 		auto& src = srcDots[j];
 
-		field[dst.first][dst.second] = { src.first - dst.first, src.second - dst.second };
-		transformField[dst.first][dst.second] = { -field[src.first][src.second].first, -field[src.first][src.second].second };
+		field.Set(dst.first, dst.second, src.first - dst.first, src.second - dst.second);
+		transformField.Set(dst.first, dst.second, -field.DX(src.first, src.second), -field.DY(src.first, src.second));
 	}
 }
 
 void VectorField::AddDots4()
 {
+	DropCachedData();
+
 	std::vector<std::pair<int, int>> srcDots;
 	std::vector<std::pair<int, int>> dstDots;
 
@@ -639,7 +798,7 @@ void VectorField::AddDots4()
 		auto& dst = dstDots[j];
 		auto& src = srcDots[j];
 
-		field[dst.first][dst.second] = { src.first - dst.first, src.second - dst.second };
-		transformField[dst.first][dst.second] = { -field[src.first][src.second].first, -field[src.first][src.second].second };
+		field.Set(dst.first, dst.second, src.first - dst.first, src.second - dst.second);
+		transformField.Set(dst.first, dst.second, -field.DX(src.first, src.second), -field.DY(src.first, src.second));
 	}
 }
@@ -1,16 +1,42 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
+
+#include "FieldEncoding.h"
+#include "FieldStorage.h"
+
+class FieldFile;
+class SparseField;
 
 class VectorField
 {
 	using elem_t = std::pair<int, int>;
 private:
-	std::vector<std::vector<elem_t>> field;
-	std::vector<std::vector<elem_t>> transformField;
+	// Dense planes, dropped by Compact() until something needs them again
+	mutable FieldStorage field;
+	mutable FieldStorage transformField;
+
+	// Set when planes view a mapped *.vfb file
+	std::shared_ptr<FieldFile> m_pFile;
+	// The file's encoded texels still match the planes
+	bool m_bMappedTexels;
+
+	// Tiled copy of `field` for apply_field, nullptr while unbuilt or when the dense kernel is faster.
+	// Once compact the tiled field and transform are what the field is kept as.
+	mutable std::shared_ptr<SparseField const> m_pSparseField;
+	std::shared_ptr<SparseField const> m_pSparseTransform;
+	mutable bool m_bSparseFieldChecked;
+	bool m_bCompact;
+	// The planes hold the field, false while compact and not asked for them
+	mutable bool m_bDense;
+	mutable std::mutex m_sparseFieldMutex;
 
 public:
+	// *.vfb files are mapped, anything else is parsed as *.fld text
 	static VectorField* loadFromFile(std::string const& filename);
+	static VectorField* loadFromBinary(std::string const& filename);
 	static std::vector<VectorField*> loadAllFromDir(std::string const& path);
 
 	static VectorField* customField(size_t width, size_t height);
@@ -19,8 +45,32 @@ public:
 	VectorField(size_t x, size_t y);
 	~VectorField();
 
+	size_t Width() const;
+	size_t Height() const;
+
+	// Rebuilt from the tiles of a compact field, which keeps them until the next Compact()
+	FieldStorage const& Storage() const;
+	FieldStorage const& TransformStorage() const;
+
+	// Keeps the field and transform only as SparseField tiles when few of them aren't constant,
+	// so memory grows with the moving area. False if the field stays dense.
+	bool Compact();
+	// Tiles of a compact field, nullptr otherwise
+	SparseField const* Sparse() const;
+	SparseField const* SparseTransform() const;
+
 	unsigned char* apply_field(unsigned char const* imageData, size_t x, size_t y, size_t n) const;
-	float* raw_data() const;
+	// float4 texels (dx / width, dy / height, transform dx / width, transform dy / height), texel (i, j)
+	// at i floats after row j, which starts j * rowPitch bytes into `texels`; 0 is a tight pitch
+	void raw_data(float* texels, size_t rowPitch) const;
+	// Reuses the capacity of `texels`
+	void raw_data(std::vector<float>& texels) const;
+	// FieldEncoding::Encode texels of the displacement from the mapped file, nullptr if the file has none
+	// in `format` or the field was modified. With those present a nullptr transform is a zero one.
+	unsigned char const* mapped_texels(FieldEncoding::Format format) const;
+	unsigned char const* mapped_transform_texels(FieldEncoding::Format format) const;
+
+	bool saveToBinary(std::string const& filename, bool withTexels = true, FieldEncoding::Format format = FieldEncoding::Format::SNORM16) const;
 
 	void invert();
 	void inv();
@@ -38,4 +88,14 @@ public:
 	void AddDots4();
 
 	void setSnakeField();
+
+private:
+	VectorField(std::shared_ptr<FieldFile> const& file);
+
+	// Called by every modification, derived data no longer matches the field
+	void DropCachedData();
+	// Planes of a compact field, m_sparseFieldMutex held
+	void Expand() const;
+
+	std::shared_ptr<SparseField const> GetSparseField() const;
 };
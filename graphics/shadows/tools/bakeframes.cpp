@@ -0,0 +1,141 @@
+// Bakes frames of an animated layer on the CPU with ReferenceRenderer.
+//   bakeframes <layer.png|jpg> <field.fld|vfb> <frames> <output prefix> [--size N] [--scale N] [--point] [--tiles]
+//   [--field-format float32|snorm16|snorm8]
+// Writes <output prefix>NNNN.png after every step, the first one is the unmodified layer.
+// --scale advects by N field steps per frame, in passes of at most LayerBatch::maxWalkSteps, --tiles runs the steps in the thread group order of the compute path,
+// --field-format quantizes the field as AnimatedTexture uploads it.
+// Builds as the bakeframes target of bench/CMakeLists.txt, or directly from the platform-neutral sources:
+//   c++ -std=c++17 -O2 -pthread -I../shadows bakeframes.cpp ../shadows/ReferenceRenderer.cpp ../shadows/FieldEncoding.cpp ../shadows/LayerBatch.cpp ../shadows/FieldSwapper.cpp ../shadows/FieldSchedule.cpp ../shadows/FieldStream.cpp ../shadows/VectorField.cpp ../shadows/SparseField.cpp ../shadows/FieldStorage.cpp ../shadows/FieldFile.cpp ../shadows/FieldKernels.cpp ../shadows/ThreadPool.cpp
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../../stb_image_write.h"
+
+#include "ReferenceRenderer.h"
+#include "VectorField.h"
+
+namespace
+{
+	bool WriteFrame(std::string const& prefix, size_t frame, ReferenceRenderer::Image const& image)
+	{
+		char name[16];
+		std::snprintf(name, sizeof(name), "%04zu.png", frame);
+
+		return stbi_write_png((prefix + name).c_str(), (int)image.width, (int)image.height, 4, image.pixels.data(), (int)(4 * image.width)) != 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		std::fprintf(stderr, "usage: %s <layer image> <field.fld|vfb> <frames> <output prefix> [--size N] [--scale N] [--point] [--tiles] [--field-format float32|snorm16|snorm8]\n", argv[0]);
+		return 1;
+	}
+
+	size_t framesNum = (size_t)std::atoll(argv[3]);
+	std::string prefix = argv[4];
+
+	size_t size = 0;
+	size_t scale = 1;
+	ReferenceRenderer::Filter filter = ReferenceRenderer::Filter::LINEAR;
+	bool tiles = false;
+	bool encoded = false;
+	FieldEncoding::Format fieldFormat = FieldEncoding::Format::FLOAT32;
+
+	for (int i = 5; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			size = (size_t)std::atoll(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+		{
+			scale = (size_t)std::atoll(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--point") == 0)
+		{
+			filter = ReferenceRenderer::Filter::POINT;
+		}
+		else if (std::strcmp(argv[i], "--tiles") == 0)
+		{
+			tiles = true;
+		}
+		else if (std::strcmp(argv[i], "--field-format") == 0 && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			encoded = true;
+
+			for (int format = 0; format <= (int)FieldEncoding::Format::SNORM8; ++format)
+			{
+				if (name == FieldEncoding::FormatName((FieldEncoding::Format)format))
+				{
+					fieldFormat = (FieldEncoding::Format)format;
+				}
+			}
+		}
+	}
+
+	int x, y, n;
+	unsigned char* pixels = stbi_load(argv[1], &x, &y, &n, 0);
+
+	if (pixels == nullptr)
+	{
+		std::fprintf(stderr, "failed to load %s\n", argv[1]);
+		return 1;
+	}
+
+	ReferenceRenderer::Image layer = ReferenceRenderer::Image::FromPixels(pixels, x, y, n);
+	stbi_image_free(pixels);
+
+	VectorField* field = VectorField::loadFromFile(argv[2]);
+
+	if (field == nullptr)
+	{
+		std::fprintf(stderr, "failed to load %s\n", argv[2]);
+		return 1;
+	}
+
+	// Render targets match the field like the 2048x2048 AnimatedTexture targets do
+	ReferenceRenderer renderer(size ? size : field->Width(), size ? size : field->Height(), filter);
+	renderer.AddLayer(layer);
+	if (encoded)
+	{
+		if (!FieldEncoding::InRange(field->Storage(), fieldFormat) || !FieldEncoding::InRange(field->TransformStorage(), fieldFormat))
+		{
+			std::fprintf(stderr, "%s is out of %s range\n", argv[2], FieldEncoding::FormatName(fieldFormat));
+			return 1;
+		}
+
+		renderer.SetField(0, field, fieldFormat);
+	}
+	else
+	{
+		renderer.SetField(0, field);
+	}
+
+	bool result = WriteFrame(prefix, 0, renderer.GetLayer(0).Source());
+
+	for (size_t frame = 1; frame <= framesNum && result; ++frame)
+	{
+		renderer.Advance(scale, tiles);
+
+		result = WriteFrame(prefix, frame, renderer.GetLayer(0).Source());
+	}
+
+	delete field;
+
+	if (!result)
+	{
+		std::fprintf(stderr, "failed to write frames to %s\n", prefix.c_str());
+		return 1;
+	}
+
+	return 0;
+}
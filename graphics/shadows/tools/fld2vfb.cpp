@@ -0,0 +1,51 @@
+// Converts text *.fld vector fields into the mapped binary *.vfb container.
+//   fld2vfb <input.fld> <output.vfb> [--no-texels] [--field-format float32|snorm16|snorm8]
+// The texels are stored in the format AnimatedTexture uploads, snorm16 unless told otherwise.
+// Builds as the fld2vfb target of bench/CMakeLists.txt, or directly from the platform-neutral field sources:
+//   c++ -std=c++17 -O2 -pthread -I../shadows fld2vfb.cpp ../shadows/VectorField.cpp ../shadows/SparseField.cpp ../shadows/FieldStorage.cpp ../shadows/FieldFile.cpp ../shadows/FieldEncoding.cpp ../shadows/FieldKernels.cpp ../shadows/ThreadPool.cpp
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "FieldFile.h"
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::fprintf(stderr, "usage: %s <input.fld> <output.vfb> [--no-texels] [--field-format float32|snorm16|snorm8]\n", argv[0]);
+		return 1;
+	}
+
+	bool withTexels = true;
+	FieldEncoding::Format fieldFormat = FieldEncoding::Format::SNORM16;
+
+	for (int i = 3; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--no-texels") == 0)
+		{
+			withTexels = false;
+		}
+		else if (std::strcmp(argv[i], "--field-format") == 0 && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+
+			for (int format = 0; format <= (int)FieldEncoding::Format::SNORM8; ++format)
+			{
+				if (name == FieldEncoding::FormatName((FieldEncoding::Format)format))
+				{
+					fieldFormat = (FieldEncoding::Format)format;
+				}
+			}
+		}
+	}
+
+	if (!FieldFile::Convert(argv[1], argv[2], withTexels, fieldFormat))
+	{
+		std::fprintf(stderr, "failed to convert %s\n", argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+// Precomputes the image based lighting textures offline with IBLBaker.
+//   iblbake <env.hdr> <shadows source dir> <cache dir>
+// Writes the four ibl_<key>_*.dds files Renderer looks up in its IBLCache directory,
+// the key covers the HDR, the IBL shader sources and the default IBLCache::Parameters.
+// Builds as the iblbake target of bench/CMakeLists.txt, or directly from the platform-neutral sources:
+//   c++ -std=c++17 -O2 -pthread -I../shadows iblbake.cpp ../shadows/IBLBaker.cpp ../shadows/IBLCache.cpp ../shadows/DDSFile.cpp ../shadows/ThreadPool.cpp ../shadows/FieldStorage.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../stb_image.h"
+
+#include "IBLBaker.h"
+#include "IBLCache.h"
+
+namespace
+{
+	bool Write(std::string const& directory, uint64_t key, IBLCache::TEXTURE texture, DDSFile::Texture const& data)
+	{
+		std::string path = IBLCache::Path(directory, key, texture);
+
+		if (!DDSFile::Write(path, data))
+		{
+			std::fprintf(stderr, "failed to write %s\n", path.c_str());
+			return false;
+		}
+
+		std::printf("%s\n", path.c_str());
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::fprintf(stderr, "usage: %s <env.hdr> <shadows source dir> <cache dir>\n", argv[0]);
+		return 1;
+	}
+
+	std::string sourceDir = argv[2];
+	std::string cacheDir = argv[3];
+
+	std::vector<unsigned char> hdr;
+	if (!IBLCache::ReadFile(argv[1], hdr))
+	{
+		std::fprintf(stderr, "failed to read %s\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<std::vector<unsigned char>> shaderSources;
+	for (auto const& name : IBLCache::ShaderSources())
+	{
+		shaderSources.emplace_back();
+		if (!IBLCache::ReadFile(sourceDir + "/" + name, shaderSources.back()))
+		{
+			std::fprintf(stderr, "failed to read %s/%s\n", sourceDir.c_str(), name.c_str());
+			return 1;
+		}
+	}
+
+	IBLCache::Parameters parameters;
+	uint64_t key = IBLCache::Key(hdr, shaderSources, parameters);
+
+	int w, h, n;
+	float* rgba = stbi_loadf_from_memory(hdr.data(), (int)hdr.size(), &w, &h, &n, STBI_rgb_alpha);
+	if (rgba == nullptr)
+	{
+		std::fprintf(stderr, "failed to decode %s\n", argv[1]);
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	DDSFile::Texture environmentCube = IBLBaker::EnvironmentCube(rgba, (size_t)w, (size_t)h, parameters.cubeSize);
+	stbi_image_free(rgba);
+
+	bool written = Write(cacheDir, key, IBLCache::TEXTURE::ENVIRONMENT_CUBE, environmentCube)
+		&& Write(cacheDir, key, IBLCache::TEXTURE::IRRADIANCE, IBLBaker::Irradiance(environmentCube, parameters.irradianceSize))
+		&& Write(cacheDir, key, IBLCache::TEXTURE::PREFILTERED_COLOR,
+			IBLBaker::PrefilteredColor(environmentCube, parameters.prefilteredColorSize, parameters.prefilteredColorMipLevels))
+		&& Write(cacheDir, key, IBLCache::TEXTURE::PREINTEGRATED_BRDF, IBLBaker::PreintegratedBRDF(parameters.preintegratedBRDFSize));
+
+	if (!written)
+	{
+		return 1;
+	}
+
+	std::printf("baked in %.2f s\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	return 0;
+}